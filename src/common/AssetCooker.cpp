@@ -0,0 +1,576 @@
+#include "AssetCooker.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <set>
+#include <sstream>
+
+#include <AssetPack.hpp>
+#include <JobPool.hpp>
+#include <TextureCook.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+	const char* sourceDirectories[] = { "shaders", "textures", "models" };
+
+	std::string ToLower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)tolower(c); });
+		return text;
+	}
+
+	std::string Trim(std::string const& text)
+	{
+		size_t begin = text.find_first_not_of(" \t\r\n");
+		if (begin == std::string::npos) {
+			return std::string();
+		}
+
+		return text.substr(begin, text.find_last_not_of(" \t\r\n") - begin + 1);
+	}
+
+	bool ReadFile(fs::path const& path, std::vector<uint8_t>& data)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		data.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read((char*)data.data(), data.size());
+		return file.good();
+	}
+
+	void AddUnique(std::vector<std::string>& names, std::string const& name)
+	{
+		if (std::find(names.begin(), names.end(), name) == names.end()) {
+			names.push_back(name);
+		}
+	}
+
+	uint64_t HashValues(std::vector<uint64_t> const& values)
+	{
+		return AssetPack::Hash((uint8_t const*)values.data(), values.size() * sizeof(uint64_t));
+	}
+
+	uint64_t HashName(std::string const& name)
+	{
+		return AssetPack::Hash((uint8_t const*)name.data(), name.size());
+	}
+}
+
+AssetCooker::AssetCooker()
+{
+	jobPool = nullptr;
+}
+
+void AssetCooker::Init(std::string const& sourceDirectory, std::string const& outputDirectory, JobPool* jobPool)
+{
+	this->sourceDirectory = sourceDirectory;
+	this->outputDirectory = outputDirectory;
+	this->jobPool = jobPool;
+}
+
+bool AssetCooker::Build(AssetCookStats& stats, std::vector<std::string> const& changedFiles)
+{
+	std::lock_guard<std::mutex> buildLock(buildMutex);
+	auto start = std::chrono::steady_clock::now();
+
+	stats = AssetCookStats();
+
+	std::map<std::string, Source> previous;
+	std::map<std::string, uint64_t> keys;
+	{
+		std::lock_guard<std::mutex> lock(graphMutex);
+		previous = sources;
+		keys = outputKeys;
+	}
+
+	// The first build since startup picks up where the last run left off.
+	if (previous.empty()) {
+		LoadManifest(previous, keys);
+	}
+
+	std::map<std::string, Source> scanned;
+	Scan(previous, scanned, stats.hashed);
+
+	std::vector<Output> outputs = GetOutputs(scanned);
+
+	std::set<std::string> changed;
+	for (auto const& file : changedFiles) {
+		changed.insert(AssetPack::NormalizeName(file));
+	}
+
+	auto isStale = [&](Output const& output) {
+		if (!changed.empty() && std::none_of(output.inputs.begin(), output.inputs.end(), [&](std::string const& input) { return changed.count(input) > 0; })) {
+			return false;
+		}
+
+		std::error_code ec;
+		auto key = keys.find(output.name);
+		return key == keys.end() || key->second != output.key || !fs::exists(fs::path(outputDirectory) / output.name, ec);
+	};
+
+	// Textures first, one job each. Each cook spreads its mips and blocks over the pool as well.
+	std::vector<size_t> cooking;
+	std::vector<std::future<bool>> jobs;
+
+	for (size_t i = 0; i < outputs.size(); i++) {
+		if (outputs[i].pack || !isStale(outputs[i])) {
+			continue;
+		}
+
+		Output const* output = &outputs[i];
+		cooking.push_back(i);
+		jobs.push_back(jobPool->Submit([this, output]() {
+			CookSettings settings = TextureCook::GetDefaultSettings();
+			settings.normalMap = output->normalMap;
+			settings.linear = output->linear;
+
+			CookResult result;
+			return TextureCook::Cook((fs::path(sourceDirectory) / output->inputs[0]).string(), (fs::path(outputDirectory) / output->name).string(),
+				settings, *jobPool, result);
+		}));
+	}
+
+	for (size_t i = 0; i < jobs.size(); i++) {
+		jobPool->Wait(jobs[i]);
+		Output const& output = outputs[cooking[i]];
+
+		if (jobs[i].get()) {
+			keys[output.name] = output.key;
+			stats.cookedOutputs.push_back(output.name);
+			stats.cooked++;
+		}
+		else {
+			keys.erase(output.name);
+			stats.failed++;
+		}
+	}
+
+	// The pack waits until every texture is cooked and current, it would be written again once they are anyway.
+	bool texturesCurrent = std::all_of(outputs.begin(), outputs.end(), [&](Output const& output) {
+		auto key = keys.find(output.name);
+		return output.pack || (key != keys.end() && key->second == output.key);
+	});
+
+	for (Output const& output : outputs) {
+		if (!output.pack || !isStale(output)) {
+			continue;
+		}
+
+		keys.erase(output.name);
+
+		if (!texturesCurrent) {
+			printf("Skipping %s until every texture has cooked\n", output.name.c_str());
+			continue;
+		}
+
+		std::vector<PackInput> inputs;
+		for (auto const& source : scanned) {
+			inputs.push_back({ source.first, (fs::path(sourceDirectory) / source.first).string(), true });
+		}
+
+		for (Output const& texture : outputs) {
+			if (!texture.pack) {
+				inputs.push_back({ texture.name, (fs::path(outputDirectory) / texture.name).string(), false });
+			}
+		}
+
+		unsigned int compressedCount = 0;
+		if (AssetPack::Write((fs::path(outputDirectory) / output.name).string(), inputs, compressedCount)) {
+			keys[output.name] = output.key;
+			stats.cookedOutputs.push_back(output.name);
+			stats.cooked++;
+		}
+		else {
+			stats.failed++;
+		}
+	}
+
+	// Cooked textures no source makes any more are deleted, so nothing loads them in place of the missing source.
+	for (auto key = keys.begin(); key != keys.end(); ) {
+		bool known = key->first.compare(0, 7, "cooked/") != 0 ||
+			std::any_of(outputs.begin(), outputs.end(), [&](Output const& output) { return output.name == key->first; });
+
+		if (known) {
+			key++;
+			continue;
+		}
+
+		std::error_code ec;
+		bool removed = fs::remove(fs::path(outputDirectory) / key->first, ec);
+
+		if (ec) {
+			printf("Failed to remove %s: %s\n", key->first.c_str(), ec.message().c_str());
+		}
+		else if (removed) {
+			stats.removedOutputs.push_back(key->first);
+			stats.removed++;
+		}
+
+		key = keys.erase(key);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(graphMutex);
+		sources = scanned;
+		outputKeys = keys;
+	}
+
+	SaveManifest(scanned, keys);
+
+	stats.sources = scanned.size();
+	stats.outputs = outputs.size();
+	stats.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	return stats.failed == 0;
+}
+
+std::vector<std::string> AssetCooker::GetDependents(std::string const& file)
+{
+	std::lock_guard<std::mutex> lock(graphMutex);
+
+	std::map<std::string, std::vector<std::string>> users;
+	for (auto const& source : sources) {
+		for (auto const& dependency : source.second.dependencies) {
+			users[dependency].push_back(source.first);
+		}
+	}
+
+	std::vector<std::string> dependents;
+	std::vector<std::string> open = { AssetPack::NormalizeName(file) };
+
+	while (!open.empty()) {
+		std::string name = open.back();
+		open.pop_back();
+
+		for (auto const& user : users[name]) {
+			if (std::find(dependents.begin(), dependents.end(), user) == dependents.end()) {
+				dependents.push_back(user);
+				open.push_back(user);
+			}
+		}
+	}
+
+	return dependents;
+}
+
+void AssetCooker::Scan(std::map<std::string, Source> const& previous, std::map<std::string, Source>& scanned, size_t& hashed)
+{
+	hashed = 0;
+
+	for (auto directory : sourceDirectories) {
+		std::error_code ec;
+		fs::path root = fs::path(sourceDirectory) / directory;
+
+		if (!fs::is_directory(root, ec)) {
+			continue;
+		}
+
+		for (auto const& entry : fs::recursive_directory_iterator(root, ec)) {
+			if (!entry.is_regular_file()) {
+				continue;
+			}
+
+			std::string name = entry.path().lexically_relative(sourceDirectory).generic_string();
+
+			Source source = {};
+			source.size = entry.file_size();
+			source.time = (int64_t)entry.last_write_time().time_since_epoch().count();
+
+			auto known = previous.find(name);
+			if (known != previous.end() && known->second.size == source.size && known->second.time == source.time) {
+				scanned[name] = known->second;
+				continue;
+			}
+
+			std::vector<uint8_t> data;
+			if (!ReadFile(entry.path(), data)) {
+				printf("Failed to read %s\n", entry.path().string().c_str());
+				continue;
+			}
+
+			source.hash = AssetPack::Hash(data.data(), data.size());
+			ParseDependencies(name, data, source);
+
+			scanned[name] = source;
+			hashed++;
+		}
+	}
+
+	ResolveDependencies(scanned);
+}
+
+void AssetCooker::ParseDependencies(std::string const& name, std::vector<uint8_t> const& data, Source& source)
+{
+	std::string extension = ToLower(fs::path(name).extension().string());
+	fs::path directory = fs::path(name).parent_path();
+	bool shader = name.compare(0, 8, "shaders/") == 0;
+
+	if (extension != ".obj" && extension != ".mtl" && !shader) {
+		return;
+	}
+
+	std::istringstream text(std::string(data.begin(), data.end()));
+	std::string line;
+	std::set<std::string> colorMaps;
+
+	while (std::getline(text, line)) {
+		line = Trim(line);
+
+		if (extension == ".obj") {
+			if (line.compare(0, 7, "mtllib ") == 0) {
+				std::istringstream libraries(line.substr(7));
+				std::string library;
+
+				while (libraries >> library) {
+					AddUnique(source.dependencies, AssetPack::NormalizeName((directory / library).string()));
+				}
+			}
+		}
+		else if (extension == ".mtl") {
+			size_t space = line.find_first_of(" \t");
+			if (space == std::string::npos) {
+				continue;
+			}
+
+			std::string key = ToLower(line.substr(0, space));
+			// bump and disp are scalar height maps, only norm is a tangent space normal map.
+			bool normal = key == "norm";
+			bool data = key == "map_bump" || key == "bump" || key == "map_disp" || key == "disp";
+
+			if (key.compare(0, 4, "map_") != 0 && !normal && !data && key != "refl") {
+				continue;
+			}
+
+			// The model loader keeps only the file name and looks for it in textures/, see Model::LoadMaterials.
+			std::string path = Trim(line.substr(space + 1));
+			size_t slash = path.find_last_of("\\/");
+			std::string file = path.substr(slash != std::string::npos ? slash + 1 : path.find_last_of(" \t") + 1);
+
+			if (file.empty()) {
+				continue;
+			}
+
+			std::string texture = "textures/" + file;
+			AddUnique(source.dependencies, texture);
+
+			if (normal) {
+				AddUnique(source.normalMaps, texture);
+			}
+			else if (data) {
+				AddUnique(source.dataMaps, texture);
+			}
+			else {
+				colorMaps.insert(texture);
+			}
+		}
+		else if (line.compare(0, 8, "#include") == 0) {
+			size_t open = line.find('"');
+			size_t close = line.find('"', open + 1);
+
+			if (open != std::string::npos && close != std::string::npos) {
+				AddUnique(source.dependencies, AssetPack::NormalizeName((directory / line.substr(open + 1, close - open - 1)).string()));
+			}
+		}
+	}
+
+	// A texture this library also samples as colour is neither a normal map nor data.
+	auto isColor = [&](std::string const& texture) { return colorMaps.count(texture) > 0; };
+	source.normalMaps.erase(std::remove_if(source.normalMaps.begin(), source.normalMaps.end(), isColor), source.normalMaps.end());
+	source.dataMaps.erase(std::remove_if(source.dataMaps.begin(), source.dataMaps.end(), isColor), source.dataMaps.end());
+}
+
+void AssetCooker::ResolveDependencies(std::map<std::string, Source>& scanned)
+{
+	// Material libraries written on Windows name textures in whatever case.
+	std::map<std::string, std::string> names;
+	for (auto const& source : scanned) {
+		names[ToLower(source.first)] = source.first;
+	}
+
+	auto resolve = [&](std::string& dependency) {
+		auto name = names.find(ToLower(dependency));
+		if (name != names.end()) {
+			dependency = name->second;
+		}
+	};
+
+	for (auto& source : scanned) {
+		std::for_each(source.second.dependencies.begin(), source.second.dependencies.end(), resolve);
+		std::for_each(source.second.normalMaps.begin(), source.second.normalMaps.end(), resolve);
+		std::for_each(source.second.dataMaps.begin(), source.second.dataMaps.end(), resolve);
+	}
+}
+
+std::vector<AssetCooker::Output> AssetCooker::GetOutputs(std::map<std::string, Source> const& scanned)
+{
+	std::vector<Output> outputs;
+
+	// A texture every material using it uses as a normal map cooks as one, as height data it cooks linear.
+	std::map<std::string, std::vector<std::string>> libraries;
+	std::set<std::string> colorUse, normalUse, dataUse;
+
+	for (auto const& source : scanned) {
+		if (ToLower(fs::path(source.first).extension().string()) != ".mtl") {
+			continue;
+		}
+
+		for (auto const& texture : source.second.dependencies) {
+			libraries[texture].push_back(source.first);
+
+			auto const& normalMaps = source.second.normalMaps;
+			auto const& dataMaps = source.second.dataMaps;
+
+			if (std::find(normalMaps.begin(), normalMaps.end(), texture) != normalMaps.end()) {
+				normalUse.insert(texture);
+			}
+			else if (std::find(dataMaps.begin(), dataMaps.end(), texture) != dataMaps.end()) {
+				dataUse.insert(texture);
+			}
+			else {
+				colorUse.insert(texture);
+			}
+		}
+	}
+
+	for (auto const& source : scanned) {
+		if (source.first.compare(0, 9, "textures/") != 0 || !TextureCook::IsImage(source.first)) {
+			continue;
+		}
+
+		Output output;
+		output.name = (fs::path("cooked") / source.first).replace_extension(".ktx2").generic_string();
+		output.inputs = { source.first };
+		output.inputs.insert(output.inputs.end(), libraries[source.first].begin(), libraries[source.first].end());
+		output.normalMap = normalUse.count(source.first) > 0 && colorUse.count(source.first) == 0 && dataUse.count(source.first) == 0;
+		output.linear = dataUse.count(source.first) > 0 && colorUse.count(source.first) == 0 && !output.normalMap;
+		output.pack = false;
+		output.key = HashValues({ source.second.hash, TextureCook::version, output.normalMap ? 1ull : 0ull, output.linear ? 1ull : 0ull });
+
+		outputs.push_back(output);
+	}
+
+	if (!packPath.empty()) {
+		Output pack;
+		pack.name = AssetPack::NormalizeName(packPath);
+		pack.normalMap = false;
+		pack.linear = false;
+		pack.pack = true;
+
+		std::vector<uint64_t> values = { packVersion };
+
+		for (auto const& source : scanned) {
+			pack.inputs.push_back(source.first);
+			values.push_back(HashName(source.first));
+			values.push_back(source.second.hash);
+		}
+
+		for (Output const& texture : outputs) {
+			values.push_back(HashName(texture.name));
+			values.push_back(texture.key);
+		}
+
+		pack.key = HashValues(values);
+		outputs.push_back(pack);
+	}
+
+	return outputs;
+}
+
+std::string AssetCooker::GetManifestPath()
+{
+	return (fs::path(outputDirectory) / "cooked" / "manifest.txt").string();
+}
+
+bool AssetCooker::LoadManifest(std::map<std::string, Source>& previous, std::map<std::string, uint64_t>& keys)
+{
+	std::ifstream file(GetManifestPath());
+	if (!file.is_open()) {
+		return false;
+	}
+
+	// Tab separated: source name hash size time, depends, normal and data name other, output name key.
+	std::string line;
+	if (!std::getline(file, line) || line != "asset_manifest\t" + std::to_string(manifestVersion)) {
+		return false;
+	}
+
+	while (std::getline(file, line)) {
+		std::vector<std::string> fields;
+		std::istringstream text(line);
+		std::string field;
+
+		while (std::getline(text, field, '\t')) {
+			fields.push_back(field);
+		}
+
+		if (fields.size() == 5 && fields[0] == "source") {
+			Source& source = previous[fields[1]];
+			source.hash = strtoull(fields[2].c_str(), nullptr, 16);
+			source.size = strtoull(fields[3].c_str(), nullptr, 10);
+			source.time = strtoll(fields[4].c_str(), nullptr, 10);
+		}
+		else if (fields.size() == 3 && fields[0] == "depends") {
+			previous[fields[1]].dependencies.push_back(fields[2]);
+		}
+		else if (fields.size() == 3 && fields[0] == "normal") {
+			previous[fields[1]].normalMaps.push_back(fields[2]);
+		}
+		else if (fields.size() == 3 && fields[0] == "data") {
+			previous[fields[1]].dataMaps.push_back(fields[2]);
+		}
+		else if (fields.size() == 3 && fields[0] == "output") {
+			keys[fields[1]] = strtoull(fields[2].c_str(), nullptr, 16);
+		}
+	}
+
+	return true;
+}
+
+bool AssetCooker::SaveManifest(std::map<std::string, Source> const& scanned, std::map<std::string, uint64_t> const& keys)
+{
+	std::error_code ec;
+	fs::create_directories(fs::path(GetManifestPath()).parent_path(), ec);
+
+	std::ofstream file(GetManifestPath());
+	if (!file.is_open()) {
+		printf("Failed to write %s\n", GetManifestPath().c_str());
+		return false;
+	}
+
+	char number[32];
+	file << "asset_manifest\t" << manifestVersion << "\n";
+
+	for (auto const& source : scanned) {
+		snprintf(number, sizeof(number), "%016llx", (unsigned long long)source.second.hash);
+		file << "source\t" << source.first << "\t" << number << "\t" << source.second.size << "\t" << source.second.time << "\n";
+
+		for (auto const& dependency : source.second.dependencies) {
+			file << "depends\t" << source.first << "\t" << dependency << "\n";
+		}
+
+		for (auto const& texture : source.second.normalMaps) {
+			file << "normal\t" << source.first << "\t" << texture << "\n";
+		}
+
+		for (auto const& texture : source.second.dataMaps) {
+			file << "data\t" << source.first << "\t" << texture << "\n";
+		}
+	}
+
+	for (auto const& key : keys) {
+		snprintf(number, sizeof(number), "%016llx", (unsigned long long)key.second);
+		file << "output\t" << key.first << "\t" << number << "\n";
+	}
+
+	return (bool)file;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+class JobPool;
+
+struct AssetCookStats {
+	size_t sources;
+	size_t hashed;			// sources read again because their size or time changed
+	size_t outputs;
+	size_t cooked;
+	size_t failed;
+	size_t removed;			// cooked files whose source is gone
+	float milliseconds;
+
+	std::vector<std::string> cookedOutputs;
+	std::vector<std::string> removedOutputs;
+};
+
+// Incremental asset build. The sources under shaders/, textures/ and models/ form a graph, an
+// OBJ depending on its material libraries, a material library on its textures and a shader on
+// what it #includes. Every output is keyed by a hash of its inputs' contents and its cooker's
+// version, and only outputs whose key changed are cooked again, spread over the job pool. Keys
+// and source hashes live in a manifest next to the outputs; a source is only read again when
+// its size or modification time changed.
+//
+// The outputs are a cooked KTX2 per texture and optionally the asset pack of everything. A texture
+// materials only use as a tangent space normal map (norm) cooks as one, a texture they only use as
+// scalar data, a bump or displacement height map, cooks without the sRGB curve.
+class AssetCooker {
+public:
+	static constexpr uint32_t manifestVersion = 2;
+
+	AssetCooker();
+
+	// Outputs and the manifest go under outputDirectory, as the engine looks for them there.
+	void Init(std::string const& sourceDirectory, std::string const& outputDirectory, JobPool* jobPool);
+
+	// Written after the cooked textures, from the sources and them, empty for none.
+	void SetPackPath(std::string const& path) { packPath = path; }
+
+	// Rescans the sources and cooks every stale output, or only those fed by one of changedFiles
+	// when any are given. Names are relative to the source directory. One build runs at a time.
+	bool Build(AssetCookStats& stats, std::vector<std::string> const& changedFiles = {});
+
+	// Sources using file directly or through others, as of the last build.
+	std::vector<std::string> GetDependents(std::string const& file);
+
+private:
+	struct Source {
+		uint64_t hash;
+		uint64_t size;
+		int64_t time;
+
+		// Other sources by name. The textures a material library uses as normal maps are also in
+		// normalMaps, those it uses as height maps in dataMaps.
+		std::vector<std::string> dependencies;
+		std::vector<std::string> normalMaps;
+		std::vector<std::string> dataMaps;
+	};
+
+	struct Output {
+		std::string name;
+		std::vector<std::string> inputs;
+		uint64_t key;
+		bool normalMap;
+		bool linear;
+		bool pack;
+	};
+
+	std::string sourceDirectory;
+	std::string outputDirectory;
+	std::string packPath;
+	JobPool* jobPool;
+
+	// One Build at a time, the graph is swapped in under its own lock so GetDependents doesn't wait on cooking.
+	std::mutex buildMutex;
+	std::mutex graphMutex;
+	std::map<std::string, Source> sources;
+	std::map<std::string, uint64_t> outputKeys;
+
+	void Scan(std::map<std::string, Source> const& previous, std::map<std::string, Source>& scanned, size_t& hashed);
+	void ParseDependencies(std::string const& name, std::vector<uint8_t> const& data, Source& source);
+	void ResolveDependencies(std::map<std::string, Source>& scanned);
+	std::vector<Output> GetOutputs(std::map<std::string, Source> const& scanned);
+
+	bool LoadManifest(std::map<std::string, Source>& previous, std::map<std::string, uint64_t>& keys);
+	bool SaveManifest(std::map<std::string, Source> const& scanned, std::map<std::string, uint64_t> const& keys);
+	std::string GetManifestPath();
+};
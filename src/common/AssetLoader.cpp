@@ -0,0 +1,266 @@
+#include "AssetLoader.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+AssetLoader::AssetLoader()
+{
+	jobPool = nullptr;
+	stagingBufferSize = 0;
+	nextStagingBuffer = 0;
+	placeholderTexture = 0;
+	budgetMilliseconds = 2.f;
+	budgetBytes = 16 << 20;
+	stats = {};
+}
+
+void AssetLoader::Init(JobPool* jobPool, size_t stagingBufferSize, unsigned int stagingBufferCount)
+{
+	this->jobPool = jobPool;
+	this->stagingBufferSize = stagingBufferSize;
+
+	stagingBuffers.resize(stagingBufferCount);
+
+	for (auto& staging : stagingBuffers) {
+		glGenBuffers(1, &staging.buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, stagingBufferSize, nullptr, GL_STREAM_DRAW);
+		staging.fence = 0;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// Mid grey so untextured surfaces still show their lighting while streaming.
+	unsigned char grey[] = { 128, 128, 128, 255 };
+
+	glGenTextures(1, &placeholderTexture);
+	glBindTexture(GL_TEXTURE_2D, placeholderTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Texture::SetPlaceholder(placeholderTexture);
+
+	// Loose textures build their mips on the CPU while being read, OBJ models parse in chunks.
+	Texture::SetJobPool(jobPool);
+	Model::SetJobPool(jobPool);
+}
+
+void AssetLoader::Shutdown()
+{
+	for (auto& job : jobs) {
+		job.wait();
+	}
+	jobs.clear();
+
+	finished.clear();
+	uploads.clear();
+
+	for (auto& staging : stagingBuffers) {
+		if (staging.fence) {
+			glDeleteSync(staging.fence);
+		}
+		glDeleteBuffers(1, &staging.buffer);
+	}
+	stagingBuffers.clear();
+
+	Texture::SetJobPool(nullptr);
+	Model::SetJobPool(nullptr);
+
+	if (placeholderTexture) {
+		Texture::SetPlaceholder(0);
+		glDeleteTextures(1, &placeholderTexture);
+		placeholderTexture = 0;
+	}
+}
+
+void AssetLoader::LoadTexture(Texture* texture, bool hasAlpha)
+{
+	stats.assetsQueued++;
+
+	texture->SetAlpha(hasAlpha);
+
+	jobs.push_back(jobPool->Submit([this, texture]() {
+		if (!texture->ReadImage()) {
+			PostFinished([this]() { stats.assetsLoaded++; });
+			return;
+		}
+
+		PostFinished([this, texture]() { QueueUpload(texture); });
+	}));
+}
+
+void AssetLoader::LoadModel(Model* model, std::string const& fileName)
+{
+	stats.assetsQueued++;
+
+	jobs.push_back(jobPool->Submit([this, model, fileName]() {
+		if (!model->ImportModel(fileName)) {
+			PostFinished([this]() { stats.assetsLoaded++; });
+			return;
+		}
+
+		PostFinished([this, model, fileName]() {
+			model->UploadMeshes();
+
+			for (auto texture : model->GetTextures()) {
+				stats.assetsQueued++;
+				QueueUpload(texture);
+			}
+
+			stats.assetsLoaded++;
+			printf("Model %s loaded \n", fileName.c_str());
+		});
+	}));
+}
+
+void AssetLoader::Update()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	stats.frameBytes = 0;
+
+	std::vector<std::function<void()>> continuations;
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		continuations.swap(finished);
+	}
+
+	for (auto& continuation : continuations) {
+		continuation();
+	}
+
+	jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](std::future<void>& job) {
+		return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}), jobs.end());
+
+	// Staged rows are tightly packed, RGB rows aren't necessarily 4 byte aligned.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	while (!uploads.empty()) {
+		float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (stats.frameBytes > 0 && (elapsed >= budgetMilliseconds || stats.frameBytes >= budgetBytes)) {
+			break;
+		}
+
+		if (!UploadSlice()) {
+			break;
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	stats.frameMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	stats.frameBudgetUsage = stats.frameMilliseconds / budgetMilliseconds;
+}
+
+bool AssetLoader::IsIdle()
+{
+	return jobs.empty() && uploads.empty() && stats.assetsLoaded >= stats.assetsQueued;
+}
+
+void AssetLoader::PostFinished(std::function<void()> continuation)
+{
+	std::lock_guard<std::mutex> lock(finishedMutex);
+	finished.push_back(std::move(continuation));
+}
+
+void AssetLoader::QueueUpload(Texture* texture)
+{
+	// Cooked textures are a fraction of the size and already carry their mips,
+	// they go up in one call instead of through the row slices.
+	if (texture->IsCompressed()) {
+		size_t size = texture->GetCompressedSize();
+
+		texture->UploadImage();
+
+		stats.bytesQueued += size;
+		stats.bytesUploaded += size;
+		stats.frameBytes += size;
+		stats.assetsLoaded++;
+		return;
+	}
+
+	if (!texture->GetPixels()) {
+		stats.assetsLoaded++;
+		return;
+	}
+
+	for (unsigned int level = 0; level < texture->GetLevelCount(); level++) {
+		stats.bytesQueued += texture->GetRowSize(level) * texture->GetHeight(level);
+	}
+	uploads.push_back({ texture, 0, 0 });
+}
+
+bool AssetLoader::UploadSlice()
+{
+	StagingBuffer& staging = stagingBuffers[nextStagingBuffer];
+
+	// The GPU is still reading the oldest slice in the ring, try again next frame.
+	if (staging.fence) {
+		if (glClientWaitSync(staging.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+			return false;
+		}
+
+		glDeleteSync(staging.fence);
+		staging.fence = 0;
+	}
+
+	TextureUpload& upload = uploads.front();
+	Texture* texture = upload.texture;
+
+	if (upload.level == 0 && upload.nextRow == 0) {
+		texture->BeginUpload();
+	}
+
+	size_t rowSize = texture->GetRowSize(upload.level);
+	GLsizei rowCount = (GLsizei)std::max<size_t>(1, stagingBufferSize / rowSize);
+	rowCount = std::min<GLsizei>(rowCount, texture->GetHeight(upload.level) - upload.nextRow);
+
+	size_t sliceSize = rowSize * rowCount;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+
+	if (sliceSize > stagingBufferSize) {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, sliceSize, nullptr, GL_STREAM_DRAW);
+		stagingBufferSize = sliceSize;
+	}
+
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, sliceSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	memcpy(mapped, texture->GetPixels(upload.level) + rowSize * upload.nextRow, sliceSize);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	// With an unpack buffer bound the data pointer is an offset into it.
+	texture->UploadRows(upload.level, upload.nextRow, rowCount, nullptr);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	nextStagingBuffer = (nextStagingBuffer + 1) % stagingBuffers.size();
+
+	upload.nextRow += rowCount;
+	stats.frameBytes += sliceSize;
+	stats.bytesUploaded += sliceSize;
+
+	if (upload.nextRow >= texture->GetHeight(upload.level)) {
+		upload.level++;
+		upload.nextRow = 0;
+	}
+
+	if (upload.level >= (GLint)texture->GetLevelCount()) {
+		texture->EndUpload();
+		uploads.pop_front();
+		stats.assetsLoaded++;
+	}
+
+	return true;
+}
+
+AssetLoader::~AssetLoader()
+{
+	Shutdown();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <future>
+#include <functional>
+
+#include <GL\glew.h>
+
+#include <JobPool.hpp>
+#include <Texture.hpp>
+#include <Model.hpp>
+
+// Loads models and textures in the background. File I/O, decoding and the
+// Assimp import run on the job pool; texture data is then copied through a
+// small ring of pixel unpack buffers and uploaded a few rows of one mip level at a time within
+// a per-frame budget. Textures sample a placeholder until fully resident.
+class AssetLoader {
+public:
+	struct Stats {
+		unsigned int assetsQueued;
+		unsigned int assetsLoaded;
+
+		size_t bytesQueued;
+		size_t bytesUploaded;
+
+		// Last Update() only.
+		size_t frameBytes;
+		float frameMilliseconds;
+		float frameBudgetUsage;
+	};
+
+	AssetLoader();
+
+	void Init(JobPool* jobPool, size_t stagingBufferSize = 4 << 20, unsigned int stagingBufferCount = 3);
+	void Shutdown();
+
+	void LoadTexture(Texture* texture, bool hasAlpha);
+	void LoadModel(Model* model, std::string const& fileName);
+
+	void SetFrameBudget(float milliseconds, size_t bytes) { budgetMilliseconds = milliseconds; budgetBytes = bytes; }
+
+	// Runs the GL side of finished loads and uploads as much texture data as
+	// the frame budget allows. Call once per frame from the main thread.
+	void Update();
+
+	bool IsIdle();
+	Stats const& GetStats() { return stats; }
+
+	~AssetLoader();
+
+private:
+	struct StagingBuffer {
+		GLuint buffer;
+		GLsync fence;
+	};
+
+	struct TextureUpload {
+		Texture* texture;
+		GLint level;
+		GLint nextRow;
+	};
+
+	JobPool* jobPool;
+
+	std::vector<std::future<void>> jobs;
+
+	// Continuations posted by the workers that have to run on the GL thread.
+	std::mutex finishedMutex;
+	std::vector<std::function<void()>> finished;
+
+	std::deque<TextureUpload> uploads;
+
+	std::vector<StagingBuffer> stagingBuffers;
+	size_t stagingBufferSize;
+	unsigned int nextStagingBuffer;
+
+	GLuint placeholderTexture;
+
+	float budgetMilliseconds;
+	size_t budgetBytes;
+
+	Stats stats;
+
+	void PostFinished(std::function<void()> continuation);
+	void QueueUpload(Texture* texture);
+	bool UploadSlice();
+};
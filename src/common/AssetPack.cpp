@@ -0,0 +1,361 @@
+#include "AssetPack.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+
+#include <Lz4.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+	std::atomic<size_t> fileOpens(0);
+
+	std::mutex looseMutex;
+	std::set<std::string> looseNames;
+
+	bool IsLoose(std::string const& name)
+	{
+		std::lock_guard<std::mutex> lock(looseMutex);
+		return looseNames.count(name) > 0;
+	}
+
+	bool ReadWholeFile(std::string const& path, std::vector<uint8_t>& data)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		fileOpens++;
+
+		data.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read((char*)data.data(), data.size());
+		return file.good();
+	}
+
+	uint64_t Align(uint64_t offset)
+	{
+		return (offset + packAlignment - 1) & ~(packAlignment - 1);
+	}
+}
+
+AssetPack* AssetPack::mounted = nullptr;
+
+AssetPack::AssetPack()
+{
+	header = nullptr;
+}
+
+bool AssetPack::Open(std::string const& path)
+{
+	Close();
+
+	if (!file.Open(path)) {
+		return false;
+	}
+
+	fileOpens++;
+	header = (PackHeader const*)file.GetData();
+
+	if (!Check()) {
+		printf("Pack %s is damaged or from another version\n", path.c_str());
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void AssetPack::Close()
+{
+	file.Close();
+	header = nullptr;
+}
+
+bool AssetPack::Check()
+{
+	uint64_t size = file.GetSize();
+
+	if (size < sizeof(PackHeader) || header->magic != packMagic || header->version != packVersion || header->fileSize != size) {
+		return false;
+	}
+
+	if (header->entriesOffset % alignof(PackEntry) != 0 || header->entriesOffset > size ||
+		header->entryCount > (size - header->entriesOffset) / sizeof(PackEntry)) {
+		return false;
+	}
+
+	// The names end in a terminator, so every name in them does.
+	if (header->namesOffset > size || header->namesSize == 0 || header->namesSize > size - header->namesOffset ||
+		file.GetData()[header->namesOffset + header->namesSize - 1] != 0) {
+		return false;
+	}
+
+	PackEntry const* entries = GetEntries();
+	for (uint32_t i = 0; i < header->entryCount; i++) {
+		PackEntry const& entry = entries[i];
+
+		if (entry.name >= header->namesSize || entry.offset > size || entry.storedSize > size - entry.offset ||
+			(!(entry.flags & packCompressed) && entry.storedSize != entry.size) ||
+			(i > 0 && entries[i - 1].nameHash > entry.nameHash)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+PackEntry const* AssetPack::Find(std::string const& name)
+{
+	std::string normalized = NormalizeName(name);
+	uint64_t hash = Hash((uint8_t const*)normalized.data(), normalized.size());
+
+	PackEntry const* begin = GetEntries();
+	PackEntry const* end = begin + header->entryCount;
+	PackEntry const* entry = std::lower_bound(begin, end, hash, [](PackEntry const& entry, uint64_t hash) { return entry.nameHash < hash; });
+
+	// Names that share a hash sit next to each other.
+	for (; entry != end && entry->nameHash == hash; entry++) {
+		if (normalized == GetName(*entry)) {
+			return entry;
+		}
+	}
+
+	return nullptr;
+}
+
+bool AssetPack::Read(PackEntry const& entry, PackView& view)
+{
+	uint8_t const* stored = file.GetData() + entry.offset;
+
+	if (!(entry.flags & packCompressed)) {
+		view.storage.clear();
+		view.data = stored;
+		view.size = (size_t)entry.size;
+		return true;
+	}
+
+	view.storage.resize((size_t)entry.size);
+
+	if (!Lz4::Decompress(stored, (size_t)entry.storedSize, view.storage.data(), view.storage.size())) {
+		printf("Pack entry %s failed to decompress\n", GetName(entry));
+		view.storage.clear();
+		view.data = nullptr;
+		view.size = 0;
+		return false;
+	}
+
+	view.data = view.storage.data();
+	view.size = view.storage.size();
+	return true;
+}
+
+bool AssetPack::Verify(PackEntry const& entry)
+{
+	PackView view;
+	return Read(entry, view) && Hash(view.GetData(), view.GetSize()) == entry.contentHash;
+}
+
+uint64_t AssetPack::Hash(uint8_t const* data, size_t size)
+{
+	// FNV-1a.
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ data[i]) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+std::string AssetPack::NormalizeName(std::string const& name)
+{
+	return fs::path(name).lexically_normal().generic_string();
+}
+
+bool AssetPack::Write(std::string const& path, std::vector<PackInput> const& inputs, unsigned int& compressedCount)
+{
+	struct Payload {
+		std::vector<uint8_t> stored;
+		uint64_t offset;
+	};
+
+	std::vector<PackEntry> entries(inputs.size());
+	std::vector<std::string> names(inputs.size());
+	std::vector<Payload> payloads;
+	std::vector<size_t> payloadIndices(inputs.size());
+
+	compressedCount = 0;
+
+	for (size_t i = 0; i < inputs.size(); i++) {
+		std::vector<uint8_t> data;
+		if (!ReadWholeFile(inputs[i].path, data)) {
+			printf("Failed to read %s\n", inputs[i].path.c_str());
+			return false;
+		}
+
+		names[i] = NormalizeName(inputs[i].name);
+
+		PackEntry& entry = entries[i];
+		entry = {};
+		entry.nameHash = Hash((uint8_t const*)names[i].data(), names[i].size());
+		entry.contentHash = Hash(data.data(), data.size());
+		entry.size = data.size();
+
+		// The same bytes under another name share the first one's payload.
+		size_t duplicate = 0;
+		while (duplicate < i && (entries[duplicate].contentHash != entry.contentHash || entries[duplicate].size != entry.size)) {
+			duplicate++;
+		}
+
+		if (duplicate < i) {
+			entry.flags = entries[duplicate].flags;
+			entry.storedSize = entries[duplicate].storedSize;
+			payloadIndices[i] = payloadIndices[duplicate];
+			continue;
+		}
+
+		Payload payload;
+		payload.offset = 0;
+
+		if (inputs[i].compress && !data.empty()) {
+			payload.stored.resize(Lz4::GetMaxCompressedSize(data.size()));
+			size_t compressedSize = Lz4::Compress(data.data(), data.size(), payload.stored.data(), payload.stored.size());
+
+			if (compressedSize > 0 && compressedSize <= data.size() - data.size() / 8) {
+				payload.stored.resize(compressedSize);
+				entry.flags |= packCompressed;
+				compressedCount++;
+			}
+		}
+
+		if (!(entry.flags & packCompressed)) {
+			payload.stored.swap(data);
+		}
+
+		entry.storedSize = payload.stored.size();
+		payloadIndices[i] = payloads.size();
+		payloads.push_back(std::move(payload));
+	}
+
+	std::vector<size_t> order(inputs.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return entries[a].nameHash != entries[b].nameHash ? entries[a].nameHash < entries[b].nameHash : names[a] < names[b];
+	});
+
+	for (size_t i = 1; i < order.size(); i++) {
+		if (names[order[i]] == names[order[i - 1]]) {
+			printf("%s is packed twice\n", names[order[i]].c_str());
+			return false;
+		}
+	}
+
+	std::vector<char> nameData;
+	for (size_t i : order) {
+		entries[i].name = (uint32_t)nameData.size();
+		nameData.insert(nameData.end(), names[i].begin(), names[i].end());
+		nameData.push_back(0);
+	}
+	nameData.push_back(0);
+
+	PackHeader header = {};
+	header.magic = packMagic;
+	header.version = packVersion;
+	header.entryCount = (uint32_t)entries.size();
+	header.namesSize = (uint32_t)nameData.size();
+	header.entriesOffset = sizeof(PackHeader);
+	header.namesOffset = header.entriesOffset + entries.size() * sizeof(PackEntry);
+
+	uint64_t offset = header.namesOffset + nameData.size();
+	for (Payload& payload : payloads) {
+		offset = Align(offset);
+		payload.offset = offset;
+		offset += payload.stored.size();
+	}
+	header.fileSize = offset;
+
+	std::vector<PackEntry> sorted;
+	for (size_t i : order) {
+		entries[i].offset = payloads.empty() ? 0 : payloads[payloadIndices[i]].offset;
+		sorted.push_back(entries[i]);
+	}
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out) {
+		printf("Failed to write %s\n", path.c_str());
+		return false;
+	}
+
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)sorted.data(), sorted.size() * sizeof(PackEntry));
+	out.write(nameData.data(), nameData.size());
+
+	uint64_t position = header.namesOffset + nameData.size();
+	std::vector<char> padding(packAlignment, 0);
+
+	for (Payload const& payload : payloads) {
+		out.write(padding.data(), payload.offset - position);
+		out.write((const char*)payload.stored.data(), payload.stored.size());
+		position = payload.offset + payload.stored.size();
+	}
+
+	return (bool)out;
+}
+
+bool AssetPack::Load(std::string const& name, PackView& view)
+{
+	if (LoadPacked(name, view)) {
+		return true;
+	}
+
+	if (!ReadWholeFile(name, view.storage)) {
+		view.storage.clear();
+		view.data = nullptr;
+		view.size = 0;
+		return false;
+	}
+
+	view.data = view.storage.data();
+	view.size = view.storage.size();
+	return true;
+}
+
+bool AssetPack::LoadPacked(std::string const& name, PackView& view)
+{
+	if (!mounted || IsLoose(NormalizeName(name))) {
+		return false;
+	}
+
+	PackEntry const* entry = mounted->Find(name);
+	return entry && mounted->Read(*entry, view);
+}
+
+bool AssetPack::Exists(std::string const& name)
+{
+	if (mounted && !IsLoose(NormalizeName(name)) && mounted->Find(name)) {
+		return true;
+	}
+
+	std::error_code ec;
+	return fs::exists(name, ec);
+}
+
+void AssetPack::PreferLoose(std::string const& name)
+{
+	std::lock_guard<std::mutex> lock(looseMutex);
+	looseNames.insert(NormalizeName(name));
+}
+
+size_t AssetPack::GetFileOpenCount()
+{
+	return fileOpens;
+}
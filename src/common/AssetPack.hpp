@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include <MappedFile.hpp>
+
+// All of the shaders, textures and models in one file, written by asset_packer and mapped whole.
+// A table of contents sorted by name hash comes first, then the names, then the payloads, each on
+// its own 4 KB page so a read touches no neighbour. Payloads that shrink by an eighth are stored
+// LZ4 compressed, identical payloads are stored once. Names are paths as the loaders ask for them,
+// relative to the working directory with forward slashes.
+static const uint32_t packMagic = 0x314B4150;		// "PAK1"
+static const uint32_t packVersion = 1;
+static const uint64_t packAlignment = 4096;
+
+static const uint32_t packCompressed = 1;
+
+struct PackHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t namesSize;
+	uint64_t fileSize;
+	uint64_t entriesOffset;
+	uint64_t namesOffset;
+};
+
+struct PackEntry {
+	uint64_t nameHash;
+	uint64_t contentHash;	// of the uncompressed bytes
+	uint64_t offset;
+	uint64_t storedSize;
+	uint64_t size;
+	uint32_t name;			// offset into the names
+	uint32_t flags;
+};
+
+// Bytes of one asset. Stored entries point straight into the mapping, compressed ones and loose
+// files are held in storage. Valid while the pack it came from stays open.
+class PackView {
+public:
+	PackView() : data(nullptr), size(0) {}
+
+	PackView(PackView&&) = default;
+	PackView& operator=(PackView&&) = default;
+	PackView(PackView const&) = delete;
+	PackView& operator=(PackView const&) = delete;
+
+	uint8_t const* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+	bool IsMapped() const { return data && data != storage.data(); }
+
+private:
+	friend class AssetPack;
+
+	uint8_t const* data;
+	size_t size;
+	std::vector<uint8_t> storage;
+};
+
+struct PackInput {
+	std::string name;
+	std::string path;
+	bool compress;
+};
+
+class AssetPack {
+public:
+	AssetPack();
+
+	AssetPack(AssetPack const&) = delete;
+	AssetPack& operator=(AssetPack const&) = delete;
+
+	// Maps the pack and checks its table of contents, the payloads are read as they are used.
+	bool Open(std::string const& path);
+	void Close();
+	bool IsOpen() { return header != nullptr; }
+
+	// nullptr if the pack has no such asset.
+	PackEntry const* Find(std::string const& name);
+	bool Read(PackEntry const& entry, PackView& view);
+
+	// Hashes the entry's bytes against the hash it was packed with.
+	bool Verify(PackEntry const& entry);
+
+	uint32_t GetEntryCount() { return header->entryCount; }
+	PackEntry const* GetEntries() { return (PackEntry const*)(file.GetData() + header->entriesOffset); }
+	const char* GetName(PackEntry const& entry) { return (const char*)file.GetData() + header->namesOffset + entry.name; }
+	size_t GetSize() { return file.GetSize(); }
+
+	static uint64_t Hash(uint8_t const* data, size_t size);
+	static std::string NormalizeName(std::string const& name);
+
+	static bool Write(std::string const& path, std::vector<PackInput> const& inputs, unsigned int& compressedCount);
+
+	// The loaders read through here: the mounted pack first, then the loose file. Files a hot
+	// reload copied over are read loose from then on. Mount before the loaders start.
+	static void Mount(AssetPack* pack) { mounted = pack; }
+	static bool Load(std::string const& name, PackView& view);
+	static bool LoadPacked(std::string const& name, PackView& view);
+	static bool Exists(std::string const& name);
+	static void PreferLoose(std::string const& name);
+
+	// Files opened by Load since startup, the pack counts once.
+	static size_t GetFileOpenCount();
+
+private:
+	MappedFile file;
+	PackHeader const* header;
+
+	static AssetPack* mounted;
+
+	bool Check();
+};
@@ -0,0 +1,301 @@
+#include "AssetReloader.hpp"
+
+#include <stdio.h>
+#include <filesystem>
+#include <algorithm>
+#include <memory>
+
+#include <AssetPack.hpp>
+
+namespace fs = std::filesystem;
+
+static std::string NormalizePath(std::string const& path)
+{
+	return fs::path(path).lexically_normal().generic_string();
+}
+
+AssetReloader::AssetReloader()
+	: cooker(nullptr)
+{
+}
+
+bool AssetReloader::Start(std::string const& sourceDirectory)
+{
+	this->sourceDirectory = sourceDirectory;
+
+	if (!watcher.Start(sourceDirectory, { "shaders", "textures", "models" })) {
+		return false;
+	}
+
+	printf("Watching %s for asset changes\n", fs::absolute(sourceDirectory).string().c_str());
+	return true;
+}
+
+void AssetReloader::Stop()
+{
+	watcher.Stop();
+
+	for (auto& reload : pending) {
+		reload.job.wait();
+	}
+
+	// Copies read but never swapped in are owned by their apply stage and freed with it.
+	pending.clear();
+	deferred.clear();
+}
+
+void AssetReloader::WatchShader(Shader* shader)
+{
+	shaders.push_back(shader);
+}
+
+void AssetReloader::WatchTexture(Texture* texture)
+{
+	textures.push_back(texture);
+}
+
+void AssetReloader::WatchModel(Model* model)
+{
+	models.push_back(model);
+}
+
+void AssetReloader::Update()
+{
+	for (auto const& file : watcher.PollChanges()) {
+		// A reload of the same file is still running, pick the change up once it finishes.
+		if (IsPending(file)) {
+			deferred.insert(file);
+			continue;
+		}
+
+		QueueReload(file);
+	}
+
+	// Everything that finished in the background is swapped in together at this frame boundary.
+	for (size_t i = 0; i < pending.size(); ) {
+		if (pending[i].job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			i++;
+			continue;
+		}
+
+		auto apply = pending[i].job.get();
+		if (apply) {
+			apply();
+
+			float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - pending[i].queued).count();
+			printf("Reloaded %s in %.1f ms\n", pending[i].file.c_str(), elapsed);
+		}
+
+		std::string file = pending[i].file;
+		pending.erase(pending.begin() + i);
+
+		if (deferred.erase(file)) {
+			QueueReload(file);
+		}
+	}
+}
+
+void AssetReloader::QueueReload(std::string const& file)
+{
+	std::string directory = file.substr(0, file.find('/'));
+
+	PendingReload reload;
+	reload.file = file;
+	reload.queued = std::chrono::steady_clock::now();
+
+	// A shader through its #includes, a model through its material libraries.
+	std::vector<std::string> dependents;
+	if (cooker) {
+		dependents = cooker->GetDependents(file);
+	}
+
+	auto uses = [&](std::string const& location) {
+		std::string normalized = NormalizePath(location);
+		return normalized == file || std::find(dependents.begin(), dependents.end(), normalized) != dependents.end();
+	};
+
+	if (directory == "shaders") {
+		std::vector<Shader*> affected;
+
+		for (auto shader : shaders) {
+			if (uses(shader->GetVertexLocation()) || uses(shader->GetFragmentLocation()) ||
+				(!shader->GetGeometryLocation().empty() && uses(shader->GetGeometryLocation()))) {
+				affected.push_back(shader);
+			}
+		}
+
+		if (affected.empty()) {
+			return;
+		}
+
+		reload.job = std::async(std::launch::async, [this, affected, file]() -> std::function<void()> {
+			CopyFromSource(file);
+
+			std::vector<std::vector<std::string>> sources;
+
+			for (auto shader : affected) {
+				sources.push_back({
+					shader->ReadFile(shader->GetVertexLocation().c_str()),
+					shader->GetGeometryLocation().empty() ? std::string() : shader->ReadFile(shader->GetGeometryLocation().c_str()),
+					shader->ReadFile(shader->GetFragmentLocation().c_str())
+				});
+			}
+
+			return [affected, sources, file]() {
+				for (size_t i = 0; i < affected.size(); i++) {
+					if (!affected[i]->Reload(sources[i][0], sources[i][1], sources[i][2])) {
+						printf("Failed to reload %s, keeping the previous program\n", file.c_str());
+					}
+				}
+			};
+		});
+
+		pending.push_back(std::move(reload));
+	}
+	else if (directory == "textures") {
+		std::vector<Texture*> collected = CollectTextures(file);
+		if (collected.empty()) {
+			return;
+		}
+
+		// Read the way the texture was loaded, with or without its alpha channel.
+		bool hasAlpha = collected[0]->HasAlpha();
+
+		reload.job = std::async(std::launch::async, [this, file, hasAlpha]() -> std::function<void()> {
+			CopyFromSource(file);
+			Cook(file);
+
+			auto staged = std::make_shared<Texture>(file.c_str());
+			staged->SetAlpha(hasAlpha);
+
+			// Shown from the edited source right away, the cooked copy is for the next start.
+			if (!staged->ReadImage(false)) {
+				return nullptr;
+			}
+
+			return [this, staged, file]() {
+				// Resolved again here since a model reload may have replaced its textures meanwhile.
+				for (auto texture : CollectTextures(file)) {
+					texture->UploadImage(*staged);
+				}
+			};
+		});
+
+		pending.push_back(std::move(reload));
+	}
+	else if (directory == "models") {
+		std::string stem = fs::path(file).stem().string();
+		std::vector<Model*> affected;
+
+		// Without the graph .obj and .mtl are assumed to share a stem, either one changing rebuilds the model.
+		for (auto target : models) {
+			if (cooker ? uses(target->GetFileName()) : fs::path(target->GetFileName()).stem().string() == stem) {
+				affected.push_back(target);
+			}
+		}
+
+		if (affected.empty()) {
+			return;
+		}
+
+		reload.job = std::async(std::launch::async, [this, affected, file]() -> std::function<void()> {
+			CopyFromSource(file);
+			Cook(file);
+
+			// Every instance gets a copy of its own to swap with, the old GPU resources go with the copy.
+			std::vector<std::shared_ptr<Model>> staged;
+
+			for (auto target : affected) {
+				staged.emplace_back(new Model(), [](Model* model) {
+					model->ClearModel();
+					delete model;
+				});
+
+				if (!staged.back()->ImportModel(target->GetFileName())) {
+					return nullptr;
+				}
+			}
+
+			return [affected, staged]() {
+				for (size_t i = 0; i < affected.size(); i++) {
+					staged[i]->UploadModel();
+					affected[i]->SwapModel(*staged[i]);
+				}
+			};
+		});
+
+		pending.push_back(std::move(reload));
+	}
+}
+
+void AssetReloader::CopyFromSource(std::string const& file)
+{
+	std::error_code ec;
+
+	// The pack holds the file as it was built, the edited one is read loose from now on.
+	AssetPack::PreferLoose(file);
+
+	fs::path source = fs::path(sourceDirectory) / file;
+	if (fs::equivalent(source, file, ec)) {
+		return;
+	}
+
+	fs::create_directories(fs::path(file).parent_path(), ec);
+	fs::copy_file(source, file, fs::copy_options::overwrite_existing, ec);
+
+	if (ec) {
+		printf("Failed to copy %s: %s\n", source.string().c_str(), ec.message().c_str());
+	}
+}
+
+void AssetReloader::Cook(std::string const& file)
+{
+	if (!cooker) {
+		return;
+	}
+
+	AssetCookStats stats;
+	cooker->Build(stats, { file });
+
+	for (auto const& output : stats.cookedOutputs) {
+		AssetPack::PreferLoose(output);
+		printf("Cooked %s in %.0f ms\n", output.c_str(), stats.milliseconds);
+	}
+}
+
+bool AssetReloader::IsPending(std::string const& file)
+{
+	for (auto const& reload : pending) {
+		if (reload.file == file) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::vector<Texture*> AssetReloader::CollectTextures(std::string const& file)
+{
+	std::vector<Texture*> result;
+
+	for (auto texture : textures) {
+		if (NormalizePath(texture->GetFileLocation()) == file) {
+			result.push_back(texture);
+		}
+	}
+
+	for (auto model : models) {
+		for (auto texture : model->GetTextures()) {
+			if (texture && NormalizePath(texture->GetFileLocation()) == file) {
+				result.push_back(texture);
+			}
+		}
+	}
+
+	return result;
+}
+
+AssetReloader::~AssetReloader()
+{
+	Stop();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <future>
+#include <functional>
+#include <chrono>
+
+#include <FileWatcher.hpp>
+#include <Shader.hpp>
+#include <Texture.hpp>
+#include <Model.hpp>
+#include <AssetCooker.hpp>
+
+// Hot reload for shaders, textures and models. Changed files are read and
+// decoded on a background thread, the GL side of the reload is applied in
+// Update(), which the main loop calls once per frame before rendering.
+class AssetReloader {
+public:
+	AssetReloader();
+
+	// sourceDirectory is where the assets are edited. When it differs from the
+	// working directory, changed files are copied over before being reloaded.
+	bool Start(std::string const& sourceDirectory);
+	void Stop();
+
+	void WatchShader(Shader* shader);
+	void WatchTexture(Texture* texture);
+	void WatchModel(Model* model);
+
+	// Edited textures are cooked again as they are reloaded, and includes and material libraries
+	// reach what uses them through the cooker's graph. Without one, models are matched by stem.
+	void SetCooker(AssetCooker* cooker) { this->cooker = cooker; }
+
+	void Update();
+
+	~AssetReloader();
+
+private:
+	struct PendingReload {
+		std::string file;
+		std::chrono::steady_clock::time_point queued;
+
+		// The background stage returns the stage that has to run on the GL thread.
+		std::future<std::function<void()>> job;
+	};
+
+	FileWatcher watcher;
+	std::string sourceDirectory;
+	AssetCooker* cooker;
+
+	std::vector<Shader*> shaders;
+	std::vector<Texture*> textures;
+	std::vector<Model*> models;
+
+	std::vector<PendingReload> pending;
+	std::set<std::string> deferred;
+
+	void QueueReload(std::string const& file);
+	void CopyFromSource(std::string const& file);
+	void Cook(std::string const& file);
+	bool IsPending(std::string const& file);
+
+	std::vector<Texture*> CollectTextures(std::string const& file);
+};
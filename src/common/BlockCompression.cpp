@@ -0,0 +1,534 @@
+#include "BlockCompression.hpp"
+
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+
+#include <JobPool.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BLOCK_COMPRESSION_SSE2
+#endif
+
+namespace {
+
+	struct Palette {
+		// Structure of arrays so the SIMD search compares four entries at once.
+		alignas(16) float channel[4][16];
+		int size;
+	};
+
+	void LoadPixels(uint8_t const* rgba, float (*pixels)[4])
+	{
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 4; c++) {
+				pixels[i][c] = rgba[i * 4 + c];
+			}
+		}
+	}
+
+	// Picks the nearest palette entry for every pixel, returns the summed weighted squared error.
+	float FindIndices(float const (*pixels)[4], Palette const& palette, float const* weights, uint8_t* indices)
+	{
+		float total = 0.f;
+
+#ifdef BLOCK_COMPRESSION_SSE2
+		for (int i = 0; i < 16; i++) {
+			__m128 bestError = _mm_set1_ps(FLT_MAX);
+			__m128 bestIndex = _mm_setzero_ps();
+			__m128 index = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+			__m128 four = _mm_set1_ps(4.f);
+
+			for (int j = 0; j < palette.size; j += 4) {
+				__m128 error = _mm_setzero_ps();
+
+				for (int c = 0; c < 4; c++) {
+					__m128 d = _mm_sub_ps(_mm_load_ps(&palette.channel[c][j]), _mm_set1_ps(pixels[i][c]));
+					error = _mm_add_ps(error, _mm_mul_ps(_mm_mul_ps(d, d), _mm_set1_ps(weights[c])));
+				}
+
+				__m128 better = _mm_cmplt_ps(error, bestError);
+				bestError = _mm_or_ps(_mm_and_ps(better, error), _mm_andnot_ps(better, bestError));
+				bestIndex = _mm_or_ps(_mm_and_ps(better, index), _mm_andnot_ps(better, bestIndex));
+				index = _mm_add_ps(index, four);
+			}
+
+			alignas(16) float errors[4], lanes[4];
+			_mm_store_ps(errors, bestError);
+			_mm_store_ps(lanes, bestIndex);
+
+			int best = 0;
+			for (int k = 1; k < 4; k++) {
+				if (errors[k] < errors[best] || (errors[k] == errors[best] && lanes[k] < lanes[best])) {
+					best = k;
+				}
+			}
+
+			indices[i] = (uint8_t)lanes[best];
+			total += errors[best];
+		}
+#else
+		for (int i = 0; i < 16; i++) {
+			float bestError = FLT_MAX;
+			int bestIndex = 0;
+
+			for (int j = 0; j < palette.size; j++) {
+				float error = 0.f;
+				for (int c = 0; c < 4; c++) {
+					float d = palette.channel[c][j] - pixels[i][c];
+					error += d * d * weights[c];
+				}
+
+				if (error < bestError) {
+					bestError = error;
+					bestIndex = j;
+				}
+			}
+
+			indices[i] = (uint8_t)bestIndex;
+			total += bestError;
+		}
+#endif
+
+		return total;
+	}
+
+	// Endpoints along the principal axis of the (weighted) pixel distribution.
+	void PrincipalAxisEndpoints(float const (*pixels)[4], float const* weights, float* low, float* high)
+	{
+		float mean[4] = { 0.f, 0.f, 0.f, 0.f };
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 4; c++) {
+				mean[c] += pixels[i][c] * (1.f / 16.f);
+			}
+		}
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; i++) {
+			float d[4];
+			for (int c = 0; c < 4; c++) {
+				d[c] = (pixels[i][c] - mean[c]) * weights[c];
+			}
+
+			for (int r = 0; r < 4; r++) {
+				for (int c = 0; c < 4; c++) {
+					covariance[r][c] += d[r] * d[c];
+				}
+			}
+		}
+
+		float axis[4] = { 1.f, 1.f, 1.f, 1.f };
+		for (int c = 0; c < 4; c++) {
+			axis[c] *= weights[c];
+		}
+
+		for (int iteration = 0; iteration < 8; iteration++) {
+			float next[4] = { 0.f, 0.f, 0.f, 0.f };
+			for (int r = 0; r < 4; r++) {
+				for (int c = 0; c < 4; c++) {
+					next[r] += covariance[r][c] * axis[c];
+				}
+			}
+
+			float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+			if (length < 1e-6f) {
+				break;
+			}
+
+			for (int c = 0; c < 4; c++) {
+				axis[c] = next[c] / length;
+			}
+		}
+
+		float minT = FLT_MAX, maxT = -FLT_MAX;
+		for (int i = 0; i < 16; i++) {
+			float t = 0.f;
+			for (int c = 0; c < 4; c++) {
+				t += (pixels[i][c] - mean[c]) * axis[c];
+			}
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+
+		for (int c = 0; c < 4; c++) {
+			low[c] = std::clamp(mean[c] + axis[c] * minT, 0.f, 255.f);
+			high[c] = std::clamp(mean[c] + axis[c] * maxT, 0.f, 255.f);
+		}
+	}
+
+	// Least squares endpoints for a fixed assignment, indexWeights maps an index to its
+	// interpolation position between the first (0) and second (1) endpoint.
+	bool RefineEndpoints(float const (*pixels)[4], uint8_t const* indices, float const* indexWeights, float* first, float* second)
+	{
+		float a = 0.f, b = 0.f, c = 0.f;
+		float x[4] = {}, y[4] = {};
+
+		for (int i = 0; i < 16; i++) {
+			float w = indexWeights[indices[i]];
+			float v = 1.f - w;
+
+			a += v * v;
+			b += v * w;
+			c += w * w;
+
+			for (int k = 0; k < 4; k++) {
+				x[k] += v * pixels[i][k];
+				y[k] += w * pixels[i][k];
+			}
+		}
+
+		float determinant = a * c - b * b;
+		if (fabsf(determinant) < 1e-6f) {
+			return false;
+		}
+
+		for (int k = 0; k < 4; k++) {
+			first[k] = std::clamp((c * x[k] - b * y[k]) / determinant, 0.f, 255.f);
+			second[k] = std::clamp((a * y[k] - b * x[k]) / determinant, 0.f, 255.f);
+		}
+
+		return true;
+	}
+
+	uint16_t PackRGB565(float const* color)
+	{
+		int r = std::clamp((int)lrintf(color[0] * 31.f / 255.f), 0, 31);
+		int g = std::clamp((int)lrintf(color[1] * 63.f / 255.f), 0, 63);
+		int b = std::clamp((int)lrintf(color[2] * 31.f / 255.f), 0, 31);
+
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void UnpackRGB565(uint16_t packed, float* color)
+	{
+		int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+
+		color[0] = (float)((r << 3) | (r >> 2));
+		color[1] = (float)((g << 2) | (g >> 4));
+		color[2] = (float)((b << 3) | (b >> 2));
+		color[3] = 255.f;
+	}
+
+	float EvaluateBC1(float const (*pixels)[4], uint16_t color0, uint16_t color1, uint8_t* indices)
+	{
+		static const float weights[4] = { 1.f, 1.f, 1.f, 0.f };
+
+		float e0[4], e1[4];
+		UnpackRGB565(color0, e0);
+		UnpackRGB565(color1, e1);
+
+		Palette palette;
+		palette.size = 4;
+
+		for (int c = 0; c < 4; c++) {
+			palette.channel[c][0] = e0[c];
+			palette.channel[c][1] = e1[c];
+			palette.channel[c][2] = (2.f * e0[c] + e1[c]) / 3.f;
+			palette.channel[c][3] = (e0[c] + 2.f * e1[c]) / 3.f;
+		}
+
+		return FindIndices(pixels, palette, weights, indices);
+	}
+
+	// Mode 6: one subset, RGBA endpoints with 7 bits plus a shared-per-endpoint p-bit, 4 bit indices.
+	const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	void QuantizeBC7Endpoint(float const* color, uint8_t* quantized, uint8_t& pBit)
+	{
+		float bestError = FLT_MAX;
+
+		for (int p = 0; p < 2; p++) {
+			uint8_t candidate[4];
+			float error = 0.f;
+
+			for (int c = 0; c < 4; c++) {
+				candidate[c] = (uint8_t)std::clamp((int)lrintf((color[c] - p) / 2.f), 0, 127);
+				float d = (float)((candidate[c] << 1) | p) - color[c];
+				error += d * d;
+			}
+
+			if (error < bestError) {
+				bestError = error;
+				memcpy(quantized, candidate, 4);
+				pBit = (uint8_t)p;
+			}
+		}
+	}
+
+	float EvaluateBC7(float const (*pixels)[4], uint8_t const* q0, uint8_t p0, uint8_t const* q1, uint8_t p1, uint8_t* indices)
+	{
+		static const float weights[4] = { 1.f, 1.f, 1.f, 1.f };
+
+		Palette palette;
+		palette.size = 16;
+
+		for (int c = 0; c < 4; c++) {
+			int e0 = (q0[c] << 1) | p0;
+			int e1 = (q1[c] << 1) | p1;
+
+			for (int j = 0; j < 16; j++) {
+				palette.channel[c][j] = (float)(((64 - bc7Weights[j]) * e0 + bc7Weights[j] * e1 + 32) >> 6);
+			}
+		}
+
+		return FindIndices(pixels, palette, weights, indices);
+	}
+
+	struct BitWriter {
+		uint8_t* data;
+		int position;
+
+		void Write(uint32_t value, int bits)
+		{
+			for (int i = 0; i < bits; i++, position++) {
+				if (value & (1u << i)) {
+					data[position >> 3] |= (uint8_t)(1u << (position & 7));
+				}
+			}
+		}
+	};
+
+}
+
+size_t BlockCompression::GetBlockSize(BlockFormat format)
+{
+	return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t BlockCompression::GetImageSize(BlockFormat format, int width, int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(format);
+}
+
+void BlockCompression::EncodeBC1(uint8_t const* rgba, uint8_t* block)
+{
+	EncodeColor(rgba, block);
+}
+
+void BlockCompression::EncodeBC3(uint8_t const* rgba, uint8_t* block)
+{
+	EncodeAlpha(rgba, 3, block);
+	EncodeColor(rgba, block + 8);
+}
+
+void BlockCompression::EncodeBC5(uint8_t const* rgba, uint8_t* block)
+{
+	EncodeAlpha(rgba, 0, block);
+	EncodeAlpha(rgba, 1, block + 8);
+}
+
+void BlockCompression::EncodeColor(uint8_t const* rgba, uint8_t* block)
+{
+	static const float weights[4] = { 1.f, 1.f, 1.f, 0.f };
+	static const float indexWeights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+	float pixels[16][4];
+	LoadPixels(rgba, pixels);
+
+	float low[4], high[4];
+	PrincipalAxisEndpoints(pixels, weights, low, high);
+
+	uint16_t color0 = PackRGB565(high);
+	uint16_t color1 = PackRGB565(low);
+
+	uint8_t indices[16];
+	float error = EvaluateBC1(pixels, color0, color1, indices);
+
+	float first[4], second[4];
+	if (RefineEndpoints(pixels, indices, indexWeights, first, second)) {
+		uint16_t refined0 = PackRGB565(first);
+		uint16_t refined1 = PackRGB565(second);
+
+		uint8_t refinedIndices[16];
+		float refinedError = EvaluateBC1(pixels, refined0, refined1, refinedIndices);
+
+		if (refinedError < error) {
+			color0 = refined0;
+			color1 = refined1;
+			error = refinedError;
+			memcpy(indices, refinedIndices, 16);
+		}
+	}
+
+	// color0 > color1 selects the four colour mode, swapping endpoints swaps the palette order too.
+	if (color0 < color1) {
+		std::swap(color0, color1);
+
+		static const uint8_t swapped[4] = { 1, 0, 3, 2 };
+		for (int i = 0; i < 16; i++) {
+			indices[i] = swapped[indices[i]];
+		}
+	}
+
+	uint32_t packedIndices = 0;
+	if (color0 != color1) {
+		for (int i = 0; i < 16; i++) {
+			packedIndices |= (uint32_t)indices[i] << (2 * i);
+		}
+	}
+
+	block[0] = (uint8_t)(color0 & 0xFF);
+	block[1] = (uint8_t)(color0 >> 8);
+	block[2] = (uint8_t)(color1 & 0xFF);
+	block[3] = (uint8_t)(color1 >> 8);
+	block[4] = (uint8_t)(packedIndices & 0xFF);
+	block[5] = (uint8_t)((packedIndices >> 8) & 0xFF);
+	block[6] = (uint8_t)((packedIndices >> 16) & 0xFF);
+	block[7] = (uint8_t)(packedIndices >> 24);
+}
+
+void BlockCompression::EncodeAlpha(uint8_t const* rgba, int channel, uint8_t* block)
+{
+	int low = 255, high = 0;
+	for (int i = 0; i < 16; i++) {
+		low = std::min<int>(low, rgba[i * 4 + channel]);
+		high = std::max<int>(high, rgba[i * 4 + channel]);
+	}
+
+	// high > low selects the eight value mode.
+	int palette[8];
+	palette[0] = high;
+	palette[1] = low;
+	for (int i = 2; i < 8; i++) {
+		palette[i] = ((8 - i) * high + (i - 1) * low) / 7;
+	}
+
+	uint64_t packedIndices = 0;
+
+	if (high != low) {
+		for (int i = 0; i < 16; i++) {
+			int value = rgba[i * 4 + channel];
+			int bestIndex = 0, bestError = 256;
+
+			for (int j = 0; j < 8; j++) {
+				int error = abs(palette[j] - value);
+				if (error < bestError) {
+					bestError = error;
+					bestIndex = j;
+				}
+			}
+
+			packedIndices |= (uint64_t)bestIndex << (3 * i);
+		}
+	}
+
+	block[0] = (uint8_t)high;
+	block[1] = (uint8_t)low;
+	for (int i = 0; i < 6; i++) {
+		block[2 + i] = (uint8_t)(packedIndices >> (8 * i));
+	}
+}
+
+void BlockCompression::EncodeBC7(uint8_t const* rgba, uint8_t* block)
+{
+	static const float weights[4] = { 1.f, 1.f, 1.f, 1.f };
+
+	float indexWeights[16];
+	for (int i = 0; i < 16; i++) {
+		indexWeights[i] = bc7Weights[i] / 64.f;
+	}
+
+	float pixels[16][4];
+	LoadPixels(rgba, pixels);
+
+	float low[4], high[4];
+	PrincipalAxisEndpoints(pixels, weights, low, high);
+
+	uint8_t q0[4], q1[4], p0, p1;
+	QuantizeBC7Endpoint(low, q0, p0);
+	QuantizeBC7Endpoint(high, q1, p1);
+
+	uint8_t indices[16];
+	float error = EvaluateBC7(pixels, q0, p0, q1, p1, indices);
+
+	float first[4], second[4];
+	if (RefineEndpoints(pixels, indices, indexWeights, first, second)) {
+		uint8_t r0[4], r1[4], rp0, rp1;
+		QuantizeBC7Endpoint(first, r0, rp0);
+		QuantizeBC7Endpoint(second, r1, rp1);
+
+		uint8_t refinedIndices[16];
+		float refinedError = EvaluateBC7(pixels, r0, rp0, r1, rp1, refinedIndices);
+
+		if (refinedError < error) {
+			memcpy(q0, r0, 4);
+			memcpy(q1, r1, 4);
+			p0 = rp0;
+			p1 = rp1;
+			memcpy(indices, refinedIndices, 16);
+		}
+	}
+
+	// The anchor index is stored with its top bit implied zero.
+	if (indices[0] & 8) {
+		uint8_t t[4];
+		memcpy(t, q0, 4);
+		memcpy(q0, q1, 4);
+		memcpy(q1, t, 4);
+		std::swap(p0, p1);
+
+		for (int i = 0; i < 16; i++) {
+			indices[i] = 15 - indices[i];
+		}
+	}
+
+	memset(block, 0, 16);
+	BitWriter writer = { block, 0 };
+
+	writer.Write(1 << 6, 7);
+
+	for (int c = 0; c < 4; c++) {
+		writer.Write(q0[c], 7);
+		writer.Write(q1[c], 7);
+	}
+
+	writer.Write(p0, 1);
+	writer.Write(p1, 1);
+
+	writer.Write(indices[0], 3);
+	for (int i = 1; i < 16; i++) {
+		writer.Write(indices[i], 4);
+	}
+}
+
+void BlockCompression::CompressImage(BlockFormat format, uint8_t const* rgba, int width, int height, uint8_t* output, JobPool* jobPool)
+{
+	int blocksX = (width + 3) / 4;
+	int blocksY = (height + 3) / 4;
+	size_t blockSize = GetBlockSize(format);
+
+	auto encodeRows = [&](size_t begin, size_t end) {
+		uint8_t pixels[16 * 4];
+
+		for (size_t by = begin; by < end; by++) {
+			for (int bx = 0; bx < blocksX; bx++) {
+				for (int y = 0; y < 4; y++) {
+					int sy = std::min((int)by * 4 + y, height - 1);
+
+					for (int x = 0; x < 4; x++) {
+						int sx = std::min(bx * 4 + x, width - 1);
+						memcpy(&pixels[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+					}
+				}
+
+				uint8_t* block = output + (by * blocksX + bx) * blockSize;
+
+				switch (format) {
+				case BlockFormat::BC1: EncodeBC1(pixels, block); break;
+				case BlockFormat::BC3: EncodeBC3(pixels, block); break;
+				case BlockFormat::BC5: EncodeBC5(pixels, block); break;
+				case BlockFormat::BC7: EncodeBC7(pixels, block); break;
+				}
+			}
+		}
+	};
+
+	if (jobPool) {
+		jobPool->ParallelFor(blocksY, 4, encodeRows);
+	}
+	else {
+		encodeRows(0, blocksY);
+	}
+}
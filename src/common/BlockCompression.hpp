@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class JobPool;
+
+enum class BlockFormat {
+	BC1,	// RGB, 4 bpp
+	BC3,	// RGBA with interpolated alpha, 8 bpp
+	BC5,	// two channel (tangent space normals), 8 bpp
+	BC7		// RGBA, mode 6 only, 8 bpp
+};
+
+// CPU encoders for the block compressed formats the cooker emits. All of them
+// take 4x4 blocks of RGBA8 pixels in row-major order.
+class BlockCompression {
+public:
+	static size_t GetBlockSize(BlockFormat format);
+	static size_t GetImageSize(BlockFormat format, int width, int height);
+
+	static void EncodeBC1(uint8_t const* rgba, uint8_t* block);
+	static void EncodeBC3(uint8_t const* rgba, uint8_t* block);
+	static void EncodeBC5(uint8_t const* rgba, uint8_t* block);
+	static void EncodeBC7(uint8_t const* rgba, uint8_t* block);
+
+	// Compresses a whole RGBA8 image, edge blocks are padded by clamping. Block
+	// rows are spread over the job pool when one is given.
+	static void CompressImage(BlockFormat format, uint8_t const* rgba, int width, int height, uint8_t* output, JobPool* jobPool);
+
+private:
+	static void EncodeAlpha(uint8_t const* rgba, int channel, uint8_t* block);
+	static void EncodeColor(uint8_t const* rgba, uint8_t* block);
+};
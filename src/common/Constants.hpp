@@ -4,4 +4,8 @@
 const int N_POINT_LIGHTS = 3;
 const int N_SPOT_LIGHTS = 3;
 
+// Unshadowed lights, read from a uniform buffer at this binding point, see FillLights.
+const int N_FILL_LIGHTS = 256;
+const unsigned int FILL_LIGHT_BINDING = 0;
+
 #endif // !CONSTANTS
@@ -0,0 +1,193 @@
+#include "DeferredRenderer.hpp"
+
+namespace {
+	// Unit icosahedron, counter-clockwise from outside.
+	const GLfloat icosahedronA = 0.5257311f;
+	const GLfloat icosahedronB = 0.8506508f;
+
+	const GLfloat icosahedronVertices[] = {
+		-icosahedronA, icosahedronB, 0.f,	icosahedronA, icosahedronB, 0.f,
+		-icosahedronA, -icosahedronB, 0.f,	icosahedronA, -icosahedronB, 0.f,
+		0.f, -icosahedronA, icosahedronB,	0.f, icosahedronA, icosahedronB,
+		0.f, -icosahedronA, -icosahedronB,	0.f, icosahedronA, -icosahedronB,
+		icosahedronB, 0.f, -icosahedronA,	icosahedronB, 0.f, icosahedronA,
+		-icosahedronB, 0.f, -icosahedronA,	-icosahedronB, 0.f, icosahedronA
+	};
+
+	const GLubyte icosahedronIndices[] = {
+		0, 11, 5,	0, 5, 1,	0, 1, 7,	0, 7, 10,	0, 10, 11,
+		1, 5, 9,	5, 11, 4,	11, 10, 2,	10, 7, 6,	7, 1, 8,
+		3, 9, 4,	3, 4, 2,	3, 2, 6,	3, 6, 8,	3, 8, 9,
+		4, 9, 5,	2, 4, 11,	6, 2, 10,	8, 6, 7,	9, 8, 1
+	};
+
+	// Indexed by GBufferTarget.
+	const GLenum targetFormats[] = { GL_RGBA8, GL_RGB10_A2, GL_DEPTH_COMPONENT24 };
+}
+
+DeferredRenderer::DeferredRenderer()
+{
+	targets[0] = targets[1] = targets[2] = 0;
+	FBO = 0;
+	fullscreenVAO = 0;
+	volumeVAO = 0;
+	volumeVBO = 0;
+	volumeIBO = 0;
+	width = 0;
+	height = 0;
+}
+
+bool DeferredRenderer::Init(GLsizei width, GLsizei height)
+{
+	Release();
+
+	this->width = width;
+	this->height = height;
+
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+	const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	// The formats are checked once on textures of a texel each, the frame graph makes the real ones.
+	GLuint probes[3];
+	glGenTextures(3, probes);
+
+	for (int i = 0; i < 3; i++) {
+		bool depth = i == (int)GBufferTarget::Depth;
+
+		glBindTexture(GL_TEXTURE_2D, probes[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, targetFormats[i], 1, 1, 0, depth ? GL_DEPTH_COMPONENT : GL_RGBA, GL_FLOAT, nullptr);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Attach(probes[0], probes[1], probes[2]);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	Attach(0, 0, 0);
+	glDeleteTextures(3, probes);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("G-buffer error: 0x%x\n", status);
+		Release();
+		return false;
+	}
+
+	// The fullscreen triangle comes from gl_VertexID alone, but core profiles still want a VAO bound.
+	glGenVertexArrays(1, &fullscreenVAO);
+
+	glGenVertexArrays(1, &volumeVAO);
+	glBindVertexArray(volumeVAO);
+
+	glGenBuffers(1, &volumeVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, volumeVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(icosahedronVertices), icosahedronVertices, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(0);
+
+	glGenBuffers(1, &volumeIBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, volumeIBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(icosahedronIndices), icosahedronIndices, GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+FrameTextureDesc DeferredRenderer::GetTargetDesc(GBufferTarget target)
+{
+	return { width, height, targetFormats[(int)target] };
+}
+
+void DeferredRenderer::Attach(GLuint albedo, GLuint normal, GLuint depth)
+{
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+
+	targets[0] = albedo;
+	targets[1] = normal;
+	targets[2] = depth;
+}
+
+void DeferredRenderer::Write(GLuint albedo, GLuint normal, GLuint depth, GLsizei viewportWidth, GLsizei viewportHeight)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+	// Attached every frame, a texture the pool freed may come back under the same name. The pool
+	// mostly hands out the same textures, so the status is only checked when they change.
+	bool changed = albedo != targets[0] || normal != targets[1] || depth != targets[2];
+	Attach(albedo, normal, depth);
+
+	if (changed) {
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			printf("G-buffer error: 0x%x\n", status);
+		}
+	}
+
+	glViewport(0, 0, viewportWidth, viewportHeight);
+}
+
+void DeferredRenderer::Read(GLenum firstUnit, GLuint albedo, GLuint normal, GLuint depth)
+{
+	glActiveTexture(firstUnit);
+	glBindTexture(GL_TEXTURE_2D, albedo);
+	glActiveTexture(firstUnit + 1);
+	glBindTexture(GL_TEXTURE_2D, normal);
+	glActiveTexture(firstUnit + 2);
+	glBindTexture(GL_TEXTURE_2D, depth);
+}
+
+void DeferredRenderer::DrawFullscreen()
+{
+	glBindVertexArray(fullscreenVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+}
+
+void DeferredRenderer::DrawLightVolumes(GLsizei count)
+{
+	glBindVertexArray(volumeVAO);
+	glDrawElementsInstanced(GL_TRIANGLES, sizeof(icosahedronIndices), GL_UNSIGNED_BYTE, 0, count);
+	glBindVertexArray(0);
+}
+
+void DeferredRenderer::Release()
+{
+	if (FBO) {
+		glDeleteFramebuffers(1, &FBO);
+		FBO = 0;
+	}
+
+	targets[0] = targets[1] = targets[2] = 0;
+
+	if (fullscreenVAO) {
+		glDeleteVertexArrays(1, &fullscreenVAO);
+		fullscreenVAO = 0;
+	}
+
+	if (volumeVAO) {
+		glDeleteVertexArrays(1, &volumeVAO);
+		volumeVAO = 0;
+	}
+
+	if (volumeVBO) {
+		glDeleteBuffers(1, &volumeVBO);
+		volumeVBO = 0;
+	}
+
+	if (volumeIBO) {
+		glDeleteBuffers(1, &volumeIBO);
+		volumeIBO = 0;
+	}
+}
+
+DeferredRenderer::~DeferredRenderer()
+{
+	Release();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <GL\glew.h>
+
+#include <FrameGraph.hpp>
+
+enum class GBufferTarget {
+	Albedo,
+	Normal,
+	Depth
+};
+
+// G-buffer of the deferred renderer, 12 bytes a pixel: albedo and specular intensity in RGBA8, an
+// octahedral normal and log2 shininess in RGB10_A2, and depth, which the light passes turn back into
+// positions. The targets are transient textures of the frame graph. Also holds what the light passes
+// draw, a triangle over the screen and an icosahedron per fill light.
+class DeferredRenderer {
+public:
+	DeferredRenderer();
+
+	// False if the driver can't render to the G-buffer's formats.
+	bool Init(GLsizei width, GLsizei height);
+
+	FrameTextureDesc GetTargetDesc(GBufferTarget target);
+
+	// Binds the targets with a viewport over the corner of them the scene is rendered to.
+	void Write(GLuint albedo, GLuint normal, GLuint depth, GLsizei viewportWidth, GLsizei viewportHeight);
+
+	// Albedo, normal and depth to firstUnit and the two units after it.
+	void Read(GLenum firstUnit, GLuint albedo, GLuint normal, GLuint depth);
+
+	GLsizei GetWidth() { return width; }
+	GLsizei GetHeight() { return height; }
+
+	void DrawFullscreen();
+
+	// Instanced, the vertex shader scales each one to enclose its light's radius.
+	void DrawLightVolumes(GLsizei count);
+
+	~DeferredRenderer();
+
+private:
+	void Release();
+	void Attach(GLuint albedo, GLuint normal, GLuint depth);
+
+	// Attached to FBO, its status is only checked when they change.
+	GLuint targets[3];
+
+	GLuint FBO;
+	GLuint fullscreenVAO, volumeVAO, volumeVBO, volumeIBO;
+	GLsizei width, height;
+};
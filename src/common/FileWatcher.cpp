@@ -0,0 +1,195 @@
+#include "FileWatcher.hpp"
+
+#include <stdio.h>
+#include <chrono>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+FileWatcher::FileWatcher()
+{
+	running = false;
+#ifdef __linux__
+	inotifyFd = -1;
+#endif
+}
+
+bool FileWatcher::Start(std::string const& rootDirectory, std::vector<std::string> const& directories)
+{
+	Stop();
+
+	this->rootDirectory = rootDirectory;
+	this->directories = directories;
+
+#ifdef __linux__
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyFd < 0) {
+		printf("Failed to initialise inotify, hot reload disabled\n");
+		return false;
+	}
+
+	for (auto const& directory : directories) {
+		fs::path dir = fs::path(rootDirectory) / directory;
+		std::error_code ec;
+
+		if (!fs::is_directory(dir, ec)) {
+			continue;
+		}
+
+		AddWatch(dir);
+
+		for (auto const& entry : fs::recursive_directory_iterator(dir, ec)) {
+			if (entry.is_directory()) {
+				AddWatch(entry.path());
+			}
+		}
+	}
+#else
+	ScanDirectories(false);
+#endif
+
+	running = true;
+	watchThread = std::thread(&FileWatcher::WatchLoop, this);
+
+	return true;
+}
+
+void FileWatcher::Stop()
+{
+	running = false;
+
+	if (watchThread.joinable()) {
+		watchThread.join();
+	}
+
+#ifdef __linux__
+	if (inotifyFd >= 0) {
+		close(inotifyFd);
+		inotifyFd = -1;
+	}
+	watchDescriptors.clear();
+#endif
+}
+
+std::vector<std::string> FileWatcher::PollChanges()
+{
+	std::lock_guard<std::mutex> lock(changesMutex);
+
+	std::vector<std::string> result(changes.begin(), changes.end());
+	changes.clear();
+
+	return result;
+}
+
+void FileWatcher::PushChange(fs::path const& file)
+{
+	std::string relative = file.lexically_relative(rootDirectory).lexically_normal().generic_string();
+
+	std::lock_guard<std::mutex> lock(changesMutex);
+	changes.insert(relative);
+}
+
+#ifdef __linux__
+
+void FileWatcher::AddWatch(fs::path const& directory)
+{
+	int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (wd < 0) {
+		printf("Failed to watch %s\n", directory.c_str());
+		return;
+	}
+
+	watchDescriptors[wd] = directory;
+}
+
+void FileWatcher::WatchLoop()
+{
+	alignas(inotify_event) char buffer[4096];
+
+	while (running) {
+		pollfd pfd = { inotifyFd, POLLIN, 0 };
+
+		// Wake up periodically so Stop() doesn't block on an idle directory.
+		if (poll(&pfd, 1, 100) <= 0) {
+			continue;
+		}
+
+		ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+
+		for (ssize_t offset = 0; offset < length; ) {
+			inotify_event* event = reinterpret_cast<inotify_event*>(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+
+			auto it = watchDescriptors.find(event->wd);
+			if (it == watchDescriptors.end() || event->len == 0) {
+				continue;
+			}
+
+			fs::path path = it->second / event->name;
+
+			if (event->mask & IN_ISDIR) {
+				if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+					AddWatch(path);
+				}
+				continue;
+			}
+
+			// A bare IN_CREATE is followed by IN_CLOSE_WRITE once the file is complete.
+			if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+				PushChange(path);
+			}
+		}
+	}
+}
+
+#else
+
+void FileWatcher::ScanDirectories(bool notify)
+{
+	for (auto const& directory : directories) {
+		fs::path dir = fs::path(rootDirectory) / directory;
+		std::error_code ec;
+
+		for (auto const& entry : fs::recursive_directory_iterator(dir, ec)) {
+			if (!entry.is_regular_file(ec)) {
+				continue;
+			}
+
+			auto writeTime = entry.last_write_time(ec);
+			auto it = writeTimes.find(entry.path().string());
+
+			if (it == writeTimes.end()) {
+				writeTimes[entry.path().string()] = writeTime;
+				if (notify) {
+					PushChange(entry.path());
+				}
+			}
+			else if (it->second != writeTime) {
+				it->second = writeTime;
+				if (notify) {
+					PushChange(entry.path());
+				}
+			}
+		}
+	}
+}
+
+void FileWatcher::WatchLoop()
+{
+	while (running) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		ScanDirectories(true);
+	}
+}
+
+#endif
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
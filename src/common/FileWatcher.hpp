@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <filesystem>
+
+// Watches a set of directories (recursively) on a background thread and
+// collects the paths of files that were written. Uses inotify on Linux and
+// falls back to polling modification times everywhere else.
+class FileWatcher {
+public:
+	FileWatcher();
+
+	bool Start(std::string const& rootDirectory, std::vector<std::string> const& directories);
+	void Stop();
+
+	// Returns the changed files since the last call, relative to the root
+	// directory and with forward slashes (e.g. "shaders/fragment.glsl").
+	std::vector<std::string> PollChanges();
+
+	std::string const& GetRootDirectory() { return rootDirectory; }
+
+	~FileWatcher();
+
+private:
+	std::string rootDirectory;
+	std::vector<std::string> directories;
+
+	std::thread watchThread;
+	std::atomic<bool> running;
+
+	std::mutex changesMutex;
+	std::set<std::string> changes;
+
+	void PushChange(std::filesystem::path const& file);
+
+	void WatchLoop();
+
+#ifdef __linux__
+	int inotifyFd;
+	std::map<int, std::filesystem::path> watchDescriptors;
+
+	void AddWatch(std::filesystem::path const& directory);
+#else
+	std::map<std::string, std::filesystem::file_time_type> writeTimes;
+
+	void ScanDirectories(bool notify);
+#endif
+};
@@ -0,0 +1,58 @@
+#include "FillLights.hpp"
+
+#include <cmath>
+
+FillLights::FillLights()
+{
+	buffer = 0;
+}
+
+bool FillLights::Init()
+{
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, N_FILL_LIGHTS * sizeof(FillLight), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	return buffer != 0;
+}
+
+void FillLights::Scatter(unsigned int count, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax, float radius, float intensity)
+{
+	if (count > N_FILL_LIGHTS) count = N_FILL_LIGHTS;
+
+	lights.resize(count);
+
+	// An R2 sequence covers the box evenly at any count, the hues go round the color wheel.
+	const float a1 = 0.7548777f, a2 = 0.5698403f;
+
+	for (unsigned int i = 0; i < count; i++) {
+		float u = fmodf(0.5f + a1 * i, 1.f);
+		float v = fmodf(0.5f + a2 * i, 1.f);
+		float hue = fmodf(0.618034f * i, 1.f) * 6.2831853f;
+
+		glm::vec3 position = glm::mix(boundsMin, boundsMax, glm::vec3(u, 0.5f, v));
+		glm::vec3 color = glm::vec3(cosf(hue), cosf(hue - 2.0943951f), cosf(hue + 2.0943951f)) * 0.5f + 0.5f;
+
+		lights[i].positionRadius = glm::vec4(position, radius);
+		lights[i].colorIntensity = glm::vec4(color, intensity);
+	}
+
+	if (count > 0) {
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(FillLight), lights.data());
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+}
+
+void FillLights::Bind()
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, FILL_LIGHT_BINDING, buffer);
+}
+
+FillLights::~FillLights()
+{
+	if (buffer) {
+		glDeleteBuffers(1, &buffer);
+	}
+}
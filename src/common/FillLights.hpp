@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+#include <Constants.hpp>
+
+// std140 layout of fragment.glsl's FillLight.
+struct FillLight {
+	glm::vec4 positionRadius;
+	glm::vec4 colorIntensity;
+};
+
+// Unshadowed point lights that fade out to nothing at their radius, so they only touch the pixels
+// near them. Both renderers read them from one uniform buffer: the forward shader loops over all of
+// them for every fragment, the deferred one draws a volume per light.
+class FillLights {
+public:
+	FillLights();
+
+	bool Init();
+
+	// Spreads count lights, at most N_FILL_LIGHTS, evenly over the box's x and z, halfway up.
+	void Scatter(unsigned int count, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax, float radius, float intensity);
+
+	unsigned int GetCount() { return (unsigned int)lights.size(); }
+
+	// To FILL_LIGHT_BINDING, where Shader points every FillLightBlock.
+	void Bind();
+
+	~FillLights();
+
+private:
+	std::vector<FillLight> lights;
+	GLuint buffer;
+};
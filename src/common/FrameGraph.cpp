@@ -0,0 +1,313 @@
+#include "FrameGraph.hpp"
+
+#include <stdio.h>
+#include <algorithm>
+
+FrameGraph::FrameGraph()
+{
+	stats = {};
+}
+
+FrameResource FrameGraph::CreateTexture(const char* name, FrameTextureDesc const& desc)
+{
+	resources.push_back({ name, desc, true, false, 0 });
+	return (FrameResource)(resources.size() - 1);
+}
+
+FrameResource FrameGraph::Import(const char* name)
+{
+	resources.push_back({ name, FrameTextureDesc{}, false, false, 0 });
+	return (FrameResource)(resources.size() - 1);
+}
+
+void FrameGraph::MarkOutput(FrameResource resource)
+{
+	resources[resource].output = true;
+}
+
+void FrameGraph::AddPass(const char* name, std::vector<FrameResource> const& reads, std::vector<FrameResource> const& writes,
+	std::function<void()> execute)
+{
+	passes.push_back({ name, reads, writes, execute, false });
+}
+
+GLuint FrameGraph::GetTexture(FrameResource resource)
+{
+	return resources[resource].texture;
+}
+
+bool FrameGraph::Writes(Pass const& pass, FrameResource resource)
+{
+	return std::find(pass.writes.begin(), pass.writes.end(), resource) != pass.writes.end();
+}
+
+bool FrameGraph::Uses(Pass const& pass, FrameResource resource)
+{
+	return Writes(pass, resource) || std::find(pass.reads.begin(), pass.reads.end(), resource) != pass.reads.end();
+}
+
+// Passes writing an output stay, then every writer added before a staying pass of what it reads.
+void FrameGraph::Cull()
+{
+	for (Pass& pass : passes) {
+		pass.kept = false;
+		for (FrameResource resource : pass.writes) {
+			pass.kept = pass.kept || resources[resource].output;
+		}
+	}
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+
+		for (size_t i = 0; i < passes.size(); i++) {
+			if (!passes[i].kept) {
+				continue;
+			}
+
+			for (FrameResource resource : passes[i].reads) {
+				for (size_t j = 0; j < i; j++) {
+					Pass& writer = passes[j];
+					if (!writer.kept && Writes(writer, resource)) {
+						writer.kept = true;
+						changed = true;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Kahn's sort over the kept passes, taking the earliest added of those ready so independent passes
+// keep the order they were added in.
+std::vector<size_t> FrameGraph::Order()
+{
+	size_t count = passes.size();
+	std::vector<std::vector<bool>> after(count, std::vector<bool>(count, false));
+
+	// In the order added, readers wait on the last writer before them and a writer on the readers since the previous one.
+	for (FrameResource resource = 0; resource < resources.size(); resource++) {
+		size_t previousWriter = count;
+		std::vector<size_t> readers;
+
+		for (size_t i = 0; i < count; i++) {
+			if (!passes[i].kept || !Uses(passes[i], resource)) {
+				continue;
+			}
+
+			if (previousWriter < count) {
+				after[i][previousWriter] = true;
+			}
+
+			if (!Writes(passes[i], resource)) {
+				readers.push_back(i);
+				continue;
+			}
+
+			for (size_t reader : readers) {
+				after[i][reader] = true;
+			}
+
+			readers.clear();
+			previousWriter = i;
+		}
+	}
+
+	std::vector<size_t> order;
+	std::vector<bool> done(count, false);
+
+	for (size_t i = 0; i < count; i++) {
+		done[i] = !passes[i].kept;
+	}
+
+	for (;;) {
+		size_t next = count;
+		bool remaining = false;
+
+		for (size_t i = 0; i < count && next == count; i++) {
+			if (done[i]) {
+				continue;
+			}
+
+			remaining = true;
+
+			bool ready = true;
+			for (size_t j = 0; j < count && ready; j++) {
+				ready = !after[i][j] || done[j];
+			}
+
+			if (ready) {
+				next = i;
+			}
+		}
+
+		if (!remaining) {
+			break;
+		}
+
+		// A cycle, the rest run in the order they were added.
+		if (next == count) {
+			printf("Frame graph: passes depend on each other, running them as added\n");
+			for (size_t i = 0; i < count; i++) {
+				if (!done[i]) {
+					order.push_back(i);
+					done[i] = true;
+				}
+			}
+			break;
+		}
+
+		order.push_back(next);
+		done[next] = true;
+	}
+
+	return order;
+}
+
+void FrameGraph::Execute()
+{
+	stats = {};
+	stats.passes = passes.size();
+
+	Cull();
+	std::vector<size_t> order = Order();
+	stats.culledPasses = passes.size() - order.size();
+
+	// Where each transient texture is first and last used in the order.
+	std::vector<size_t> first(resources.size(), order.size()), last(resources.size(), 0);
+
+	for (size_t position = 0; position < order.size(); position++) {
+		for (FrameResource resource = 0; resource < resources.size(); resource++) {
+			if (resources[resource].transient && Uses(passes[order[position]], resource)) {
+				first[resource] = std::min(first[resource], position);
+				last[resource] = position;
+			}
+		}
+	}
+
+	for (FrameResource resource = 0; resource < resources.size(); resource++) {
+		if (resources[resource].transient) {
+			stats.unaliasedBytes += GetBytes(resources[resource].desc);
+		}
+
+		if (first[resource] < order.size()) {
+			stats.transientTextures++;
+		}
+	}
+
+	for (PooledTexture& pooled : pool) {
+		pooled.usedThisFrame = false;
+	}
+
+	for (size_t position = 0; position < order.size(); position++) {
+		Pass& pass = passes[order[position]];
+
+		for (FrameResource resource = 0; resource < resources.size(); resource++) {
+			if (first[resource] == position) {
+				resources[resource].texture = Acquire(resources[resource].desc);
+			}
+		}
+
+		pass.execute();
+
+		for (FrameResource resource = 0; resource < resources.size(); resource++) {
+			if (first[resource] < order.size() && last[resource] == position) {
+				Release(resources[resource].texture);
+			}
+		}
+
+		if (position > 0) {
+			stats.order += ", ";
+		}
+		stats.order += pass.name;
+	}
+
+	// Textures left over this frame go, after a resize they would never match again.
+	for (size_t i = 0; i < pool.size();) {
+		if (!pool[i].usedThisFrame) {
+			glDeleteTextures(1, &pool[i].texture);
+			pool.erase(pool.begin() + i);
+		}
+		else {
+			stats.allocatedBytes += GetBytes(pool[i].desc);
+			i++;
+		}
+	}
+
+	resources.clear();
+	passes.clear();
+}
+
+GLuint FrameGraph::Acquire(FrameTextureDesc const& desc)
+{
+	for (PooledTexture& pooled : pool) {
+		if (!pooled.inUse && pooled.desc.width == desc.width && pooled.desc.height == desc.height &&
+			pooled.desc.internalFormat == desc.internalFormat) {
+			pooled.inUse = true;
+			pooled.usedThisFrame = true;
+			return pooled.texture;
+		}
+	}
+
+	bool depthStencil = desc.internalFormat == GL_DEPTH24_STENCIL8;
+	bool depth = depthStencil || desc.internalFormat == GL_DEPTH_COMPONENT16 || desc.internalFormat == GL_DEPTH_COMPONENT24 ||
+		desc.internalFormat == GL_DEPTH_COMPONENT32F;
+
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0,
+		depthStencil ? GL_DEPTH_STENCIL : depth ? GL_DEPTH_COMPONENT : GL_RGBA, depthStencil ? GL_UNSIGNED_INT_24_8 : GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	pool.push_back({ desc, texture, true, true });
+	return texture;
+}
+
+void FrameGraph::Release(GLuint texture)
+{
+	for (PooledTexture& pooled : pool) {
+		if (pooled.texture == texture) {
+			pooled.inUse = false;
+		}
+	}
+}
+
+size_t FrameGraph::GetBytes(FrameTextureDesc const& desc)
+{
+	size_t texelBytes = 4;
+
+	switch (desc.internalFormat) {
+	case GL_R8:
+		texelBytes = 1;
+		break;
+	case GL_RG8:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16:
+		texelBytes = 2;
+		break;
+	case GL_RGBA16F:
+	case GL_RG32F:
+		texelBytes = 8;
+		break;
+	case GL_RGBA32F:
+		texelBytes = 16;
+		break;
+	default:
+		// RGBA8, RGB10_A2, RG16F, R32F and the 24 and 32 bit depth formats.
+		break;
+	}
+
+	return (size_t)desc.width * desc.height * texelBytes;
+}
+
+FrameGraph::~FrameGraph()
+{
+	for (PooledTexture& pooled : pool) {
+		glDeleteTextures(1, &pooled.texture);
+	}
+}
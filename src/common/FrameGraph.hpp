@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <GL\glew.h>
+
+// A resource declared to the frame graph, valid until the next Execute.
+typedef unsigned int FrameResource;
+
+struct FrameTextureDesc {
+	GLsizei width;
+	GLsizei height;
+	GLenum internalFormat;
+};
+
+struct FrameGraphStats {
+	size_t passes;
+	size_t culledPasses;
+	size_t transientTextures;
+
+	// Backing this frame's transient textures, and what every declared one, culled or not, would take
+	// with a texture of its own, the way each target was allocated for good before the graph.
+	size_t allocatedBytes;
+	size_t unaliasedBytes;
+
+	// Names of the passes run, in order.
+	std::string order;
+};
+
+// Passes declare what they read and write and the graph works out the rest every frame: passes
+// that no output depends on are culled, the others run after the passes added before them that
+// write what they read, writers of one resource run in the order they were added and after the
+// earlier passes reading it. Nothing orders a pass after writers added later than it. Transient textures come from a pool
+// when their first pass runs and go back after their last one, so those whose lifetimes don't
+// overlap share a texture. Passes bind their own framebuffers.
+class FrameGraph {
+public:
+	FrameGraph();
+
+	FrameResource CreateTexture(const char* name, FrameTextureDesc const& desc);
+
+	// Kept outside the graph, like the shadow maps the lights own or the casters one pass gathers
+	// for the next. The graph only orders the passes using it.
+	FrameResource Import(const char* name);
+
+	void MarkOutput(FrameResource resource);
+
+	void AddPass(const char* name, std::vector<FrameResource> const& reads, std::vector<FrameResource> const& writes,
+		std::function<void()> execute);
+
+	// A transient texture, from within a pass using it.
+	GLuint GetTexture(FrameResource resource);
+
+	// Culls, orders and runs the passes added since the last call.
+	void Execute();
+
+	FrameGraphStats const& GetStats() { return stats; }
+
+	~FrameGraph();
+
+private:
+	struct Resource {
+		std::string name;
+		FrameTextureDesc desc;
+		bool transient;
+		bool output;
+		GLuint texture;
+	};
+
+	struct Pass {
+		std::string name;
+		std::vector<FrameResource> reads;
+		std::vector<FrameResource> writes;
+		std::function<void()> execute;
+		bool kept;
+	};
+
+	struct PooledTexture {
+		FrameTextureDesc desc;
+		GLuint texture;
+		bool inUse;
+		bool usedThisFrame;
+	};
+
+	void Cull();
+	std::vector<size_t> Order();
+
+	GLuint Acquire(FrameTextureDesc const& desc);
+	void Release(GLuint texture);
+
+	static bool Writes(Pass const& pass, FrameResource resource);
+	static bool Uses(Pass const& pass, FrameResource resource);
+	static size_t GetBytes(FrameTextureDesc const& desc);
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<PooledTexture> pool;
+	FrameGraphStats stats;
+};
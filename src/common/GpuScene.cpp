@@ -0,0 +1,369 @@
+#include "GpuScene.hpp"
+
+#include <stdio.h>
+#include <algorithm>
+
+namespace {
+
+	// Must match local_size_x and local_size_y of the compute shaders.
+	const GLuint cullGroupSize = 64;
+	const GLuint hiZGroupSize = 8;
+
+	// Storage buffer bindings shared with the compute shaders.
+	const GLuint instanceBinding = 0;
+	const GLuint modelBinding = 1;
+	const GLuint counterBinding = 2;
+	const GLuint transformBinding = 3;
+	const GLuint commandBinding = 4;
+	const GLuint commandCounterBinding = 5;
+
+	GLuint CreateBuffer()
+	{
+		GLuint buffer = 0;
+		glGenBuffers(1, &buffer);
+		return buffer;
+	}
+
+	void UploadBuffer(GLuint buffer, GLsizeiptr size, const void* data)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+}
+
+GpuScene::GpuScene()
+{
+	instancesDirty = false;
+	tablesDirty = false;
+	instanceBuffer = 0;
+	modelBuffer = 0;
+	commandCounterBuffer = 0;
+	commandCount = 0;
+	counterCount = 0;
+	slotCount = 0;
+	depthCopy = 0;
+	hiZ = 0;
+	depthWidth = 0;
+	depthHeight = 0;
+	hiZLevels = 0;
+	hiZViewProjection = glm::mat4(1.f);
+	hiZValid = false;
+}
+
+bool GpuScene::IsSupported()
+{
+	return GLEW_VERSION_4_3 != 0;
+}
+
+bool GpuScene::Init(unsigned int viewCount)
+{
+	if (!IsSupported()) {
+		return false;
+	}
+
+	if (!cullShader.CreateComputeFromFile("shaders/gpu_cull_compute.glsl") ||
+		!commandShader.CreateComputeFromFile("shaders/gpu_cull_commands_compute.glsl") ||
+		!hiZShader.CreateComputeFromFile("shaders/hiz_compute.glsl")) {
+		printf("GPU culling shaders failed to compile, using the CPU path\n");
+		return false;
+	}
+
+	instanceBuffer = CreateBuffer();
+	modelBuffer = CreateBuffer();
+	commandCounterBuffer = CreateBuffer();
+
+	views.resize(viewCount);
+	for (auto& view : views) {
+		view.commandBuffer = CreateBuffer();
+		view.counterBuffer = CreateBuffer();
+		view.transformBuffer = CreateBuffer();
+	}
+
+	return true;
+}
+
+unsigned int GpuScene::AddModel(Model* model)
+{
+	models.push_back({ model, 0, {}, 0, 0 });
+	tablesDirty = true;
+	return (unsigned int)models.size() - 1;
+}
+
+void GpuScene::AddInstance(unsigned int model, glm::mat4 const& transform)
+{
+	instances.push_back({ transform, model, { 0, 0, 0 } });
+	models[model].instanceCount++;
+	instancesDirty = true;
+	tablesDirty = true;
+}
+
+bool GpuScene::UpdateTables()
+{
+	if (views.empty() || instances.empty()) {
+		return false;
+	}
+
+	if (instancesDirty) {
+		UploadBuffer(instanceBuffer, instances.size() * sizeof(GpuInstance), instances.data());
+		instancesDirty = false;
+	}
+
+	for (auto const& entry : models) {
+		if (entry.meshes != entry.model->GetMeshes()) {
+			tablesDirty = true;
+		}
+	}
+
+	if (tablesDirty) {
+		std::vector<GpuModel> modelData;
+		std::vector<DrawElementsIndirectCommand> commands;
+		std::vector<GLuint> commandCounters;
+
+		counterCount = 0;
+		slotCount = 0;
+
+		for (auto& entry : models) {
+			Model* model = entry.model;
+
+			entry.meshes = model->GetMeshes();
+			entry.lodCount = std::min(std::max(model->GetLodCount(), 1u), maxLods);
+			entry.firstCommand = (GLuint)commands.size();
+
+			// Every LOD gets room for all instances, they may all pick the same one.
+			GpuModel data = {};
+			data.boundsMin = glm::vec4(model->GetBoundsMin(), 0.f);
+			data.boundsMax = glm::vec4(model->GetBoundsMax(), 0.f);
+			data.lodCount = entry.lodCount;
+			data.counterBase = counterCount;
+			data.slotBase = slotCount;
+			data.capacity = entry.meshes.empty() ? 0 : (GLuint)entry.instanceCount;
+
+			for (GLuint lod = 0; lod < entry.lodCount && lod < model->GetLodCount(); lod++) {
+				data.lodErrors[lod / 4][lod % 4] = model->GetLodError(lod);
+			}
+
+			// Each mesh's commands are its LODs in order, one multi-draw each.
+			for (auto mesh : entry.meshes) {
+				for (GLuint lod = 0; lod < entry.lodCount; lod++) {
+					MeshLod const& level = mesh->GetLod(lod);
+					commands.push_back({ level.indexCount, 0, level.indexOffset, 0, data.slotBase + lod * data.capacity });
+					commandCounters.push_back(data.counterBase + lod);
+				}
+			}
+
+			counterCount += entry.lodCount;
+			slotCount += entry.lodCount * data.capacity;
+			modelData.push_back(data);
+		}
+
+		commandCount = (GLuint)commands.size();
+
+		UploadBuffer(modelBuffer, modelData.size() * sizeof(GpuModel), modelData.data());
+		UploadBuffer(commandCounterBuffer, commandCounters.size() * sizeof(GLuint), commandCounters.data());
+
+		for (auto const& view : views) {
+			UploadBuffer(view.commandBuffer, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+			UploadBuffer(view.counterBuffer, counterCount * sizeof(GLuint), nullptr);
+			UploadBuffer(view.transformBuffer, slotCount * sizeof(glm::mat4), nullptr);
+		}
+
+		tablesDirty = false;
+	}
+
+	return commandCount > 0 && slotCount > 0;
+}
+
+void GpuScene::Cull(unsigned int view, glm::mat4 const& viewProjection, glm::vec3 const& eye, float lodProjectionScale, float lodMaxPixels,
+	unsigned int lodBias, bool occlusion)
+{
+	if (!UpdateTables()) {
+		return;
+	}
+
+	View const& target = views[view];
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, target.counterBuffer);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instanceBinding, instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, modelBinding, modelBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, counterBinding, target.counterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, transformBinding, target.transformBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, commandBinding, target.commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, commandCounterBinding, commandCounterBuffer);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, hiZ);
+
+	cullShader.UseShader();
+	cullShader.SetCullView(viewProjection, eye);
+	cullShader.SetCullLod(lodProjectionScale, lodMaxPixels, (GLint)lodBias);
+	cullShader.SetCullOcclusion(occlusion && hiZValid, hiZViewProjection, 0);
+	glDispatchCompute(((GLuint)instances.size() + cullGroupSize - 1) / cullGroupSize, 1, 1);
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	commandShader.UseShader();
+	glDispatchCompute((commandCount + cullGroupSize - 1) / cullGroupSize, 1, 1);
+
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+}
+
+void GpuScene::Draw(unsigned int view, bool depth)
+{
+	if (views.empty() || commandCount == 0 || slotCount == 0) {
+		return;
+	}
+
+	View const& target = views[view];
+
+	for (auto const& entry : models) {
+		if (!entry.meshes.empty() && entry.meshes == entry.model->GetMeshes()) {
+			entry.model->RenderModelIndirect(target.commandBuffer, entry.firstCommand, entry.lodCount, target.transformBuffer, depth);
+		}
+	}
+}
+
+void GpuScene::CreateHiZ(GLsizei width, GLsizei height)
+{
+	if (depthCopy) {
+		glDeleteTextures(1, &depthCopy);
+	}
+
+	if (hiZ) {
+		glDeleteTextures(1, &hiZ);
+	}
+
+	depthWidth = width;
+	depthHeight = height;
+
+	glGenTextures(1, &depthCopy);
+	glBindTexture(GL_TEXTURE_2D, depthCopy);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	GLsizei hiZWidth = std::max(width / 2, 1);
+	GLsizei hiZHeight = std::max(height / 2, 1);
+
+	hiZLevels = 1;
+	while ((std::max(hiZWidth, hiZHeight) >> hiZLevels) > 0) {
+		hiZLevels++;
+	}
+
+	glGenTextures(1, &hiZ);
+	glBindTexture(GL_TEXTURE_2D, hiZ);
+	glTexStorage2D(GL_TEXTURE_2D, hiZLevels, GL_R32F, hiZWidth, hiZHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	hiZValid = false;
+}
+
+void GpuScene::BuildHiZ(glm::mat4 const& viewProjection)
+{
+	if (views.empty() || instances.empty()) {
+		return;
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	if (viewport[2] != depthWidth || viewport[3] != depthHeight) {
+		CreateHiZ(viewport[2], viewport[3]);
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, depthCopy);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], depthWidth, depthHeight);
+
+	hiZShader.UseShader();
+
+	// Each level is the farthest depth of the one before, the first one of the copied depth.
+	for (GLint level = 0; level < hiZLevels; level++) {
+		GLsizei width = std::max((depthWidth / 2) >> level, 1);
+		GLsizei height = std::max((depthHeight / 2) >> level, 1);
+
+		glBindTexture(GL_TEXTURE_2D, level == 0 ? depthCopy : hiZ);
+		hiZShader.SetHiZSource(0, level == 0 ? 0 : level - 1);
+		glBindImageTexture(0, hiZ, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		glDispatchCompute((width + hiZGroupSize - 1) / hiZGroupSize, (height + hiZGroupSize - 1) / hiZGroupSize, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+
+	hiZViewProjection = viewProjection;
+	hiZValid = true;
+}
+
+GpuCullStats GpuScene::ReadStats(unsigned int view)
+{
+	GpuCullStats stats = { instances.size(), 0, 0 };
+
+	if (views.empty() || commandCount == 0) {
+		return stats;
+	}
+
+	std::vector<DrawElementsIndirectCommand> commands(commandCount);
+
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, views[view].commandBuffer);
+	glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	for (auto const& entry : models) {
+		// The first mesh's commands hold the instances of every LOD, the others repeat them.
+		for (GLuint lod = 0; lod < entry.lodCount && !entry.meshes.empty(); lod++) {
+			stats.drawn += commands[entry.firstCommand + lod].instanceCount;
+		}
+	}
+
+	for (auto const& command : commands) {
+		stats.triangles += (size_t)command.count / 3 * command.instanceCount;
+	}
+
+	return stats;
+}
+
+void GpuScene::Release()
+{
+	for (auto& view : views) {
+		glDeleteBuffers(1, &view.commandBuffer);
+		glDeleteBuffers(1, &view.counterBuffer);
+		glDeleteBuffers(1, &view.transformBuffer);
+	}
+	views.clear();
+
+	if (instanceBuffer) {
+		glDeleteBuffers(1, &instanceBuffer);
+		glDeleteBuffers(1, &modelBuffer);
+		glDeleteBuffers(1, &commandCounterBuffer);
+		instanceBuffer = modelBuffer = commandCounterBuffer = 0;
+	}
+
+	if (depthCopy) {
+		glDeleteTextures(1, &depthCopy);
+		depthCopy = 0;
+	}
+
+	if (hiZ) {
+		glDeleteTextures(1, &hiZ);
+		hiZ = 0;
+	}
+}
+
+GpuScene::~GpuScene()
+{
+	Release();
+}
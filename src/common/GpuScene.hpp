@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+#include <Model.hpp>
+#include <Shader.hpp>
+
+// Read back from a view's draw list, summed over every model.
+struct GpuCullStats {
+	size_t instances;
+	size_t drawn;
+	size_t triangles;
+};
+
+// GPU-driven culling for many instances of a few models, GL 4.3 only. The
+// instances and a table of their models live in storage buffers. Per view a
+// compute pass tests every instance against the frustum and, for the camera,
+// a farthest depth pyramid of the last frame, picks its LOD and appends its
+// transform to that LOD's list. A second pass copies the list sizes into the
+// draw commands, so each mesh is one multi-draw over its LODs and nothing is
+// read back. Models that haven't loaded yet are skipped until they have.
+class GpuScene {
+public:
+	static const unsigned int maxLods = 8;
+
+	GpuScene();
+
+	static bool IsSupported();
+
+	// Each view culls into its own draw list, so the camera's can be drawn twice after the shadow's.
+	bool Init(unsigned int viewCount);
+
+	unsigned int AddModel(Model* model);
+	void AddInstance(unsigned int model, glm::mat4 const& transform);
+
+	size_t GetInstanceCount() { return instances.size(); }
+
+	// lodMaxPixels and lodBias as for Model::SelectLod and the shadow passes, without the hysteresis.
+	void Cull(unsigned int view, glm::mat4 const& viewProjection, glm::vec3 const& eye, float lodProjectionScale, float lodMaxPixels,
+		unsigned int lodBias, bool occlusion);
+
+	// Binds each mesh's texture first unless depth, the shader takes the model matrix from attributes 6 to 9.
+	void Draw(unsigned int view, bool depth);
+
+	// Reduces the depth in the current viewport of the read framebuffer, for the next frame's occlusion tests.
+	void BuildHiZ(glm::mat4 const& viewProjection);
+
+	// Waits on the GPU, for benchmarks.
+	GpuCullStats ReadStats(unsigned int view);
+
+	~GpuScene();
+
+private:
+	// std430 layouts of the compute shaders' buffers.
+	struct GpuInstance {
+		glm::mat4 transform;
+		GLuint model;
+		GLuint padding[3];
+	};
+
+	struct GpuModel {
+		glm::vec4 boundsMin;
+		glm::vec4 boundsMax;
+		glm::vec4 lodErrors[maxLods / 4];
+		GLuint lodCount;
+		GLuint counterBase;
+		GLuint slotBase;
+		GLuint capacity;
+	};
+
+	struct ModelEntry {
+		Model* model;
+		size_t instanceCount;
+
+		// As of the last table build, a reload swaps in other meshes.
+		std::vector<Mesh*> meshes;
+		GLuint lodCount;
+		GLuint firstCommand;
+	};
+
+	struct View {
+		GLuint commandBuffer;
+		GLuint counterBuffer;
+		GLuint transformBuffer;
+	};
+
+	bool UpdateTables();
+	void CreateHiZ(GLsizei width, GLsizei height);
+	void Release();
+
+	Shader cullShader, commandShader, hiZShader;
+
+	std::vector<ModelEntry> models;
+	std::vector<GpuInstance> instances;
+	std::vector<View> views;
+	bool instancesDirty, tablesDirty;
+
+	GLuint instanceBuffer, modelBuffer, commandCounterBuffer;
+	GLuint commandCount, counterCount, slotCount;
+
+	// Copy of the depth buffer, then its pyramid from half resolution down, in window depth.
+	GLuint depthCopy, hiZ;
+	GLsizei depthWidth, depthHeight;
+	GLint hiZLevels;
+	glm::mat4 hiZViewProjection;
+	bool hiZValid;
+};
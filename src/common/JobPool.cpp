@@ -0,0 +1,110 @@
+#include "JobPool.hpp"
+
+#include <algorithm>
+
+JobPool::JobPool()
+{
+	stopping = false;
+}
+
+void JobPool::Init(unsigned int workerCount)
+{
+	Shutdown();
+
+	if (workerCount == 0) {
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 1;
+	}
+
+	stopping = false;
+
+	for (unsigned int i = 0; i < workerCount; i++) {
+		workers.emplace_back(&JobPool::WorkerLoop, this);
+	}
+}
+
+void JobPool::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueCondition.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	workers.clear();
+
+	// Anything still queued runs on the caller so no future is left dangling.
+	while (RunPendingJob()) {
+	}
+}
+
+void JobPool::ParallelFor(size_t count, size_t minChunk, std::function<void(size_t begin, size_t end)> const& body)
+{
+	if (count == 0) {
+		return;
+	}
+
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>(count / std::max<size_t>(minChunk, 1), workers.size() + 1));
+	size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+	std::vector<std::future<void>> chunks;
+
+	for (size_t begin = chunkSize; begin < count; begin += chunkSize) {
+		size_t end = std::min(begin + chunkSize, count);
+		chunks.push_back(Submit([&body, begin, end]() { body(begin, end); }));
+	}
+
+	body(0, std::min(chunkSize, count));
+
+	for (auto& chunk : chunks) {
+		Wait(chunk);
+	}
+}
+
+bool JobPool::RunPendingJob()
+{
+	std::function<void()> job;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (queue.empty()) {
+			return false;
+		}
+
+		job = std::move(queue.front());
+		queue.pop_front();
+	}
+
+	job();
+	return true;
+}
+
+void JobPool::WorkerLoop()
+{
+	while (true) {
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this]() { return stopping || !queue.empty(); });
+
+			if (queue.empty()) {
+				return;
+			}
+
+			job = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		job();
+	}
+}
+
+JobPool::~JobPool()
+{
+	Shutdown();
+}
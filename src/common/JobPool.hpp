@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+
+// Fixed set of worker threads shared by the loaders and the per-frame systems.
+// Jobs must not touch GL, there is only one context and it lives on the main thread.
+class JobPool {
+public:
+	JobPool();
+
+	// workerCount 0 picks one thread per core, minus the main thread.
+	void Init(unsigned int workerCount = 0);
+	void Shutdown();
+
+	template<typename F>
+	auto Submit(F&& job) -> std::future<decltype(job())>
+	{
+		using Result = decltype(job());
+
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+		std::future<Result> result = task->get_future();
+
+		if (workers.empty()) {
+			(*task)();
+			return result;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			queue.push_back([task]() { (*task)(); });
+		}
+		queueCondition.notify_one();
+
+		return result;
+	}
+
+	// Splits [0, count) into chunks of at least minChunk items and runs body(begin, end)
+	// on the workers. The calling thread works on the queue too until every chunk is done.
+	void ParallelFor(size_t count, size_t minChunk, std::function<void(size_t begin, size_t end)> const& body);
+
+	// Blocks on a future while helping with queued jobs, so waiting from inside a job can't deadlock.
+	template<typename T>
+	void Wait(std::future<T>& future)
+	{
+		while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			if (!RunPendingJob()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	unsigned int GetWorkerCount() { return (unsigned int)workers.size(); }
+
+	~JobPool();
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> queue;
+
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	bool stopping;
+
+	bool RunPendingJob();
+	void WorkerLoop();
+};
@@ -0,0 +1,271 @@
+#include "Ktx2File.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+
+namespace {
+
+	const uint8_t identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+#pragma pack(push, 4)
+	struct Header {
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+#pragma pack(pop)
+
+	static_assert(sizeof(Header) == 68, "KTX2 header must be tightly packed");
+
+	// VkFormat values of the formats the cooker writes.
+	enum : uint32_t {
+		VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131,
+		VK_FORMAT_BC3_UNORM_BLOCK = 137,
+		VK_FORMAT_BC5_UNORM_BLOCK = 141,
+		VK_FORMAT_BC7_UNORM_BLOCK = 145
+	};
+
+	// Data format descriptor colour models and channel ids (Khronos DFD spec).
+	enum : uint32_t {
+		KHR_DF_MODEL_BC1A = 128,
+		KHR_DF_MODEL_BC3 = 130,
+		KHR_DF_MODEL_BC5 = 132,
+		KHR_DF_MODEL_BC7 = 134,
+		KHR_DF_PRIMARIES_BT709 = 1,
+		KHR_DF_TRANSFER_LINEAR = 1,
+		KHR_DF_CHANNEL_COLOR = 0,
+		KHR_DF_CHANNEL_GREEN = 1,
+		KHR_DF_CHANNEL_ALPHA = 15
+	};
+
+	uint32_t GetVkFormat(BlockFormat format)
+	{
+		switch (format) {
+		case BlockFormat::BC1: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case BlockFormat::BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
+		case BlockFormat::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case BlockFormat::BC7: return VK_FORMAT_BC7_UNORM_BLOCK;
+		}
+		return 0;
+	}
+
+	bool GetBlockFormat(uint32_t vkFormat, BlockFormat& format)
+	{
+		switch (vkFormat) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK: format = BlockFormat::BC1; return true;
+		case VK_FORMAT_BC3_UNORM_BLOCK: format = BlockFormat::BC3; return true;
+		case VK_FORMAT_BC5_UNORM_BLOCK: format = BlockFormat::BC5; return true;
+		case VK_FORMAT_BC7_UNORM_BLOCK: format = BlockFormat::BC7; return true;
+		}
+		return false;
+	}
+
+	void AppendSample(std::vector<uint32_t>& dfd, uint32_t bitOffset, uint32_t bitLength, uint32_t channel)
+	{
+		dfd.push_back(bitOffset | ((bitLength - 1) << 16) | (channel << 24));
+		dfd.push_back(0);
+		dfd.push_back(0);
+		dfd.push_back(0xFFFFFFFF);
+	}
+
+	std::vector<uint32_t> BuildDataFormatDescriptor(BlockFormat format)
+	{
+		std::vector<uint32_t> dfd;
+		uint32_t model = 0;
+
+		std::vector<uint32_t> samples;
+
+		switch (format) {
+		case BlockFormat::BC1:
+			model = KHR_DF_MODEL_BC1A;
+			AppendSample(samples, 0, 64, KHR_DF_CHANNEL_COLOR);
+			break;
+		case BlockFormat::BC3:
+			model = KHR_DF_MODEL_BC3;
+			AppendSample(samples, 0, 64, KHR_DF_CHANNEL_ALPHA);
+			AppendSample(samples, 64, 64, KHR_DF_CHANNEL_COLOR);
+			break;
+		case BlockFormat::BC5:
+			model = KHR_DF_MODEL_BC5;
+			AppendSample(samples, 0, 64, KHR_DF_CHANNEL_COLOR);
+			AppendSample(samples, 64, 64, KHR_DF_CHANNEL_GREEN);
+			break;
+		case BlockFormat::BC7:
+			model = KHR_DF_MODEL_BC7;
+			AppendSample(samples, 0, 128, KHR_DF_CHANNEL_COLOR);
+			break;
+		}
+
+		uint32_t blockSize = 24 + (uint32_t)samples.size() * 4;
+
+		dfd.push_back(4 + blockSize); // dfdTotalSize
+		dfd.push_back(0); // vendorId, descriptorType
+		dfd.push_back(2 | (blockSize << 16)); // versionNumber, descriptorBlockSize
+		dfd.push_back(model | (KHR_DF_PRIMARIES_BT709 << 8) | (KHR_DF_TRANSFER_LINEAR << 16));
+		dfd.push_back(3 | (3 << 8)); // 4x4x1x1 texel block
+		dfd.push_back((uint32_t)BlockCompression::GetBlockSize(format)); // bytesPlane0
+		dfd.push_back(0); // bytesPlane4..7
+
+		dfd.insert(dfd.end(), samples.begin(), samples.end());
+
+		return dfd;
+	}
+
+}
+
+Ktx2File::Ktx2File()
+{
+	format = BlockFormat::BC1;
+	width = 0;
+	height = 0;
+}
+
+bool Ktx2File::Write(std::string const& path, BlockFormat format, int width, int height, std::vector<std::vector<uint8_t>> const& levelData)
+{
+	std::vector<uint32_t> dfd = BuildDataFormatDescriptor(format);
+
+	Header header = {};
+	header.vkFormat = GetVkFormat(format);
+	header.typeSize = 1;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.faceCount = 1;
+	header.levelCount = (uint32_t)levelData.size();
+	header.dfdByteOffset = (uint32_t)(sizeof(identifier) + sizeof(Header) + sizeof(LevelIndex) * levelData.size());
+	header.dfdByteLength = (uint32_t)(dfd.size() * sizeof(uint32_t));
+
+	// Level data follows the descriptor, smallest mip first, each aligned to the block size.
+	uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+	uint64_t alignment = BlockCompression::GetBlockSize(format);
+
+	std::vector<LevelIndex> index(levelData.size());
+
+	for (size_t i = levelData.size(); i-- > 0; ) {
+		offset = (offset + alignment - 1) / alignment * alignment;
+
+		index[i].byteOffset = offset;
+		index[i].byteLength = levelData[i].size();
+		index[i].uncompressedByteLength = levelData[i].size();
+
+		offset += levelData[i].size();
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		printf("Failed to write %s\n", path.c_str());
+		return false;
+	}
+
+	file.write((char const*)identifier, sizeof(identifier));
+	file.write((char const*)&header, sizeof(header));
+	file.write((char const*)index.data(), sizeof(LevelIndex) * index.size());
+	file.write((char const*)dfd.data(), dfd.size() * sizeof(uint32_t));
+
+	uint64_t position = header.dfdByteOffset + header.dfdByteLength;
+	const char padding[16] = {};
+
+	for (size_t i = levelData.size(); i-- > 0; ) {
+		file.write(padding, index[i].byteOffset - position);
+		file.write((char const*)levelData[i].data(), levelData[i].size());
+		position = index[i].byteOffset + levelData[i].size();
+	}
+
+	return file.good();
+}
+
+bool Ktx2File::Open(std::string const& path)
+{
+	this->path = path;
+	levels.clear();
+	packed = PackView();
+
+	// A packed file is read from the pack's mapping, a loose one a piece at a time.
+	std::ifstream file;
+	size_t position = 0;
+
+	if (!AssetPack::LoadPacked(path, packed)) {
+		file.open(path, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+	}
+
+	auto read = [&](void* data, size_t size) {
+		if (!packed.GetData()) {
+			file.read((char*)data, size);
+			return file.good();
+		}
+
+		if (size > packed.GetSize() - position) {
+			return false;
+		}
+
+		memcpy(data, packed.GetData() + position, size);
+		position += size;
+		return true;
+	};
+
+	uint8_t fileIdentifier[12];
+	Header header;
+
+	if (!read(fileIdentifier, sizeof(fileIdentifier)) || !read(&header, sizeof(header)) ||
+		memcmp(fileIdentifier, identifier, sizeof(identifier)) != 0) {
+		printf("%s is not a KTX2 file\n", path.c_str());
+		return false;
+	}
+
+	if (!GetBlockFormat(header.vkFormat, format) || header.supercompressionScheme != 0 ||
+		header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.levelCount == 0) {
+		printf("%s uses an unsupported KTX2 layout\n", path.c_str());
+		return false;
+	}
+
+	width = header.pixelWidth;
+	height = header.pixelHeight;
+
+	levels.resize(header.levelCount);
+	return read(levels.data(), sizeof(LevelIndex) * levels.size());
+}
+
+bool Ktx2File::ReadLevel(unsigned int level, std::vector<uint8_t>& data)
+{
+	if (level >= levels.size()) {
+		return false;
+	}
+
+	if (packed.GetData()) {
+		LevelIndex const& index = levels[level];
+		if (index.byteOffset > packed.GetSize() || index.byteLength > packed.GetSize() - index.byteOffset) {
+			return false;
+		}
+
+		data.assign(packed.GetData() + index.byteOffset, packed.GetData() + index.byteOffset + index.byteLength);
+		return true;
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	data.resize(levels[level].byteLength);
+
+	file.seekg(levels[level].byteOffset);
+	file.read((char*)data.data(), data.size());
+
+	return file.good();
+}
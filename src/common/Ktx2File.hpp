@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <BlockCompression.hpp>
+#include <AssetPack.hpp>
+
+// Minimal KTX2 container for the cooked textures: one 2D image, one layer,
+// block compressed, no supercompression. Levels can be read one at a time so
+// the streamer only pulls in the mips it needs. Files in the mounted pack are
+// read from its mapping.
+class Ktx2File {
+public:
+	Ktx2File();
+
+	static bool Write(std::string const& path, BlockFormat format, int width, int height,
+		std::vector<std::vector<uint8_t>> const& levels);
+
+	// Reads the header and level index only, or maps a packed file.
+	bool Open(std::string const& path);
+	bool ReadLevel(unsigned int level, std::vector<uint8_t>& data);
+
+	BlockFormat GetFormat() { return format; }
+	int GetWidth() { return width; }
+	int GetHeight() { return height; }
+	unsigned int GetLevelCount() { return (unsigned int)levels.size(); }
+	size_t GetLevelSize(unsigned int level) { return levels[level].byteLength; }
+
+	static int GetLevelWidth(int width, unsigned int level) { return width >> level > 0 ? width >> level : 1; }
+	static int GetLevelHeight(int height, unsigned int level) { return height >> level > 0 ? height >> level : 1; }
+
+private:
+	struct LevelIndex {
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	std::string path;
+	BlockFormat format;
+	int width, height;
+	std::vector<LevelIndex> levels;
+	PackView packed;
+};
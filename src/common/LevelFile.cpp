@@ -0,0 +1,235 @@
+#include "LevelFile.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+
+namespace {
+	// Sections start on 16 bytes, which covers every record's alignment.
+	const uint32_t sectionAlignment = 16;
+
+	uint32_t Align(uint32_t offset)
+	{
+		return (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+	}
+
+	template<typename T>
+	LevelSection Place(uint32_t& offset, std::vector<T> const& records)
+	{
+		offset = Align(offset);
+		LevelSection section = { offset, (uint32_t)records.size() };
+		offset += (uint32_t)(records.size() * sizeof(T));
+		return section;
+	}
+
+	template<typename T>
+	void Put(std::vector<uint8_t>& data, LevelSection const& section, std::vector<T> const& records)
+	{
+		if (!records.empty()) {
+			memcpy(data.data() + section.offset, records.data(), records.size() * sizeof(T));
+		}
+	}
+}
+
+LevelFile::LevelFile()
+{
+	header = nullptr;
+}
+
+bool LevelFile::Load(std::string const& path)
+{
+	Close();
+
+	if (!file.Open(path)) {
+		printf("Failed to open level %s\n", path.c_str());
+		return false;
+	}
+
+	header = (LevelHeader const*)file.GetData();
+
+	if (!Check()) {
+		printf("Level %s is damaged or from another version\n", path.c_str());
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void LevelFile::Close()
+{
+	file.Close();
+	header = nullptr;
+}
+
+template<typename T>
+bool LevelFile::CheckSection(LevelSection const& section)
+{
+	return section.offset % alignof(T) == 0 && section.offset <= file.GetSize() &&
+		section.count <= (file.GetSize() - section.offset) / sizeof(T);
+}
+
+bool LevelFile::CheckString(uint32_t offset)
+{
+	LevelSection const& strings = header->strings;
+	return offset >= strings.offset && offset < strings.offset + strings.count;
+}
+
+bool LevelFile::Check()
+{
+	if (file.GetSize() < sizeof(LevelHeader) || header->magic != levelMagic || header->version != levelVersion ||
+		header->fileSize != file.GetSize()) {
+		return false;
+	}
+
+	// The string section has to end in a terminator for the strings in it to.
+	LevelSection const& strings = header->strings;
+	if (!CheckSection<char>(strings) || strings.count == 0 || file.GetData()[strings.offset + strings.count - 1] != 0) {
+		return false;
+	}
+
+	if (!CheckSection<LevelModel>(header->models) || !CheckSection<LevelMaterial>(header->materials) ||
+		!CheckSection<LevelEntity>(header->entities) || !CheckSection<LevelDirectionalLight>(header->directionalLights) ||
+		!CheckSection<LevelPointLight>(header->pointLights) || !CheckSection<LevelSpotLight>(header->spotLights)) {
+		return false;
+	}
+
+	for (uint32_t face : header->skyboxFaces) {
+		if (!CheckString(face)) {
+			return false;
+		}
+	}
+
+	LevelModel const* models = GetModels();
+	for (uint32_t i = 0; i < GetModelCount(); i++) {
+		if (!CheckString(models[i].name) || !CheckString(models[i].path)) {
+			return false;
+		}
+	}
+
+	LevelMaterial const* materials = GetMaterials();
+	for (uint32_t i = 0; i < GetMaterialCount(); i++) {
+		if (!CheckString(materials[i].name)) {
+			return false;
+		}
+	}
+
+	LevelEntity const* entities = GetEntities();
+	for (uint32_t i = 0; i < GetEntityCount(); i++) {
+		LevelEntity const& entity = entities[i];
+
+		if (!CheckString(entity.name) || (entity.model != noLevelIndex && entity.model >= GetModelCount()) ||
+			(entity.material != noLevelIndex && entity.material >= GetMaterialCount()) ||
+			(entity.parent != noLevelIndex && entity.parent >= i)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::vector<std::string> LevelFile::GetSkyboxFaces()
+{
+	std::vector<std::string> faces;
+	for (uint32_t face : header->skyboxFaces) {
+		faces.push_back(GetString(face));
+	}
+	return faces;
+}
+
+uint32_t LevelFile::FindEntity(const char* name)
+{
+	LevelEntity const* entities = GetEntities();
+	for (uint32_t i = 0; i < GetEntityCount(); i++) {
+		if (strcmp(GetString(entities[i].name), name) == 0) {
+			return i;
+		}
+	}
+
+	return noLevelIndex;
+}
+
+void LevelFile::Instantiate(Scene& scene, std::vector<Entity>& entities)
+{
+	LevelEntity const* records = GetEntities();
+	uint32_t count = GetEntityCount();
+
+	scene.Reserve(scene.GetEntityCount() + count);
+	entities.resize(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		LevelEntity const& record = records[i];
+
+		Entity entity = scene.Create();
+		if (record.parent != noLevelIndex) {
+			scene.SetParent(entity, entities[record.parent]);
+		}
+
+		scene.SetPosition(entity, glm::vec3(record.position[0], record.position[1], record.position[2]));
+		scene.SetRotation(entity, glm::quat(record.rotation[3], record.rotation[0], record.rotation[1], record.rotation[2]));
+		scene.SetScale(entity, glm::vec3(record.scale[0], record.scale[1], record.scale[2]));
+		entities[i] = entity;
+	}
+}
+
+bool LevelFile::Write(std::string const& path, std::vector<LevelModel> const& models, std::vector<LevelMaterial> const& materials,
+	std::vector<LevelEntity> const& entities, std::vector<LevelDirectionalLight> const& directionalLights,
+	std::vector<LevelPointLight> const& pointLights, std::vector<LevelSpotLight> const& spotLights,
+	uint32_t const skyboxFaces[6], std::vector<char> const& strings)
+{
+	LevelHeader header = {};
+	header.magic = levelMagic;
+	header.version = levelVersion;
+
+	uint32_t offset = sizeof(LevelHeader);
+	header.models = Place(offset, models);
+	header.materials = Place(offset, materials);
+	header.entities = Place(offset, entities);
+	header.directionalLights = Place(offset, directionalLights);
+	header.pointLights = Place(offset, pointLights);
+	header.spotLights = Place(offset, spotLights);
+	header.strings = Place(offset, strings);
+	header.fileSize = offset;
+
+	// String offsets come in relative to strings and go out relative to the file.
+	uint32_t base = header.strings.offset;
+
+	for (int i = 0; i < 6; i++) {
+		header.skyboxFaces[i] = skyboxFaces[i] + base;
+	}
+
+	std::vector<LevelModel> placedModels = models;
+	for (LevelModel& model : placedModels) {
+		model.name += base;
+		model.path += base;
+	}
+
+	std::vector<LevelMaterial> placedMaterials = materials;
+	for (LevelMaterial& material : placedMaterials) {
+		material.name += base;
+	}
+
+	std::vector<LevelEntity> placedEntities = entities;
+	for (LevelEntity& entity : placedEntities) {
+		entity.name += base;
+	}
+
+	std::vector<uint8_t> data(header.fileSize, 0);
+	memcpy(data.data(), &header, sizeof(header));
+	Put(data, header.models, placedModels);
+	Put(data, header.materials, placedMaterials);
+	Put(data, header.entities, placedEntities);
+	Put(data, header.directionalLights, directionalLights);
+	Put(data, header.pointLights, pointLights);
+	Put(data, header.spotLights, spotLights);
+	Put(data, header.strings, strings);
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out) {
+		printf("Failed to write %s\n", path.c_str());
+		return false;
+	}
+
+	out.write((const char*)data.data(), data.size());
+	return (bool)out;
+}
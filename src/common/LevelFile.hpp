@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <MappedFile.hpp>
+#include <Scene.hpp>
+
+// Compiled levels, written by level_compiler from a text description and mapped as they are: a
+// header, arrays of fixed size records, then the strings the records point at. Strings are offsets
+// from the start of the file and everything else an index into its array, so nothing is rewritten
+// or allocated when a level loads. Parents come before their children.
+static const uint32_t levelMagic = 0x314C564C;		// "LVL1"
+static const uint32_t levelVersion = 1;
+static const uint32_t noLevelIndex = 0xFFFFFFFFu;
+
+struct LevelSection {
+	uint32_t offset;
+	uint32_t count;
+};
+
+struct LevelHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t fileSize;
+
+	LevelSection models;
+	LevelSection materials;
+	LevelSection entities;
+	LevelSection directionalLights;
+	LevelSection pointLights;
+	LevelSection spotLights;
+
+	// Bytes, the strings are null terminated.
+	LevelSection strings;
+
+	// Right, left, top, bottom, back and front, as Skybox takes them.
+	uint32_t skyboxFaces[6];
+};
+
+struct LevelModel {
+	uint32_t name;
+	uint32_t path;
+};
+
+struct LevelMaterial {
+	uint32_t name;
+	float specularIntensity;
+	float shininess;
+};
+
+struct LevelEntity {
+	uint32_t name;
+	uint32_t model;			// or noLevelIndex
+	uint32_t material;		// or noLevelIndex
+	uint32_t parent;		// or noLevelIndex
+	float position[3];
+	float rotation[4];		// quaternion, x y z w
+	float scale[3];
+};
+
+struct LevelDirectionalLight {
+	float color[3];
+	float ambientIntensity;
+	float diffuseIntensity;
+	float direction[3];
+	uint32_t shadowWidth;
+	uint32_t shadowHeight;
+};
+
+struct LevelPointLight {
+	float color[3];
+	float ambientIntensity;
+	float diffuseIntensity;
+	float position[3];
+	float constant;
+	float linear;
+	float exponent;
+	uint32_t shadowWidth;
+	uint32_t shadowHeight;
+	float nearPlane;
+	float farPlane;
+};
+
+struct LevelSpotLight {
+	LevelPointLight light;
+	float direction[3];
+	float edgeAngle;		// degrees
+};
+
+class LevelFile {
+public:
+	LevelFile();
+
+	// Maps the file and checks every offset and index in it, which touches each record once but
+	// copies nothing.
+	bool Load(std::string const& path);
+	void Close();
+
+	LevelModel const* GetModels() { return GetSection<LevelModel>(header->models); }
+	uint32_t GetModelCount() { return header->models.count; }
+	LevelMaterial const* GetMaterials() { return GetSection<LevelMaterial>(header->materials); }
+	uint32_t GetMaterialCount() { return header->materials.count; }
+	LevelEntity const* GetEntities() { return GetSection<LevelEntity>(header->entities); }
+	uint32_t GetEntityCount() { return header->entities.count; }
+	LevelDirectionalLight const* GetDirectionalLights() { return GetSection<LevelDirectionalLight>(header->directionalLights); }
+	uint32_t GetDirectionalLightCount() { return header->directionalLights.count; }
+	LevelPointLight const* GetPointLights() { return GetSection<LevelPointLight>(header->pointLights); }
+	uint32_t GetPointLightCount() { return header->pointLights.count; }
+	LevelSpotLight const* GetSpotLights() { return GetSection<LevelSpotLight>(header->spotLights); }
+	uint32_t GetSpotLightCount() { return header->spotLights.count; }
+
+	const char* GetString(uint32_t offset) { return (const char*)file.GetData() + offset; }
+	std::vector<std::string> GetSkyboxFaces();
+
+	// Index of the first entity so named, or noLevelIndex.
+	uint32_t FindEntity(const char* name);
+
+	// Creates the entities in file order with their transforms and parents, entities[i] gets the
+	// handle of entity i. Components are the caller's to add.
+	void Instantiate(Scene& scene, std::vector<Entity>& entities);
+
+	size_t GetSize() { return file.GetSize(); }
+
+	// Writes a level laid out the way Load expects, the records' string offsets index strings.
+	static bool Write(std::string const& path, std::vector<LevelModel> const& models, std::vector<LevelMaterial> const& materials,
+		std::vector<LevelEntity> const& entities, std::vector<LevelDirectionalLight> const& directionalLights,
+		std::vector<LevelPointLight> const& pointLights, std::vector<LevelSpotLight> const& spotLights,
+		uint32_t const skyboxFaces[6], std::vector<char> const& strings);
+
+private:
+	template<typename T>
+	T const* GetSection(LevelSection const& section) { return (T const*)(file.GetData() + section.offset); }
+
+	template<typename T>
+	bool CheckSection(LevelSection const& section);
+
+	bool CheckString(uint32_t offset);
+	bool Check();
+
+	MappedFile file;
+	LevelHeader const* header;
+};
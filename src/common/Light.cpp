@@ -5,6 +5,7 @@ Light::Light()
 	color = glm::vec3(1.0f, 1.0f, 1.0f);
 	ambientIntensity = 1.f;
 	diffuseIntensity = 0.f;
+	shadowMap = nullptr;
 }
 
 Light::Light(GLfloat red, GLfloat green, GLfloat blue, GLfloat ambientIntensity, GLfloat diffuseIntensity,
@@ -16,8 +17,12 @@ Light::Light(GLfloat red, GLfloat green, GLfloat blue, GLfloat ambientIntensity,
 
 	this->ambientIntensity = ambientIntensity;
 	this->diffuseIntensity = diffuseIntensity;
-	shadowMap = new ShadowMap();
-	shadowMap->Init(shadowWidth, shadowHeight);
+	shadowMap = nullptr;
+
+	if (shadowWidth > 0 && shadowHeight > 0) {
+		shadowMap = new ShadowMap();
+		shadowMap->Init(shadowWidth, shadowHeight);
+	}
 }
 
 Light::~Light()
@@ -0,0 +1,178 @@
+#include "Lz4.hpp"
+
+#include <string.h>
+#include <vector>
+
+namespace {
+	const int hashBits = 16;
+	const size_t minMatch = 4;
+	const size_t maxOffset = 65535;
+
+	// The format's end rules: the last 5 bytes are literals and no match starts in the last 12.
+	const size_t lastLiterals = 5;
+	const size_t matchStartLimit = 12;
+
+	uint32_t Read32(uint8_t const* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint32_t Hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - hashBits);
+	}
+
+	uint8_t* WriteLength(uint8_t* output, size_t length)
+	{
+		while (length >= 255) {
+			*output++ = 255;
+			length -= 255;
+		}
+		*output++ = (uint8_t)length;
+		return output;
+	}
+
+	bool ReadLength(uint8_t const*& input, uint8_t const* end, size_t& length)
+	{
+		uint8_t byte;
+		do {
+			if (input >= end) {
+				return false;
+			}
+			byte = *input++;
+			length += byte;
+		} while (byte == 255);
+
+		return true;
+	}
+
+	uint8_t* WriteLiterals(uint8_t* output, uint8_t token, uint8_t const* literals, size_t count)
+	{
+		*output++ = token | (uint8_t)((count < 15 ? count : 15) << 4);
+		if (count >= 15) {
+			output = WriteLength(output, count - 15);
+		}
+
+		memcpy(output, literals, count);
+		return output + count;
+	}
+}
+
+size_t Lz4::Compress(uint8_t const* input, size_t size, uint8_t* output, size_t capacity)
+{
+	if (capacity < GetMaxCompressedSize(size)) {
+		return 0;
+	}
+
+	std::vector<uint32_t> table((size_t)1 << hashBits, 0);
+	uint8_t* out = output;
+	size_t anchor = 0;
+	size_t position = 0;
+
+	// Misses make the search step grow, so data that doesn't compress is skipped through quickly.
+	size_t misses = 0;
+
+	while (position + matchStartLimit <= size) {
+		uint32_t sequence = Read32(input + position);
+		uint32_t& slot = table[Hash(sequence)];
+		size_t candidate = slot;
+		slot = (uint32_t)position;
+
+		if (candidate >= position || position - candidate > maxOffset || Read32(input + candidate) != sequence) {
+			position += 1 + (misses++ >> 6);
+			continue;
+		}
+
+		misses = 0;
+
+		while (position > anchor && candidate > 0 && input[position - 1] == input[candidate - 1]) {
+			position--;
+			candidate--;
+		}
+
+		size_t length = minMatch;
+		while (position + length < size - lastLiterals && input[position + length] == input[candidate + length]) {
+			length++;
+		}
+
+		size_t matchLength = length - minMatch;
+		out = WriteLiterals(out, (uint8_t)(matchLength < 15 ? matchLength : 15), input + anchor, position - anchor);
+
+		size_t offset = position - candidate;
+		*out++ = (uint8_t)offset;
+		*out++ = (uint8_t)(offset >> 8);
+
+		if (matchLength >= 15) {
+			out = WriteLength(out, matchLength - 15);
+		}
+
+		position += length;
+		anchor = position;
+	}
+
+	out = WriteLiterals(out, 0, input + anchor, size - anchor);
+	return (size_t)(out - output);
+}
+
+bool Lz4::Decompress(uint8_t const* input, size_t inputSize, uint8_t* output, size_t size)
+{
+	uint8_t const* in = input;
+	uint8_t const* inEnd = input + inputSize;
+	uint8_t* out = output;
+	uint8_t* outEnd = output + size;
+
+	while (in < inEnd) {
+		uint8_t token = *in++;
+
+		size_t literals = token >> 4;
+		if (literals == 15 && !ReadLength(in, inEnd, literals)) {
+			return false;
+		}
+
+		if (literals > (size_t)(inEnd - in) || literals > (size_t)(outEnd - out)) {
+			return false;
+		}
+
+		memcpy(out, in, literals);
+		in += literals;
+		out += literals;
+
+		// The last sequence has literals only.
+		if (in == inEnd) {
+			break;
+		}
+
+		if (inEnd - in < 2) {
+			return false;
+		}
+
+		size_t offset = in[0] | (size_t)in[1] << 8;
+		in += 2;
+
+		size_t length = token & 15;
+		if (length == 15 && !ReadLength(in, inEnd, length)) {
+			return false;
+		}
+		length += minMatch;
+
+		if (offset == 0 || offset > (size_t)(out - output) || length > (size_t)(outEnd - out)) {
+			return false;
+		}
+
+		// Matches may overlap what they write, a short offset repeats a pattern.
+		uint8_t const* match = out - offset;
+		if (offset >= length) {
+			memcpy(out, match, length);
+			out += length;
+		}
+		else {
+			for (size_t i = 0; i < length; i++) {
+				*out++ = match[i];
+			}
+		}
+	}
+
+	return out == outEnd;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// LZ4 block format, no frame: greedy matching on a hash of 4 byte sequences, the
+// format's 64 KB window. Decoding is a loop of copies, fast enough to sit between
+// a mapped file and the loaders.
+class Lz4 {
+public:
+	static size_t GetMaxCompressedSize(size_t size) { return size + size / 255 + 16; }
+
+	// Bytes written, 0 if capacity is below GetMaxCompressedSize(size).
+	static size_t Compress(uint8_t const* input, size_t size, uint8_t* output, size_t capacity);
+
+	// False unless input decodes to exactly size bytes.
+	static bool Decompress(uint8_t const* input, size_t inputSize, uint8_t* output, size_t size);
+};
@@ -0,0 +1,120 @@
+#include "MappedFile.hpp"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	data = nullptr;
+	size = 0;
+	open = false;
+
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = nullptr;
+#endif
+}
+
+bool MappedFile::Open(std::string const& path)
+{
+	Close();
+
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		Close();
+		return false;
+	}
+
+	size = (size_t)fileSize.QuadPart;
+
+	if (size > 0) {
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		data = mapping ? (uint8_t const*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+		if (!data) {
+			printf("Failed to map %s\n", path.c_str());
+			Close();
+			return false;
+		}
+	}
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) != 0) {
+		::close(fd);
+		return false;
+	}
+
+	size = (size_t)status.st_size;
+
+	// The mapping keeps the file, the descriptor can go.
+	if (size > 0) {
+		void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (mapped == MAP_FAILED) {
+			printf("Failed to map %s\n", path.c_str());
+			::close(fd);
+			size = 0;
+			return false;
+		}
+
+		data = (uint8_t const*)mapped;
+	}
+
+	::close(fd);
+#endif
+
+	open = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+
+	if (mapping) {
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (data) {
+		munmap((void*)data, size);
+	}
+#endif
+
+	data = nullptr;
+	size = 0;
+	open = false;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
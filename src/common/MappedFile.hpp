@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// A whole file mapped read-only. Only the pages touched are read, and they stay shared with the
+// OS's file cache instead of being copied into the process.
+class MappedFile {
+public:
+	MappedFile();
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	// An empty file opens with no data.
+	bool Open(std::string const& path);
+	void Close();
+
+	bool IsOpen() { return open; }
+	uint8_t const* GetData() { return data; }
+	size_t GetSize() { return size; }
+
+	~MappedFile();
+
+private:
+	uint8_t const* data;
+	size_t size;
+	bool open;
+
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#endif
+};
@@ -1,50 +1,276 @@
 #include <Mesh.hpp>
 
+#include <algorithm>
+
+size_t Mesh::submittedTriangles = 0;
+size_t Mesh::submittedDraws = 0;
+ClusterStats Mesh::clusterStats = {};
+std::vector<GLsizei> Mesh::drawCounts;
+std::vector<const GLvoid*> Mesh::drawOffsets;
+
 Mesh::Mesh() {
 	VAO = 0;
 	VBO = 0;
 	IBO = 0;
 	indexCount = 0;
+	indexType = GL_UNSIGNED_INT;
+	depthVAO = 0;
+	depthVBO = 0;
+	depthIBO = 0;
+	depthIndexType = GL_UNSIGNED_INT;
+	positionScale = glm::vec4(1.f, 1.f, 1.f, 0.f);
+	positionOffset = glm::vec4(0.f);
+	boundsMin = glm::vec3(0.f);
+	boundsMax = glm::vec3(0.f);
 }
 
 void Mesh::CreateMesh(GLfloat* vertices, unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices) {
-	indexCount = numOfIndices;
+	CreateMesh(VertexPacker::Pack(vertices, numOfVertices / 8, indices, numOfIndices, VertexPacker::GetFullFormat()));
+}
+
+void Mesh::CreateMesh(PackedMesh const& packed) {
+	VertexFormat const& format = packed.format;
+	GLsizei stride = format.GetStride();
+
+	indexCount = packed.indexCount;
+	indexType = format.shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	lods = packed.lods;
+	clusters = packed.clusters;
+	boundsMin = packed.boundsMin;
+	boundsMax = packed.boundsMax;
+
+	if (lods.empty()) {
+		lods.push_back({ 0, packed.indexCount, 0.f, 0, 0 });
+	}
+
+	positionScale = glm::vec4(packed.positionScale, 0.f);
+	positionOffset = glm::vec4(packed.positionOffset, format.normal == NormalFormat::Octahedral16 ? 1.f : 0.f);
 
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
 
 	glGenBuffers(1, &IBO);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * numOfIndices, indices, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, packed.indices.size(), packed.indices.data(), GL_STATIC_DRAW);
 
 	glGenBuffers(1, &VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * numOfVertices, vertices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, packed.vertices.size(), packed.vertices.data(), GL_STATIC_DRAW);
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, 0);
+	switch (format.position) {
+	case PositionFormat::Float3:
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 0);
+		break;
+	case PositionFormat::Half4:
+		glVertexAttribPointer(0, 4, GL_HALF_FLOAT, GL_FALSE, stride, 0);
+		break;
+	case PositionFormat::Unorm16x4:
+		glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, 0);
+		break;
+	}
 	glEnableVertexAttribArray(0);
 
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, (void*)(sizeof(vertices[0]) * 3));
+	void* texCoordOffset = (void*)(size_t)format.GetTexCoordOffset();
+	if (format.texCoord == TexCoordFormat::Float2) {
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, texCoordOffset);
+	}
+	else {
+		glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, texCoordOffset);
+	}
 	glEnableVertexAttribArray(1);
 
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, (void*)(sizeof(vertices[0]) * 5));
+	void* normalOffset = (void*)(size_t)format.GetNormalOffset();
+	if (format.normal == NormalFormat::Float3) {
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, normalOffset);
+	}
+	else {
+		glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, stride, normalOffset);
+	}
 	glEnableVertexAttribArray(2);
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
 	glBindVertexArray(0);
+
+	if (packed.depthVertices.empty()) {
+		return;
+	}
+
+	GLsizei depthStride = format.GetPositionStride();
+	depthIndexType = packed.shortDepthIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	glGenVertexArrays(1, &depthVAO);
+	glBindVertexArray(depthVAO);
+
+	glGenBuffers(1, &depthIBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, depthIBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, packed.depthIndices.size(), packed.depthIndices.data(), GL_STATIC_DRAW);
+
+	glGenBuffers(1, &depthVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+	glBufferData(GL_ARRAY_BUFFER, packed.depthVertices.size(), packed.depthVertices.data(), GL_STATIC_DRAW);
+
+	switch (format.position) {
+	case PositionFormat::Float3:
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, depthStride, 0);
+		break;
+	case PositionFormat::Half4:
+		glVertexAttribPointer(0, 4, GL_HALF_FLOAT, GL_FALSE, depthStride, 0);
+		break;
+	case PositionFormat::Unorm16x4:
+		glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, depthStride, 0);
+		break;
+	}
+	glEnableVertexAttribArray(0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glBindVertexArray(0);
 }
 
-void Mesh::RenderMesh() {
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+void Mesh::RenderMesh(unsigned int lod, ClusterView const* view) {
+	Draw(VAO, IBO, indexType, lod, view, 1);
+}
+
+void Mesh::RenderDepth(unsigned int lod, ClusterView const* view, GLsizei instances) {
+	if (depthVAO == 0) {
+		Draw(VAO, IBO, indexType, lod, view, instances);
+		return;
+	}
+
+	Draw(depthVAO, depthIBO, depthIndexType, lod, view, instances);
+}
+
+void Mesh::RenderIndirect(GLuint commandBuffer, GLintptr commandOffset, GLsizei drawCount, GLuint transformBuffer, bool depth) {
+	bool depthStream = depth && depthVAO != 0;
+	GLuint vao = depthStream ? depthVAO : VAO;
+	GLuint ibo = depthStream ? depthIBO : IBO;
+	GLenum type = depthStream ? depthIndexType : indexType;
+
+	if (lods.empty() || drawCount == 0) {
+		return;
+	}
+
+	glVertexAttrib4fv(4, &positionScale[0]);
+	glVertexAttrib4fv(5, &positionOffset[0]);
+
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+	glBindBuffer(GL_ARRAY_BUFFER, transformBuffer);
+	for (GLuint column = 0; column < 4; column++) {
+		glVertexAttribPointer(6 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(6 + column, 1);
+		glEnableVertexAttribArray(6 + column);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, type, (const void*)commandOffset, drawCount, 0);
+	submittedDraws++;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	// The other shaders read the model matrix from a uniform, so the VAO goes back to how it was.
+	for (GLuint column = 0; column < 4; column++) {
+		glDisableVertexAttribArray(6 + column);
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void Mesh::Draw(GLuint vao, GLuint ibo, GLenum type, unsigned int lod, ClusterView const* view, GLsizei instances) {
+	if (lods.empty()) {
+		return;
+	}
+
+	MeshLod const& level = lods[std::min(lod, (unsigned int)lods.size() - 1)];
+	size_t indexSize = type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+	// Current attribute values aren't VAO state, so they're set on every draw.
+	glVertexAttrib4fv(4, &positionScale[0]);
+	glVertexAttrib4fv(5, &positionOffset[0]);
+
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+	if (!view || level.clusterCount == 0) {
+		if (instances == 1) {
+			glDrawElements(GL_TRIANGLES, level.indexCount, type, (void*)(level.indexOffset * indexSize));
+		}
+		else {
+			glDrawElementsInstanced(GL_TRIANGLES, level.indexCount, type, (void*)(level.indexOffset * indexSize), instances);
+		}
+		submittedTriangles += level.indexCount / 3 * instances;
+		submittedDraws++;
+	}
+	else {
+		drawCounts.clear();
+		drawOffsets.clear();
+
+		unsigned int runEnd = 0;
+
+		for (unsigned int i = level.clusterOffset; i < level.clusterOffset + level.clusterCount; i++) {
+			MeshCluster const& cluster = clusters[i];
+			clusterStats.clusters++;
+
+			if (!view->IsInFrustum(cluster)) {
+				clusterStats.frustumCulled++;
+				continue;
+			}
+
+			if (view->cullBackfaces && view->IsBackfacing(cluster)) {
+				clusterStats.backfaceCulled++;
+				continue;
+			}
+
+			if (!drawCounts.empty() && runEnd == cluster.indexOffset) {
+				drawCounts.back() += cluster.indexCount;
+			}
+			else {
+				drawCounts.push_back(cluster.indexCount);
+				drawOffsets.push_back((const GLvoid*)(cluster.indexOffset * indexSize));
+			}
+
+			runEnd = cluster.indexOffset + cluster.indexCount;
+			submittedTriangles += cluster.indexCount / 3 * instances;
+		}
+
+		if (instances == 1 && !drawCounts.empty()) {
+			glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), type, drawOffsets.data(), (GLsizei)drawCounts.size());
+			submittedDraws++;
+		}
+		else {
+			// No instanced multi-draw before GL 4.3.
+			for (size_t i = 0; i < drawCounts.size(); i++) {
+				glDrawElementsInstanced(GL_TRIANGLES, drawCounts[i], type, drawOffsets[i], instances);
+			}
+			submittedDraws += drawCounts.size();
+		}
+	}
+
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 }
 
 void Mesh::ClearMesh() {
+	if (depthIBO != 0) {
+		glDeleteBuffers(1, &depthIBO);
+		depthIBO = 0;
+	}
+
+	if (depthVBO != 0) {
+		glDeleteBuffers(1, &depthVBO);
+		depthVBO = 0;
+	}
+
+	if (depthVAO != 0) {
+		glDeleteVertexArrays(1, &depthVAO);
+		depthVAO = 0;
+	}
+
 	if (IBO != 0) {
 		glDeleteBuffers(1, &IBO);
 		IBO = 0;
@@ -61,6 +287,8 @@ void Mesh::ClearMesh() {
 	}
 
 	indexCount = 0;
+	lods.clear();
+	clusters.clear();
 }
 
 Mesh::~Mesh() {
@@ -1,18 +1,83 @@
 #pragma once
 
+#include <vector>
+#include <algorithm>
+
 #include <GL\glew.h>
+#include <glm\glm.hpp>
+
+#include <VertexPacker.hpp>
+#include <MeshClusterizer.hpp>
+
+// The command layout glMultiDrawElementsIndirect reads, firstIndex counts indices rather than bytes.
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
 
 class Mesh {
 public:
 	Mesh();
 
 	void CreateMesh(GLfloat *vertices, unsigned int *indices, unsigned int numOfVertices, unsigned int numOfIndices);
-	void RenderMesh();
+	void CreateMesh(PackedMesh const& packed);
+
+	// Levels past the coarsest one draw the coarsest. With a view only the
+	// visible clusters are drawn, neighbouring ones merged into one range.
+	void RenderMesh(unsigned int lod = 0, ClusterView const* view = nullptr);
+
+	// Same triangles from the position only stream, for shadow and depth passes.
+	// Instanced draws leave it to the shader to tell the instances apart.
+	void RenderDepth(unsigned int lod = 0, ClusterView const* view = nullptr, GLsizei instances = 1);
+
+	// One multi-draw of drawCount DrawElementsIndirectCommands, GL 4.3 only. Each instance's
+	// model matrix comes from transformBuffer through attributes 6 to 9, offset by the command's baseInstance.
+	void RenderIndirect(GLuint commandBuffer, GLintptr commandOffset, GLsizei drawCount, GLuint transformBuffer, bool depth);
 	void ClearMesh();
 
+	unsigned int GetLodCount() { return (unsigned int)lods.size(); }
+	// Levels past the coarsest one give the coarsest.
+	MeshLod const& GetLod(unsigned int lod) { return lods[std::min(lod, (unsigned int)lods.size() - 1)]; }
+
+	// Bounding sphere of the vertices in model space.
+	glm::vec3 GetBoundsCenter() { return (boundsMin + boundsMax) * 0.5f; }
+	float GetBoundsRadius() { return glm::length(boundsMax - boundsMin) * 0.5f; }
+
+	// Triangles drawn by all meshes since the last reset, each instance counted, and the draw calls that drew them.
+	// A multi-draw is one call.
+	static size_t GetSubmittedTriangles() { return submittedTriangles; }
+	static size_t GetSubmittedDraws() { return submittedDraws; }
+	static void ResetSubmittedTriangles() { submittedTriangles = submittedDraws = 0; }
+
+	static ClusterStats const& GetClusterStats() { return clusterStats; }
+	static void ResetClusterStats() { clusterStats = {}; }
+
 	~Mesh();
 
 private:
 	GLuint VAO, VBO, IBO;
 	GLsizei indexCount;
-};
\ No newline at end of file
+	GLenum indexType;
+	GLuint depthVAO, depthVBO, depthIBO;
+	GLenum depthIndexType;
+	std::vector<MeshLod> lods;
+	std::vector<MeshCluster> clusters;
+	glm::vec3 boundsMin, boundsMax;
+
+	// Dequantization constants, fed to the shaders through disabled attributes 4 and 5.
+	glm::vec4 positionScale;
+	glm::vec4 positionOffset;
+
+	void Draw(GLuint vao, GLuint ibo, GLenum type, unsigned int lod, ClusterView const* view, GLsizei instances);
+
+	static size_t submittedTriangles;
+	static size_t submittedDraws;
+	static ClusterStats clusterStats;
+
+	// Scratch for the compacted draw list.
+	static std::vector<GLsizei> drawCounts;
+	static std::vector<const GLvoid*> drawOffsets;
+};
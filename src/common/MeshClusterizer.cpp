@@ -0,0 +1,303 @@
+#include "MeshClusterizer.hpp"
+
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+
+#include <MeshOptimizer.hpp>
+
+namespace {
+
+	// Clusters whose triangles spread wider than this from the average normal are never back-facing.
+	const float minConeDot = 0.1f;
+
+	// Triangles turned further than about 37 degrees from a cluster's average normal start a new one.
+	const float minClusterDot = 0.8f;
+
+	// Triangles after the first unclustered one that a cluster out of neighbours looks through to top up.
+	const size_t topUpWindow = 1024;
+
+}
+
+ClusterView ClusterView::Create(glm::mat4 const& viewProjection, glm::mat4 const& transform, glm::vec3 const& eye, bool cullBackfaces)
+{
+	ClusterView view;
+
+	// Planes of the combined matrix come out in model space (Gribb and Hartmann).
+	glm::mat4 matrix = viewProjection * transform;
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+	}
+
+	view.planes[0] = rows[3] + rows[0];
+	view.planes[1] = rows[3] - rows[0];
+	view.planes[2] = rows[3] + rows[1];
+	view.planes[3] = rows[3] - rows[1];
+	view.planes[4] = rows[3] + rows[2];
+	view.planes[5] = rows[3] - rows[2];
+
+	for (auto& plane : view.planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	view.eye = glm::vec3(glm::inverse(transform) * glm::vec4(eye, 1.f));
+	view.cullBackfaces = cullBackfaces;
+
+	return view;
+}
+
+bool ClusterView::IsInFrustum(MeshCluster const& cluster) const
+{
+	for (auto& plane : planes) {
+		if (glm::dot(glm::vec3(plane), cluster.center) + plane.w < -cluster.radius) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ClusterView::IsBackfacing(MeshCluster const& cluster) const
+{
+	// Conservative for any eye position that sees some point of the bounding sphere.
+	glm::vec3 toCenter = cluster.center - eye;
+	return glm::dot(toCenter, cluster.coneAxis) >= cluster.coneCutoff * glm::length(toCenter) + cluster.radius;
+}
+
+std::vector<MeshCluster> MeshClusterizer::Build(unsigned int* indices, size_t indexCount, GLfloat const* vertices, size_t vertexCount, size_t vertexStride,
+	unsigned int maxVertices, unsigned int maxTriangles)
+{
+	size_t triangleCount = indexCount / 3;
+	std::vector<MeshCluster> clusters;
+
+	if (triangleCount == 0) {
+		return clusters;
+	}
+
+	auto position = [&](unsigned int v) { return glm::vec3(vertices[v * vertexStride], vertices[v * vertexStride + 1], vertices[v * vertexStride + 2]); };
+
+	std::vector<glm::vec3> normals(triangleCount);
+	std::vector<glm::vec3> centroids(triangleCount);
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		glm::vec3 p0 = position(indices[t * 3]);
+		glm::vec3 p1 = position(indices[t * 3 + 1]);
+		glm::vec3 p2 = position(indices[t * 3 + 2]);
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+
+		normals[t] = length > 0.f ? normal / length : glm::vec3(0.f);
+		centroids[t] = (p0 + p1 + p2) / 3.f;
+	}
+
+	// Neighbours are found through welded positions, flat shaded models and UV seams share few vertices.
+	std::vector<unsigned int> weld = MeshOptimizer::WeldPositions(vertices, vertexCount, vertexStride);
+
+	std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		adjacencyOffset[weld[indices[i]] + 1]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffset[v + 1] += adjacencyOffset[v];
+	}
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		adjacency[fill[weld[indices[i]]]++] = (unsigned int)(i / 3);
+	}
+
+	std::vector<bool> used(triangleCount, false);
+	std::vector<unsigned int> vertexCluster(vertexCount, 0);
+	std::vector<unsigned int> positionCluster(vertexCount, 0);
+	std::vector<unsigned int> clusterTriangles;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+
+	size_t cursor = 0;
+
+	while (true) {
+		while (cursor < triangleCount && used[cursor]) {
+			cursor++;
+		}
+
+		if (cursor == triangleCount) {
+			break;
+		}
+
+		// Cluster ids start at one, zero marks vertices no cluster has used yet.
+		unsigned int id = (unsigned int)clusters.size() + 1;
+		unsigned int clusterVertices = 0;
+		glm::vec3 normalSum(0.f), centroidSum(0.f);
+
+		clusterTriangles.clear();
+		candidates.clear();
+
+		auto addTriangle = [&](unsigned int t) {
+			used[t] = true;
+			clusterTriangles.push_back(t);
+			normalSum += normals[t];
+			centroidSum += centroids[t];
+
+			for (int k = 0; k < 3; k++) {
+				unsigned int v = indices[t * 3 + k];
+
+				if (vertexCluster[v] != id) {
+					vertexCluster[v] = id;
+					clusterVertices++;
+				}
+
+				unsigned int p = weld[v];
+				if (positionCluster[p] != id) {
+					positionCluster[p] = id;
+
+					for (unsigned int a = adjacencyOffset[p]; a < adjacencyOffset[p + 1]; a++) {
+						if (!used[adjacency[a]]) {
+							candidates.push_back(adjacency[a]);
+						}
+					}
+				}
+			}
+		};
+
+		// Degenerate triangles have no normal and fit anywhere.
+		auto facing = [&](unsigned int t, glm::vec3 const& axis) {
+			return normals[t] == glm::vec3(0.f) || axis == glm::vec3(0.f) ? 1.f : glm::dot(normals[t], axis);
+		};
+
+		auto newVertices = [&](unsigned int t) {
+			unsigned int count = 0;
+			for (int k = 0; k < 3; k++) {
+				count += vertexCluster[indices[t * 3 + k]] != id ? 1 : 0;
+			}
+			return count;
+		};
+
+		addTriangle((unsigned int)cursor);
+
+		while (clusterTriangles.size() < maxTriangles) {
+			glm::vec3 axis = glm::length(normalSum) > 0.f ? glm::normalize(normalSum) : glm::vec3(0.f);
+
+			// Prefer neighbours that add the fewest vertices, then the ones facing most the same way as the cluster.
+			int best = -1;
+			float bestScore = FLT_MAX;
+			size_t write = 0;
+
+			for (unsigned int t : candidates) {
+				if (used[t]) {
+					continue;
+				}
+				candidates[write++] = t;
+
+				if (facing(t, axis) < minClusterDot) {
+					continue;
+				}
+
+				unsigned int added = newVertices(t);
+				if (clusterVertices + added > maxVertices) {
+					continue;
+				}
+
+				float score = (float)added - facing(t, axis);
+				if (score < bestScore) {
+					bestScore = score;
+					best = (int)t;
+				}
+			}
+
+			candidates.resize(write);
+
+			// Out of neighbours: top up with the nearest triangle facing the same way among the next few in index order,
+			// which the vertex cache optimisation left close together. Bounded so disjoint pieces stay linear.
+			if (best < 0 && clusterVertices + 3 <= maxVertices) {
+				glm::vec3 center = centroidSum / (float)clusterTriangles.size();
+				float bestDistance = FLT_MAX;
+
+				for (size_t t = cursor; t < std::min(triangleCount, cursor + topUpWindow); t++) {
+					if (used[t] || facing((unsigned int)t, axis) < minClusterDot) {
+						continue;
+					}
+
+					glm::vec3 offset = centroids[t] - center;
+					float distance = glm::dot(offset, offset);
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						best = (int)t;
+					}
+				}
+			}
+
+			if (best < 0) {
+				break;
+			}
+
+			addTriangle((unsigned int)best);
+		}
+
+		size_t offset = output.size();
+		for (unsigned int t : clusterTriangles) {
+			output.insert(output.end(), indices + t * 3, indices + t * 3 + 3);
+		}
+
+		MeshCluster cluster = ComputeBounds(&output[offset], output.size() - offset, vertices, vertexStride);
+		cluster.indexOffset = (unsigned int)offset;
+		cluster.indexCount = (unsigned int)(output.size() - offset);
+		clusters.push_back(cluster);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+	return clusters;
+}
+
+MeshCluster MeshClusterizer::ComputeBounds(unsigned int const* indices, size_t indexCount, GLfloat const* vertices, size_t vertexStride)
+{
+	auto position = [&](unsigned int v) { return glm::vec3(vertices[v * vertexStride], vertices[v * vertexStride + 1], vertices[v * vertexStride + 2]); };
+
+	MeshCluster cluster = {};
+
+	glm::vec3 minimum(FLT_MAX), maximum(-FLT_MAX);
+	for (size_t i = 0; i < indexCount; i++) {
+		minimum = glm::min(minimum, position(indices[i]));
+		maximum = glm::max(maximum, position(indices[i]));
+	}
+
+	cluster.center = (minimum + maximum) * 0.5f;
+	for (size_t i = 0; i < indexCount; i++) {
+		cluster.radius = std::max(cluster.radius, glm::length(position(indices[i]) - cluster.center));
+	}
+
+	std::vector<glm::vec3> normals;
+	glm::vec3 normalSum(0.f);
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		glm::vec3 p0 = position(indices[i]);
+		glm::vec3 normal = glm::cross(position(indices[i + 1]) - p0, position(indices[i + 2]) - p0);
+		float length = glm::length(normal);
+
+		if (length > 0.f) {
+			normals.push_back(normal / length);
+			normalSum += normal / length;
+		}
+	}
+
+	// The cone holds every triangle normal, coneCutoff is the sine of its half angle.
+	cluster.coneCutoff = 1.f;
+
+	if (glm::length(normalSum) > 0.f) {
+		cluster.coneAxis = glm::normalize(normalSum);
+
+		float minDot = 1.f;
+		for (auto& normal : normals) {
+			minDot = std::min(minDot, glm::dot(normal, cluster.coneAxis));
+		}
+
+		if (minDot > minConeDot) {
+			cluster.coneCutoff = sqrtf(1.f - minDot * minDot);
+		}
+	}
+
+	return cluster;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+#include <VertexPacker.hpp>
+
+// Clusters rejected while drawing, summed over every mesh since the last reset.
+struct ClusterStats {
+	size_t clusters;
+	size_t frustumCulled;
+	size_t backfaceCulled;
+};
+
+// Camera frustum and position moved into the model space of one instance, so
+// clusters are tested without transforming their bounds.
+struct ClusterView {
+	glm::vec4 planes[6];
+	glm::vec3 eye;
+	bool cullBackfaces;
+
+	static ClusterView Create(glm::mat4 const& viewProjection, glm::mat4 const& transform, glm::vec3 const& eye, bool cullBackfaces);
+
+	bool IsInFrustum(MeshCluster const& cluster) const;
+
+	// True when every triangle in the cluster faces away from the eye.
+	bool IsBackfacing(MeshCluster const& cluster) const;
+};
+
+// Splits index buffers into small clusters of neighbouring, similarly facing
+// triangles for culling below the mesh level.
+class MeshClusterizer {
+public:
+	// Reorders the triangles so each cluster is one contiguous range, and
+	// returns the clusters with offsets relative to indices.
+	static std::vector<MeshCluster> Build(unsigned int* indices, size_t indexCount, GLfloat const* vertices, size_t vertexCount, size_t vertexStride,
+		unsigned int maxVertices = 128, unsigned int maxTriangles = 128);
+
+private:
+	static MeshCluster ComputeBounds(unsigned int const* indices, size_t indexCount, GLfloat const* vertices, size_t vertexStride);
+};
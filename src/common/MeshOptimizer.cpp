@@ -0,0 +1,288 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include <glm\glm.hpp>
+
+void MeshOptimizer::Optimize(std::vector<GLfloat>& vertices, size_t vertexStride, std::vector<unsigned int>& indices, unsigned int cacheSize)
+{
+	size_t vertexCount = vertices.size() / vertexStride;
+
+	if (indices.size() < 3 || vertexCount == 0) {
+		return;
+	}
+
+	std::vector<size_t> clusters;
+	OptimizeVertexCache(indices.data(), indices.size(), vertexCount, cacheSize, &clusters);
+	OptimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertexStride, clusters);
+
+	vertexCount = OptimizeVertexFetch(vertices.data(), vertexCount, vertexStride, indices.data(), indices.size());
+	vertices.resize(vertexCount * vertexStride);
+}
+
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize,
+	std::vector<size_t>* clusters)
+{
+	size_t triangleCount = indexCount / 3;
+
+	if (clusters) {
+		clusters->clear();
+	}
+
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Triangles around each vertex, as offsets into one shared list.
+	std::vector<unsigned int> liveCount(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		liveCount[indices[i]]++;
+	}
+
+	std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + liveCount[v];
+	}
+
+	std::vector<unsigned int> adjacency(adjacencyOffset[vertexCount]);
+	std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int k = 0; k < 3; k++) {
+			adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+		}
+	}
+
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+
+	unsigned int timestamp = cacheSize + 1;
+	size_t cursor = 0;
+	int fanning = 0;
+
+	auto inCache = [&](unsigned int v) { return timestamp - cacheTime[v] <= cacheSize; };
+
+	while (fanning >= 0) {
+		unsigned int f = (unsigned int)fanning;
+
+		// Each fan starting from a vertex that is no longer cached begins a cluster.
+		if (clusters && !inCache(f) && (clusters->empty() || clusters->back() != output.size() / 3)) {
+			clusters->push_back(output.size() / 3);
+		}
+
+		candidates.clear();
+
+		for (size_t a = adjacencyOffset[f]; a < adjacencyOffset[f + 1]; a++) {
+			unsigned int t = adjacency[a];
+			if (emitted[t]) {
+				continue;
+			}
+
+			for (int k = 0; k < 3; k++) {
+				unsigned int v = indices[t * 3 + k];
+
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveCount[v]--;
+
+				if (!inCache(v)) {
+					cacheTime[v] = timestamp++;
+				}
+			}
+
+			emitted[t] = true;
+		}
+
+		// Next fan: the candidate that stays cached longest once its remaining triangles are added.
+		fanning = -1;
+		int bestPriority = -1;
+
+		for (unsigned int v : candidates) {
+			if (liveCount[v] == 0) {
+				continue;
+			}
+
+			int priority = 0;
+			if (timestamp - cacheTime[v] + 2 * liveCount[v] <= cacheSize) {
+				priority = (int)(timestamp - cacheTime[v]);
+			}
+
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				fanning = (int)v;
+			}
+		}
+
+		// Dead end: back up to a recently used vertex, otherwise move on to the next untouched one.
+		while (fanning < 0 && !deadEnd.empty()) {
+			unsigned int v = deadEnd.back();
+			deadEnd.pop_back();
+
+			if (liveCount[v] > 0) {
+				fanning = (int)v;
+			}
+		}
+
+		while (fanning < 0 && cursor < vertexCount) {
+			if (liveCount[cursor] > 0) {
+				fanning = (int)cursor;
+			}
+			cursor++;
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(unsigned int* indices, size_t indexCount, GLfloat const* vertices, size_t vertexStride,
+	std::vector<size_t> const& clusters)
+{
+	size_t triangleCount = indexCount / 3;
+
+	if (clusters.size() < 2) {
+		return;
+	}
+
+	auto position = [&](unsigned int v) { return glm::vec3(vertices[v * vertexStride], vertices[v * vertexStride + 1], vertices[v * vertexStride + 2]); };
+
+	struct Cluster {
+		size_t begin;
+		size_t end;
+		glm::vec3 centroid;
+		glm::vec3 normal;	// area weighted
+		float area;
+		float sortKey;
+	};
+
+	std::vector<Cluster> sorted;
+	glm::vec3 meshCentroid(0.f);
+	float meshArea = 0.f;
+
+	for (size_t c = 0; c < clusters.size(); c++) {
+		Cluster cluster = { clusters[c], c + 1 < clusters.size() ? clusters[c + 1] : triangleCount, glm::vec3(0.f), glm::vec3(0.f), 0.f, 0.f };
+
+		for (size_t t = cluster.begin; t < cluster.end; t++) {
+			glm::vec3 p0 = position(indices[t * 3]);
+			glm::vec3 p1 = position(indices[t * 3 + 1]);
+			glm::vec3 p2 = position(indices[t * 3 + 2]);
+
+			// Counter-clockwise winding faces outwards.
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(cross) * 0.5f;
+
+			cluster.centroid += (p0 + p1 + p2) * (area / 3.f);
+			cluster.normal += cross * 0.5f;
+			cluster.area += area;
+		}
+
+		meshCentroid += cluster.centroid;
+		meshArea += cluster.area;
+
+		if (cluster.area > 0.f) {
+			cluster.centroid /= cluster.area;
+		}
+
+		sorted.push_back(cluster);
+	}
+
+	if (meshArea > 0.f) {
+		meshCentroid /= meshArea;
+	}
+
+	// Clusters on the outside of the mesh facing away from its centre are likely occluders, so they draw first.
+	for (auto& cluster : sorted) {
+		float length = glm::length(cluster.normal);
+		cluster.sortKey = length > 0.f ? glm::dot(cluster.centroid - meshCentroid, cluster.normal / length) : 0.f;
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), [](Cluster const& a, Cluster const& b) {
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+
+	for (auto& cluster : sorted) {
+		output.insert(output.end(), indices + cluster.begin * 3, indices + cluster.end * 3);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+size_t MeshOptimizer::OptimizeVertexFetch(GLfloat* vertices, size_t vertexCount, size_t vertexStride, unsigned int* indices, size_t indexCount)
+{
+	const unsigned int unused = ~0u;
+
+	std::vector<unsigned int> remap(vertexCount, unused);
+	unsigned int nextVertex = 0;
+
+	for (size_t i = 0; i < indexCount; i++) {
+		unsigned int& target = remap[indices[i]];
+		if (target == unused) {
+			target = nextVertex++;
+		}
+		indices[i] = target;
+	}
+
+	std::vector<GLfloat> reordered(nextVertex * vertexStride);
+
+	for (size_t v = 0; v < vertexCount; v++) {
+		if (remap[v] != unused) {
+			std::copy(vertices + v * vertexStride, vertices + (v + 1) * vertexStride, reordered.begin() + remap[v] * vertexStride);
+		}
+	}
+
+	std::copy(reordered.begin(), reordered.end(), vertices);
+
+	return nextVertex;
+}
+
+std::vector<unsigned int> MeshOptimizer::WeldPositions(GLfloat const* vertices, size_t vertexCount, size_t vertexStride)
+{
+	std::vector<unsigned int> order(vertexCount);
+	std::iota(order.begin(), order.end(), 0);
+
+	auto position = [&](unsigned int v) { return vertices + v * vertexStride; };
+
+	std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+		return std::lexicographical_compare(position(a), position(a) + 3, position(b), position(b) + 3);
+	});
+
+	std::vector<unsigned int> weld(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; i++) {
+		bool same = i > 0 && std::equal(position(order[i]), position(order[i]) + 3, position(order[i - 1]));
+		weld[order[i]] = same ? weld[order[i - 1]] : order[i];
+	}
+
+	return weld;
+}
+
+VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(unsigned int const* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStatistics statistics = { 0, indexCount / 3, 0 };
+
+	// A vertex is in the FIFO while fewer than cacheSize others were added after it.
+	std::vector<size_t> cacheTime(vertexCount, 0);
+	size_t timestamp = cacheSize + 1;
+
+	for (size_t i = 0; i < statistics.triangles * 3; i++) {
+		unsigned int v = indices[i];
+
+		if (cacheTime[v] == 0) {
+			statistics.vertices++;
+		}
+
+		if (timestamp - cacheTime[v] > cacheSize) {
+			cacheTime[v] = timestamp++;
+			statistics.transformed++;
+		}
+	}
+
+	return statistics;
+}
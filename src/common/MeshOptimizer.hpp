@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include <GL\glew.h>
+
+// Result of running an index buffer through a simulated FIFO post-transform cache.
+struct VertexCacheStatistics {
+	size_t transformed;		// cache misses
+	size_t triangles;
+	size_t vertices;		// distinct vertices referenced
+
+	float GetACMR() const { return triangles ? (float)transformed / triangles : 0.f; }
+	float GetATVR() const { return vertices ? (float)transformed / vertices : 0.f; }
+};
+
+// Reorders imported meshes for the GPU: triangles for post-transform cache
+// hits and less overdraw, vertices for sequential fetch. Vertices are the
+// interleaved float layout with the position in the first three floats.
+class MeshOptimizer {
+public:
+	// Runs all passes in order and drops unreferenced vertices.
+	static void Optimize(std::vector<GLfloat>& vertices, size_t vertexStride, std::vector<unsigned int>& indices, unsigned int cacheSize = 16);
+
+	// Tipsify (Sander, Nehab, Barczak, "Fast Triangle Reordering for Vertex
+	// Locality and Reduced Overdraw", 2007). clusters receives the first
+	// triangle of each run that starts from a cold cache.
+	static void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize,
+		std::vector<size_t>* clusters);
+
+	// Sorts the clusters so the outward facing ones, which tend to occlude the rest, draw first.
+	static void OptimizeOverdraw(unsigned int* indices, size_t indexCount, GLfloat const* vertices, size_t vertexStride,
+		std::vector<size_t> const& clusters);
+
+	// Renumbers vertices in first use order and returns the number still referenced.
+	static size_t OptimizeVertexFetch(GLfloat* vertices, size_t vertexCount, size_t vertexStride, unsigned int* indices, size_t indexCount);
+
+	// Maps every vertex to the first vertex with the same position.
+	static std::vector<unsigned int> WeldPositions(GLfloat const* vertices, size_t vertexCount, size_t vertexStride);
+
+	static VertexCacheStatistics AnalyzeVertexCache(unsigned int const* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize);
+};
@@ -0,0 +1,422 @@
+#include "MeshSimplifier.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+	// Borders and seams are held in place by planes through their edges, weighted above the surface planes.
+	const double edgeWeight = 10.0;
+
+	// Collapses may not turn a neighbouring triangle further than about 75 degrees.
+	const double minNormalDot = 0.25;
+
+	uint64_t EdgeKey(unsigned int from, unsigned int to)
+	{
+		return ((uint64_t)from << 32) | to;
+	}
+
+	void Cross(double const* a, double const* b, double const* c, double* normal)
+	{
+		double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		double v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+
+		normal[0] = u[1] * v[2] - u[2] * v[1];
+		normal[1] = u[2] * v[0] - u[0] * v[2];
+		normal[2] = u[0] * v[1] - u[1] * v[0];
+	}
+
+	double Dot(double const* a, double const* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+}
+
+void MeshSimplifier::AddPlane(Quadric& quadric, double const* normal, double distance, double weight)
+{
+	quadric.a00 += weight * normal[0] * normal[0];
+	quadric.a11 += weight * normal[1] * normal[1];
+	quadric.a22 += weight * normal[2] * normal[2];
+	quadric.a01 += weight * normal[0] * normal[1];
+	quadric.a02 += weight * normal[0] * normal[2];
+	quadric.a12 += weight * normal[1] * normal[2];
+	quadric.b0 += weight * normal[0] * distance;
+	quadric.b1 += weight * normal[1] * distance;
+	quadric.b2 += weight * normal[2] * distance;
+	quadric.c += weight * distance * distance;
+	quadric.weight += weight;
+}
+
+void MeshSimplifier::AddQuadric(Quadric& quadric, Quadric const& other)
+{
+	quadric.a00 += other.a00;
+	quadric.a11 += other.a11;
+	quadric.a22 += other.a22;
+	quadric.a01 += other.a01;
+	quadric.a02 += other.a02;
+	quadric.a12 += other.a12;
+	quadric.b0 += other.b0;
+	quadric.b1 += other.b1;
+	quadric.b2 += other.b2;
+	quadric.c += other.c;
+	quadric.weight += other.weight;
+}
+
+double MeshSimplifier::Evaluate(Quadric const& quadric, double const* position)
+{
+	double x = position[0], y = position[1], z = position[2];
+
+	double error = quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z +
+		2.0 * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z) +
+		2.0 * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z) + quadric.c;
+
+	// Weighted mean of the squared plane distances.
+	return quadric.weight > 0.0 ? std::max(error, 0.0) / quadric.weight : 0.0;
+}
+
+size_t MeshSimplifier::Simplify(unsigned int* destination, unsigned int const* indices, size_t indexCount,
+	GLfloat const* vertices, size_t vertexCount, size_t vertexStride, size_t targetIndexCount, float maxError, float* error)
+{
+	std::vector<unsigned int> result(indices, indices + indexCount - indexCount % 3);
+	double worstCost = 0.0;
+
+	if (error) {
+		*error = 0.f;
+	}
+
+	if (result.size() <= targetIndexCount || vertexCount == 0) {
+		std::copy(result.begin(), result.end(), destination);
+		return result.size();
+	}
+
+	// Positions scaled so the largest side of the bounds is one, errors are then relative to the extent.
+	double minimum[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+	double maximum[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+
+	for (size_t v = 0; v < vertexCount; v++) {
+		for (int k = 0; k < 3; k++) {
+			minimum[k] = std::min(minimum[k], (double)vertices[v * vertexStride + k]);
+			maximum[k] = std::max(maximum[k], (double)vertices[v * vertexStride + k]);
+		}
+	}
+
+	double extent = std::max(maximum[0] - minimum[0], std::max(maximum[1] - minimum[1], maximum[2] - minimum[2]));
+	double scale = extent > 0.0 ? 1.0 / extent : 1.0;
+
+	std::vector<double> positions(vertexCount * 3);
+	for (size_t v = 0; v < vertexCount; v++) {
+		for (int k = 0; k < 3; k++) {
+			positions[v * 3 + k] = (vertices[v * vertexStride + k] - minimum[k]) * scale;
+		}
+	}
+
+	// Topology works on welded positions, a position's vertices are its wedges.
+	std::vector<unsigned int> weld = MeshOptimizer::WeldPositions(vertices, vertexCount, vertexStride);
+	auto position = [&](unsigned int v) { return &positions[weld[v] * 3]; };
+
+	struct HalfEdge {
+		unsigned int from;
+		unsigned int to;
+		unsigned int count;
+	};
+
+	std::unordered_map<uint64_t, HalfEdge> halfEdges;
+	halfEdges.reserve(result.size());
+
+	for (size_t i = 0; i < result.size(); i++) {
+		unsigned int a = result[i];
+		unsigned int b = result[i - i % 3 + (i + 1) % 3];
+
+		auto inserted = halfEdges.insert({ EdgeKey(weld[a], weld[b]), HalfEdge{ a, b, 0 } });
+		inserted.first->second.count++;
+	}
+
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	std::vector<bool> border(vertexCount, false);
+	std::vector<bool> locked(vertexCount, false);
+
+	for (size_t t = 0; t < result.size() / 3; t++) {
+		unsigned int const* corners = &result[t * 3];
+
+		double normal[3];
+		Cross(position(corners[0]), position(corners[1]), position(corners[2]), normal);
+
+		double length = sqrt(Dot(normal, normal));
+		if (length == 0.0) {
+			continue;
+		}
+
+		for (int k = 0; k < 3; k++) {
+			normal[k] /= length;
+		}
+
+		for (int k = 0; k < 3; k++) {
+			AddPlane(quadrics[weld[corners[k]]], normal, -Dot(normal, position(corners[0])), length * 0.5);
+		}
+
+		for (int k = 0; k < 3; k++) {
+			unsigned int a = corners[k];
+			unsigned int b = corners[(k + 1) % 3];
+
+			HalfEdge const& edge = halfEdges[EdgeKey(weld[a], weld[b])];
+			auto opposite = halfEdges.find(EdgeKey(weld[b], weld[a]));
+
+			if (edge.count > 1 || (opposite != halfEdges.end() && opposite->second.count > 1)) {
+				locked[weld[a]] = locked[weld[b]] = true;
+				continue;
+			}
+
+			bool isBorder = opposite == halfEdges.end();
+			bool isSeam = !isBorder && (opposite->second.from != b || opposite->second.to != a);
+
+			if (!isBorder && !isSeam) {
+				continue;
+			}
+
+			if (isBorder) {
+				border[weld[a]] = border[weld[b]] = true;
+			}
+
+			// Plane through the edge, perpendicular to the triangle.
+			double const* pa = position(a);
+			double const* pb = position(b);
+			double direction[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+			double edgeLength = sqrt(Dot(direction, direction));
+
+			if (edgeLength == 0.0) {
+				continue;
+			}
+
+			double plane[3] = {
+				direction[1] * normal[2] - direction[2] * normal[1],
+				direction[2] * normal[0] - direction[0] * normal[2],
+				direction[0] * normal[1] - direction[1] * normal[0]
+			};
+			double planeLength = sqrt(Dot(plane, plane));
+
+			for (int j = 0; j < 3; j++) {
+				plane[j] /= planeLength;
+			}
+
+			AddPlane(quadrics[weld[a]], plane, -Dot(plane, pa), edgeLength * edgeLength * edgeWeight);
+			AddPlane(quadrics[weld[b]], plane, -Dot(plane, pa), edgeLength * edgeLength * edgeWeight);
+		}
+	}
+
+	size_t targetTriangles = targetIndexCount / 3;
+	double maxCost = (double)maxError * maxError;
+
+	std::vector<unsigned int> adjacencyOffset(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<unsigned int> wedgeRemap(vertexCount);
+	std::vector<bool> ringLocked(vertexCount);
+	std::unordered_set<uint64_t> currentEdges;
+	std::vector<uint64_t> edges;
+	std::vector<Collapse> collapses;
+	std::vector<std::pair<unsigned int, unsigned int>> wedgeMap;
+
+	// Each pass collapses a batch of cheap, non-overlapping edges, then rebuilds the topology.
+	while (result.size() / 3 > targetTriangles) {
+		size_t triangleCount = result.size() / 3;
+
+		std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+		for (unsigned int v : result) {
+			adjacencyOffset[weld[v] + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+			adjacencyOffset[v + 1] += adjacencyOffset[v];
+		}
+
+		adjacency.resize(result.size());
+		std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for (size_t i = 0; i < result.size(); i++) {
+			adjacency[fill[weld[result[i]]]++] = (unsigned int)(i / 3);
+		}
+
+		currentEdges.clear();
+		edges.clear();
+
+		for (size_t i = 0; i < result.size(); i++) {
+			unsigned int a = weld[result[i]];
+			unsigned int b = weld[result[i - i % 3 + (i + 1) % 3]];
+
+			currentEdges.insert(EdgeKey(a, b));
+			edges.push_back(EdgeKey(std::min(a, b), std::max(a, b)));
+		}
+
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		auto allowed = [&](unsigned int from, unsigned int to) {
+			if (locked[from]) {
+				return false;
+			}
+
+			// Border vertices slide along the border only.
+			return !border[from] || currentEdges.count(EdgeKey(from, to)) + currentEdges.count(EdgeKey(to, from)) == 1;
+		};
+
+		collapses.clear();
+
+		for (uint64_t edge : edges) {
+			unsigned int a = (unsigned int)(edge >> 32);
+			unsigned int b = (unsigned int)edge;
+
+			double costA = allowed(a, b) ? Evaluate(quadrics[a], &positions[b * 3]) : DBL_MAX;
+			double costB = allowed(b, a) ? Evaluate(quadrics[b], &positions[a * 3]) : DBL_MAX;
+
+			if (costA == DBL_MAX && costB == DBL_MAX) {
+				continue;
+			}
+
+			collapses.push_back(costA <= costB ? Collapse{ a, b, costA } : Collapse{ b, a, costB });
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](Collapse const& a, Collapse const& b) {
+			return a.cost < b.cost;
+		});
+
+		std::iota(wedgeRemap.begin(), wedgeRemap.end(), 0);
+		std::fill(ringLocked.begin(), ringLocked.end(), false);
+
+		// Each collapse removes about two triangles, stop the pass before overshooting the target.
+		size_t collapseLimit = (triangleCount - targetTriangles) / 2 + 1;
+		size_t performed = 0;
+
+		for (Collapse const& collapse : collapses) {
+			if (collapse.cost > maxCost || performed >= collapseLimit) {
+				break;
+			}
+
+			if (ringLocked[collapse.from] || ringLocked[collapse.to]) {
+				continue;
+			}
+
+			// Every wedge of the removed position needs exactly one wedge to merge into across the collapsed edge.
+			wedgeMap.clear();
+			bool valid = true;
+
+			for (unsigned int a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1] && valid; a++) {
+				unsigned int const* corners = &result[adjacency[a] * 3];
+				unsigned int fromWedge = 0, toWedge = 0;
+				bool hasTo = false;
+
+				for (int k = 0; k < 3; k++) {
+					if (weld[corners[k]] == collapse.from) {
+						fromWedge = corners[k];
+					}
+					else if (weld[corners[k]] == collapse.to) {
+						toWedge = corners[k];
+						hasTo = true;
+					}
+				}
+
+				if (!hasTo) {
+					continue;
+				}
+
+				for (auto& pair : wedgeMap) {
+					if (pair.first == fromWedge && pair.second != toWedge) {
+						valid = false;
+					}
+				}
+
+				wedgeMap.push_back({ fromWedge, toWedge });
+			}
+
+			for (unsigned int a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1] && valid; a++) {
+				unsigned int const* corners = &result[adjacency[a] * 3];
+				bool hasTo = false;
+				bool mapped = false;
+
+				for (int k = 0; k < 3; k++) {
+					hasTo |= weld[corners[k]] == collapse.to;
+
+					for (auto& pair : wedgeMap) {
+						mapped |= pair.first == corners[k];
+					}
+				}
+
+				if (!mapped) {
+					valid = false;
+					break;
+				}
+
+				if (hasTo) {
+					continue;
+				}
+
+				// Triangles that stay must not flip or fold over.
+				double const* p[3];
+				double const* q[3];
+				for (int k = 0; k < 3; k++) {
+					p[k] = position(corners[k]);
+					q[k] = weld[corners[k]] == collapse.from ? &positions[collapse.to * 3] : p[k];
+				}
+
+				double before[3], after[3];
+				Cross(p[0], p[1], p[2], before);
+				Cross(q[0], q[1], q[2], after);
+
+				double dot = Dot(before, after);
+				if (dot <= 0.0 || dot * dot < minNormalDot * minNormalDot * Dot(before, before) * Dot(after, after)) {
+					valid = false;
+				}
+			}
+
+			if (!valid || wedgeMap.empty()) {
+				continue;
+			}
+
+			for (auto& pair : wedgeMap) {
+				wedgeRemap[pair.first] = pair.second;
+			}
+
+			for (unsigned int a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1]; a++) {
+				for (int k = 0; k < 3; k++) {
+					ringLocked[weld[result[adjacency[a] * 3 + k]]] = true;
+				}
+			}
+
+			AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			worstCost = std::max(worstCost, collapse.cost);
+			performed++;
+		}
+
+		if (performed == 0) {
+			break;
+		}
+
+		size_t write = 0;
+
+		for (size_t t = 0; t < triangleCount; t++) {
+			unsigned int a = wedgeRemap[result[t * 3]];
+			unsigned int b = wedgeRemap[result[t * 3 + 1]];
+			unsigned int c = wedgeRemap[result[t * 3 + 2]];
+
+			if (weld[a] == weld[b] || weld[b] == weld[c] || weld[c] == weld[a]) {
+				continue;
+			}
+
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+
+		result.resize(write);
+	}
+
+	if (error) {
+		*error = (float)sqrt(worstCost);
+	}
+
+	std::copy(result.begin(), result.end(), destination);
+	return result.size();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include <GL\glew.h>
+
+// Edge collapse simplification driven by quadric error metrics (Garland and
+// Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997).
+// Collapses are half-edge: a vertex is merged into a neighbour that already
+// exists, so the result indexes the original vertex buffer and every LOD of a
+// mesh can share it. Vertices with the same position but different texture
+// coordinates or normals only collapse along the seam between them, and open
+// borders only collapse along themselves.
+class MeshSimplifier {
+public:
+	// Collapses edges, cheapest first, until at most targetIndexCount indices
+	// remain or the next collapse would cost more than maxError. Errors are
+	// distances relative to the mesh extent; error receives the largest one
+	// used. destination may alias indices. Returns the new index count.
+	static size_t Simplify(unsigned int* destination, unsigned int const* indices, size_t indexCount,
+		GLfloat const* vertices, size_t vertexCount, size_t vertexStride, size_t targetIndexCount, float maxError, float* error);
+
+private:
+	struct Quadric {
+		double a00, a11, a22, a01, a02, a12;
+		double b0, b1, b2;
+		double c;
+		double weight;
+	};
+
+	struct Collapse {
+		unsigned int from;
+		unsigned int to;
+		double cost;
+	};
+
+	static void AddPlane(Quadric& quadric, double const* normal, double distance, double weight);
+	static void AddQuadric(Quadric& quadric, Quadric const& other);
+	static double Evaluate(Quadric const& quadric, double const* position);
+};
@@ -0,0 +1,409 @@
+#include "MipGenerator.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include <JobPool.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE2
+#endif
+
+namespace {
+
+	const float kaiserWidth = 1.5f;	// half width in destination texels
+	const float kaiserAlpha = 4.f;
+
+	// Rows per job are picked so a chunk is roughly 16k texels.
+	void ForRows(JobPool* jobPool, int rows, int width, std::function<void(size_t begin, size_t end)> const& body)
+	{
+		if (jobPool) {
+			jobPool->ParallelFor(rows, std::max<size_t>(1, 16384 / std::max(width, 1)), body);
+		}
+		else {
+			body(0, rows);
+		}
+	}
+
+	float BesselI0(float x)
+	{
+		// Power series, converges quickly for the small arguments the window uses.
+		float sum = 1.f, term = 1.f;
+		for (int k = 1; k < 20; k++) {
+			term *= (x / (2.f * k)) * (x / (2.f * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	float Sinc(float x)
+	{
+		if (fabsf(x) < 1e-5f) {
+			return 1.f;
+		}
+		x *= 3.14159265f;
+		return sinf(x) / x;
+	}
+
+	float KaiserWindow(float x)
+	{
+		if (fabsf(x) >= 1.f) {
+			return 0.f;
+		}
+		return BesselI0(kaiserAlpha * sqrtf(1.f - x * x)) / BesselI0(kaiserAlpha);
+	}
+
+	float const* GetSrgbToLinear()
+	{
+		static const std::vector<float> table = []() {
+			std::vector<float> values(256);
+			for (int i = 0; i < 256; i++) {
+				float c = i / 255.f;
+				values[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return values;
+		}();
+		return table.data();
+	}
+
+	// 16 bit linear in, 8 bit sRGB out. Fine enough that the darkest codes stay distinct.
+	uint8_t const* GetLinearToSrgb()
+	{
+		static const std::vector<uint8_t> table = []() {
+			std::vector<uint8_t> values(65536);
+			for (int i = 0; i < 65536; i++) {
+				float c = i / 65535.f;
+				float s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+				values[i] = (uint8_t)(s * 255.f + 0.5f);
+			}
+			return values;
+		}();
+		return table.data();
+	}
+
+	inline float Saturate(float x)
+	{
+		return x < 0.f ? 0.f : (x > 1.f ? 1.f : x);
+	}
+
+	bool Contains(std::string const& text, char const* word)
+	{
+		return text.find(word) != std::string::npos;
+	}
+
+}
+
+MipGenerator::Options MipGenerator::GetDefaultOptions(std::string const& fileName)
+{
+	std::string name = fileName;
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)tolower(c); });
+
+	Options options;
+	options.filter = MipFilter::Kaiser;
+	options.normalMap = Contains(name, "normal");
+
+	// Everything authored as data rather than colour stays linear.
+	options.srgb = !options.normalMap && !Contains(name, "metallic") && !Contains(name, "roughness") &&
+		!Contains(name, "height") && !Contains(name, "_ao") && !Contains(name, "occlusion");
+
+	options.alphaCutoff = 0.f;
+
+	return options;
+}
+
+std::vector<MipGenerator::Level> MipGenerator::GenerateMips(uint8_t const* pixels, int width, int height, int channels,
+	Options const& options, JobPool* jobPool)
+{
+	std::vector<Level> chain;
+
+	std::vector<float> current((size_t)width * height * 4);
+	Decode(pixels, width, height, channels, options, current.data(), jobPool);
+
+	float coverage = 0.f;
+	if (options.alphaCutoff > 0.f && channels == 4) {
+		Level source = { width, height, std::vector<uint8_t>(pixels, pixels + (size_t)width * height * 4) };
+		coverage = GetCoverage(source, channels, options.alphaCutoff, 1.f);
+	}
+
+	std::vector<float> next;
+
+	while (width > 1 || height > 1) {
+		int nextWidth = std::max(1, width / 2);
+		int nextHeight = std::max(1, height / 2);
+
+		next.resize((size_t)nextWidth * nextHeight * 4);
+		Downsample(current.data(), width, height, next.data(), nextWidth, nextHeight, options.filter, jobPool);
+
+		Level level;
+		level.width = nextWidth;
+		level.height = nextHeight;
+		Encode(next.data(), nextWidth, nextHeight, channels, options, level, jobPool);
+
+		if (options.alphaCutoff > 0.f && channels == 4) {
+			PreserveCoverage(level, channels, options.alphaCutoff, coverage);
+		}
+
+		chain.push_back(std::move(level));
+
+		current.swap(next);
+		width = nextWidth;
+		height = nextHeight;
+	}
+
+	return chain;
+}
+
+MipGenerator::Taps MipGenerator::BuildTaps(MipFilter filter, int sourceSize, int destinationSize)
+{
+	float scale = (float)sourceSize / destinationSize;
+
+	std::vector<std::vector<std::pair<int, float>>> perTexel(destinationSize);
+	int count = 1;
+
+	for (int x = 0; x < destinationSize; x++) {
+		auto& taps = perTexel[x];
+
+		if (filter == MipFilter::Box || scale == 1.f) {
+			float start = x * scale;
+			float end = start + scale;
+
+			for (int i = (int)floorf(start); i < (int)ceilf(end); i++) {
+				float weight = std::min(end, i + 1.f) - std::max(start, (float)i);
+				if (weight > 0.f) {
+					taps.push_back({ i, weight });
+				}
+			}
+		}
+		else {
+			float center = (x + 0.5f) * scale;
+			float radius = kaiserWidth * scale;
+
+			for (int i = (int)floorf(center - radius); i <= (int)ceilf(center + radius); i++) {
+				float t = (i + 0.5f - center) / scale;
+				float weight = Sinc(t) * KaiserWindow(t / kaiserWidth);
+				if (weight != 0.f) {
+					taps.push_back({ i, weight });
+				}
+			}
+		}
+
+		float sum = 0.f;
+		for (auto const& tap : taps) {
+			sum += tap.second;
+		}
+		for (auto& tap : taps) {
+			tap.first = ((tap.first % sourceSize) + sourceSize) % sourceSize;
+			tap.second /= sum;
+		}
+
+		count = std::max(count, (int)taps.size());
+	}
+
+	// Fixed stride so the inner loops don't branch, spare taps get zero weight.
+	Taps result;
+	result.count = count;
+	result.indices.resize((size_t)destinationSize * count);
+	result.weights.resize((size_t)destinationSize * count);
+
+	for (int x = 0; x < destinationSize; x++) {
+		for (int k = 0; k < count; k++) {
+			bool used = k < (int)perTexel[x].size();
+			result.indices[(size_t)x * count + k] = used ? perTexel[x][k].first : perTexel[x][0].first;
+			result.weights[(size_t)x * count + k] = used ? perTexel[x][k].second : 0.f;
+		}
+	}
+
+	return result;
+}
+
+void MipGenerator::Decode(uint8_t const* pixels, int width, int height, int channels, Options const& options, float* linear, JobPool* jobPool)
+{
+	// One table per colour space keeps the per texel work to lookups.
+	float colour[256];
+	float const* srgbToLinear = GetSrgbToLinear();
+
+	for (int i = 0; i < 256; i++) {
+		if (options.normalMap) {
+			colour[i] = i * (2.f / 255.f) - 1.f;
+		}
+		else if (options.srgb) {
+			colour[i] = srgbToLinear[i];
+		}
+		else {
+			colour[i] = i * (1.f / 255.f);
+		}
+	}
+
+	ForRows(jobPool, height, width, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++) {
+			uint8_t const* in = pixels + y * width * channels;
+			float* out = linear + y * width * 4;
+
+			if (channels == 4) {
+				for (int x = 0; x < width; x++, in += 4, out += 4) {
+					out[0] = colour[in[0]];
+					out[1] = colour[in[1]];
+					out[2] = colour[in[2]];
+					out[3] = in[3] * (1.f / 255.f);
+				}
+			}
+			else {
+				for (int x = 0; x < width; x++, in += 3, out += 4) {
+					out[0] = colour[in[0]];
+					out[1] = colour[in[1]];
+					out[2] = colour[in[2]];
+					out[3] = 1.f;
+				}
+			}
+		}
+	});
+}
+
+void MipGenerator::Downsample(float const* source, int sourceWidth, int sourceHeight, float* destination, int width, int height,
+	MipFilter filter, JobPool* jobPool)
+{
+	Taps horizontal = BuildTaps(filter, sourceWidth, width);
+	Taps vertical = BuildTaps(filter, sourceHeight, height);
+
+	// Horizontal pass into a narrow intermediate, then vertical into the destination.
+	std::vector<float> intermediate((size_t)width * sourceHeight * 4);
+
+	ForRows(jobPool, sourceHeight, width * horizontal.count, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++) {
+			float const* row = source + y * sourceWidth * 4;
+			float* out = intermediate.data() + y * width * 4;
+
+			for (int x = 0; x < width; x++) {
+				int const* indices = horizontal.indices.data() + (size_t)x * horizontal.count;
+				float const* weights = horizontal.weights.data() + (size_t)x * horizontal.count;
+
+#ifdef MIP_GENERATOR_SSE2
+				__m128 sum = _mm_setzero_ps();
+				for (int k = 0; k < horizontal.count; k++) {
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(row + indices[k] * 4), _mm_set1_ps(weights[k])));
+				}
+				_mm_storeu_ps(out + x * 4, sum);
+#else
+				float sum[4] = {};
+				for (int k = 0; k < horizontal.count; k++) {
+					for (int c = 0; c < 4; c++) {
+						sum[c] += row[indices[k] * 4 + c] * weights[k];
+					}
+				}
+				memcpy(out + x * 4, sum, sizeof(sum));
+#endif
+			}
+		}
+	});
+
+	ForRows(jobPool, height, width * vertical.count, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++) {
+			int const* indices = vertical.indices.data() + y * vertical.count;
+			float const* weights = vertical.weights.data() + y * vertical.count;
+			float* out = destination + y * width * 4;
+
+			memset(out, 0, sizeof(float) * width * 4);
+
+			// Whole rows at a time so both streams stay sequential.
+			for (int k = 0; k < vertical.count; k++) {
+				float const* row = intermediate.data() + (size_t)indices[k] * width * 4;
+
+#ifdef MIP_GENERATOR_SSE2
+				__m128 weight = _mm_set1_ps(weights[k]);
+				for (int i = 0; i < width * 4; i += 4) {
+					_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(row + i), weight)));
+				}
+#else
+				for (int i = 0; i < width * 4; i++) {
+					out[i] += row[i] * weights[k];
+				}
+#endif
+			}
+		}
+	});
+}
+
+void MipGenerator::Encode(float* linear, int width, int height, int channels, Options const& options, Level& level, JobPool* jobPool)
+{
+	uint8_t const* linearToSrgb = GetLinearToSrgb();
+
+	level.pixels.resize((size_t)width * height * channels);
+
+	ForRows(jobPool, height, width, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++) {
+			float* in = linear + y * width * 4;
+			uint8_t* out = level.pixels.data() + y * width * channels;
+
+			for (int x = 0; x < width; x++, in += 4, out += channels) {
+				if (options.normalMap) {
+					// Renormalized in place so the next level filters unit vectors too.
+					float length = sqrtf(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+					float scale = length > 1e-6f ? 1.f / length : 0.f;
+
+					for (int c = 0; c < 3; c++) {
+						in[c] *= scale;
+						out[c] = (uint8_t)(Saturate(in[c] * 0.5f + 0.5f) * 255.f + 0.5f);
+					}
+				}
+				else if (options.srgb) {
+					for (int c = 0; c < 3; c++) {
+						out[c] = linearToSrgb[(int)(Saturate(in[c]) * 65535.f + 0.5f)];
+					}
+				}
+				else {
+					for (int c = 0; c < 3; c++) {
+						out[c] = (uint8_t)(Saturate(in[c]) * 255.f + 0.5f);
+					}
+				}
+
+				if (channels == 4) {
+					out[3] = (uint8_t)(Saturate(in[3]) * 255.f + 0.5f);
+				}
+			}
+		}
+	});
+}
+
+float MipGenerator::GetCoverage(Level const& level, int channels, float cutoff, float scale)
+{
+	size_t count = (size_t)level.width * level.height;
+	size_t passing = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		if (level.pixels[i * channels + 3] * (1.f / 255.f) * scale > cutoff) {
+			passing++;
+		}
+	}
+
+	return (float)passing / count;
+}
+
+void MipGenerator::PreserveCoverage(Level& level, int channels, float cutoff, float coverage)
+{
+	// Alpha tested texels thin out as the levels blur, find the alpha scale that
+	// restores the source coverage (Castano, "Computing Alpha Mipmaps").
+	float low = 0.f, high = 4.f, scale = 1.f;
+
+	for (int i = 0; i < 12; i++) {
+		scale = (low + high) * 0.5f;
+		float current = GetCoverage(level, channels, cutoff, scale);
+
+		if (current < coverage) {
+			low = scale;
+		}
+		else if (current > coverage) {
+			high = scale;
+		}
+		else {
+			break;
+		}
+	}
+
+	size_t count = (size_t)level.width * level.height;
+	for (size_t i = 0; i < count; i++) {
+		uint8_t& alpha = level.pixels[i * channels + 3];
+		alpha = (uint8_t)std::min(255.f, alpha * scale + 0.5f);
+	}
+}
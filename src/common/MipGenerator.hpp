@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class JobPool;
+
+enum class MipFilter {
+	Box,	// area average, cheapest
+	Kaiser	// Kaiser windowed sinc (width 3, alpha 4), keeps detail the box blurs away
+};
+
+// Builds mip chains of 8-bit images on the CPU, down to 1x1. Filtering runs on
+// a linear float copy so every level is derived from full precision data, with
+// separable SIMD passes spread over the job pool.
+class MipGenerator {
+public:
+	struct Level {
+		int width, height;
+		std::vector<uint8_t> pixels;
+	};
+
+	struct Options {
+		MipFilter filter;
+		bool srgb;			// colour channels are sRGB encoded, filter them in linear space
+		bool normalMap;		// RGB is a unit vector, renormalized on every level
+		float alphaCutoff;	// > 0 keeps the fraction of texels passing this alpha test constant
+	};
+
+	// Picks the colour space and normal handling from the usual file name suffixes.
+	static Options GetDefaultOptions(std::string const& fileName);
+
+	// Returns every level below the source, largest first. channels is 3 or 4,
+	// the levels use the same layout as the source. Edges wrap like GL_REPEAT.
+	static std::vector<Level> GenerateMips(uint8_t const* pixels, int width, int height, int channels,
+		Options const& options, JobPool* jobPool);
+
+private:
+	struct Taps {
+		int count;
+		std::vector<int> indices;		// count per destination texel
+		std::vector<float> weights;
+	};
+
+	static Taps BuildTaps(MipFilter filter, int sourceSize, int destinationSize);
+
+	static void Decode(uint8_t const* pixels, int width, int height, int channels, Options const& options, float* linear, JobPool* jobPool);
+	static void Downsample(float const* source, int sourceWidth, int sourceHeight, float* destination, int width, int height,
+		MipFilter filter, JobPool* jobPool);
+	static void Encode(float* linear, int width, int height, int channels, Options const& options, Level& level, JobPool* jobPool);
+
+	static float GetCoverage(Level const& level, int channels, float cutoff, float scale);
+	static void PreserveCoverage(Level& level, int channels, float cutoff, float coverage);
+};
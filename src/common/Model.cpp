@@ -1,12 +1,108 @@
 #include <Model.hpp>
 
+#include <float.h>
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+
+#include <assimp\IOSystem.hpp>
+#include <assimp\IOStream.hpp>
+
+#include <AssetPack.hpp>
+#include <ObjFile.hpp>
+
+namespace {
+	// Serves Assimp's reads, the model's and its material library's, from AssetPack::Load.
+	class PackIOStream : public Assimp::IOStream {
+	public:
+		PackIOStream(PackView&& view) : view(std::move(view)), position(0) {}
+
+		size_t Read(void* buffer, size_t size, size_t count) override
+		{
+			if (size == 0) {
+				return 0;
+			}
+
+			count = std::min(count, (view.GetSize() - position) / size);
+			memcpy(buffer, view.GetData() + position, size * count);
+			position += size * count;
+			return count;
+		}
+
+		size_t Write(const void*, size_t, size_t) override { return 0; }
+
+		aiReturn Seek(size_t offset, aiOrigin origin) override
+		{
+			size_t target = origin == aiOrigin_SET ? offset : origin == aiOrigin_CUR ? position + offset : view.GetSize() + offset;
+			if (target > view.GetSize()) {
+				return aiReturn_FAILURE;
+			}
+
+			position = target;
+			return aiReturn_SUCCESS;
+		}
+
+		size_t Tell() const override { return position; }
+		size_t FileSize() const override { return view.GetSize(); }
+		void Flush() override {}
+
+	private:
+		PackView view;
+		size_t position;
+	};
+
+	class PackIOSystem : public Assimp::IOSystem {
+	public:
+		bool Exists(const char* file) const override { return AssetPack::Exists(file); }
+		char getOsSeparator() const override { return '/'; }
+
+		Assimp::IOStream* Open(const char* file, const char*) override
+		{
+			PackView view;
+			if (!AssetPack::Load(file, view)) {
+				return nullptr;
+			}
+
+			return new PackIOStream(std::move(view));
+		}
+
+		void Close(Assimp::IOStream* stream) override { delete stream; }
+	};
+}
+
+namespace {
+
+	// Largest error of each level of detail after the first, relative to the model extent.
+	const float lodErrorBudget[] = { 0.0025f, 0.01f, 0.03f, 0.08f };
+	const unsigned int maxLods = 1 + sizeof(lodErrorBudget) / sizeof(lodErrorBudget[0]);
+
+	// A coarser LOD is only picked once its projected error is this much under the limit.
+	const float lodHysteresis = 0.25f;
+
+	// Occluders keep a 32nd of the triangles, or fewer, within this error relative to the model extent.
+	const float occluderErrorBudget = 0.02f;
+	const size_t occluderTriangleRatio = 32;
+
+}
+
+JobPool* Model::jobPool = nullptr;
+
 Model::Model()
 {
 	model = glm::mat4(1.f);
 	position = glm::vec3(0.f, 0.f, 0.f);
+	boundsMin = glm::vec3(0.f);
+	boundsMax = glm::vec3(0.f);
+	sourceBytes = 0;
+	packedBytes = 0;
+	depthBytes = 0;
+	maxError = { 0.f, 0.f, 0.f };
+	cacheBefore = { 0, 0, 0 };
+	cacheAfter = { 0, 0, 0 };
+	occluder = {};
 }
 
-void Model::RenderModel()
+void Model::RenderModel(unsigned int lod, ClusterView const* view)
 {
 	for (size_t i = 0; i < meshList.size(); i++) {
 		unsigned int materialIndex = meshToTexture[i];
@@ -15,26 +111,248 @@ void Model::RenderModel()
 			textureList[materialIndex]->UseTexture();
 		}
 
-		meshList[i]->RenderMesh();
+		meshList[i]->RenderMesh(lod, view);
+	}
+}
+
+void Model::RenderModelDepth(unsigned int lod, ClusterView const* view, GLsizei instances)
+{
+	for (auto mesh : meshList) {
+		mesh->RenderDepth(lod, view, instances);
+	}
+}
+
+void Model::RenderModelIndirect(GLuint commandBuffer, GLuint firstCommand, GLuint lodCount, GLuint transformBuffer, bool depth)
+{
+	for (size_t i = 0; i < meshList.size(); i++) {
+		unsigned int materialIndex = meshToTexture[i];
+
+		if (!depth && materialIndex < textureList.size() && textureList[materialIndex]) {
+			textureList[materialIndex]->UseTexture();
+		}
+
+		GLintptr offset = (GLintptr)(firstCommand + i * lodCount) * sizeof(DrawElementsIndirectCommand);
+		meshList[i]->RenderIndirect(commandBuffer, offset, (GLsizei)lodCount, transformBuffer, depth);
 	}
 }
 
 void Model::LoadModel(const std::string& fileName)
+{
+	if (!ImportModel(fileName)) {
+		return;
+	}
+
+	UploadModel();
+
+	printf("Model %s loaded \n", fileName.c_str());
+
+}
+
+unsigned int Model::SelectLod(glm::mat4 const& transform, glm::vec3 const& eye, float projectionScale, float maxPixels, unsigned int current)
+{
+	unsigned int count = (unsigned int)lodErrors.size();
+
+	if (count < 2) {
+		return 0;
+	}
+
+	float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+	glm::vec3 center = glm::vec3(transform * glm::vec4(GetBoundsCenter(), 1.f));
+	float distance = std::max(glm::length(center - eye) - GetBoundsRadius() * scale, 0.01f);
+
+	auto pixels = [&](unsigned int lod) { return lodErrors[lod] * scale * projectionScale / distance; };
+
+	unsigned int lod = std::min(current, count - 1);
+
+	while (lod > 0 && pixels(lod) > maxPixels) {
+		lod--;
+	}
+
+	while (lod + 1 < count && pixels(lod + 1) <= maxPixels * (1.f - lodHysteresis)) {
+		lod++;
+	}
+
+	return lod;
+}
+
+bool Model::ImportModel(const std::string& fileName)
+{
+	this->fileName = fileName;
+
+	sourceBytes = 0;
+	packedBytes = 0;
+	depthBytes = 0;
+	maxError = { 0.f, 0.f, 0.f };
+	cacheBefore = { 0, 0, 0 };
+	cacheAfter = { 0, 0, 0 };
+	lodTriangles.assign(maxLods, 0);
+	lodClusters.assign(maxLods, 0);
+	lodErrors.clear();
+	occluder = {};
+
+	if (!ObjFile::IsObj(fileName) || !ImportObj(fileName)) {
+		if (ObjFile::IsObj(fileName)) {
+			printf("Model %s: reading it through Assimp instead\n", fileName.c_str());
+		}
+
+		if (!ImportAssimp(fileName)) {
+			return false;
+		}
+	}
+
+	printf("Model %s: vertex data %.2f MB -> %.2f MB, max error position %g (extent %g), uv %g, normal %.3f deg\n", fileName.c_str(),
+		sourceBytes / (1024.0 * 1024.0), packedBytes / (1024.0 * 1024.0), maxError.position, glm::length(boundsMax - boundsMin),
+		maxError.texCoord, maxError.normalDegrees);
+	printf("Model %s: depth stream %.2f MB\n", fileName.c_str(), depthBytes / (1024.0 * 1024.0));
+	printf("Model %s: vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", fileName.c_str(),
+		cacheBefore.GetACMR(), cacheAfter.GetACMR(), cacheBefore.GetATVR(), cacheAfter.GetATVR());
+
+	// A mesh with fewer levels draws its coarsest one at the model's later levels.
+	for (auto& packed : pendingMeshes) {
+		lodErrors.resize(std::max(lodErrors.size(), packed.lods.size()), 0.f);
+	}
+
+	for (auto& packed : pendingMeshes) {
+		for (size_t lod = 0; lod < lodErrors.size(); lod++) {
+			MeshLod const& level = packed.lods[std::min(lod, packed.lods.size() - 1)];
+			lodErrors[lod] = std::max(lodErrors[lod], level.error);
+			lodTriangles[lod] += level.indexCount / 3;
+			lodClusters[lod] += level.clusterCount;
+		}
+	}
+
+	occluder.center = GetBoundsCenter();
+	occluder.radius = GetBoundsRadius();
+
+	printf("Model %s: occluder %zu triangles\n", fileName.c_str(), occluder.indices.size() / 3);
+	printf("Model %s: %zu LODs,", fileName.c_str(), lodErrors.size());
+	for (size_t lod = 0; lod < lodErrors.size(); lod++) {
+		printf(" %zu triangles in %zu clusters (error %g)", lodTriangles[lod], lodClusters[lod], lodErrors[lod]);
+	}
+	printf("\n");
+
+	return true;
+}
+
+bool Model::ImportObj(const std::string& fileName)
+{
+	ObjFile obj;
+
+	if (!obj.Load(fileName, jobPool)) {
+		return false;
+	}
+
+	ObjStats const& stats = obj.GetStats();
+	printf("Model %s: parsed %.2f MB in %.1f ms and welded %zu vertices in %.1f ms, %zu chunks\n", fileName.c_str(),
+		stats.bytes / (1024.0 * 1024.0), stats.parseMilliseconds, stats.vertices, stats.weldMilliseconds, stats.chunks);
+
+	// Bounds first, the LOD error budgets are relative to the whole model.
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+
+	for (auto const& mesh : obj.GetMeshes()) {
+		for (size_t i = 0; i < mesh.vertices.size(); i += 8) {
+			glm::vec3 position(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+	}
+
+	// Materials first, the mesh packing tolerances depend on the texture sizes.
+	std::vector<std::string> diffuseMaps;
+	for (auto const& material : obj.GetMaterials()) {
+		diffuseMaps.push_back(material.diffuseMap);
+	}
+
+	LoadMaterials(diffuseMaps);
+
+	// Flipped like Assimp's in LoadMesh.
+	for (auto& mesh : obj.GetMeshes()) {
+		for (size_t i = 5; i < mesh.vertices.size(); i += 8) {
+			mesh.vertices[i] = -mesh.vertices[i];
+			mesh.vertices[i + 1] = -mesh.vertices[i + 1];
+			mesh.vertices[i + 2] = -mesh.vertices[i + 2];
+		}
+
+		LoadMesh(mesh.vertices, mesh.indices, mesh.material);
+	}
+
+	return true;
+}
+
+bool Model::ImportAssimp(const std::string& fileName)
 {
 	Assimp::Importer importer;
+	importer.SetIOHandler(new PackIOSystem());
+
 	const aiScene* scene = importer.ReadFile(fileName, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices);
 
 	if (!scene) {
 		printf("Model %s failed to load: %s \n", fileName.c_str(), importer.GetErrorString());
-		return;
+		return false;
+	}
+
+	// Bounds first, the LOD error budgets are relative to the whole model.
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+
+	for (size_t i = 0; i < scene->mNumMeshes; i++) {
+		for (size_t j = 0; j < scene->mMeshes[i]->mNumVertices; j++) {
+			aiVector3D const& vertex = scene->mMeshes[i]->mVertices[j];
+			boundsMin = glm::min(boundsMin, glm::vec3(vertex.x, vertex.y, vertex.z));
+			boundsMax = glm::max(boundsMax, glm::vec3(vertex.x, vertex.y, vertex.z));
+		}
 	}
 
+	// Materials first, the mesh packing tolerances depend on the texture sizes.
+	std::vector<std::string> diffuseMaps(scene->mNumMaterials);
+
+	for (size_t i = 0; i < scene->mNumMaterials; i++) {
+		aiString path;
+
+		if (scene->mMaterials[i]->GetTextureCount(aiTextureType_DIFFUSE) &&
+			scene->mMaterials[i]->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS) {
+			diffuseMaps[i] = path.data;
+		}
+	}
+
+	LoadMaterials(diffuseMaps);
+
 	LoadNode(scene->mRootNode, scene);
 
-	LoadMaterials(scene);
+	return true;
+}
 
-	printf("Model %s loaded \n", fileName.c_str());
+void Model::UploadModel()
+{
+	UploadMeshes();
+
+	for (auto texture : textureList) {
+		texture->UploadImage();
+	}
+}
+
+void Model::UploadMeshes()
+{
+	for (auto& data : pendingMeshes) {
+		Mesh* newMesh = new Mesh();
+		newMesh->CreateMesh(data);
+		meshList.push_back(newMesh);
+	}
 
+	pendingMeshes.clear();
+}
+
+void Model::SwapModel(Model& other)
+{
+	std::swap(meshList, other.meshList);
+	std::swap(textureList, other.textureList);
+	std::swap(meshToTexture, other.meshToTexture);
+	std::swap(pendingMeshes, other.pendingMeshes);
+	std::swap(boundsMin, other.boundsMin);
+	std::swap(boundsMax, other.boundsMax);
+	std::swap(lodErrors, other.lodErrors);
+	std::swap(occluder, other.occluder);
 }
 
 void Model::LoadNode(aiNode* node, const aiScene* scene)
@@ -48,7 +366,7 @@ void Model::LoadNode(aiNode* node, const aiScene* scene)
 	}
 }
 
-void Model::LoadMesh(aiMesh* mesh, const aiScene* scene)
+void Model::LoadMesh(aiMesh* mesh, const aiScene*)
 {
 	std::vector<GLfloat> vertices;
 	std::vector<unsigned int> indices;
@@ -75,44 +393,154 @@ void Model::LoadMesh(aiMesh* mesh, const aiScene* scene)
 		}
 	}
 
-	Mesh* newMesh = new Mesh();
-	newMesh->CreateMesh(&vertices[0], &indices[0], vertices.size(), indices.size());
-	meshList.push_back(newMesh);
-	meshToTexture.push_back(mesh->mMaterialIndex);
+	LoadMesh(vertices, indices, mesh->mMaterialIndex);
 }
 
-void Model::LoadMaterials(const aiScene* scene)
+void Model::LoadMesh(std::vector<GLfloat>& vertices, std::vector<unsigned int>& indices, unsigned int materialIndex)
 {
-	textureList.resize(scene->mNumMaterials);
+	glm::vec3 meshMin(FLT_MAX), meshMax(-FLT_MAX);
 
-	for (size_t i = 0; i < scene->mNumMaterials; i++) {
-		aiMaterial* material = scene->mMaterials[i];
+	for (size_t i = 0; i < vertices.size(); i += 8) {
+		meshMin = glm::min(meshMin, glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]));
+		meshMax = glm::max(meshMax, glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]));
+	}
 
-		textureList[i] = nullptr;
+	// Positions within 1/10000 of the mesh extent, UVs within half a texel of the texture they sample.
+	int textureSize = 2048;
+	if (materialIndex < textureList.size() && textureList[materialIndex] && textureList[materialIndex]->GetWidth() > 0) {
+		textureSize = std::max(textureList[materialIndex]->GetWidth(), textureList[materialIndex]->GetHeight());
+	}
+
+	// Reorder for the post-transform cache and overdraw before packing, so the packed vertices are in fetch order.
+	VertexCacheStatistics before = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), (unsigned int)(vertices.size() / 8), 16);
+	MeshOptimizer::Optimize(vertices, 8, indices, 16);
+
+	cacheBefore.transformed += before.transformed;
+	cacheBefore.triangles += before.triangles;
+	cacheBefore.vertices += before.vertices;
+
+	unsigned int vertexCount = (unsigned int)(vertices.size() / 8);
+	size_t sourceIndexCount = indices.size();
+
+	// Levels of detail share the vertex buffer and follow the full detail indices in the index buffer.
+	glm::vec3 modelSize = boundsMax - boundsMin;
+	glm::vec3 meshSize = meshMax - meshMin;
+	float modelExtent = std::max(modelSize.x, std::max(modelSize.y, modelSize.z));
+	float meshExtent = std::max(meshSize.x, std::max(meshSize.y, meshSize.z));
+
+	std::vector<MeshLod> lods = { { 0, (unsigned int)sourceIndexCount, 0.f, 0, 0 } };
+	std::vector<unsigned int> lodIndices(sourceIndexCount);
+
+	for (unsigned int level = 1; level < maxLods && meshExtent > 0.f; level++) {
+		size_t target = (sourceIndexCount / 3 >> level) * 3;
+		float lodError = 0.f;
+		size_t count = MeshSimplifier::Simplify(lodIndices.data(), indices.data(), sourceIndexCount, vertices.data(), vertexCount, 8,
+			target, lodErrorBudget[level - 1] * modelExtent / meshExtent, &lodError);
+
+		// Stop once the error budget keeps the mesh from getting meaningfully smaller.
+		if (count == 0 || count > lods.back().indexCount * 0.9f) {
+			break;
+		}
+
+		MeshOptimizer::OptimizeVertexCache(lodIndices.data(), count, vertexCount, 16, nullptr);
+
+		lods.push_back({ (unsigned int)indices.size(), (unsigned int)count, lodError * meshExtent, 0, 0 });
+		indices.insert(indices.end(), lodIndices.begin(), lodIndices.begin() + count);
+	}
+
+	// Every level is split into clusters for culling, each cluster then gets its own vertex cache order.
+	std::vector<MeshCluster> clusters;
+
+	for (auto& lod : lods) {
+		std::vector<MeshCluster> lodClusters = MeshClusterizer::Build(&indices[lod.indexOffset], lod.indexCount, vertices.data(), vertexCount, 8);
+
+		lod.clusterOffset = (unsigned int)clusters.size();
+		lod.clusterCount = (unsigned int)lodClusters.size();
+
+		for (auto& cluster : lodClusters) {
+			cluster.indexOffset += lod.indexOffset;
+			MeshOptimizer::OptimizeVertexCache(&indices[cluster.indexOffset], cluster.indexCount, vertexCount, 16, nullptr);
+			clusters.push_back(cluster);
+		}
+	}
 
-		if (material->GetTextureCount(aiTextureType_DIFFUSE)) {
-			aiString path;
+	MeshOptimizer::OptimizeVertexFetch(vertices.data(), vertexCount, 8, indices.data(), indices.size());
 
-			if (material->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS) {
-				int idx = std::string(path.data).rfind("\\");
-				std::string filename = std::string(path.data).substr(idx + 1);
+	// The occluder only needs positions, so it's simplified with the seams welded shut.
+	std::vector<unsigned int> positionRemap = MeshOptimizer::WeldPositions(vertices.data(), vertexCount, 8);
+	std::vector<unsigned int> occluderIndices(sourceIndexCount);
 
-				std::string texPath = std::string("textures/") + filename;
+	for (size_t i = 0; i < sourceIndexCount; i++) {
+		occluderIndices[i] = positionRemap[indices[i]];
+	}
+
+	size_t occluderIndexCount = MeshSimplifier::Simplify(occluderIndices.data(), occluderIndices.data(), sourceIndexCount, vertices.data(),
+		vertexCount, 8, sourceIndexCount / 3 / occluderTriangleRatio * 3, meshExtent > 0.f ? occluderErrorBudget * modelExtent / meshExtent : 0.f, nullptr);
+
+	std::vector<unsigned int> occluderVertices(vertexCount, UINT_MAX);
+
+	for (size_t i = 0; i < occluderIndexCount; i++) {
+		unsigned int& vertex = occluderVertices[occluderIndices[i]];
+
+		if (vertex == UINT_MAX) {
+			vertex = (unsigned int)occluder.positions.size();
+			GLfloat const* position = &vertices[occluderIndices[i] * 8];
+			occluder.positions.push_back(glm::vec3(position[0], position[1], position[2]));
+		}
+
+		occluder.indices.push_back(vertex);
+	}
+
+	VertexCacheStatistics after = MeshOptimizer::AnalyzeVertexCache(indices.data(), sourceIndexCount, vertexCount, 16);
+	cacheAfter.transformed += after.transformed;
+	cacheAfter.triangles += after.triangles;
+	cacheAfter.vertices += after.vertices;
+
+	VertexFormat format = VertexPacker::ChooseFormat(vertices.data(), vertexCount, 1e-4f, 0.5f / textureSize);
+	PackedMesh packed = VertexPacker::Pack(vertices.data(), vertexCount, indices.data(), (unsigned int)indices.size(), format);
+	packed.lods = lods;
+	packed.clusters = clusters;
+
+	QuantizationError error = VertexPacker::MeasureError(packed, vertices.data());
+	maxError.position = std::max(maxError.position, error.position);
+	maxError.texCoord = std::max(maxError.texCoord, error.texCoord);
+	maxError.normalDegrees = std::max(maxError.normalDegrees, error.normalDegrees);
 
-				textureList[i] = new Texture(texPath.c_str());
+	sourceBytes += vertices.size() * sizeof(GLfloat) + sourceIndexCount * sizeof(unsigned int);
+	packedBytes += packed.vertices.size() + packed.indices.size();
+	depthBytes += packed.depthVertices.size() + packed.depthIndices.size();
 
-				if (!textureList[i]->LoadTexture())
-				{
-					printf("Failed to load texture at: %s\n", texPath.c_str());
-					delete textureList[i];
-					textureList[i] = nullptr;
-				}
+	pendingMeshes.push_back(std::move(packed));
+	meshToTexture.push_back(materialIndex);
+}
+
+void Model::LoadMaterials(std::vector<std::string> const& diffuseMaps)
+{
+	textureList.resize(diffuseMaps.size());
+
+	for (size_t i = 0; i < diffuseMaps.size(); i++) {
+		textureList[i] = nullptr;
+
+		if (!diffuseMaps[i].empty()) {
+			int idx = diffuseMaps[i].rfind("\\");
+			std::string filename = diffuseMaps[i].substr(idx + 1);
+
+			std::string texPath = std::string("textures/") + filename;
+
+			textureList[i] = new Texture(texPath.c_str());
+
+			if (!textureList[i]->ReadImage())
+			{
+				printf("Failed to load texture at: %s\n", texPath.c_str());
+				delete textureList[i];
+				textureList[i] = nullptr;
 			}
 		}
 
 		if (!textureList[i]) {
 			textureList[i] = new Texture("textures/plain.png");
-			textureList[i]->LoadTextureA();
+			textureList[i]->SetAlpha(true);
+			textureList[i]->ReadImage();
 		}
 	}
 }
@@ -132,6 +560,13 @@ void Model::ClearModel()
 			textureList[i] = nullptr;
 		}
 	}
+
+	meshList.clear();
+	textureList.clear();
+	meshToTexture.clear();
+	pendingMeshes.clear();
+	lodErrors.clear();
+	occluder = {};
 }
 
 Model::~Model()
@@ -12,29 +12,97 @@
 #include <glm\gtc\matrix_transform.hpp>
 
 #include <Mesh.hpp>
+#include <MeshClusterizer.hpp>
+#include <MeshOptimizer.hpp>
+#include <MeshSimplifier.hpp>
+#include <OcclusionCuller.hpp>
 #include <Texture.hpp>
 
+class JobPool;
+
 class Model
 {
 public:
 	Model();
 
 	void LoadModel(const std::string& fileName);
-	void RenderModel();
+	// With a view, clusters outside its frustum or facing away from it are skipped.
+	void RenderModel(unsigned int lod = 0, ClusterView const* view = nullptr);
+	// Positions only and no textures, for shadow maps and depth passes.
+	void RenderModelDepth(unsigned int lod = 0, ClusterView const* view = nullptr, GLsizei instances = 1);
+	// One multi-draw per mesh, each of lodCount commands starting at firstCommand + mesh * lodCount. See Mesh::RenderIndirect.
+	void RenderModelIndirect(GLuint commandBuffer, GLuint firstCommand, GLuint lodCount, GLuint transformBuffer, bool depth);
 	void ClearModel();
 	void SetModelMatrix(glm::mat4 const& matrix) { model = matrix; }
+
+	// Split load used by background loaders: ImportModel reads the file and
+	// decodes textures without touching GL, UploadModel creates the GL objects.
+	// OBJ files go through ObjFile, everything else and any OBJ it can't read through Assimp.
+	bool ImportModel(const std::string& fileName);
+	void UploadModel();
+	void UploadMeshes();
+
+	// Exchanges the GPU resources of two models, used to swap in a reloaded copy.
+	void SwapModel(Model& other);
+
+	std::string const& GetFileName() { return fileName; }
+	std::vector<Texture*> const& GetTextures() { return textureList; }
+	std::vector<Mesh*> const& GetMeshes() { return meshList; }
+
+	// Bounding sphere of the imported vertices in model space.
+	glm::vec3 GetBoundsCenter() { return (boundsMin + boundsMax) * 0.5f; }
+	float GetBoundsRadius() { return glm::length(boundsMax - boundsMin) * 0.5f; }
+	glm::vec3 const& GetBoundsMin() { return boundsMin; }
+	glm::vec3 const& GetBoundsMax() { return boundsMax; }
+
+	// All meshes simplified far past the coarsest LOD, for the software occlusion culler.
+	OccluderMesh const& GetOccluder() { return occluder; }
+
+	// Levels of detail generated at import, with the largest error of any mesh at each level in model units.
+	unsigned int GetLodCount() { return (unsigned int)lodErrors.size(); }
+	float GetLodError(unsigned int lod) { return lodErrors[lod]; }
+
+	// Coarsest LOD whose error projects to at most maxPixels on screen. current is
+	// the LOD the instance used last frame, it only moves to a coarser one once that
+	// is comfortably under the limit so instances near a threshold don't flicker.
+	unsigned int SelectLod(glm::mat4 const& transform, glm::vec3 const& eye, float projectionScale, float maxPixels, unsigned int current);
+
+	// OBJ files are parsed in chunks on it, see ObjFile.
+	static void SetJobPool(JobPool* pool) { jobPool = pool; }
+
 	~Model();
 
 private:
+	static JobPool* jobPool;
+
+	bool ImportObj(const std::string& fileName);
+	bool ImportAssimp(const std::string& fileName);
+
 	void LoadNode(aiNode* node, const aiScene* scene);
 	void LoadMesh(aiMesh* mesh, const aiScene* scene);
-	void LoadMaterials(const aiScene* scene);
+	// Eight floats per vertex, position, texture coordinate and normal.
+	void LoadMesh(std::vector<GLfloat>& vertices, std::vector<unsigned int>& indices, unsigned int materialIndex);
+	void LoadMaterials(std::vector<std::string> const& diffuseMaps);
+
+	std::string fileName;
+
+	std::vector<PackedMesh> pendingMeshes;
+
+	// Packing totals of the last import, printed as the quantization report.
+	size_t sourceBytes, packedBytes, depthBytes;
+	QuantizationError maxError;
+	VertexCacheStatistics cacheBefore, cacheAfter;
+	std::vector<size_t> lodTriangles;
+	std::vector<size_t> lodClusters;
+
+	std::vector<float> lodErrors;
+	OccluderMesh occluder;
 
 	std::vector<Mesh*> meshList;
 	std::vector<Texture*> textureList;
 	std::vector<unsigned int> meshToTexture;
+	glm::vec3 boundsMin, boundsMax;
 	glm::vec3 position;
 	glm::vec4 scale;
 	glm::mat4 model;
 };
-
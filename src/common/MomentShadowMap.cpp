@@ -0,0 +1,155 @@
+#include "MomentShadowMap.hpp"
+
+#include <stdio.h>
+
+#include <Shader.hpp>
+
+MomentShadowMap::MomentShadowMap()
+{
+	filter = ShadowFilter::Pcf;
+	width = 0;
+	height = 0;
+	downsample = 1;
+	mipmaps = false;
+	FBOs[0] = FBOs[1] = 0;
+	texture = 0;
+	VAO = 0;
+}
+
+ShadowFilterSettings MomentShadowMap::GetSettings(ShadowFilter filter)
+{
+	// Half floats hold exp(2c) for c up to about 5.5, full floats allow the sharper warp.
+	switch (filter) {
+	case ShadowFilter::EvsmLow:
+		return { GL_RG16F, 2, glm::vec2(5.f, 0.f), 1 };
+	case ShadowFilter::EvsmMedium:
+		return { GL_RGBA16F, 4, glm::vec2(5.f, 5.f), 2 };
+	case ShadowFilter::EvsmHigh:
+		return { GL_RGBA32F, 4, glm::vec2(40.f, 5.f), 3 };
+	default:
+		return { GL_NONE, 0, glm::vec2(0.f), 0 };
+	}
+}
+
+bool MomentShadowMap::Init(unsigned int depthWidth, unsigned int depthHeight, unsigned int downsample, ShadowFilter filter, bool mipmaps)
+{
+	Release();
+
+	this->filter = filter;
+	this->downsample = downsample;
+	this->mipmaps = mipmaps;
+	width = depthWidth / downsample;
+	height = depthHeight / downsample;
+
+	if (filter == ShadowFilter::Pcf) {
+		return true;
+	}
+
+	ShadowFilterSettings settings = GetSettings(filter);
+
+	glGenVertexArrays(1, &VAO);
+	glGenFramebuffers(2, FBOs);
+	glGenTextures(1, &texture);
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, settings.internalFormat, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	if (mipmaps) {
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	// The scratch texture has the same format, so this covers it too.
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBOs[1]);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+	GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Moment shadow map framebuffer error: %u\n", status);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		Release();
+		return false;
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return true;
+}
+
+FrameTextureDesc MomentShadowMap::GetScratchDesc()
+{
+	return { (GLsizei)width, (GLsizei)height, GetSettings(filter).internalFormat };
+}
+
+void MomentShadowMap::Filter(Shader& shader, ShadowMap* depth, glm::ivec4 const& rect, GLuint scratch)
+{
+	if (!VAO) {
+		return;
+	}
+
+	glm::ivec4 target = rect / (int)downsample;
+	glm::ivec4 bounds(target.x, target.y, target.x + target.z - 1, target.y + target.w - 1);
+
+	shader.UseShader();
+	shader.SetShadowFilter(filter);
+	glViewport(target.x, target.y, target.z, target.w);
+	glBindVertexArray(VAO);
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBOs[0]);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scratch, 0);
+
+	depth->Read(GL_TEXTURE0);
+	shader.SetMomentBlur(0, glm::ivec2(1, 0), downsample, bounds);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// A downsample of 0 reads moments rather than depth.
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBOs[1]);
+	glBindTexture(GL_TEXTURE_2D, scratch);
+	shader.SetMomentBlur(0, glm::ivec2(0, 1), 0, bounds);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+	if (mipmaps) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void MomentShadowMap::Read(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void MomentShadowMap::Release()
+{
+	if (FBOs[0]) {
+		glDeleteFramebuffers(2, FBOs);
+		FBOs[0] = FBOs[1] = 0;
+	}
+
+	if (texture) {
+		glDeleteTextures(1, &texture);
+		texture = 0;
+	}
+
+	if (VAO) {
+		glDeleteVertexArrays(1, &VAO);
+		VAO = 0;
+	}
+}
+
+MomentShadowMap::~MomentShadowMap()
+{
+	Release();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+#include <ShadowMap.hpp>
+#include <FrameGraph.hpp>
+
+class Shader;
+
+// Percentage closer filtering, or exponential variance shadow maps (EVSM) in
+// rising quality. The EVSM tiers need one filtered fetch per light.
+enum class ShadowFilter {
+	Pcf,
+	EvsmLow,		// positive moments in RG16F, 3 tap blur
+	EvsmMedium,		// positive and negative moments in RGBA16F, 5 tap blur
+	EvsmHigh		// positive and negative moments in RGBA32F, stronger warp, 7 tap blur
+};
+
+struct ShadowFilterSettings {
+	GLenum internalFormat;
+	GLint momentCount;
+	glm::vec2 exponents;	// warp of the positive and negative moments
+	GLint blurRadius;
+};
+
+// Blurred exponential moments of a depth shadow map. The depth passes stay as
+// they are; Filter warps a rectangle of depth into moments, blurring it across
+// then down without reading outside it, so atlas tiles never bleed into each other.
+class MomentShadowMap {
+public:
+	MomentShadowMap();
+
+	static ShadowFilterSettings GetSettings(ShadowFilter filter);
+
+	// Moments are stored at 1 / downsample of the depth resolution. Mipmaps
+	// only suit maps holding a single view, as coarse levels mix atlas tiles.
+	bool Init(unsigned int depthWidth, unsigned int depthHeight, unsigned int downsample, ShadowFilter filter, bool mipmaps);
+
+	// Moments blurred across, only needed while filtering, so the frame graph's to share.
+	FrameTextureDesc GetScratchDesc();
+
+	// rect is x, y, width, height in depth texels, a multiple of downsample. scratch as GetScratchDesc.
+	void Filter(Shader& shader, ShadowMap* depth, glm::ivec4 const& rect, GLuint scratch);
+
+	void Read(GLenum textureUnit);
+
+	~MomentShadowMap();
+
+private:
+	void Release();
+
+	ShadowFilter filter;
+	unsigned int width, height, downsample;
+	bool mipmaps;
+
+	// Moments blurred across into the scratch texture, then the finished ones.
+	GLuint FBOs[2];
+	GLuint texture;
+
+	// Empty, the filter's one triangle comes from gl_VertexID.
+	GLuint VAO;
+};
@@ -0,0 +1,722 @@
+#include "ObjFile.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <bit>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+
+#include <AssetPack.hpp>
+#include <MappedFile.hpp>
+#include <JobPool.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+	// Chunks are cut at the first line break after every chunkSize bytes.
+	const size_t chunkSize = 256 * 1024;
+
+	const int32_t noIndex = -1;
+	const uint32_t noMaterial = 0xFFFFFFFFu;
+	const uint32_t emptySlot = 0xFFFFFFFFu;
+
+	const double powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+		1e18, 1e19, 1e20, 1e21, 1e22 };
+	const uint64_t digitScales[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+
+	struct MaterialRun {
+		size_t triangle;		// first one of the chunk using it
+		std::string name;
+	};
+
+	// What one chunk read. Corners are position, texture coordinate and normal indices, three corners a
+	// triangle. A negative OBJ index counts back from the last element so far, which other chunks feed,
+	// so it is kept relative to the chunk's first element and its slot listed in relative until their
+	// counts are known.
+	struct Chunk {
+		std::vector<float> positions;
+		std::vector<float> texCoords;
+		std::vector<float> normals;
+		std::vector<int32_t> corners;
+		std::vector<size_t> relative;
+		std::vector<MaterialRun> materials;
+		std::vector<std::string> libraries;
+		std::string error;
+
+		// The face being read, before it is fanned into triangles.
+		std::vector<int32_t> face;
+		std::vector<uint8_t> faceRelative;
+	};
+
+	// Where one material's triangles are, in the order the file lists them.
+	struct Span {
+		size_t chunk;
+		size_t begin, end;
+		uint32_t material;
+	};
+
+	void ForEach(JobPool* jobPool, size_t count, std::function<void(size_t index)> const& body)
+	{
+		if (jobPool) {
+			jobPool->ParallelFor(count, 1, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					body(i);
+				}
+			});
+		}
+		else {
+			for (size_t i = 0; i < count; i++) {
+				body(i);
+			}
+		}
+	}
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	char const* SkipSpaces(char const* p, char const* end)
+	{
+		while (p < end && IsSpace(*p)) {
+			p++;
+		}
+		return p;
+	}
+
+	std::string Trim(char const* p, char const* end)
+	{
+		p = SkipSpaces(p, end);
+		while (end > p && IsSpace(end[-1])) {
+			end--;
+		}
+		return std::string(p, end);
+	}
+
+	void Fail(Chunk& chunk, char const* what, char const* line, char const* end)
+	{
+		if (chunk.error.empty()) {
+			chunk.error = std::string(what) + " '" + std::string(line, std::min<size_t>(end - line, 60)) + "'";
+		}
+	}
+
+	// Eight characters at once, the first in the lowest byte as on every platform the engine runs on.
+	// Returns how many of them are digits before the first that isn't.
+	unsigned int CountDigits(uint64_t bytes)
+	{
+		// A byte is a digit when its high nibble is 3 both as is and with 6 added. ASCII never carries into the next byte.
+		uint64_t high = (bytes & 0xF0F0F0F0F0F0F0F0ull) ^ 0x3030303030303030ull;
+		uint64_t shifted = ((bytes + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) ^ 0x3030303030303030ull;
+		uint64_t other = high | shifted;
+
+		// The top bit of every byte that isn't a digit.
+		uint64_t mask = (other | ((other & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full)) & 0x8080808080808080ull;
+		return mask ? (unsigned int)std::countr_zero(mask) / 8 : 8;
+	}
+
+	// The value of the first count digits, combined pairwise in three multiplies instead of one per digit.
+	uint32_t ParseDigits(uint64_t bytes, unsigned int count)
+	{
+		// Whatever follows the digits borrows only from the bytes after it, which the shift drops, and the
+		// zeros it shifts in read as leading zeros.
+		uint64_t digits = (bytes - 0x3030303030303030ull) << (8 * (8 - count));
+
+		digits = digits * 10 + (digits >> 8);
+		digits = (((digits & 0x000000FF000000FFull) * 0x000F424000000064ull) +
+			(((digits >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull)) >> 32;
+		return (uint32_t)digits;
+	}
+
+	// Digits past what mantissa holds only move the exponent, a float never needs them.
+	char const* ReadDigits(char const* p, char const* end, uint64_t& mantissa, int& exponent, bool fraction)
+	{
+		while (end - p >= 8 && mantissa < 100000000000ull) {
+			uint64_t bytes;
+			memcpy(&bytes, p, 8);
+
+			unsigned int count = CountDigits(bytes);
+			if (count == 0) {
+				return p;
+			}
+
+			mantissa = mantissa * digitScales[count] + ParseDigits(bytes, count);
+			exponent -= fraction ? (int)count : 0;
+			p += count;
+
+			if (count < 8) {
+				return p;
+			}
+		}
+
+		for (; p < end && (unsigned char)(*p - '0') < 10; p++) {
+			if (mantissa < 1000000000000000000ull) {
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent -= fraction ? 1 : 0;
+			}
+			else if (!fraction) {
+				exponent++;
+			}
+		}
+
+		return p;
+	}
+
+	bool ParseFloat(char const*& p, char const* end, float& value)
+	{
+		p = SkipSpaces(p, end);
+
+		bool negative = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+')) {
+			p++;
+		}
+
+		uint64_t mantissa = 0;
+		int exponent = 0;
+
+		char const* start = p;
+		p = ReadDigits(p, end, mantissa, exponent, false);
+		bool integer = p != start;
+
+		if (p < end && *p == '.') {
+			char const* fraction = ++p;
+			p = ReadDigits(p, end, mantissa, exponent, true);
+			integer = integer || p != fraction;
+		}
+
+		if (!integer) {
+			return false;
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			p++;
+			bool negativeExponent = p < end && *p == '-';
+			if (p < end && (*p == '-' || *p == '+')) {
+				p++;
+			}
+
+			int written = 0;
+			for (; p < end && (unsigned char)(*p - '0') < 10; p++) {
+				written = std::min(written * 10 + (*p - '0'), 1000);
+			}
+			exponent += negativeExponent ? -written : written;
+		}
+
+		// Exact up to 10^22, so the double is correctly rounded and the float off by at most the double rounding.
+		double result = (double)mantissa;
+		if (exponent < 0) {
+			result = exponent >= -22 ? result / powersOfTen[-exponent] : result * pow(10.0, exponent);
+		}
+		else if (exponent > 0) {
+			result = exponent <= 22 ? result * powersOfTen[exponent] : result * pow(10.0, exponent);
+		}
+
+		value = (float)(negative ? -result : result);
+		return p == end || IsSpace(*p);
+	}
+
+	bool ParseInteger(char const*& p, char const* end, int64_t& value)
+	{
+		bool negative = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+')) {
+			p++;
+		}
+
+		char const* start = p;
+		value = 0;
+		for (; p < end && (unsigned char)(*p - '0') < 10 && value < INT32_MAX; p++) {
+			value = value * 10 + (*p - '0');
+		}
+
+		value = negative ? -value : value;
+		return p != start && value >= -INT32_MAX && value <= INT32_MAX;
+	}
+
+	// One face corner, v, v/vt, v//vn or v/vt/vn.
+	bool ParseCorner(char const*& p, char const* end, Chunk const& chunk, int32_t corner[3], bool relative[3])
+	{
+		size_t counts[3] = { chunk.positions.size() / 3, chunk.texCoords.size() / 2, chunk.normals.size() / 3 };
+
+		for (int i = 0; i < 3; i++) {
+			corner[i] = noIndex;
+			relative[i] = false;
+		}
+
+		for (int i = 0; i < 3; i++) {
+			if (i > 0) {
+				if (p == end || *p != '/') {
+					break;
+				}
+				p++;
+
+				if (i == 1 && p < end && *p == '/') {
+					continue;
+				}
+			}
+
+			int64_t index;
+			if (!ParseInteger(p, end, index) || index == 0) {
+				return false;
+			}
+
+			// Counted from 1, or back from the last element read.
+			if (index > 0) {
+				corner[i] = (int32_t)(index - 1);
+			}
+			else {
+				corner[i] = (int32_t)((int64_t)counts[i] + index);
+				relative[i] = true;
+			}
+		}
+
+		return p == end || IsSpace(*p);
+	}
+
+	void ParseFace(char const* p, char const* line, char const* end, Chunk& chunk)
+	{
+		chunk.face.clear();
+		chunk.faceRelative.clear();
+
+		while ((p = SkipSpaces(p, end)) < end) {
+			int32_t corner[3];
+			bool relative[3];
+
+			if (!ParseCorner(p, end, chunk, corner, relative)) {
+				Fail(chunk, "Bad face", line, end);
+				return;
+			}
+
+			chunk.face.insert(chunk.face.end(), corner, corner + 3);
+			chunk.faceRelative.insert(chunk.faceRelative.end(), relative, relative + 3);
+		}
+
+		// Points and lines aren't drawn.
+		size_t count = chunk.face.size() / 3;
+
+		for (size_t i = 1; i + 1 < count; i++) {
+			for (size_t corner : { (size_t)0, i, i + 1 }) {
+				for (size_t j = 0; j < 3; j++) {
+					if (chunk.faceRelative[corner * 3 + j]) {
+						chunk.relative.push_back(chunk.corners.size());
+					}
+					chunk.corners.push_back(chunk.face[corner * 3 + j]);
+				}
+			}
+		}
+	}
+
+	void ParseLine(char const* line, char const* end, Chunk& chunk)
+	{
+		char const* p = SkipSpaces(line, end);
+		if (p == end || *p == '#') {
+			return;
+		}
+
+		char const* keyword = p;
+		while (p < end && !IsSpace(*p)) {
+			p++;
+		}
+		size_t length = p - keyword;
+
+		if (length == 1 && keyword[0] == 'f') {
+			ParseFace(p, line, end, chunk);
+		}
+		else if (length == 1 && keyword[0] == 'v') {
+			float position[3];
+			for (float& value : position) {
+				if (!ParseFloat(p, end, value)) {
+					Fail(chunk, "Bad position", line, end);
+					return;
+				}
+			}
+			chunk.positions.insert(chunk.positions.end(), position, position + 3);
+		}
+		else if (length == 2 && keyword[0] == 'v' && keyword[1] == 't') {
+			float texCoord[2] = { 0.f, 0.f };
+			if (!ParseFloat(p, end, texCoord[0])) {
+				Fail(chunk, "Bad texture coordinate", line, end);
+				return;
+			}
+			if (SkipSpaces(p, end) < end && !ParseFloat(p, end, texCoord[1])) {
+				Fail(chunk, "Bad texture coordinate", line, end);
+				return;
+			}
+			chunk.texCoords.insert(chunk.texCoords.end(), texCoord, texCoord + 2);
+		}
+		else if (length == 2 && keyword[0] == 'v' && keyword[1] == 'n') {
+			float normal[3];
+			for (float& value : normal) {
+				if (!ParseFloat(p, end, value)) {
+					Fail(chunk, "Bad normal", line, end);
+					return;
+				}
+			}
+			chunk.normals.insert(chunk.normals.end(), normal, normal + 3);
+		}
+		else if (length == 6 && !memcmp(keyword, "usemtl", 6)) {
+			chunk.materials.push_back({ chunk.corners.size() / 9, Trim(p, end) });
+		}
+		else if (length == 6 && !memcmp(keyword, "mtllib", 6)) {
+			chunk.libraries.push_back(Trim(p, end));
+		}
+	}
+
+	void ParseChunk(char const* p, char const* end, Chunk& chunk)
+	{
+		while (p < end) {
+			char const* lineEnd = (char const*)memchr(p, '\n', end - p);
+			if (!lineEnd) {
+				lineEnd = end;
+			}
+
+			ParseLine(p, lineEnd, chunk);
+			p = lineEnd + 1;
+		}
+	}
+
+	char const* NextToken(char const* p, char const* end)
+	{
+		while (p < end && !IsSpace(*p)) {
+			p++;
+		}
+		return SkipSpaces(p, end);
+	}
+
+	// A number, on or off, with more of the line after it.
+	bool IsOptionArgument(char const* p, char const* end)
+	{
+		char const* tokenEnd = p;
+		while (tokenEnd < end && !IsSpace(*tokenEnd)) {
+			tokenEnd++;
+		}
+
+		std::string token(p, tokenEnd);
+		float value;
+		return tokenEnd < end && !token.empty() && (token == "on" || token == "off" || ParseFloat(p, tokenEnd, value));
+	}
+
+	size_t HashCorner(int32_t const* corner)
+	{
+		uint64_t hash = (uint32_t)corner[0] * 0x9E3779B97F4A7C15ull ^ (uint32_t)corner[1] * 0xC2B2AE3D27D4EB4Full ^
+			(uint32_t)corner[2] * 0x165667B19E3779F9ull;
+		return (size_t)(hash ^ (hash >> 32));
+	}
+}
+
+ObjFile::ObjFile()
+{
+	stats = {};
+}
+
+bool ObjFile::IsObj(std::string const& path)
+{
+	std::string extension = fs::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+	return extension == ".obj";
+}
+
+bool ObjFile::Load(std::string const& path, JobPool* jobPool)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	meshes.clear();
+	materials.clear();
+	stats = {};
+
+	// Mapped from the pack when it holds the file, else mapped loose.
+	PackView packed;
+	MappedFile mapped;
+	char const* text;
+
+	if (AssetPack::LoadPacked(path, packed)) {
+		text = (char const*)packed.GetData();
+		stats.bytes = packed.GetSize();
+	}
+	else if (mapped.Open(path)) {
+		text = (char const*)mapped.GetData();
+		stats.bytes = mapped.GetSize();
+	}
+	else {
+		printf("Failed to open %s\n", path.c_str());
+		return false;
+	}
+
+	char const* end = text + stats.bytes;
+
+	std::vector<char const*> bounds(std::max<size_t>(1, stats.bytes / chunkSize) + 1);
+	bounds.front() = text;
+	bounds.back() = end;
+
+	for (size_t i = 1; i + 1 < bounds.size(); i++) {
+		char const* cut = std::max(bounds[i - 1], text + stats.bytes * i / (bounds.size() - 1));
+		char const* lineEnd = (char const*)memchr(cut, '\n', end - cut);
+		bounds[i] = lineEnd ? lineEnd + 1 : end;
+	}
+
+	std::vector<Chunk> chunks(bounds.size() - 1);
+	stats.chunks = chunks.size();
+
+	ForEach(jobPool, chunks.size(), [&](size_t i) {
+		ParseChunk(bounds[i], bounds[i + 1], chunks[i]);
+	});
+
+	// Where each chunk's elements start once they are all put together.
+	std::vector<size_t> firsts(chunks.size() * 3);
+	size_t counts[3] = { 0, 0, 0 };
+
+	for (size_t i = 0; i < chunks.size(); i++) {
+		if (!chunks[i].error.empty()) {
+			printf("Failed to read %s: %s\n", path.c_str(), chunks[i].error.c_str());
+			return false;
+		}
+
+		firsts[i * 3 + 0] = counts[0];
+		firsts[i * 3 + 1] = counts[1];
+		firsts[i * 3 + 2] = counts[2];
+
+		counts[0] += chunks[i].positions.size() / 3;
+		counts[1] += chunks[i].texCoords.size() / 2;
+		counts[2] += chunks[i].normals.size() / 3;
+		stats.triangles += chunks[i].corners.size() / 9;
+	}
+
+	stats.positions = counts[0];
+
+	if (stats.triangles == 0) {
+		printf("Failed to read %s: no faces\n", path.c_str());
+		return false;
+	}
+
+	std::vector<float> positions(counts[0] * 3);
+	std::vector<float> texCoords(counts[1] * 2);
+	std::vector<float> normals(counts[2] * 3);
+	std::vector<uint8_t> invalid(chunks.size(), 0);
+	std::vector<uint8_t> missingNormals(chunks.size(), 0);
+
+	ForEach(jobPool, chunks.size(), [&](size_t i) {
+		Chunk& chunk = chunks[i];
+
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + firsts[i * 3 + 0] * 3);
+		std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + firsts[i * 3 + 1] * 2);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + firsts[i * 3 + 2] * 3);
+
+		for (size_t slot : chunk.relative) {
+			int64_t index = (int64_t)firsts[i * 3 + slot % 3] + chunk.corners[slot];
+			chunk.corners[slot] = index < 0 ? INT32_MIN : (int32_t)index;
+		}
+
+		for (size_t slot = 0; slot < chunk.corners.size(); slot++) {
+			int32_t index = chunk.corners[slot];
+
+			if (index == noIndex && slot % 3 != 0) {
+				missingNormals[i] |= slot % 3 == 2;
+			}
+			else if (index < 0 || (size_t)index >= counts[slot % 3]) {
+				invalid[i] = 1;
+			}
+		}
+	});
+
+	if (std::find(invalid.begin(), invalid.end(), 1) != invalid.end()) {
+		printf("Failed to read %s: a face refers past the elements it was given\n", path.c_str());
+		return false;
+	}
+
+	// Libraries and material names are few, they are resolved in file order.
+	std::map<std::string, uint32_t> materialIndices;
+	std::string directory = fs::path(path).parent_path().generic_string();
+
+	for (auto const& chunk : chunks) {
+		for (auto const& library : chunk.libraries) {
+			LoadMaterialLibrary(directory.empty() ? library : directory + "/" + library);
+		}
+	}
+
+	for (uint32_t i = 0; i < materials.size(); i++) {
+		materialIndices.emplace(materials[i].name, i);
+	}
+
+	auto findMaterial = [&](std::string const& name) {
+		auto found = materialIndices.emplace(name, (uint32_t)materials.size());
+		if (found.second) {
+			materials.push_back({ name, std::string() });
+		}
+		return found.first->second;
+	};
+
+	std::vector<Span> spans;
+	uint32_t current = noMaterial;
+
+	for (size_t i = 0; i < chunks.size(); i++) {
+		size_t begin = 0;
+		size_t triangleCount = chunks[i].corners.size() / 9;
+
+		for (auto const& run : chunks[i].materials) {
+			if (run.triangle > begin) {
+				spans.push_back({ i, begin, run.triangle, current == noMaterial ? findMaterial("") : current });
+			}
+
+			current = findMaterial(run.name);
+			begin = run.triangle;
+		}
+
+		if (triangleCount > begin) {
+			spans.push_back({ i, begin, triangleCount, current == noMaterial ? findMaterial("") : current });
+		}
+	}
+
+	// Area weighted face normals summed per position, for the corners the file gives none.
+	std::vector<float> smoothNormals;
+
+	if (std::find(missingNormals.begin(), missingNormals.end(), 1) != missingNormals.end()) {
+		smoothNormals.assign(positions.size(), 0.f);
+
+		for (auto const& chunk : chunks) {
+			for (size_t corner = 0; corner < chunk.corners.size(); corner += 9) {
+				float const* a = &positions[chunk.corners[corner + 0] * 3];
+				float const* b = &positions[chunk.corners[corner + 3] * 3];
+				float const* c = &positions[chunk.corners[corner + 6] * 3];
+
+				float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+				float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+				float normal[3] = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+
+				for (size_t j = 0; j < 9; j += 3) {
+					float* sum = &smoothNormals[chunk.corners[corner + j] * 3];
+					sum[0] += normal[0];
+					sum[1] += normal[1];
+					sum[2] += normal[2];
+				}
+			}
+		}
+
+		for (size_t i = 0; i < smoothNormals.size(); i += 3) {
+			float length = sqrtf(smoothNormals[i] * smoothNormals[i] + smoothNormals[i + 1] * smoothNormals[i + 1] + smoothNormals[i + 2] * smoothNormals[i + 2]);
+			if (length > 0.f) {
+				smoothNormals[i] /= length;
+				smoothNormals[i + 1] /= length;
+				smoothNormals[i + 2] /= length;
+			}
+		}
+	}
+
+	stats.parseMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+
+	// One mesh per material in use, each welded on its own.
+	for (uint32_t material = 0; material < materials.size(); material++) {
+		if (std::any_of(spans.begin(), spans.end(), [&](Span const& span) { return span.material == material; })) {
+			meshes.push_back({ {}, {}, material });
+		}
+	}
+
+	ForEach(jobPool, meshes.size(), [&](size_t i) {
+		ObjMesh& mesh = meshes[i];
+
+		size_t cornerCount = 0;
+		for (auto const& span : spans) {
+			cornerCount += span.material == mesh.material ? (span.end - span.begin) * 3 : 0;
+		}
+
+		// Open addressing at most half full, slots hold welded vertices and keys their corners.
+		size_t tableSize = 16;
+		while (tableSize < cornerCount * 2) {
+			tableSize *= 2;
+		}
+
+		std::vector<uint32_t> table(tableSize, emptySlot);
+		std::vector<int32_t> keys;
+
+		mesh.indices.reserve(cornerCount);
+
+		for (auto const& span : spans) {
+			if (span.material != mesh.material) {
+				continue;
+			}
+
+			std::vector<int32_t> const& corners = chunks[span.chunk].corners;
+
+			for (size_t c = span.begin * 9; c < span.end * 9; c += 3) {
+				int32_t const* corner = &corners[c];
+				size_t slot = HashCorner(corner) & (tableSize - 1);
+
+				while (table[slot] != emptySlot && memcmp(&keys[table[slot] * 3], corner, sizeof(int32_t) * 3)) {
+					slot = (slot + 1) & (tableSize - 1);
+				}
+
+				if (table[slot] == emptySlot) {
+					table[slot] = (uint32_t)(keys.size() / 3);
+					keys.insert(keys.end(), corner, corner + 3);
+
+					float const* position = &positions[corner[0] * 3];
+					float const* normal = corner[2] != noIndex ? &normals[corner[2] * 3] : &smoothNormals[corner[0] * 3];
+					float u = corner[1] != noIndex ? texCoords[corner[1] * 2] : 0.f;
+					float v = corner[1] != noIndex ? 1.f - texCoords[corner[1] * 2 + 1] : 0.f;
+
+					mesh.vertices.insert(mesh.vertices.end(), { position[0], position[1], position[2], u, v, normal[0], normal[1], normal[2] });
+				}
+
+				mesh.indices.push_back(table[slot]);
+			}
+		}
+	});
+
+	for (auto const& mesh : meshes) {
+		stats.vertices += mesh.vertices.size() / 8;
+	}
+
+	stats.weldMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+bool ObjFile::LoadMaterialLibrary(std::string const& path)
+{
+	PackView view;
+	if (!AssetPack::Load(path, view)) {
+		printf("Failed to open material library %s\n", path.c_str());
+		return false;
+	}
+
+	char const* p = (char const*)view.GetData();
+	char const* end = p + view.GetSize();
+
+	while (p < end) {
+		char const* lineEnd = (char const*)memchr(p, '\n', end - p);
+		if (!lineEnd) {
+			lineEnd = end;
+		}
+
+		char const* keyword = SkipSpaces(p, lineEnd);
+		char const* rest = keyword;
+		while (rest < lineEnd && !IsSpace(*rest)) {
+			rest++;
+		}
+
+		std::string name(keyword, rest);
+
+		if (name == "newmtl") {
+			materials.push_back({ Trim(rest, lineEnd), std::string() });
+		}
+		else if (name == "map_Kd" && !materials.empty()) {
+			// Options come first, a dash and its arguments. Whatever follows is the path, spaces and all.
+			char const* option = SkipSpaces(rest, lineEnd);
+
+			while (option < lineEnd && *option == '-') {
+				option = NextToken(option, lineEnd);
+
+				while (IsOptionArgument(option, lineEnd)) {
+					option = NextToken(option, lineEnd);
+				}
+			}
+
+			materials.back().diffuseMap = Trim(option, lineEnd);
+		}
+
+		p = lineEnd + 1;
+	}
+
+	return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+class JobPool;
+
+struct ObjMaterial {
+	std::string name;
+	std::string diffuseMap;		// as the library writes it, empty for none
+};
+
+// Triangles of one material. Eight floats per vertex, position, texture coordinate with v flipped
+// and normal, the layout Model packs from. Every distinct corner of the file appears once.
+struct ObjMesh {
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+	unsigned int material;
+};
+
+struct ObjStats {
+	size_t bytes;
+	size_t positions;
+	size_t triangles;
+	size_t vertices;			// after welding
+	size_t chunks;
+	float parseMilliseconds;
+	float weldMilliseconds;
+};
+
+// Wavefront OBJ and MTL reader for Model, in place of Assimp's. The file is mapped and cut into
+// line aligned chunks that are parsed in parallel, then polygons are fanned into triangles and
+// their corners welded through a hash table straight into Model's vertex layout. Normals the file
+// leaves out are smoothed over each position's faces.
+class ObjFile {
+public:
+	ObjFile();
+
+	static bool IsObj(std::string const& path);
+
+	// Reads path and the material libraries it names, relative to it. Chunks run on jobPool when given.
+	bool Load(std::string const& path, JobPool* jobPool);
+
+	std::vector<ObjMesh>& GetMeshes() { return meshes; }
+	std::vector<ObjMaterial> const& GetMaterials() { return materials; }
+	ObjStats const& GetStats() { return stats; }
+
+private:
+	std::vector<ObjMesh> meshes;
+	std::vector<ObjMaterial> materials;
+	ObjStats stats;
+
+	bool LoadMaterialLibrary(std::string const& path);
+};
@@ -0,0 +1,366 @@
+#include "OcclusionCuller.hpp"
+
+#include <math.h>
+#include <float.h>
+#include <chrono>
+#include <algorithm>
+
+#include <emmintrin.h>
+
+namespace {
+
+	const int tilesX = OcclusionCuller::width / OcclusionCuller::tileWidth;
+	const int tilesY = OcclusionCuller::height / OcclusionCuller::tileHeight;
+
+	// Occluders whose bounding sphere is smaller than this radius in buffer pixels hide too little to be worth drawing.
+	const float minOccluderPixels = 2.f;
+
+	float MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+}
+
+OcclusionCuller::OcclusionCuller()
+{
+	viewProjection = glm::mat4(1.f);
+	tileBins.resize(tilesX * tilesY);
+	stats = {};
+
+	glm::ivec2 size(width, height);
+	pyramidSizes.push_back(size);
+
+	while (size.x > 1 || size.y > 1) {
+		size = glm::max((size + 1) / 2, glm::ivec2(1));
+		pyramidSizes.push_back(size);
+	}
+
+	// Cleared to the far plane, so nothing is occluded before the first Rasterize.
+	for (auto const& levelSize : pyramidSizes) {
+		pyramid.push_back(std::vector<float>(levelSize.x * levelSize.y, 1.f));
+	}
+}
+
+void OcclusionCuller::Begin(glm::mat4 const& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	occluders.clear();
+	stats = {};
+}
+
+void OcclusionCuller::AddOccluder(OccluderMesh const* mesh, glm::mat4 const& transform)
+{
+	if (mesh && !mesh->indices.empty()) {
+		occluders.push_back({ mesh, transform });
+	}
+}
+
+void OcclusionCuller::Rasterize(JobPool* jobPool)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	occluderTriangles.resize(occluders.size());
+
+	jobPool->ParallelFor(occluders.size(), 4, [this](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			occluderTriangles[i].clear();
+			SetupTriangles(occluders[i], occluderTriangles[i]);
+		}
+	});
+
+	// Binning is cheap next to filling, so it stays on this thread.
+	for (auto& bin : tileBins) {
+		bin.clear();
+	}
+
+	for (auto const& triangles : occluderTriangles) {
+		stats.occluders += triangles.empty() ? 0 : 1;
+		stats.triangles += triangles.size();
+
+		for (auto const& triangle : triangles) {
+			for (int tileY = triangle.minY / tileHeight; tileY <= triangle.maxY / tileHeight; tileY++) {
+				for (int tileX = triangle.minX / tileWidth; tileX <= triangle.maxX / tileWidth; tileX++) {
+					tileBins[tileY * tilesX + tileX].push_back(&triangle);
+				}
+			}
+		}
+	}
+
+	jobPool->ParallelFor(tileBins.size(), 1, [this](size_t begin, size_t end) {
+		for (size_t tile = begin; tile < end; tile++) {
+			RasterizeTile(tile);
+		}
+	});
+
+	BuildPyramid();
+
+	stats.rasterMilliseconds = MillisecondsSince(start);
+}
+
+void OcclusionCuller::SetupTriangles(Occluder const& occluder, std::vector<ScreenTriangle>& triangles)
+{
+	OccluderMesh const& mesh = *occluder.mesh;
+	glm::mat4 modelViewProjection = viewProjection * occluder.transform;
+
+	// The view's vertical scale: a row of the view projection is a row of the view, a unit vector, times the projection's scale.
+	float yScale = glm::length(glm::vec3(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1]));
+	float scale = std::max(glm::length(glm::vec3(occluder.transform[0])), std::max(glm::length(glm::vec3(occluder.transform[1])),
+		glm::length(glm::vec3(occluder.transform[2]))));
+	float radius = mesh.radius * scale;
+	glm::vec4 center = modelViewProjection * glm::vec4(mesh.center, 1.f);
+
+	if (center.w > radius && radius * yScale / center.w * height * 0.5f < minOccluderPixels) {
+		return;
+	}
+
+	std::vector<glm::vec4> clip(mesh.positions.size());
+	for (size_t i = 0; i < mesh.positions.size(); i++) {
+		clip[i] = modelViewProjection * glm::vec4(mesh.positions[i], 1.f);
+	}
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		glm::vec4 corners[3] = { clip[mesh.indices[i]], clip[mesh.indices[i + 1]], clip[mesh.indices[i + 2]] };
+		AddTriangle(corners, triangles);
+	}
+}
+
+void OcclusionCuller::AddTriangle(glm::vec4 const* clip, std::vector<ScreenTriangle>& triangles)
+{
+	// Entirely beyond one side of the frustum.
+	for (int axis = 0; axis < 3; axis++) {
+		if (clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w) {
+			return;
+		}
+		if (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w) {
+			return;
+		}
+	}
+
+	// Clipped against the near plane only, the bounding box keeps the rest on screen.
+	glm::vec4 polygon[4];
+	int count = 0;
+
+	for (int i = 0; i < 3; i++) {
+		glm::vec4 const& a = clip[i];
+		glm::vec4 const& b = clip[(i + 1) % 3];
+		float distanceA = a.z + a.w;
+		float distanceB = b.z + b.w;
+
+		if (distanceA >= 0.f) {
+			polygon[count++] = a;
+		}
+		if ((distanceA >= 0.f) != (distanceB >= 0.f)) {
+			polygon[count++] = a + (b - a) * (distanceA / (distanceA - distanceB));
+		}
+	}
+
+	for (int i = 1; i + 1 < count; i++) {
+		glm::vec3 screen[3];
+		glm::vec4 const* corners[3] = { &polygon[0], &polygon[i], &polygon[i + 1] };
+
+		for (int j = 0; j < 3; j++) {
+			glm::vec3 ndc = glm::vec3(*corners[j]) / corners[j]->w;
+			screen[j] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z);
+		}
+
+		// Occluders needn't be closed or consistently wound, so both facings are drawn.
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+		if (area == 0.f) {
+			continue;
+		}
+		if (area < 0.f) {
+			std::swap(screen[1], screen[2]);
+			area = -area;
+		}
+
+		ScreenTriangle triangle;
+		triangle.minX = std::max((int)floorf(std::min(screen[0].x, std::min(screen[1].x, screen[2].x))), 0);
+		triangle.minY = std::max((int)floorf(std::min(screen[0].y, std::min(screen[1].y, screen[2].y))), 0);
+		triangle.maxX = std::min((int)ceilf(std::max(screen[0].x, std::max(screen[1].x, screen[2].x))), width - 1);
+		triangle.maxY = std::min((int)ceilf(std::max(screen[0].y, std::max(screen[1].y, screen[2].y))), height - 1);
+
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+			continue;
+		}
+
+		for (int j = 0; j < 3; j++) {
+			glm::vec3 const& a = screen[j];
+			glm::vec3 const& b = screen[(j + 1) % 3];
+			triangle.edgeA[j] = a.y - b.y;
+			triangle.edgeB[j] = b.x - a.x;
+			triangle.edgeC[j] = a.x * b.y - a.y * b.x;
+		}
+
+		glm::vec3 edge1 = screen[1] - screen[0];
+		glm::vec3 edge2 = screen[2] - screen[0];
+		triangle.depthA = (edge1.z * edge2.y - edge2.z * edge1.y) / area;
+		triangle.depthB = (edge2.z * edge1.x - edge1.z * edge2.x) / area;
+		triangle.depthC = screen[0].z - triangle.depthA * screen[0].x - triangle.depthB * screen[0].y;
+
+		triangles.push_back(triangle);
+	}
+}
+
+void OcclusionCuller::RasterizeTile(size_t tile)
+{
+	int tileX = (int)(tile % tilesX) * tileWidth;
+	int tileY = (int)(tile / tilesX) * tileHeight;
+	float* depth = pyramid[0].data();
+
+	for (int y = tileY; y < tileY + tileHeight; y++) {
+		std::fill(depth + y * width + tileX, depth + y * width + tileX + tileWidth, 1.f);
+	}
+
+	__m128 const centerOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+	for (ScreenTriangle const* triangle : tileBins[tile]) {
+		// Rows are walked in aligned groups of four, the edge functions mask off what's outside.
+		int minX = std::max(triangle->minX, tileX) & ~3;
+		int maxX = std::min(triangle->maxX, tileX + tileWidth - 1);
+		int minY = std::max(triangle->minY, tileY);
+		int maxY = std::min(triangle->maxY, tileY + tileHeight - 1);
+
+		__m128 edgeA[3];
+		for (int j = 0; j < 3; j++) {
+			edgeA[j] = _mm_set1_ps(triangle->edgeA[j]);
+		}
+		__m128 depthA = _mm_set1_ps(triangle->depthA);
+
+		for (int y = minY; y <= maxY; y++) {
+			float centerY = y + 0.5f;
+			float rowMinX = (float)minX, rowMaxX = (float)maxX;
+
+			// Each edge bounds the row's span from one side, only the span is walked.
+			__m128 edgeRow[3];
+			for (int j = 0; j < 3; j++) {
+				float row = triangle->edgeB[j] * centerY + triangle->edgeC[j];
+				edgeRow[j] = _mm_set1_ps(row);
+
+				if (triangle->edgeA[j] > 0.f) {
+					rowMinX = std::max(rowMinX, -row / triangle->edgeA[j] - 1.f);
+				}
+				else if (triangle->edgeA[j] < 0.f) {
+					rowMaxX = std::min(rowMaxX, -row / triangle->edgeA[j]);
+				}
+				else if (row < 0.f) {
+					rowMaxX = -1.f;
+				}
+			}
+
+			if (rowMinX > rowMaxX) {
+				continue;
+			}
+
+			__m128 depthRow = _mm_set1_ps(triangle->depthB * centerY + triangle->depthC);
+			int spanMaxX = (int)rowMaxX;
+
+			for (int x = std::max((int)rowMinX, minX) & ~3; x <= spanMaxX; x += 4) {
+				__m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), centerOffsets);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], centerX), edgeRow[0]), _mm_setzero_ps());
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], centerX), edgeRow[1]), _mm_setzero_ps()));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], centerX), edgeRow[2]), _mm_setzero_ps()));
+
+				if (_mm_movemask_ps(inside) == 0) {
+					continue;
+				}
+
+				float* pixels = depth + y * width + x;
+				__m128 current = _mm_loadu_ps(pixels);
+				__m128 nearer = _mm_min_ps(current, _mm_add_ps(_mm_mul_ps(depthA, centerX), depthRow));
+				_mm_storeu_ps(pixels, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildPyramid()
+{
+	for (size_t level = 1; level < pyramid.size(); level++) {
+		glm::ivec2 source = pyramidSizes[level - 1];
+		glm::ivec2 size = pyramidSizes[level];
+		float const* below = pyramid[level - 1].data();
+		float* texels = pyramid[level].data();
+
+		for (int y = 0; y < size.y; y++) {
+			int y0 = y * 2, y1 = std::min(y * 2 + 1, source.y - 1);
+
+			for (int x = 0; x < size.x; x++) {
+				int x0 = x * 2, x1 = std::min(x * 2 + 1, source.x - 1);
+
+				texels[y * size.x + x] = std::max(std::max(below[y0 * source.x + x0], below[y0 * source.x + x1]),
+					std::max(below[y1 * source.x + x0], below[y1 * source.x + x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(glm::mat4 const& modelViewProjection, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax, bool counted)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	bool visible = TestBounds(modelViewProjection, boundsMin, boundsMax);
+
+	if (!counted) {
+		return visible;
+	}
+
+	stats.tested++;
+	stats.culled += visible ? 0 : 1;
+	stats.testMicroseconds += MillisecondsSince(start) * 1000.f;
+
+	return visible;
+}
+
+bool OcclusionCuller::TestBounds(glm::mat4 const& modelViewProjection, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax)
+{
+	glm::vec2 screenMin(FLT_MAX), screenMax(-FLT_MAX);
+	float nearest = FLT_MAX;
+
+	for (int i = 0; i < 8; i++) {
+		glm::vec3 corner(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y, i & 4 ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = modelViewProjection * glm::vec4(corner, 1.f);
+
+		if (clip.w <= 0.f || clip.z < -clip.w) {
+			return true;
+		}
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		screenMin = glm::min(screenMin, glm::vec2(ndc));
+		screenMax = glm::max(screenMax, glm::vec2(ndc));
+		nearest = std::min(nearest, ndc.z);
+	}
+
+	int minX = (int)floorf((screenMin.x * 0.5f + 0.5f) * width);
+	int minY = (int)floorf((screenMin.y * 0.5f + 0.5f) * height);
+	int maxX = (int)floorf((screenMax.x * 0.5f + 0.5f) * width);
+	int maxY = (int)floorf((screenMax.y * 0.5f + 0.5f) * height);
+
+	if (maxX < 0 || maxY < 0 || minX >= width || minY >= height) {
+		return true;
+	}
+
+	minX = std::max(minX, 0);
+	minY = std::max(minY, 0);
+	maxX = std::min(maxX, width - 1);
+	maxY = std::min(maxY, height - 1);
+
+	// The level where the box spans at most two texels each way.
+	size_t level = 0;
+	while (level + 1 < pyramid.size() && ((maxX >> level) - (minX >> level) > 1 || (maxY >> level) - (minY >> level) > 1)) {
+		level++;
+	}
+
+	glm::ivec2 size = pyramidSizes[level];
+	float const* texels = pyramid[level].data();
+
+	for (int y = minY >> level; y <= maxY >> level; y++) {
+		for (int x = minX >> level; x <= maxX >> level; x++) {
+			if (nearest <= texels[y * size.x + x]) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include <glm\glm.hpp>
+
+#include <JobPool.hpp>
+
+// Simplified stand-in for a model's surface, only ever drawn into the occlusion buffer.
+struct OccluderMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> indices;
+
+	// Bounding sphere in model space, for skipping occluders too small on screen to hide anything.
+	glm::vec3 center;
+	float radius;
+};
+
+// Counters since the last Begin.
+struct OcclusionStats {
+	size_t occluders;			// rasterized, after dropping the small ones
+	size_t triangles;			// rasterized, after clipping
+	float rasterMilliseconds;
+	size_t tested;
+	size_t culled;
+	float testMicroseconds;		// all tests together
+};
+
+// Software occlusion culling. Occluders are rasterized on the CPU into a small
+// depth buffer, split into tiles that the workers fill four pixels at a time.
+// Objects are then tested by the depth of their bounding box against a
+// pyramid holding the farthest depth under each texel, so a test reads at most
+// four texels. Depths are NDC z, the buffer is cleared to the far plane.
+class OcclusionCuller {
+public:
+	static const int width = 256;
+	static const int height = 144;
+	static const int tileWidth = 32;
+	static const int tileHeight = 16;
+
+	OcclusionCuller();
+
+	void Begin(glm::mat4 const& viewProjection);
+
+	// The mesh must stay alive until Rasterize returns.
+	void AddOccluder(OccluderMesh const* mesh, glm::mat4 const& transform);
+
+	// Transforms and clips the occluders, then fills the tiles, both spread over the pool's workers.
+	void Rasterize(JobPool* jobPool);
+
+	// False only when the box lies entirely behind the occluders. Boxes crossing
+	// the near plane or leaving the screen count as visible, frustum culling
+	// is left to the caller. A test repeated in a later pass of the same frame
+	// leaves the stats alone with counted unset.
+	bool IsVisible(glm::mat4 const& modelViewProjection, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax, bool counted = true);
+
+	OcclusionStats const& GetStats() { return stats; }
+	float const* GetDepth() { return pyramid[0].data(); }
+
+private:
+	struct Occluder {
+		OccluderMesh const* mesh;
+		glm::mat4 transform;
+	};
+
+	// Edge functions positive inside, and the depth plane, in pixels.
+	struct ScreenTriangle {
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC;
+		int minX, minY, maxX, maxY;
+	};
+
+	void SetupTriangles(Occluder const& occluder, std::vector<ScreenTriangle>& triangles);
+	void AddTriangle(glm::vec4 const* clip, std::vector<ScreenTriangle>& triangles);
+	void RasterizeTile(size_t tile);
+	void BuildPyramid();
+	bool TestBounds(glm::mat4 const& modelViewProjection, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax);
+
+	glm::mat4 viewProjection;
+
+	std::vector<Occluder> occluders;
+	std::vector<std::vector<ScreenTriangle>> occluderTriangles;
+	std::vector<std::vector<ScreenTriangle const*>> tileBins;
+
+	// Level 0 is the depth buffer, every other level the farthest depth of each 2x2 block of the one below.
+	std::vector<std::vector<float>> pyramid;
+	std::vector<glm::ivec2> pyramidSizes;
+
+	OcclusionStats stats;
+};
@@ -1,15 +1,28 @@
 #include "PointLight.hpp"
 
+#include <math.h>
+#include <algorithm>
+
+namespace {
+
+	// Light below this fraction of its diffuse intensity counts as gone.
+	const float reachCutoff = 1.f / 64.f;
+
+}
+
 PointLight::PointLight() : Light()
 {
 	position = glm::vec3(0.f, 0.f, 0.f);
 	constant = 1.f;
 	linear = 0.f;
 	exponent = 0.f;
+	farPlane = 0.f;
+	maxShadowFaceSize = 0;
+	shadowTiles = {};
 }
 
 PointLight::PointLight(GLfloat red, GLfloat green, GLfloat blue, GLfloat aIntensity, GLfloat dIntensity, GLfloat xPos, GLfloat yPos, GLfloat zPos, GLfloat con, GLfloat lin, GLfloat exp, GLuint shadowWidth, GLuint shadowHeight, GLfloat near, GLfloat far)
-	: Light(red, green, blue, aIntensity, dIntensity, shadowWidth, shadowHeight)
+	: Light(red, green, blue, aIntensity, dIntensity, 0, 0)
 {
 	position = glm::vec3(xPos, yPos, zPos);
 	constant = con;
@@ -17,12 +30,11 @@ PointLight::PointLight(GLfloat red, GLfloat green, GLfloat blue, GLfloat aIntens
 	exponent = exp;
 	farPlane = far;
 
-	float aspect = (float)shadowWidth / (float)shadowHeight;
-
-	lightProj = glm::perspective(glm::radians(90.f), aspect, near, far);
+	lightProj = glm::perspective(glm::radians(90.f), 1.f, near, far);
 
-	shadowMap = new OmniShadowMap();
-	shadowMap->Init(shadowWidth, shadowHeight);
+	// The faces live in the shared shadow atlas, the requested size is only an upper bound.
+	maxShadowFaceSize = std::min(shadowWidth, shadowHeight);
+	shadowTiles = {};
 }
 
 void PointLight::UseLight(GLuint ambientIntensityLocation, GLuint ambientColorLocation, GLuint diffuseIntensityLocation, GLuint positionLocation, GLuint constantLocation, GLuint linearLocation, GLuint exponentLocation)
@@ -49,6 +61,60 @@ std::vector<glm::mat4> PointLight::CalcLightTransform()
 	return lightTransforms;
 }
 
+unsigned int PointLight::GetFaceMask(glm::vec3 const& center, float radius)
+{
+	glm::vec3 offset = center - position;
+	unsigned int mask = 0;
+
+	// Each face sees the 90 degree pyramid around its axis, bounded by the 45 degree
+	// planes to the two other axes, out to the far plane.
+	float margin = radius * 1.41421356f;
+
+	for (int axis = 0; axis < 3; axis++) {
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+
+		for (int side = 0; side < 2; side++) {
+			float along = side == 0 ? offset[axis] : -offset[axis];
+
+			if (along + margin >= fabsf(offset[u]) && along + margin >= fabsf(offset[v]) && along - radius <= farPlane) {
+				mask |= 1u << (axis * 2 + side);
+			}
+		}
+	}
+
+	return mask;
+}
+
+GLfloat PointLight::GetReach()
+{
+	// Solve exponent * d^2 + linear * d + constant = diffuseIntensity / reachCutoff.
+	float c = constant - diffuseIntensity / reachCutoff;
+
+	if (c >= 0.f) {
+		return 0.f;
+	}
+
+	float reach = farPlane;
+	if (exponent > 0.f) {
+		reach = (-linear + sqrtf(linear * linear - 4.f * exponent * c)) / (2.f * exponent);
+	}
+	else if (linear > 0.f) {
+		reach = -c / linear;
+	}
+
+	return std::min(reach, farPlane);
+}
+
+float PointLight::GetShadowImportance(glm::vec3 const& eye, float projectionScale)
+{
+	float reach = GetReach();
+	float distance = glm::length(eye - position);
+
+	// Seen from inside its reach the light covers the whole view.
+	return projectionScale * reach / std::max(distance, reach) * std::min(diffuseIntensity, 1.f);
+}
+
 GLfloat PointLight::GetFarPlane()
 {
 	return farPlane;
@@ -2,7 +2,7 @@
 
 #include <vector>
 #include <Light.hpp>
-#include <OmniShadowMap.hpp>
+#include <ShadowAtlas.hpp>
 
 class PointLight :
 	public Light
@@ -20,6 +20,21 @@ public:
 
 	std::vector<glm::mat4> CalcLightTransform();
 
+	// Bit i set when a sphere reaches into cube face i, in the order of CalcLightTransform.
+	unsigned int GetFaceMask(glm::vec3 const& center, float radius);
+
+	// Distance at which the light fades below visible, capped by the far plane.
+	GLfloat GetReach();
+
+	// Pixels across the light's reach seen from eye, weighted by its brightness.
+	float GetShadowImportance(glm::vec3 const& eye, float projectionScale);
+
+	unsigned int GetMaxShadowFaceSize() { return maxShadowFaceSize; }
+
+	// Faces in the shadow atlas this frame, from ShadowAtlas::Allocate.
+	void SetShadowTiles(OmniShadowTiles const& tiles) { shadowTiles = tiles; }
+	OmniShadowTiles const& GetShadowTiles() { return shadowTiles; }
+
 	GLfloat GetFarPlane();
 
 	glm::vec3 GetPosition() { return position; }
@@ -32,5 +47,8 @@ protected:
 	GLfloat constant, linear, exponent;
 
 	GLfloat farPlane;
+
+	unsigned int maxShadowFaceSize;
+	OmniShadowTiles shadowTiles;
 };
 
@@ -0,0 +1,251 @@
+#include "ResolutionScaler.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include <Shader.hpp>
+
+namespace {
+	// The scale moves in twentieths of the window, down to half of it.
+	const int maxScaleSteps = 20;
+	const int minScaleSteps = 10;
+
+	// Frame times this close to the target leave the scale as it is.
+	const float targetTolerance = 0.1f;
+
+	// Of the upscale pass below the window's resolution, 1 sharpens the most.
+	const float upscaleSharpening = 0.6f;
+
+	const GLenum colorFormat = GL_RGBA8;
+	const GLenum depthFormat = GL_DEPTH_COMPONENT24;
+}
+
+ResolutionScaler::ResolutionScaler()
+{
+	for (unsigned int i = 0; i < timerFrames; i++) {
+		timers[i][0] = timers[i][1] = 0;
+		timerPending[i] = false;
+	}
+
+	timerIndex = 0;
+	settleFrames = 0;
+	targets[0] = targets[1] = 0;
+	FBO = 0;
+	fullscreenVAO = 0;
+	linearSampler = 0;
+	width = height = renderWidth = renderHeight = 0;
+	scaleSteps = maxScaleSteps;
+	targetMs = 16.7f;
+	scale = 1.f;
+	gpuTime = 0.f;
+	enabled = false;
+}
+
+bool ResolutionScaler::Init(GLsizei width, GLsizei height, float targetMs)
+{
+	Release();
+
+	this->width = width;
+	this->height = height;
+	this->targetMs = targetMs;
+	SetScaleSteps(maxScaleSteps);
+
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+	// The formats are checked once on textures of a texel each, the frame graph makes the real ones.
+	GLuint probes[2];
+	glGenTextures(2, probes);
+
+	glBindTexture(GL_TEXTURE_2D, probes[0]);
+	glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, 1, 1, 0, GL_RGBA, GL_FLOAT, nullptr);
+	glBindTexture(GL_TEXTURE_2D, probes[1]);
+	glTexImage2D(GL_TEXTURE_2D, 0, depthFormat, 1, 1, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Attach(probes[0], probes[1]);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	Attach(0, 0);
+	glDeleteTextures(2, probes);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Scene target error: 0x%x\n", status);
+		Release();
+		return false;
+	}
+
+	// The frame graph's textures filter to the nearest texel, the stretch wants them bilinear.
+	glGenSamplers(1, &linearSampler);
+	glSamplerParameteri(linearSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(linearSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(linearSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(linearSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenVertexArrays(1, &fullscreenVAO);
+
+	for (unsigned int i = 0; i < timerFrames; i++) {
+		glGenQueries(2, timers[i]);
+	}
+
+	return true;
+}
+
+void ResolutionScaler::SetEnabled(bool enabled)
+{
+	this->enabled = enabled;
+
+	if (!enabled) {
+		SetScaleSteps(maxScaleSteps);
+	}
+}
+
+void ResolutionScaler::SetScaleSteps(int steps)
+{
+	scaleSteps = std::clamp(steps, minScaleSteps, maxScaleSteps);
+	scale = (float)scaleSteps / maxScaleSteps;
+	renderWidth = std::max((GLsizei)roundf(width * scale), 1);
+	renderHeight = std::max((GLsizei)roundf(height * scale), 1);
+}
+
+void ResolutionScaler::BeginFrame()
+{
+	if (!FBO) {
+		return;
+	}
+
+	// The oldest frame's timestamps, the frames after it are still queued.
+	if (timerPending[timerIndex]) {
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(timers[timerIndex][0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(timers[timerIndex][1], GL_QUERY_RESULT, &end);
+		gpuTime = (end - begin) / 1e6f;
+		timerPending[timerIndex] = false;
+
+		if (settleFrames > 0) {
+			settleFrames--;
+		}
+		else if (enabled && gpuTime > 0.f) {
+			// Most of the frame goes with the pixels, so with the square of the scale. Over the target it
+			// drops to what fits, under it only grows once a whole step fits.
+			int wanted = (int)floorf(scaleSteps * sqrtf(targetMs / gpuTime));
+			bool over = gpuTime > targetMs * (1.f + targetTolerance);
+			bool under = gpuTime < targetMs * (1.f - targetTolerance);
+
+			if ((over && wanted < scaleSteps) || (under && wanted > scaleSteps)) {
+				int previous = scaleSteps;
+				SetScaleSteps(over ? std::min(wanted, scaleSteps - 1) : wanted);
+				settleFrames = scaleSteps != previous ? timerFrames - 1 : 0;
+			}
+		}
+	}
+
+	glQueryCounter(timers[timerIndex][0], GL_TIMESTAMP);
+}
+
+void ResolutionScaler::EndFrame()
+{
+	if (!FBO) {
+		return;
+	}
+
+	glQueryCounter(timers[timerIndex][1], GL_TIMESTAMP);
+	timerPending[timerIndex] = true;
+	timerIndex = (timerIndex + 1) % timerFrames;
+}
+
+FrameTextureDesc ResolutionScaler::GetColorDesc()
+{
+	return { width, height, colorFormat };
+}
+
+FrameTextureDesc ResolutionScaler::GetDepthDesc()
+{
+	return { width, height, depthFormat };
+}
+
+void ResolutionScaler::Attach(GLuint color, GLuint depth)
+{
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+
+	targets[0] = color;
+	targets[1] = depth;
+}
+
+void ResolutionScaler::Write(GLuint color, GLuint depth)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+	// Attached every frame like the G-buffer, a texture the pool freed may come back under the same name.
+	bool changed = color != targets[0] || depth != targets[1];
+	Attach(color, depth);
+
+	if (changed) {
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			printf("Scene target error: 0x%x\n", status);
+		}
+	}
+
+	glViewport(0, 0, renderWidth, renderHeight);
+}
+
+void ResolutionScaler::Upscale(Shader& shader, GLuint color, GLuint textureUnit)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, width, height);
+	glDisable(GL_DEPTH_TEST);
+
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	glBindTexture(GL_TEXTURE_2D, color);
+	glBindSampler(textureUnit, linearSampler);
+
+	// Nothing to sharpen at the window's resolution.
+	shader.UseShader();
+	shader.SetUpscale(textureUnit, glm::vec2((float)renderWidth / width, (float)renderHeight / height),
+		scaleSteps < maxScaleSteps ? upscaleSharpening : 0.f);
+	shader.Validate();
+
+	glBindVertexArray(fullscreenVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	glBindSampler(textureUnit, 0);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void ResolutionScaler::Release()
+{
+	if (FBO) {
+		glDeleteFramebuffers(1, &FBO);
+		FBO = 0;
+	}
+
+	targets[0] = targets[1] = 0;
+
+	if (fullscreenVAO) {
+		glDeleteVertexArrays(1, &fullscreenVAO);
+		fullscreenVAO = 0;
+	}
+
+	if (linearSampler) {
+		glDeleteSamplers(1, &linearSampler);
+		linearSampler = 0;
+	}
+
+	for (unsigned int i = 0; i < timerFrames; i++) {
+		if (timers[i][0]) {
+			glDeleteQueries(2, timers[i]);
+			timers[i][0] = timers[i][1] = 0;
+		}
+
+		timerPending[i] = false;
+	}
+}
+
+ResolutionScaler::~ResolutionScaler()
+{
+	Release();
+}
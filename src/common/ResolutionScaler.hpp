@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+#include <FrameGraph.hpp>
+
+class Shader;
+
+// Renders the main view into part of a target the size of the window, the part shrinking or growing
+// every frame to hold the GPU to a target frame time. Frame times come from timestamps a few frames
+// old, so nothing waits on the GPU, and the scale moves in steps so the view settles on a size. The
+// upscale pass stretches the part over the window and sharpens what the stretch blurs; anything drawn
+// after it is at the window's resolution.
+class ResolutionScaler {
+public:
+	ResolutionScaler();
+
+	// False if the driver can't render to the target's formats.
+	bool Init(GLsizei width, GLsizei height, float targetMs);
+
+	// Off, the view renders at the window's resolution.
+	void SetEnabled(bool enabled);
+	bool IsEnabled() { return enabled; }
+
+	// Around everything the GPU does in a frame, BeginFrame also moves the scale.
+	void BeginFrame();
+	void EndFrame();
+
+	float GetScale() { return scale; }
+	float GetGpuTime() { return gpuTime; }
+	float GetTargetTime() { return targetMs; }
+
+	// Of the rendered part.
+	GLsizei GetWidth() { return renderWidth; }
+	GLsizei GetHeight() { return renderHeight; }
+
+	FrameTextureDesc GetColorDesc();
+	FrameTextureDesc GetDepthDesc();
+
+	// Binds the targets with a viewport over the rendered part.
+	void Write(GLuint color, GLuint depth);
+
+	// Stretches the rendered part of color over the window.
+	void Upscale(Shader& shader, GLuint color, GLuint textureUnit);
+
+	~ResolutionScaler();
+
+private:
+	void Release();
+	void Attach(GLuint color, GLuint depth);
+	void SetScaleSteps(int steps);
+
+	// Begin and end timestamps of a frame each, read back once the frames after it are queued.
+	static const unsigned int timerFrames = 3;
+
+	GLuint timers[timerFrames][2];
+	bool timerPending[timerFrames];
+	unsigned int timerIndex;
+
+	// Frames already queued at the old scale when it changed, their times are skipped.
+	unsigned int settleFrames;
+
+	// Attached to FBO, its status is only checked when they change.
+	GLuint targets[2];
+
+	GLuint FBO, fullscreenVAO, linearSampler;
+	GLsizei width, height, renderWidth, renderHeight;
+	int scaleSteps;
+	float targetMs, scale, gpuTime;
+	bool enabled;
+};
@@ -0,0 +1,354 @@
+#include "Scene.hpp"
+
+#include <stdio.h>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
+
+namespace {
+	// The last slot's last generation would be nullEntity.
+	const uint32_t maxEntities = (1u << 24) - 1;
+
+	// Transforms per job, a matrix product and a quaternion each.
+	const size_t transformChunk = 2048;
+
+	const glm::vec3 zero(0.f);
+	const glm::quat identityRotation(1.f, 0.f, 0.f, 0.f);
+	const glm::mat4 identityMatrix(1.f);
+}
+
+Scene::Scene()
+{
+	reorder = false;
+	stats = {};
+}
+
+Entity Scene::Create()
+{
+	uint32_t index;
+
+	if (!freeSlots.empty()) {
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		if (generations.size() >= maxEntities) {
+			printf("Scene: out of entities\n");
+			return nullEntity;
+		}
+
+		index = (uint32_t)generations.size();
+		generations.push_back(0);
+		transformIndices.push_back(noTransform);
+		childCounts.push_back(0);
+	}
+
+	Entity entity = index | ((Entity)generations[index] << 24);
+
+	transformIndices[index] = (uint32_t)transformEntities.size();
+	childCounts[index] = 0;
+
+	transformEntities.push_back(entity);
+	positions.push_back(zero);
+	rotations.push_back(identityRotation);
+	scales.push_back(glm::vec3(1.f));
+	parents.push_back(nullEntity);
+	worldMatrices.push_back(identityMatrix);
+	dirty.push_back(1);
+
+	// Roots go at the front, so it's out of order unless everything is a root.
+	reorder = true;
+	return entity;
+}
+
+void Scene::Destroy(Entity entity)
+{
+	uint32_t dense = Find(entity);
+	if (dense == noTransform) {
+		return;
+	}
+
+	for (auto& pool : pools) {
+		if (pool) {
+			pool->Remove(entity);
+		}
+	}
+
+	uint32_t index = GetEntityIndex(entity);
+
+	if (childCounts[index] > 0) {
+		for (size_t i = 0; i < parents.size(); i++) {
+			if (parents[i] == entity) {
+				parents[i] = nullEntity;
+				dirty[i] = 1;
+			}
+		}
+	}
+
+	if (parents[dense] != nullEntity) {
+		childCounts[GetEntityIndex(parents[dense])]--;
+	}
+
+	// The last transform fills the hole.
+	uint32_t last = (uint32_t)transformEntities.size() - 1;
+	transformEntities[dense] = transformEntities[last];
+	positions[dense] = positions[last];
+	rotations[dense] = rotations[last];
+	scales[dense] = scales[last];
+	parents[dense] = parents[last];
+	worldMatrices[dense] = worldMatrices[last];
+	dirty[dense] = dirty[last];
+	transformIndices[GetEntityIndex(transformEntities[dense])] = dense;
+
+	transformEntities.pop_back();
+	positions.pop_back();
+	rotations.pop_back();
+	scales.pop_back();
+	parents.pop_back();
+	worldMatrices.pop_back();
+	dirty.pop_back();
+
+	transformIndices[index] = noTransform;
+	generations[index]++;
+	freeSlots.push_back(index);
+
+	reorder = true;
+}
+
+void Scene::Reserve(size_t count)
+{
+	generations.reserve(count);
+	transformIndices.reserve(count);
+	childCounts.reserve(count);
+
+	transformEntities.reserve(count);
+	positions.reserve(count);
+	rotations.reserve(count);
+	scales.reserve(count);
+	parents.reserve(count);
+	worldMatrices.reserve(count);
+	dirty.reserve(count);
+}
+
+bool Scene::IsAlive(Entity entity)
+{
+	return Find(entity) != noTransform;
+}
+
+uint32_t Scene::Find(Entity entity)
+{
+	uint32_t index = GetEntityIndex(entity);
+	if (entity == nullEntity || index >= generations.size() || generations[index] != (uint8_t)(entity >> 24)) {
+		return noTransform;
+	}
+
+	return transformIndices[index];
+}
+
+void Scene::SetPosition(Entity entity, glm::vec3 const& position)
+{
+	uint32_t dense = Find(entity);
+	if (dense != noTransform) {
+		positions[dense] = position;
+		dirty[dense] = 1;
+	}
+}
+
+void Scene::SetRotation(Entity entity, glm::quat const& rotation)
+{
+	uint32_t dense = Find(entity);
+	if (dense != noTransform) {
+		rotations[dense] = rotation;
+		dirty[dense] = 1;
+	}
+}
+
+void Scene::SetScale(Entity entity, glm::vec3 const& scale)
+{
+	uint32_t dense = Find(entity);
+	if (dense != noTransform) {
+		scales[dense] = scale;
+		dirty[dense] = 1;
+	}
+}
+
+glm::vec3 const& Scene::GetPosition(Entity entity)
+{
+	uint32_t dense = Find(entity);
+	return dense != noTransform ? positions[dense] : zero;
+}
+
+glm::quat const& Scene::GetRotation(Entity entity)
+{
+	uint32_t dense = Find(entity);
+	return dense != noTransform ? rotations[dense] : identityRotation;
+}
+
+glm::vec3 const& Scene::GetScale(Entity entity)
+{
+	uint32_t dense = Find(entity);
+	return dense != noTransform ? scales[dense] : zero;
+}
+
+bool Scene::SetParent(Entity entity, Entity parent)
+{
+	uint32_t dense = Find(entity);
+	if (dense == noTransform || (parent != nullEntity && Find(parent) == noTransform)) {
+		return false;
+	}
+
+	// Walks up from the new parent, meeting entity would make a loop.
+	for (Entity above = parent; above != nullEntity; above = parents[Find(above)]) {
+		if (above == entity) {
+			return false;
+		}
+	}
+
+	if (parents[dense] != nullEntity) {
+		childCounts[GetEntityIndex(parents[dense])]--;
+	}
+
+	if (parent != nullEntity) {
+		childCounts[GetEntityIndex(parent)]++;
+	}
+
+	parents[dense] = parent;
+	dirty[dense] = 1;
+	reorder = true;
+	return true;
+}
+
+Entity Scene::GetParent(Entity entity)
+{
+	uint32_t dense = Find(entity);
+	return dense != noTransform ? parents[dense] : nullEntity;
+}
+
+glm::mat4 const& Scene::GetWorldMatrix(Entity entity)
+{
+	uint32_t dense = Find(entity);
+	return dense != noTransform ? worldMatrices[dense] : identityMatrix;
+}
+
+// Counting sort by depth. Parents are looked up by entity here, the update uses the dense indices it leaves.
+void Scene::Reorder()
+{
+	size_t count = transformEntities.size();
+	std::vector<uint32_t> depths(count, noTransform);
+	std::vector<uint32_t> chain;
+	size_t depthCount = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		// Up to the first ancestor whose depth is known, then back down.
+		uint32_t dense = (uint32_t)i;
+		while (depths[dense] == noTransform && parents[dense] != nullEntity) {
+			chain.push_back(dense);
+			dense = Find(parents[dense]);
+		}
+
+		if (depths[dense] == noTransform) {
+			depths[dense] = 0;
+		}
+
+		uint32_t depth = depths[dense];
+		while (!chain.empty()) {
+			depths[chain.back()] = ++depth;
+			chain.pop_back();
+		}
+
+		depthCount = std::max<size_t>(depthCount, depths[i] + 1);
+	}
+
+	depthStarts.assign(depthCount + 1, 0);
+	for (size_t i = 0; i < count; i++) {
+		depthStarts[depths[i] + 1]++;
+	}
+	for (size_t depth = 0; depth < depthCount; depth++) {
+		depthStarts[depth + 1] += depthStarts[depth];
+	}
+
+	std::vector<size_t> next(depthStarts.begin(), depthStarts.end() - 1);
+	std::vector<uint32_t> order(count);
+	for (size_t i = 0; i < count; i++) {
+		order[next[depths[i]]++] = (uint32_t)i;
+	}
+
+	auto permute = [&](auto& values) {
+		std::remove_reference_t<decltype(values)> sorted(count);
+		for (size_t i = 0; i < count; i++) {
+			sorted[i] = values[order[i]];
+		}
+		values.swap(sorted);
+	};
+
+	permute(transformEntities);
+	permute(positions);
+	permute(rotations);
+	permute(scales);
+	permute(parents);
+	permute(worldMatrices);
+	permute(dirty);
+
+	for (size_t i = 0; i < count; i++) {
+		transformIndices[GetEntityIndex(transformEntities[i])] = (uint32_t)i;
+	}
+
+	parentIndices.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		parentIndices[i] = parents[i] != nullEntity ? Find(parents[i]) : noTransform;
+	}
+
+	reorder = false;
+}
+
+void Scene::UpdateTransforms(JobPool* pool)
+{
+	stats.reordered = reorder;
+
+	if (reorder) {
+		Reorder();
+	}
+
+	std::atomic<size_t> updated(0);
+
+	for (size_t depth = 0; depth + 1 < depthStarts.size(); depth++) {
+		size_t first = depthStarts[depth];
+
+		// A transform is redone if it or its parent changed, and is then marked changed for its children.
+		// Parents are a depth up, finished before this one starts.
+		auto update = [&, first](size_t begin, size_t end) {
+			size_t count = 0;
+
+			for (size_t i = first + begin; i < first + end; i++) {
+				uint32_t parent = parentIndices[i];
+				if (!dirty[i] && (parent == noTransform || !dirty[parent])) {
+					continue;
+				}
+
+				glm::mat3 rotation = glm::mat3_cast(rotations[i]);
+				glm::mat4 local(glm::vec4(rotation[0] * scales[i].x, 0.f), glm::vec4(rotation[1] * scales[i].y, 0.f),
+					glm::vec4(rotation[2] * scales[i].z, 0.f), glm::vec4(positions[i], 1.f));
+
+				worldMatrices[i] = parent == noTransform ? local : worldMatrices[parent] * local;
+				dirty[i] = 1;
+				count++;
+			}
+
+			updated += count;
+		};
+
+		size_t count = depthStarts[depth + 1] - first;
+		if (pool) {
+			pool->ParallelFor(count, transformChunk, update);
+		}
+		else {
+			update(0, count);
+		}
+	}
+
+	std::fill(dirty.begin(), dirty.end(), 0);
+
+	stats.entities = transformEntities.size();
+	stats.updatedTransforms = updated;
+	stats.depths = depthStarts.empty() ? 0 : depthStarts.size() - 1;
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include <glm\glm.hpp>
+#include <glm\gtc\quaternion.hpp>
+
+#include <JobPool.hpp>
+
+// Slot index in the low 24 bits and the slot's generation in the high 8, so handles to a destroyed
+// entity stop matching once its slot is reused.
+typedef uint32_t Entity;
+
+static const Entity nullEntity = 0xFFFFFFFFu;
+
+inline uint32_t GetEntityIndex(Entity entity) { return entity & 0xFFFFFFu; }
+
+class ComponentPoolBase {
+public:
+	virtual void Remove(Entity entity) = 0;
+	virtual ~ComponentPoolBase() {}
+};
+
+// Sparse set of one component type: the components and their entities packed in dense arrays that
+// systems walk, and a sparse array from entity index to dense index for lookups. Removing moves the
+// last component into the hole, so the dense order changes.
+template<typename T>
+class ComponentPool : public ComponentPoolBase {
+public:
+	T& Add(Entity entity, T const& component)
+	{
+		uint32_t index = GetEntityIndex(entity);
+		if (index >= sparse.size()) {
+			sparse.resize(index + 1, noComponent);
+		}
+
+		if (sparse[index] != noComponent) {
+			components[sparse[index]] = component;
+			return components[sparse[index]];
+		}
+
+		sparse[index] = (uint32_t)components.size();
+		entities.push_back(entity);
+		components.push_back(component);
+		return components.back();
+	}
+
+	void Remove(Entity entity) override
+	{
+		uint32_t index = GetEntityIndex(entity);
+		if (index >= sparse.size() || sparse[index] == noComponent || entities[sparse[index]] != entity) {
+			return;
+		}
+
+		uint32_t dense = sparse[index];
+		entities[dense] = entities.back();
+		components[dense] = std::move(components.back());
+		sparse[GetEntityIndex(entities[dense])] = dense;
+		sparse[index] = noComponent;
+
+		entities.pop_back();
+		components.pop_back();
+	}
+
+	T* Get(Entity entity)
+	{
+		uint32_t index = GetEntityIndex(entity);
+		if (index >= sparse.size() || sparse[index] == noComponent || entities[sparse[index]] != entity) {
+			return nullptr;
+		}
+
+		return &components[sparse[index]];
+	}
+
+	size_t GetCount() { return components.size(); }
+	T* GetData() { return components.data(); }
+	Entity const* GetEntities() { return entities.data(); }
+
+	// body(entity, component) over every component, in chunks of at least minChunk on the pool's
+	// workers. No pool runs them here.
+	template<typename F>
+	void ForEach(JobPool* pool, size_t minChunk, F const& body)
+	{
+		auto run = [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				body(entities[i], components[i]);
+			}
+		};
+
+		if (pool) {
+			pool->ParallelFor(components.size(), minChunk, run);
+		}
+		else {
+			run(0, components.size());
+		}
+	}
+
+private:
+	static constexpr uint32_t noComponent = 0xFFFFFFFFu;
+
+	std::vector<uint32_t> sparse;
+	std::vector<Entity> entities;
+	std::vector<T> components;
+};
+
+struct SceneStats {
+	size_t entities;
+
+	// Of the last UpdateTransforms, and how deep the hierarchy went.
+	size_t updatedTransforms;
+	size_t depths;
+	bool reordered;
+};
+
+// Entities, their components and the transform every entity has. Transforms are kept as arrays of
+// positions, rotations and scales, sorted by depth in the hierarchy so UpdateTransforms can walk one
+// depth at a time, each split across the job pool, knowing the parents are done. Only what changed
+// since the last update and what hangs below it is recomputed. Components of any other type live in
+// a ComponentPool per type, created on first use.
+class Scene {
+public:
+	Scene();
+
+	// At the origin, under no parent.
+	Entity Create();
+
+	// Removes its components, its children move to the root keeping their local transforms.
+	void Destroy(Entity entity);
+
+	bool IsAlive(Entity entity);
+	size_t GetEntityCount() { return transformEntities.size(); }
+
+	// Room for count entities, so creating that many doesn't reallocate.
+	void Reserve(size_t count);
+
+	template<typename T>
+	ComponentPool<T>& Components()
+	{
+		size_t id = GetComponentId<T>();
+		if (id >= pools.size()) {
+			pools.resize(id + 1);
+		}
+
+		if (!pools[id]) {
+			pools[id] = std::make_unique<ComponentPool<T>>();
+		}
+
+		return *static_cast<ComponentPool<T>*>(pools[id].get());
+	}
+
+	// Local transforms. Setting those of different entities from different jobs is fine.
+	void SetPosition(Entity entity, glm::vec3 const& position);
+	void SetRotation(Entity entity, glm::quat const& rotation);
+	void SetScale(Entity entity, glm::vec3 const& scale);
+
+	glm::vec3 const& GetPosition(Entity entity);
+	glm::quat const& GetRotation(Entity entity);
+	glm::vec3 const& GetScale(Entity entity);
+
+	// nullEntity moves it to the root. False, and nothing changes, if parent is below entity.
+	bool SetParent(Entity entity, Entity parent);
+	Entity GetParent(Entity entity);
+
+	// As of the last UpdateTransforms.
+	glm::mat4 const& GetWorldMatrix(Entity entity);
+
+	// No pool updates on this thread.
+	void UpdateTransforms(JobPool* pool);
+
+	SceneStats const& GetStats() { return stats; }
+
+private:
+	static constexpr uint32_t noTransform = 0xFFFFFFFFu;
+
+	// Dense index of a live entity's transform, noTransform otherwise.
+	uint32_t Find(Entity entity);
+	void Reorder();
+
+	static size_t NextComponentId()
+	{
+		static size_t next = 0;
+		return next++;
+	}
+
+	template<typename T>
+	static size_t GetComponentId()
+	{
+		static size_t id = NextComponentId();
+		return id;
+	}
+
+	// Per entity slot.
+	std::vector<uint8_t> generations;
+	std::vector<uint32_t> transformIndices;
+	std::vector<uint32_t> childCounts;
+	std::vector<uint32_t> freeSlots;
+
+	// Per transform. Creating, destroying or parenting leaves them out of depth order until the next update.
+	std::vector<Entity> transformEntities;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<Entity> parents;
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<uint8_t> dirty;
+
+	// Valid once sorted: the parent's dense index and where each depth starts, with the end last.
+	std::vector<uint32_t> parentIndices;
+	std::vector<size_t> depthStarts;
+	bool reorder;
+
+	std::vector<std::unique_ptr<ComponentPoolBase>> pools;
+	SceneStats stats;
+};
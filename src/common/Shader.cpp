@@ -1,7 +1,56 @@
 #include <Shader.hpp>
+#include <AssetPack.hpp>
+#include <filesystem>
 #include <iostream>
 #include <format>
 
+namespace {
+	std::string ReadSource(const char* fileLocation, int depth)
+	{
+		PackView file;
+
+		if (!AssetPack::Load(fileLocation, file)) {
+			printf("Failed to read %s : File doesn't exist \n", fileLocation);
+			return std::string();
+		}
+
+		std::string source((const char*)file.GetData(), file.GetSize());
+		std::string content;
+		size_t lineStart = 0;
+
+		while (lineStart < source.size()) {
+			size_t lineEnd = source.find('\n', lineStart);
+			lineEnd = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+
+			std::string line = source.substr(lineStart, lineEnd - lineStart);
+			size_t open = line.find('"');
+			size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+
+			if (line.compare(0, 8, "#include") == 0 && close != std::string::npos) {
+				std::string location = (std::filesystem::path(fileLocation).parent_path() / line.substr(open + 1, close - open - 1)).generic_string();
+
+				// Guards against a file including itself, directly or not.
+				if (depth >= 16) {
+					printf("Failed to read %s : includes nest too deep \n", location.c_str());
+				}
+				else {
+					content += ReadSource(location.c_str(), depth + 1);
+					if (!content.empty() && content.back() != '\n') {
+						content += '\n';
+					}
+				}
+			}
+			else {
+				content += line;
+			}
+
+			lineStart = lineEnd;
+		}
+
+		return content;
+	}
+}
+
 Shader::Shader() {
 	shaderID = 0;
 	uniformModel = 0;
@@ -16,6 +65,10 @@ void Shader::CreateFromString(const char* vertexCode, const char* fragmentCode)
 
 void Shader::CreateFromFiles(const char* vertexLocation, const char* fragmentLocation)
 {
+	this->vertexLocation = vertexLocation;
+	this->geometryLocation = "";
+	this->fragmentLocation = fragmentLocation;
+
 	std::string vertexString = ReadFile(vertexLocation);
 	std::string fragmentString = ReadFile(fragmentLocation);
 
@@ -27,6 +80,10 @@ void Shader::CreateFromFiles(const char* vertexLocation, const char* fragmentLoc
 
 void Shader::CreateFromFiles(const char* vertexLocation, const char* geometryLocation, const char* fragmentLocation)
 {
+	this->vertexLocation = vertexLocation;
+	this->geometryLocation = geometryLocation;
+	this->fragmentLocation = fragmentLocation;
+
 	std::string vertexString = ReadFile(vertexLocation);
 	std::string geometryString = ReadFile(geometryLocation);
 	std::string fragmentString = ReadFile(fragmentLocation);
@@ -37,6 +94,34 @@ void Shader::CreateFromFiles(const char* vertexLocation, const char* geometryLoc
 	CompileShader(vertexCode, geometryCode, fragmentCode);
 }
 
+bool Shader::CreateComputeFromFile(const char* computeLocation)
+{
+	this->vertexLocation = "";
+	this->geometryLocation = "";
+	this->fragmentLocation = "";
+
+	std::string computeString = ReadFile(computeLocation);
+
+	if (computeString.empty()) {
+		return false;
+	}
+
+	return CompileComputeShader(computeString.c_str());
+}
+
+bool Shader::Reload(std::string const& vertexCode, std::string const& geometryCode, std::string const& fragmentCode)
+{
+	if (vertexCode.empty() || fragmentCode.empty()) {
+		return false;
+	}
+
+	if (geometryCode.empty()) {
+		return CompileShader(vertexCode.c_str(), fragmentCode.c_str());
+	}
+
+	return CompileShader(vertexCode.c_str(), geometryCode.c_str(), fragmentCode.c_str());
+}
+
 void Shader::Validate()
 {
 	GLint result = 0;
@@ -54,23 +139,7 @@ void Shader::Validate()
 
 std::string Shader::ReadFile(const char* fileLocation)
 {
-	std::string content;
-	std::ifstream fileStream(fileLocation, std::ios::in);
-
-	if (!fileStream.is_open()) {
-		printf("Failed to read %s : File doesn't exist \n", fileLocation);
-		return std::string();
-	}
-
-	std::string line = "";
-
-	while (!fileStream.eof()) {
-		std::getline(fileStream, line);
-		content.append(line + "\n");
-	}
-
-	fileStream.close();
-	return content;
+	return ReadSource(fileLocation, 0);
 }
 
 GLuint Shader::GetProjectionLocation() {
@@ -131,7 +200,7 @@ void Shader::SetDirectionalLight(DirectionalLight* directionalLight)
 		uniformDirectionalLight.uniformDiffuseIntensity, uniformDirectionalLight.uniformDirection);
 }
 
-void Shader::SetPointLights(PointLight* pointLight, unsigned int lightCount, unsigned int textureUnit, unsigned int offset)
+void Shader::SetPointLights(PointLight* pointLight, unsigned int lightCount, unsigned int offset)
 {
 	if (lightCount > N_POINT_LIGHTS) lightCount = N_POINT_LIGHTS;
 
@@ -142,13 +211,16 @@ void Shader::SetPointLights(PointLight* pointLight, unsigned int lightCount, uns
 			uniformPointLight[i].uniformDiffuseIntensity, uniformPointLight[i].uniformPosition,
 			uniformPointLight[i].uniformConstant, uniformPointLight[i].uniformLinear, uniformPointLight[i].uniformExponent);
 
-		pointLight[i].GetShadowMap()->Read(GL_TEXTURE0 + textureUnit + i);
-		glUniform1i(uniformOmniShadowMap[i + offset].uniformShadowMap, textureUnit + i);
+		OmniShadowTiles const& tiles = pointLight[i].GetShadowTiles();
+		for (size_t face = 0; face < 6; face++) {
+			glUniform2fv(uniformOmniShadowMap[i + offset].uniformFaceOffsets[face], 1, glm::value_ptr(tiles.faceOffsets[face]));
+		}
+		glUniform1f(uniformOmniShadowMap[i + offset].uniformFaceScale, tiles.faceScale);
 		glUniform1f(uniformOmniShadowMap[i + offset].uniformFarPlane, pointLight[i].GetFarPlane());
 	}
 }
 
-void Shader::SetSpotLights(SpotLight* spotLight, unsigned int lightCount, unsigned int textureUnit, unsigned int offset)
+void Shader::SetSpotLights(SpotLight* spotLight, unsigned int lightCount, unsigned int offset)
 {
 	if (lightCount > N_SPOT_LIGHTS) lightCount = N_SPOT_LIGHTS;
 
@@ -160,12 +232,20 @@ void Shader::SetSpotLights(SpotLight* spotLight, unsigned int lightCount, unsign
 			uniformSpotLight[i].uniformConstant, uniformSpotLight[i].uniformLinear, uniformSpotLight[i].uniformExponent,
 			uniformSpotLight[i].uniformDirection, uniformSpotLight[i].uniformEdgeAngle);
 	
-		spotLight[i].GetShadowMap()->Read(GL_TEXTURE0 + textureUnit + i);
-		glUniform1i(uniformOmniShadowMap[i + offset].uniformShadowMap, textureUnit + i);
+		OmniShadowTiles const& tiles = spotLight[i].GetShadowTiles();
+		for (size_t face = 0; face < 6; face++) {
+			glUniform2fv(uniformOmniShadowMap[i + offset].uniformFaceOffsets[face], 1, glm::value_ptr(tiles.faceOffsets[face]));
+		}
+		glUniform1f(uniformOmniShadowMap[i + offset].uniformFaceScale, tiles.faceScale);
 		glUniform1f(uniformOmniShadowMap[i + offset].uniformFarPlane, spotLight[i].GetFarPlane());
 	}
 }
 
+void Shader::SetOmniShadowAtlas(GLuint textureUnit)
+{
+	glUniform1i(uniformOmniShadowAtlas, textureUnit);
+}
+
 void Shader::SetDirectionalShadowMap(GLuint textureUnit)
 {
 	glUniform1i(uniformDirectionalShadowMap, textureUnit);
@@ -188,19 +268,110 @@ void Shader::SetOmniLightMatrices(std::vector<glm::mat4> lightMatrices)
 	}
 }
 
-void Shader::CompileProgram()
+void Shader::SetOmniFaces(GLint const* faces, GLsizei count)
+{
+	glUniform1iv(uniformFaces, count, faces);
+}
+
+void Shader::SetOmniShadowTiles(OmniShadowTiles const& tiles)
+{
+	for (size_t face = 0; face < 6; face++) {
+		glUniform2fv(uniformFaceOffsets[face], 1, glm::value_ptr(tiles.faceOffsets[face]));
+	}
+	glUniform1f(uniformFaceScale, tiles.faceScale);
+}
+
+void Shader::SetShadowFilter(ShadowFilter filter)
+{
+	ShadowFilterSettings settings = MomentShadowMap::GetSettings(filter);
+
+	glUniform1i(uniformShadowFilter, filter == ShadowFilter::Pcf ? 0 : 1);
+	glUniform1i(uniformMomentCount, settings.momentCount);
+	glUniform2fv(uniformEvsmExponents, 1, glm::value_ptr(settings.exponents));
+	glUniform1i(uniformBlurRadius, settings.blurRadius);
+}
+
+void Shader::SetMomentMaps(GLuint directionalUnit, GLuint omniUnit)
+{
+	glUniform1i(uniformDirectionalMomentMap, directionalUnit);
+	glUniform1i(uniformOmniMomentAtlas, omniUnit);
+}
+
+void Shader::SetMomentBlur(GLuint sourceUnit, glm::ivec2 const& direction, GLint downsample, glm::ivec4 const& bounds)
+{
+	glUniform1i(uniformFilterSource, sourceUnit);
+	glUniform2iv(uniformBlurDirection, 1, glm::value_ptr(direction));
+	glUniform1i(uniformDownsample, downsample);
+	glUniform4iv(uniformFilterBounds, 1, glm::value_ptr(bounds));
+}
+
+void Shader::SetCullView(glm::mat4 const& viewProjection, glm::vec3 const& eye)
+{
+	glUniformMatrix4fv(uniformCullViewProjection, 1, GL_FALSE, glm::value_ptr(viewProjection));
+	glUniform3fv(uniformCullEye, 1, glm::value_ptr(eye));
+}
+
+void Shader::SetCullLod(float projectionScale, float maxPixels, GLint lodBias)
+{
+	glUniform1f(uniformLodProjectionScale, projectionScale);
+	glUniform1f(uniformLodMaxPixels, maxPixels);
+	glUniform1i(uniformLodBias, lodBias);
+}
+
+void Shader::SetCullOcclusion(bool enabled, glm::mat4 const& occlusionViewProjection, GLuint hiZUnit)
+{
+	glUniform1i(uniformOcclusionEnabled, enabled ? 1 : 0);
+	glUniformMatrix4fv(uniformOcclusionViewProjection, 1, GL_FALSE, glm::value_ptr(occlusionViewProjection));
+	glUniform1i(uniformHiZ, hiZUnit);
+}
+
+void Shader::SetHiZSource(GLuint sourceUnit, GLint sourceLevel)
+{
+	glUniform1i(uniformHiZSource, sourceUnit);
+	glUniform1i(uniformHiZSourceLevel, sourceLevel);
+}
+
+void Shader::SetFillLightCount(unsigned int count)
+{
+	if (count > N_FILL_LIGHTS) count = N_FILL_LIGHTS;
+
+	glUniform1i(uniformFillLightCount, count);
+}
+
+void Shader::SetGBuffer(GLuint firstUnit, glm::mat4 const& inverseViewProjection, glm::vec2 const& viewportSize)
+{
+	glUniform1i(uniformGBufferAlbedo, firstUnit);
+	glUniform1i(uniformGBufferNormal, firstUnit + 1);
+	glUniform1i(uniformGBufferDepth, firstUnit + 2);
+	glUniformMatrix4fv(uniformInverseViewProjection, 1, GL_FALSE, glm::value_ptr(inverseViewProjection));
+	glUniform2f(uniformGBufferViewport, viewportSize.x, viewportSize.y);
+}
+
+void Shader::SetUpscale(GLuint sourceUnit, glm::vec2 const& sourceExtent, float sharpening)
+{
+	glUniform1i(uniformUpscaleSource, sourceUnit);
+	glUniform2f(uniformUpscaleExtent, sourceExtent.x, sourceExtent.y);
+	glUniform1f(uniformSharpening, sharpening);
+}
+
+bool Shader::CompileProgram(GLuint theProgram)
 {
 	GLint result = 0;
 	GLchar eLog[1024] = { 0 };
 
-	glLinkProgram(shaderID);
-	glGetProgramiv(shaderID, GL_LINK_STATUS, &result);
+	glLinkProgram(theProgram);
+	glGetProgramiv(theProgram, GL_LINK_STATUS, &result);
 	if (!result) {
-		glGetProgramInfoLog(shaderID, sizeof(eLog), NULL, eLog);
+		glGetProgramInfoLog(theProgram, sizeof(eLog), NULL, eLog);
 		printf("Error linking program: '%s'\n", eLog);
-		return;
+		return false;
 	}
 
+	return true;
+}
+
+void Shader::GetUniformLocations()
+{
 	uniformModel = glGetUniformLocation(shaderID, "model");
 	uniformProjection = glGetUniformLocation(shaderID, "projection");
 	uniformView = glGetUniformLocation(shaderID, "view");
@@ -251,52 +422,147 @@ void Shader::CompileProgram()
 		uniformLightMatrices[i] = glGetUniformLocation(shaderID, std::format("lightMatrices[{}]", i).c_str());
 	}
 
+	uniformFaces = glGetUniformLocation(shaderID, "faces");
+
+	for (size_t i = 0; i < 6; i++) {
+		uniformFaceOffsets[i] = glGetUniformLocation(shaderID, std::format("faceOffsets[{}]", i).c_str());
+	}
+	uniformFaceScale = glGetUniformLocation(shaderID, "faceScale");
+	uniformOmniShadowAtlas = glGetUniformLocation(shaderID, "omniShadowAtlas");
+
+	uniformShadowFilter = glGetUniformLocation(shaderID, "shadowFilter");
+	uniformMomentCount = glGetUniformLocation(shaderID, "momentCount");
+	uniformEvsmExponents = glGetUniformLocation(shaderID, "evsmExponents");
+	uniformBlurRadius = glGetUniformLocation(shaderID, "blurRadius");
+	uniformDirectionalMomentMap = glGetUniformLocation(shaderID, "directionalMomentMap");
+	uniformOmniMomentAtlas = glGetUniformLocation(shaderID, "omniMomentAtlas");
+	uniformFilterSource = glGetUniformLocation(shaderID, "filterSource");
+	uniformBlurDirection = glGetUniformLocation(shaderID, "blurDirection");
+	uniformDownsample = glGetUniformLocation(shaderID, "downsample");
+	uniformFilterBounds = glGetUniformLocation(shaderID, "filterBounds");
+
+	uniformCullViewProjection = glGetUniformLocation(shaderID, "cullViewProjection");
+	uniformCullEye = glGetUniformLocation(shaderID, "cullEye");
+	uniformLodProjectionScale = glGetUniformLocation(shaderID, "lodProjectionScale");
+	uniformLodMaxPixels = glGetUniformLocation(shaderID, "lodMaxPixels");
+	uniformLodBias = glGetUniformLocation(shaderID, "lodBias");
+	uniformOcclusionEnabled = glGetUniformLocation(shaderID, "occlusionEnabled");
+	uniformOcclusionViewProjection = glGetUniformLocation(shaderID, "occlusionViewProjection");
+	uniformHiZ = glGetUniformLocation(shaderID, "hiZ");
+	uniformHiZSource = glGetUniformLocation(shaderID, "hiZSource");
+	uniformHiZSourceLevel = glGetUniformLocation(shaderID, "hiZSourceLevel");
+
+	uniformFillLightCount = glGetUniformLocation(shaderID, "fillLightCount");
+	uniformGBufferAlbedo = glGetUniformLocation(shaderID, "gBufferAlbedo");
+	uniformGBufferNormal = glGetUniformLocation(shaderID, "gBufferNormal");
+	uniformGBufferDepth = glGetUniformLocation(shaderID, "gBufferDepth");
+	uniformInverseViewProjection = glGetUniformLocation(shaderID, "inverseViewProjection");
+	uniformGBufferViewport = glGetUniformLocation(shaderID, "gBufferViewport");
+	uniformUpscaleSource = glGetUniformLocation(shaderID, "upscaleSource");
+	uniformUpscaleExtent = glGetUniformLocation(shaderID, "upscaleExtent");
+	uniformSharpening = glGetUniformLocation(shaderID, "sharpening");
+
+	// GLSL 3.30 can't give the block a binding itself.
+	GLuint fillLightBlock = glGetUniformBlockIndex(shaderID, "FillLightBlock");
+	if (fillLightBlock != GL_INVALID_INDEX) {
+		glUniformBlockBinding(shaderID, fillLightBlock, FILL_LIGHT_BINDING);
+	}
+
 	for (size_t i = 0; i < N_POINT_LIGHTS + N_SPOT_LIGHTS; i++) {
-		uniformOmniShadowMap[i].uniformShadowMap = glGetUniformLocation(shaderID, std::format("omniShadowMaps[{}].shadowMap", i).c_str());
+		for (size_t face = 0; face < 6; face++) {
+			uniformOmniShadowMap[i].uniformFaceOffsets[face] = glGetUniformLocation(shaderID, std::format("omniShadowMaps[{}].faceOffsets[{}]", i, face).c_str());
+		}
+		uniformOmniShadowMap[i].uniformFaceScale = glGetUniformLocation(shaderID, std::format("omniShadowMaps[{}].faceScale", i).c_str());
 		uniformOmniShadowMap[i].uniformFarPlane = glGetUniformLocation(shaderID, std::format("omniShadowMaps[{}].farPlane", i).c_str());
 
 	}
 }
 
-void Shader::CompileShader(const char* vertexCode, const char* fragmentCode) {
-	shaderID = glCreateProgram();
+bool Shader::CompileShader(const char* vertexCode, const char* fragmentCode) {
+	GLuint program = glCreateProgram();
 
-	if (!shaderID) {
+	if (!program) {
 		printf("Error creating shader program!\n");
-		return;
+		return false;
+	}
+
+	if (!AddShader(program, vertexCode, GL_VERTEX_SHADER) ||
+		!AddShader(program, fragmentCode, GL_FRAGMENT_SHADER) ||
+		!CompileProgram(program)) {
+		glDeleteProgram(program);
+		return false;
 	}
 
-	AddShader(shaderID, vertexCode, GL_VERTEX_SHADER);
-	AddShader(shaderID, fragmentCode, GL_FRAGMENT_SHADER);
+	ClearShader();
+	shaderID = program;
+	GetUniformLocations();
 
-	CompileProgram();
+	return true;
 }
 
-void Shader::CompileShader(const char* vertexCode, const char* geometryCode, const char* fragmentCode)
+bool Shader::CompileShader(const char* vertexCode, const char* geometryCode, const char* fragmentCode)
 {
-	shaderID = glCreateProgram();
+	GLuint program = glCreateProgram();
 
-	if (!shaderID)
+	if (!program)
 	{
 		printf("Error creating shader program!\n");
-		return;
+		return false;
 	}
 
-	AddShader(shaderID, vertexCode, GL_VERTEX_SHADER);
-	AddShader(shaderID, geometryCode, GL_GEOMETRY_SHADER);
-	AddShader(shaderID, fragmentCode, GL_FRAGMENT_SHADER);
+	if (!AddShader(program, vertexCode, GL_VERTEX_SHADER) ||
+		!AddShader(program, geometryCode, GL_GEOMETRY_SHADER) ||
+		!AddShader(program, fragmentCode, GL_FRAGMENT_SHADER) ||
+		!CompileProgram(program)) {
+		glDeleteProgram(program);
+		return false;
+	}
 
-	CompileProgram();
+	ClearShader();
+	shaderID = program;
+	GetUniformLocations();
+
+	return true;
 }
 
-void Shader::AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderType) {
+bool Shader::CompileComputeShader(const char* computeCode)
+{
+	GLuint program = glCreateProgram();
+
+	if (!program)
+	{
+		printf("Error creating shader program!\n");
+		return false;
+	}
+
+	if (!AddShader(program, computeCode, GL_COMPUTE_SHADER) ||
+		!CompileProgram(program)) {
+		glDeleteProgram(program);
+		return false;
+	}
+
+	ClearShader();
+	shaderID = program;
+	GetUniformLocations();
+
+	return true;
+}
+
+bool Shader::AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderType) {
 	GLuint theShader = glCreateShader(shaderType);
 
+	// The #version line has to stay first.
+	std::string code = shaderCode;
+	if (!defines.empty()) {
+		size_t versionEnd = code.find('\n');
+		code.insert(versionEnd == std::string::npos ? code.size() : versionEnd + 1, defines);
+	}
+
 	const GLchar* theCode[1];
-	theCode[0] = shaderCode;
+	theCode[0] = code.c_str();
 
 	GLint codeLength[1];
-	codeLength[0] = strlen(shaderCode);
+	codeLength[0] = (GLint)code.size();
 
 	glShaderSource(theShader, 1, theCode, codeLength);
 	glCompileShader(theShader);
@@ -309,10 +575,16 @@ void Shader::AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderT
 	{
 		glGetShaderInfoLog(theShader, 1024, NULL, eLog);
 		fprintf(stderr, "Error compiling the %d shader: '%s'\n", shaderType, eLog);
-		return;
+		glDeleteShader(theShader);
+		return false;
 	}
 
 	glAttachShader(theProgram, theShader);
+
+	// Only flags the shader; it is released together with the program.
+	glDeleteShader(theShader);
+
+	return true;
 }
 
 void Shader::UseShader() {
@@ -13,19 +13,35 @@
 #include <DirectionalLight.hpp>
 #include <PointLight.hpp>
 #include <SpotLight.hpp>
+#include <MomentShadowMap.hpp>
 
 class Shader {
 public:
 	Shader();
 
+	// Inserted after the #version line of every stage, for variants that share a source file. Set
+	// before creating the program, reloads keep them.
+	void SetDefines(std::string const& defines) { this->defines = defines; }
+
 	void CreateFromString(const char* vertexCode, const char* fragmentCode);
 	void CreateFromFiles(const char* vertexLocation, const char* fragmentLocation);
 	void CreateFromFiles(const char* vertexLocation, const char* geometryLocation, const char* fragmentLocation);
 
+	// GL 4.3 only. False if it fails to compile, so the caller can fall back.
+	bool CreateComputeFromFile(const char* computeLocation);
+
+	// Recompiles from new sources; the current program is kept if anything fails.
+	bool Reload(std::string const& vertexCode, std::string const& geometryCode, std::string const& fragmentCode);
+
 	void Validate();
 
+	// #include "file" lines are replaced by that file, found next to the one including it.
 	std::string ReadFile(const char* fileLocation);
 
+	std::string const& GetVertexLocation() { return vertexLocation; }
+	std::string const& GetGeometryLocation() { return geometryLocation; }
+	std::string const& GetFragmentLocation() { return fragmentLocation; }
+
 	GLuint GetProjectionLocation();
 	GLuint GetModelLocation();
 	GLuint GetViewLocation();
@@ -39,12 +55,36 @@ public:
 	GLuint GetFarPlaneLocation();
 
 	void SetDirectionalLight(DirectionalLight* directionalLight);
-	void SetPointLights(PointLight* pointLight, unsigned int lightCount, unsigned int textureUnit, unsigned int offset);
-	void SetSpotLights(SpotLight* spotLight, unsigned int lightCount, unsigned int textureUnit, unsigned int offset);
+	void SetPointLights(PointLight* pointLight, unsigned int lightCount, unsigned int offset);
+	void SetSpotLights(SpotLight* spotLight, unsigned int lightCount, unsigned int offset);
+	void SetOmniShadowAtlas(GLuint textureUnit);
 	void SetDirectionalShadowMap(GLuint textureUnit);
 	void SetTexture(GLuint textureUnit);
 	void SetDirectionalLightTransform(glm::mat4* lightTransform);
 	void SetOmniLightMatrices(std::vector<glm::mat4> lightMatrices);
+	void SetOmniFaces(GLint const* faces, GLsizei count);
+	void SetOmniShadowTiles(OmniShadowTiles const& tiles);
+	void SetShadowFilter(ShadowFilter filter);
+	void SetMomentMaps(GLuint directionalUnit, GLuint omniUnit);
+
+	// bounds are the first and last texels the blur may read, in moment texels.
+	void SetMomentBlur(GLuint sourceUnit, glm::ivec2 const& direction, GLint downsample, glm::ivec4 const& bounds);
+
+	// GPU culling. A negative maxPixels keeps every instance at the finest LOD. The occlusion
+	// pyramid was built from an earlier frame, seen through occlusionViewProjection.
+	void SetCullView(glm::mat4 const& viewProjection, glm::vec3 const& eye);
+	void SetCullLod(float projectionScale, float maxPixels, GLint lodBias);
+	void SetCullOcclusion(bool enabled, glm::mat4 const& occlusionViewProjection, GLuint hiZUnit);
+	void SetHiZSource(GLuint sourceUnit, GLint sourceLevel);
+
+	void SetFillLightCount(unsigned int count);
+
+	// Albedo, normal and depth on firstUnit and the two units after it, see DeferredRenderer. The
+	// viewport may cover only part of them, see ResolutionScaler.
+	void SetGBuffer(GLuint firstUnit, glm::mat4 const& inverseViewProjection, glm::vec2 const& viewportSize);
+
+	// sourceExtent is the part of the source rendered to, in texture coordinates.
+	void SetUpscale(GLuint sourceUnit, glm::vec2 const& sourceExtent, float sharpening);
 
 	void UseShader();
 	void ClearShader();
@@ -54,6 +94,9 @@ public:
 private:
 	int pointLightCount, spotLightCount;
 
+	std::string vertexLocation, geometryLocation, fragmentLocation;
+	std::string defines;
+
 	GLuint shaderID, uniformProjection, uniformModel, uniformView, 
 		uniformEyePosition, uniformSpecularIntensity, uniformShininess,
 		uniformPointLightCount,
@@ -65,6 +108,43 @@ private:
 		uniformFarPlane;
 
 	GLuint uniformLightMatrices[6];
+	GLuint uniformFaces;
+	GLuint uniformFaceOffsets[6];
+	GLuint uniformFaceScale;
+	GLuint uniformOmniShadowAtlas;
+
+	GLuint uniformShadowFilter;
+	GLuint uniformMomentCount;
+	GLuint uniformEvsmExponents;
+	GLuint uniformBlurRadius;
+	GLuint uniformDirectionalMomentMap;
+	GLuint uniformOmniMomentAtlas;
+	GLuint uniformFilterSource;
+	GLuint uniformBlurDirection;
+	GLuint uniformDownsample;
+	GLuint uniformFilterBounds;
+
+	GLuint uniformCullViewProjection;
+	GLuint uniformCullEye;
+	GLuint uniformLodProjectionScale;
+	GLuint uniformLodMaxPixels;
+	GLuint uniformLodBias;
+	GLuint uniformOcclusionEnabled;
+	GLuint uniformOcclusionViewProjection;
+	GLuint uniformHiZ;
+	GLuint uniformHiZSource;
+	GLuint uniformHiZSourceLevel;
+
+	GLuint uniformFillLightCount;
+	GLuint uniformGBufferAlbedo;
+	GLuint uniformGBufferNormal;
+	GLuint uniformGBufferDepth;
+	GLuint uniformInverseViewProjection;
+	GLuint uniformGBufferViewport;
+
+	GLuint uniformUpscaleSource;
+	GLuint uniformUpscaleExtent;
+	GLuint uniformSharpening;
 
 	struct {
 		GLuint uniformColor;
@@ -97,12 +177,15 @@ private:
 	} uniformSpotLight[N_SPOT_LIGHTS];
 
 	struct {
-		GLuint uniformShadowMap;
+		GLuint uniformFaceOffsets[6];
+		GLuint uniformFaceScale;
 		GLuint uniformFarPlane;
 	} uniformOmniShadowMap[N_POINT_LIGHTS + N_SPOT_LIGHTS];
 
-	void CompileProgram();
-	void CompileShader(const char* vertexCode, const char* fragmentCode);
-	void CompileShader(const char* vertexCode, const char* geometryCode, const char* fragmentCode);
-	void AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderType);
+	bool CompileProgram(GLuint theProgram);
+	void GetUniformLocations();
+	bool CompileShader(const char* vertexCode, const char* fragmentCode);
+	bool CompileShader(const char* vertexCode, const char* geometryCode, const char* fragmentCode);
+	bool CompileComputeShader(const char* computeCode);
+	bool AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderType);
 };
\ No newline at end of file
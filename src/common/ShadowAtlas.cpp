@@ -0,0 +1,147 @@
+#include "ShadowAtlas.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+	// Face texels per pixel of importance, a face sees a quarter turn around the light.
+	const float faceSizePerPixel = 0.5f;
+
+	// How far past a size threshold a light has to go before its tiles change size.
+	const float sizeHysteresis = 1.25f;
+
+	// Splits the interleaved bits of a Z-order index back into x and y.
+	unsigned int CompactBits(unsigned int value)
+	{
+		value &= 0x55555555;
+		value = (value | (value >> 1)) & 0x33333333;
+		value = (value | (value >> 2)) & 0x0F0F0F0F;
+		value = (value | (value >> 4)) & 0x00FF00FF;
+		value = (value | (value >> 8)) & 0x0000FFFF;
+		return value;
+	}
+
+}
+
+ShadowAtlas::ShadowAtlas() : ShadowMap()
+{
+	minFaceSize = 64;
+	shadowedLights = 0;
+	usage = 0.f;
+}
+
+bool ShadowAtlas::Init(unsigned int size, unsigned int minFaceSize)
+{
+	this->minFaceSize = minFaceSize;
+	return ShadowMap::Init(size, size);
+}
+
+std::vector<OmniShadowTiles> ShadowAtlas::Allocate(std::vector<ShadowRequest> const& requests)
+{
+	std::vector<unsigned int> faceSizes(requests.size(), 0);
+
+	for (size_t i = 0; i < requests.size(); i++) {
+		float wanted = requests[i].importance * faceSizePerPixel;
+
+		// Lights that would get less than half the smallest face go without.
+		if (wanted < minFaceSize * 0.5f) {
+			continue;
+		}
+
+		unsigned int faceSize = minFaceSize;
+		while (faceSize * 2 <= wanted && faceSize * 2 <= requests[i].maxFaceSize) {
+			faceSize *= 2;
+		}
+		faceSizes[i] = faceSize;
+	}
+
+	// A changed size moves tiles, so a light keeps its last size until it is clearly past the threshold.
+	if (previousFaceSizes.size() == requests.size()) {
+		for (size_t i = 0; i < requests.size(); i++) {
+			unsigned int previous = previousFaceSizes[i];
+			if (previous == 0 || previous == faceSizes[i] || previous > requests[i].maxFaceSize) {
+				continue;
+			}
+
+			float wanted = requests[i].importance * faceSizePerPixel;
+			float threshold = previous == minFaceSize ? previous * 0.5f : (float)previous;
+
+			if (faceSizes[i] > previous ? wanted < faceSizes[i] * sizeHysteresis : wanted >= threshold / sizeHysteresis) {
+				faceSizes[i] = previous;
+			}
+		}
+	}
+
+	// Most important first, so ties shrink and drop from the back.
+	std::vector<size_t> order(requests.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return requests[a].importance > requests[b].importance; });
+
+	// Area in units of the smallest face.
+	size_t capacity = (size_t)(shadowWidth / minFaceSize) * (shadowHeight / minFaceSize);
+	auto area = [&](unsigned int faceSize) { return 6 * (size_t)(faceSize / minFaceSize) * (faceSize / minFaceSize); };
+
+	size_t used = 0;
+	for (unsigned int faceSize : faceSizes) {
+		used += faceSize ? area(faceSize) : 0;
+	}
+
+	while (used > capacity) {
+		size_t largest = requests.size();
+		for (size_t i : order) {
+			if (faceSizes[i] > minFaceSize && (largest == requests.size() || faceSizes[i] >= faceSizes[largest])) {
+				largest = i;
+			}
+		}
+
+		if (largest < requests.size()) {
+			used -= area(faceSizes[largest]) - area(faceSizes[largest] / 2);
+			faceSizes[largest] /= 2;
+			continue;
+		}
+
+		for (auto i = order.rbegin(); i != order.rend(); i++) {
+			if (faceSizes[*i]) {
+				used -= area(faceSizes[*i]);
+				faceSizes[*i] = 0;
+				break;
+			}
+		}
+	}
+
+	// Power of two squares placed largest first along a Z-order curve pack without gaps. Equal
+	// sizes go in light order, so tiles only move when some light's face size changes.
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return faceSizes[a] > faceSizes[b]; });
+
+	std::vector<OmniShadowTiles> tiles(requests.size(), OmniShadowTiles{});
+	size_t cursor = 0;
+	shadowedLights = 0;
+
+	for (size_t i : order) {
+		if (faceSizes[i] == 0) {
+			continue;
+		}
+
+		size_t faceArea = area(faceSizes[i]) / 6;
+		tiles[i].faceScale = (float)faceSizes[i] / shadowWidth;
+
+		for (int face = 0; face < 6; face++) {
+			glm::vec2 corner((float)CompactBits((unsigned int)cursor), (float)CompactBits((unsigned int)cursor >> 1));
+			tiles[i].faceOffsets[face] = corner * (float)minFaceSize / glm::vec2((float)shadowWidth, (float)shadowHeight);
+			cursor += faceArea;
+		}
+
+		shadowedLights++;
+	}
+
+	usage = capacity ? (float)cursor / capacity : 0.f;
+	previousFaceSizes = faceSizes;
+
+	return tiles;
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include <glm\glm.hpp>
+
+#include <ShadowMap.hpp>
+
+// Where one omni light's six cube faces sit in the atlas, in texture
+// coordinates. faceScale is 0 for a light left without shadows this frame.
+struct OmniShadowTiles {
+	glm::vec2 faceOffsets[6];
+	float faceScale;
+};
+
+// How much an omni light wants a shadow: importance is the size in pixels
+// it covers on screen weighted by its brightness, 0 for none.
+struct ShadowRequest {
+	float importance;
+	unsigned int maxFaceSize;
+};
+
+// One depth texture shared by every omni light. Each frame the lights get
+// square tiles for their cube faces by importance, so the number of shadowed
+// lights grows with the scene while the memory stays fixed.
+class ShadowAtlas : public ShadowMap {
+public:
+	ShadowAtlas();
+
+	bool Init(unsigned int size, unsigned int minFaceSize);
+
+	// Face size follows importance in powers of two, with some hysteresis as
+	// tiles that change size move. While the requests don't fit, the largest
+	// faces are halved, then the least important lights go without shadows.
+	// Requests are expected in the same light order every frame.
+	std::vector<OmniShadowTiles> Allocate(std::vector<ShadowRequest> const& requests);
+
+	unsigned int GetShadowedLights() { return shadowedLights; }
+	float GetUsage() { return usage; }
+
+	~ShadowAtlas();
+
+private:
+	unsigned int minFaceSize;
+	unsigned int shadowedLights;
+	float usage;
+	std::vector<unsigned int> previousFaceSizes;
+};
@@ -0,0 +1,231 @@
+#include "ShadowScheduler.hpp"
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+namespace {
+
+	// Casters moving less than this in world units count as still.
+	const float minMovement = 1e-4f;
+
+	// Lights this much farther from the camera wait one more frame between updates of a face.
+	const float refreshDistance = 10.f;
+	const unsigned int maxRefreshInterval = 8;
+
+	// Faces nothing moved in are still redrawn after this many intervals, in case a change slipped past the bounds.
+	const unsigned int idleRefreshIntervals = 30;
+
+	// Scores above every moved face, so stale tiles are always drawn first.
+	const float invalidScore = 1e6f;
+
+}
+
+ShadowScheduler::ShadowScheduler()
+{
+	maxFaces = 0;
+	maxMilliseconds = 0.f;
+	millisecondsPerFace = 0.f;
+	faceBudget = 0;
+}
+
+void ShadowScheduler::SetBudget(unsigned int maxFaces, float maxMilliseconds)
+{
+	this->maxFaces = maxFaces;
+	this->maxMilliseconds = maxMilliseconds;
+}
+
+void ShadowScheduler::BeginFrame()
+{
+	std::swap(casters, previousCasters);
+	casters.clear();
+}
+
+void ShadowScheduler::AddCaster(glm::vec3 const& center, float radius)
+{
+	casters.push_back({ center, radius });
+}
+
+void ShadowScheduler::Schedule(std::vector<PointLight*> const& lightList, glm::vec3 const& eye, bool wholeLights)
+{
+	if (lights.size() != lightList.size()) {
+		lights.assign(lightList.size(), LightState{});
+	}
+
+	for (size_t i = 0; i < lightList.size(); i++) {
+		LightState& light = lights[i];
+		OmniShadowTiles const& tiles = lightList[i]->GetShadowTiles();
+
+		light.updateMask = 0;
+
+		// Faces that moved to a new tile, or have none, hold nothing useful.
+		if (tiles.faceScale == 0.f || !SameTiles(tiles, light.tiles)) {
+			for (auto& face : light.faces) {
+				face = { false, 0, 0.f };
+			}
+			light.tiles = tiles;
+		}
+
+		if (lightList[i]->GetPosition() != light.position) {
+			for (auto& face : light.faces) {
+				face.dirty += 1.f;
+			}
+			light.position = lightList[i]->GetPosition();
+		}
+
+		for (auto& face : light.faces) {
+			face.age++;
+		}
+	}
+
+	// A caster marks the faces it left and the faces it entered, by how far it moved relative to its distance from
+	// the light. Casters that appeared or went away count as moved all the way.
+	for (size_t c = 0; c < std::max(casters.size(), previousCasters.size()); c++) {
+		Caster const& caster = c < casters.size() ? casters[c] : previousCasters[c];
+		Caster const& previous = c < previousCasters.size() ? previousCasters[c] : casters[c];
+
+		bool changed = c >= casters.size() || c >= previousCasters.size();
+		float movement = changed ? FLT_MAX : glm::length(caster.center - previous.center) + fabsf(caster.radius - previous.radius);
+		if (movement < minMovement) {
+			continue;
+		}
+
+		for (size_t i = 0; i < lightList.size(); i++) {
+			if (lights[i].tiles.faceScale == 0.f) {
+				continue;
+			}
+
+			float distance = std::max(glm::length(caster.center - lightList[i]->GetPosition()), caster.radius);
+			float amount = std::min(movement / std::max(distance, minMovement), 1.f);
+			unsigned int mask = lightList[i]->GetFaceMask(caster.center, caster.radius) | lightList[i]->GetFaceMask(previous.center, previous.radius);
+
+			for (int face = 0; face < 6; face++) {
+				if (mask & (1u << face)) {
+					lights[i].faces[face].dirty += amount;
+				}
+			}
+		}
+	}
+
+	struct Candidate {
+		float score;
+		size_t light;
+		int face;
+	};
+
+	std::vector<Candidate> candidates;
+
+	for (size_t i = 0; i < lightList.size(); i++) {
+		LightState& light = lights[i];
+		if (light.tiles.faceScale == 0.f) {
+			continue;
+		}
+
+		float distance = glm::length(eye - lightList[i]->GetPosition());
+		float reach = lightList[i]->GetReach();
+		float closeness = reach / (reach + distance);
+		unsigned int interval = std::min(1 + (unsigned int)(distance / refreshDistance), maxRefreshInterval);
+
+		for (int face = 0; face < 6; face++) {
+			FaceState const& state = light.faces[face];
+
+			if (!state.valid) {
+				candidates.push_back({ invalidScore + closeness, i, face });
+			}
+			else if (state.dirty > 0.f && state.age >= interval) {
+				candidates.push_back({ state.dirty * closeness * state.age, i, face });
+			}
+			else if (state.age >= interval * idleRefreshIntervals) {
+				// Oldest first, below any face with moved casters.
+				candidates.push_back({ state.age * 1e-6f, i, face });
+			}
+		}
+	}
+
+	std::stable_sort(candidates.begin(), candidates.end(), [](Candidate const& a, Candidate const& b) { return a.score > b.score; });
+
+	faceBudget = (unsigned int)candidates.size();
+	if (maxFaces > 0) {
+		faceBudget = std::min(faceBudget, maxFaces);
+	}
+	if (maxMilliseconds > 0.f && millisecondsPerFace > 0.f) {
+		faceBudget = std::min(faceBudget, std::max(1u, (unsigned int)(maxMilliseconds / millisecondsPerFace)));
+	}
+
+	unsigned int used = 0;
+
+	for (auto& candidate : candidates) {
+		LightState& light = lights[candidate.light];
+		unsigned int faces = wholeLights ? 0x3F : 1u << candidate.face;
+		unsigned int cost = wholeLights ? 6 : 1;
+
+		if (light.updateMask & faces) {
+			continue;
+		}
+		if (used + cost > faceBudget) {
+			break;
+		}
+
+		light.updateMask |= faces;
+		used += cost;
+
+		for (int face = 0; face < 6; face++) {
+			if (faces & (1u << face)) {
+				light.faces[face] = { true, 0, 0.f };
+			}
+		}
+	}
+
+	stats.assign(lightList.size(), ShadowLightStats{});
+
+	for (size_t i = 0; i < lights.size(); i++) {
+		ShadowLightStats& light = stats[i];
+		light.ready = IsReady(i);
+
+		for (int face = 0; face < 6; face++) {
+			light.updatedFaces += (lights[i].updateMask >> face) & 1;
+			light.oldestFace = std::max(light.oldestFace, lights[i].faces[face].age);
+			light.averageAge += lights[i].faces[face].age / 6.f;
+		}
+	}
+}
+
+bool ShadowScheduler::IsReady(size_t light)
+{
+	if (lights[light].tiles.faceScale == 0.f) {
+		return false;
+	}
+
+	for (auto& face : lights[light].faces) {
+		if (!face.valid) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ShadowScheduler::ReportCost(float milliseconds, unsigned int faces)
+{
+	if (faces == 0) {
+		return;
+	}
+
+	float sample = milliseconds / faces;
+	millisecondsPerFace = millisecondsPerFace > 0.f ? millisecondsPerFace * 0.9f + sample * 0.1f : sample;
+}
+
+bool ShadowScheduler::SameTiles(OmniShadowTiles const& a, OmniShadowTiles const& b)
+{
+	if (a.faceScale != b.faceScale) {
+		return false;
+	}
+
+	for (int face = 0; face < 6; face++) {
+		if (a.faceOffsets[face] != b.faceOffsets[face]) {
+			return false;
+		}
+	}
+
+	return true;
+}
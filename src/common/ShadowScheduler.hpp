@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include <glm\glm.hpp>
+
+#include <PointLight.hpp>
+
+// Face ages are in frames since the face was last drawn.
+struct ShadowLightStats {
+	unsigned int updatedFaces;
+	unsigned int oldestFace;
+	float averageAge;
+	bool ready;
+};
+
+// Spreads omni shadow face updates over frames. Faces whose tile moved in the
+// atlas must be drawn before the light casts shadows again; faces whose
+// casters moved go next, weighted by how far the casters moved as seen from
+// the light and how close the light is to the camera; every other face is
+// refreshed in turn, less often the farther the light is.
+class ShadowScheduler {
+public:
+	ShadowScheduler();
+
+	// Zero lifts a limit. The milliseconds become a face count through the measured cost per face.
+	void SetBudget(unsigned int maxFaces, float maxMilliseconds);
+
+	// Casters are recorded every frame in the same order, each one's index is its identity.
+	void BeginFrame();
+	void AddCaster(glm::vec3 const& center, float radius);
+
+	// Picks this frame's updates, lights in the same order every frame. With
+	// wholeLights a light updates all six faces or none, for the geometry shader path.
+	void Schedule(std::vector<PointLight*> const& lightList, glm::vec3 const& eye, bool wholeLights);
+
+	unsigned int GetUpdateMask(size_t light) { return lights[light].updateMask; }
+
+	// A light casts shadows once all six faces hold its current tiles.
+	bool IsReady(size_t light);
+
+	// GPU time of a frame's updates, whenever the timer query comes back.
+	void ReportCost(float milliseconds, unsigned int faces);
+
+	unsigned int GetFaceBudget() { return faceBudget; }
+	std::vector<ShadowLightStats> const& GetStats() { return stats; }
+
+private:
+	struct Caster {
+		glm::vec3 center;
+		float radius;
+	};
+
+	struct FaceState {
+		bool valid;
+		unsigned int age;
+		float dirty;
+	};
+
+	struct LightState {
+		OmniShadowTiles tiles;
+		glm::vec3 position;
+		FaceState faces[6];
+		unsigned int updateMask;
+	};
+
+	static bool SameTiles(OmniShadowTiles const& a, OmniShadowTiles const& b);
+
+	unsigned int maxFaces;
+	float maxMilliseconds;
+	float millisecondsPerFace;
+	unsigned int faceBudget;
+
+	std::vector<Caster> casters, previousCasters;
+	std::vector<LightState> lights;
+	std::vector<ShadowLightStats> stats;
+};
@@ -1,5 +1,6 @@
 #include "Skybox.hpp"
 #include <stb_image.h>
+#include <AssetPack.hpp>
 
 
 Skybox::Skybox()
@@ -22,8 +23,13 @@ Skybox::Skybox(std::vector<std::string> const& faceLocations)
 	int width, height, bitDepth;
 
 	for (size_t i = 0; i < 6; i++) {
-		unsigned char* texData = stbi_load(faceLocations[i].c_str(), &width, &height, &bitDepth, 0);
-		
+		unsigned char* texData = nullptr;
+
+		PackView file;
+		if (AssetPack::Load(faceLocations[i], file)) {
+			texData = stbi_load_from_memory(file.GetData(), (int)file.GetSize(), &width, &height, &bitDepth, 0);
+		}
+
 		if (!texData) {
 			printf("Failed to find: %s\n", faceLocations[i].c_str());
 			return;
@@ -83,9 +89,14 @@ void Skybox::DrawSkybox(glm::mat4 viewMatrix, glm::mat4 projectionMatrix)
 	viewMatrix = glm::mat4(glm::mat3(viewMatrix));
 
 	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_LEQUAL);
 
 	skyShader->UseShader();
 
+	// Looked up per draw since a hot reload replaces the program.
+	uniformProjection = skyShader->GetProjectionLocation();
+	uniformView = skyShader->GetViewLocation();
+
 	glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
 	glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(viewMatrix));
 
@@ -96,6 +107,7 @@ void Skybox::DrawSkybox(glm::mat4 viewMatrix, glm::mat4 projectionMatrix)
 
 	skyMesh->RenderMesh();
 
+	glDepthFunc(GL_LESS);
 	glDepthMask(GL_TRUE);
 }
 
@@ -16,8 +16,11 @@ public:
 
 	Skybox(std::vector<std::string> const& faceLocations);
 
+	// Drawn at the far plane after the scene, filling only the pixels left uncovered.
 	void DrawSkybox(glm::mat4 viewMatrix, glm::mat4 projectioMatrix);
 
+	Shader* GetShader() { return skyShader; }
+
 	~Skybox();
 
 private:
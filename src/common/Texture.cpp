@@ -1,11 +1,30 @@
 #include <Texture.hpp>
 
+#include <filesystem>
+
+#include <Ktx2File.hpp>
+#include <AssetPack.hpp>
+#include <TextureStreamer.hpp>
+
+GLuint Texture::placeholderTexture = 0;
+JobPool* Texture::jobPool = nullptr;
+TextureStreamer* Texture::streamer = nullptr;
+int Texture::streamingTailSize = 0;
+
 Texture::Texture()
 {
 	textureID = 0;
 	width = 0;
 	height = 0;
 	bitDepth = 0;
+	hasAlpha = false;
+	resident = false;
+	pixelData = nullptr;
+	compressedFormat = 0;
+	cookedFormat = BlockFormat::BC1;
+	cookedLevelCount = 0;
+	baseLevel = 0;
+	streamed = false;
 	fileLocation = "";
 }
 
@@ -15,6 +34,14 @@ Texture::Texture(char const* fileLocation)
 	width = 0;
 	height = 0;
 	bitDepth = 0;
+	hasAlpha = false;
+	resident = false;
+	pixelData = nullptr;
+	compressedFormat = 0;
+	cookedFormat = BlockFormat::BC1;
+	cookedLevelCount = 0;
+	baseLevel = 0;
+	streamed = false;
 	this->fileLocation = fileLocation;
 }
 
@@ -25,72 +52,368 @@ Texture::~Texture()
 
 bool Texture::LoadTexture()
 {
-	unsigned char* textData = stbi_load(fileLocation, &width, &height, &bitDepth, 0);
-	if (!textData) {
-		printf("failed to find: %s \n", fileLocation);
+	hasAlpha = false;
+
+	if (!ReadImage()) {
+		return false;
+	}
+
+	return UploadImage();
+}
+
+bool Texture::LoadTextureA()
+{
+	hasAlpha = true;
+
+	if (!ReadImage()) {
+		return false;
+	}
+
+	return UploadImage();
+}
+
+bool Texture::ReadImage(bool allowCooked)
+{
+	if (allowCooked && ReadCooked()) {
+		return true;
+	}
+
+	int w = 0, h = 0, depth = 0;
+	unsigned char* texData = nullptr;
+
+	PackView file;
+	if (AssetPack::Load(fileLocation, file)) {
+		texData = stbi_load_from_memory(file.GetData(), (int)file.GetSize(), &w, &h, &depth, hasAlpha ? 4 : 3);
+	}
+
+	if (!texData) {
+		printf("Failed to find: %s\n", fileLocation.c_str());
+		return false;
+	}
+
+	if (pixelData) {
+		stbi_image_free(pixelData);
+	}
+
+	compressedLevels.clear();
+
+	// Built here rather than by glGenerateMipmap so colour is filtered in linear space and normals stay unit length.
+	mipLevels = MipGenerator::GenerateMips(texData, w, h, hasAlpha ? 4 : 3, MipGenerator::GetDefaultOptions(fileLocation), jobPool);
+
+	pixelData = texData;
+	width = w;
+	height = h;
+	bitDepth = depth;
+
+	return true;
+}
+
+bool Texture::ReadCooked()
+{
+	std::string cookedLocation = GetCookedLocation();
+
+	if (!AssetPack::Exists(cookedLocation)) {
+		return false;
+	}
+
+	Ktx2File file;
+	if (!file.Open(cookedLocation)) {
+		return false;
+	}
+
+	// With streaming on only the small tail is read up front, the streamer brings in the rest.
+	unsigned int firstLevel = 0;
+	while (streamingTailSize > 0 && firstLevel + 1 < file.GetLevelCount() &&
+		std::max(Ktx2File::GetLevelWidth(file.GetWidth(), firstLevel), Ktx2File::GetLevelHeight(file.GetHeight(), firstLevel)) > streamingTailSize) {
+		firstLevel++;
+	}
+
+	std::vector<std::vector<unsigned char>> levels(file.GetLevelCount() - firstLevel);
+
+	for (unsigned int i = firstLevel; i < file.GetLevelCount(); i++) {
+		if (!file.ReadLevel(i, levels[i - firstLevel])) {
+			printf("Failed to read level %u of %s\n", i, cookedLocation.c_str());
+			return false;
+		}
+	}
+
+	switch (file.GetFormat()) {
+	case BlockFormat::BC1: compressedFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
+	case BlockFormat::BC3: compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+	case BlockFormat::BC5: compressedFormat = GL_COMPRESSED_RG_RGTC2; break;
+	case BlockFormat::BC7: compressedFormat = GL_COMPRESSED_RGBA_BPTC_UNORM; break;
+	}
+
+	if (pixelData) {
+		stbi_image_free(pixelData);
+		pixelData = nullptr;
+	}
+	mipLevels.clear();
+
+	compressedLevels.swap(levels);
+	cookedFormat = file.GetFormat();
+	cookedLevelCount = file.GetLevelCount();
+	baseLevel = firstLevel;
+	width = file.GetWidth();
+	height = file.GetHeight();
+	bitDepth = 0;
+
+	return true;
+}
+
+std::string Texture::GetCookedLocation()
+{
+	std::filesystem::path cookedLocation = std::filesystem::path("cooked") / fileLocation;
+	cookedLocation.replace_extension(".ktx2");
+	return cookedLocation.string();
+}
+
+size_t Texture::GetCookedLevelSize(unsigned int level)
+{
+	return BlockCompression::GetImageSize(cookedFormat, Ktx2File::GetLevelWidth(width, level), Ktx2File::GetLevelHeight(height, level));
+}
+
+void Texture::UploadLevel(unsigned int level, std::vector<unsigned char> const& data)
+{
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	glCompressedTexImage2D(GL_TEXTURE_2D, level, compressedFormat,
+		Ktx2File::GetLevelWidth(width, level), Ktx2File::GetLevelHeight(height, level), 0, (GLsizei)data.size(), data.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	baseLevel = level;
+}
+
+void Texture::EvictLevel()
+{
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// Levels below the base don't count for completeness, respecifying it as 0x0 hands the memory back.
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel + 1);
+	glCompressedTexImage2D(GL_TEXTURE_2D, baseLevel, compressedFormat, 0, 0, 0, 0, nullptr);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	baseLevel++;
+}
+
+size_t Texture::GetCompressedSize()
+{
+	size_t size = 0;
+	for (auto const& level : compressedLevels) {
+		size += level.size();
+	}
+	return size;
+}
+
+unsigned char const* Texture::GetPixels(unsigned int level)
+{
+	return level == 0 ? pixelData : mipLevels[level - 1].pixels.data();
+}
+
+int Texture::GetWidth(unsigned int level)
+{
+	return level == 0 ? width : mipLevels[level - 1].width;
+}
+
+int Texture::GetHeight(unsigned int level)
+{
+	return level == 0 ? height : mipLevels[level - 1].height;
+}
+
+bool Texture::UploadImage()
+{
+	if (IsCompressed()) {
+		UploadCompressed(compressedLevels, compressedFormat, width, height, baseLevel, cookedLevelCount);
+		compressedLevels.clear();
+		return true;
+	}
+
+	if (!pixelData) {
+		return false;
+	}
+
+	Upload(pixelData, width, height, hasAlpha, mipLevels);
+
+	stbi_image_free(pixelData);
+	pixelData = nullptr;
+	mipLevels.clear();
+
+	return true;
+}
+
+bool Texture::UploadImage(Texture const& source)
+{
+	if (!source.compressedLevels.empty()) {
+		UploadCompressed(source.compressedLevels, source.compressedFormat, source.width, source.height, source.baseLevel, source.cookedLevelCount);
+
+		compressedFormat = source.compressedFormat;
+		cookedFormat = source.cookedFormat;
+		cookedLevelCount = source.cookedLevelCount;
+		baseLevel = source.baseLevel;
+	}
+	else if (source.pixelData) {
+		Upload(source.pixelData, source.width, source.height, source.hasAlpha, source.mipLevels);
+
+		cookedLevelCount = 0;
+		baseLevel = 0;
+	}
+	else {
 		return false;
 	}
 
-	//printf("found texture: %s \n", fileLocation);
+	width = source.width;
+	height = source.height;
+	bitDepth = source.bitDepth;
+
+	return true;
+}
+
+void Texture::Upload(unsigned char const* data, int dataWidth, int dataHeight, bool dataHasAlpha, std::vector<MipGenerator::Level> const& mips)
+{
+	// Reuse the existing name on reload so anything holding the ID keeps working.
+	if (textureID == 0) {
+		glGenTextures(1, &textureID);
+	}
 
-	glGenTextures(1, &textureID);
 	glBindTexture(GL_TEXTURE_2D, textureID);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, textData);
-	glGenerateMipmap(GL_TEXTURE_2D);
+	GLenum internalFormat = hasAlpha ? GL_RGBA : GL_RGB;
+	GLenum dataFormat = dataHasAlpha ? GL_RGBA : GL_RGB;
+
+	// RGB rows of the odd sized levels aren't 4 byte aligned.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, dataWidth, dataHeight, 0, dataFormat, GL_UNSIGNED_BYTE, data);
+	for (size_t level = 0; level < mips.size(); level++) {
+		glTexImage2D(GL_TEXTURE_2D, (GLint)level + 1, internalFormat, mips[level].width, mips[level].height, 0,
+			dataFormat, GL_UNSIGNED_BYTE, mips[level].pixels.data());
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)mips.size());
 
 	glBindTexture(GL_TEXTURE_2D, 0);
 
-	stbi_image_free(textData);
+	resident = true;
+}
 
-	return true;
+void Texture::UploadCompressed(std::vector<std::vector<unsigned char>> const& levels, GLenum format, int dataWidth, int dataHeight,
+	unsigned int firstLevel, unsigned int levelCount)
+{
+	if (textureID == 0) {
+		glGenTextures(1, &textureID);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// The cooker already built the chain, glGenerateMipmap can't run on compressed storage anyway.
+	for (unsigned int i = 0; i < levels.size(); i++) {
+		unsigned int level = firstLevel + i;
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, format,
+			Ktx2File::GetLevelWidth(dataWidth, level), Ktx2File::GetLevelHeight(dataHeight, level), 0,
+			(GLsizei)levels[i].size(), levels[i].data());
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, firstLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	resident = true;
 }
 
-bool Texture::LoadTextureA()
+void Texture::BeginUpload()
 {
-	unsigned char* texData = stbi_load(fileLocation, &width, &height, &bitDepth, 0);
-	if (!texData)
-	{
-		printf("Failed to find: %s\n", fileLocation);
-		return false;
+	if (textureID == 0) {
+		glGenTextures(1, &textureID);
 	}
 
-	glGenTextures(1, &textureID);
+	resident = false;
+
 	glBindTexture(GL_TEXTURE_2D, textureID);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texData);
-	glGenerateMipmap(GL_TEXTURE_2D);
+	GLenum format = hasAlpha ? GL_RGBA : GL_RGB;
+	for (unsigned int level = 0; level < GetLevelCount(); level++) {
+		glTexImage2D(GL_TEXTURE_2D, level, format, GetWidth(level), GetHeight(level), 0, format, GL_UNSIGNED_BYTE, nullptr);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GetLevelCount() - 1);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-	stbi_image_free(texData);
+void Texture::UploadRows(GLint level, GLint firstRow, GLsizei rowCount, void const* data)
+{
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glTexSubImage2D(GL_TEXTURE_2D, level, 0, firstRow, GetWidth(level), rowCount, hasAlpha ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, data);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-	return true;
+void Texture::EndUpload()
+{
+	if (pixelData) {
+		stbi_image_free(pixelData);
+		pixelData = nullptr;
+	}
+	mipLevels.clear();
+
+	resident = true;
 }
 
 void Texture::UseTexture()
 {
 	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	glBindTexture(GL_TEXTURE_2D, resident ? textureID : placeholderTexture);
 	//printf("%d \n", textureID);
 }
 
 void Texture::ClearTexture()
 {
-	glDeleteTextures(1, &textureID);
-	textureID = 0;
+	if (streamed && streamer) {
+		streamer->Forget(this);
+		streamed = false;
+	}
+
+	// Textures that were only read (e.g. on a loader thread) own no GL name.
+	if (textureID != 0) {
+		glDeleteTextures(1, &textureID);
+		textureID = 0;
+	}
+
+	resident = false;
+
 	width = 0;
 	height = 0;
 	bitDepth = 0;
+
+	if (pixelData) {
+		stbi_image_free(pixelData);
+		pixelData = nullptr;
+	}
+
+	mipLevels.clear();
+	compressedLevels.clear();
+	cookedLevelCount = 0;
+	baseLevel = 0;
+
 	fileLocation = "";
 }
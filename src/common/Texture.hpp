@@ -1,8 +1,16 @@
 #pragma once
 
+#include <string>
+#include <vector>
 #include <GL\glew.h>
 #include <stb_image.h>
 
+#include <MipGenerator.hpp>
+#include <BlockCompression.hpp>
+
+class JobPool;
+class TextureStreamer;
+
 class Texture {
 public:
 	Texture();
@@ -13,11 +21,84 @@ public:
 	void UseTexture();
 	void ClearTexture();
 	bool LoadTextureA();
+
+	// Split load used by background loaders: ReadImage only touches the
+	// file and CPU memory, UploadImage must run on the GL thread. A cooked
+	// KTX2 next to the working directory ("cooked/textures/x.ktx2") is
+	// preferred over the loose image when allowCooked is set, loose images
+	// get their mip chain built on the CPU here.
+	bool ReadImage(bool allowCooked = true);
+	bool UploadImage();
+
+	// Uploads the pixels read by another texture into this texture's GL name.
+	bool UploadImage(Texture const& source);
+
+	// Incremental upload used by the streaming loader. Until EndUpload the
+	// texture samples as the placeholder.
+	void BeginUpload();
+	void UploadRows(GLint level, GLint firstRow, GLsizei rowCount, void const* data);
+	void EndUpload();
+
+	void SetAlpha(bool hasAlpha) { this->hasAlpha = hasAlpha; }
+	bool HasAlpha() { return hasAlpha; }
+	std::string const& GetFileLocation() { return fileLocation; }
+
+	unsigned int GetLevelCount() { return 1 + (unsigned int)mipLevels.size(); }
+	unsigned char const* GetPixels(unsigned int level = 0);
+	int GetWidth(unsigned int level = 0);
+	int GetHeight(unsigned int level = 0);
+	size_t GetRowSize(unsigned int level = 0) { return (size_t)GetWidth(level) * (hasAlpha ? 4 : 3); }
+	bool IsResident() { return resident; }
+	bool IsCompressed() { return !compressedLevels.empty(); }
+	size_t GetCompressedSize();
+
+	// Cooked textures can have their finer levels streamed in and out. Only
+	// levels from GetBaseLevel() down are resident, sampling is clamped to them.
+	bool IsStreamable() { return resident && cookedLevelCount > 0; }
+	std::string GetCookedLocation();
+	unsigned int GetBaseLevel() { return baseLevel; }
+	unsigned int GetCookedLevelCount() { return cookedLevelCount; }
+	size_t GetCookedLevelSize(unsigned int level);
+
+	// Adds the level above the current base, data as read from the cooked file.
+	void UploadLevel(unsigned int level, std::vector<unsigned char> const& data);
+	// Drops the current base level and releases its storage.
+	void EvictLevel();
+	void SetStreamed(bool streamed) { this->streamed = streamed; }
+
+	static void SetPlaceholder(GLuint placeholder) { placeholderTexture = placeholder; }
+	static void SetJobPool(JobPool* pool) { jobPool = pool; }
+
+	// Cooked reads stop at the first level no larger than this, 0 reads every level.
+	static void SetStreamer(TextureStreamer* textureStreamer, int tailSize) { streamer = textureStreamer; streamingTailSize = tailSize; }
 	
 private:
 	GLuint textureID;
 	int width, height, bitDepth;
+	bool hasAlpha;
+	bool resident;
+
+	static GLuint placeholderTexture;
+	static JobPool* jobPool;
+	static TextureStreamer* streamer;
+	static int streamingTailSize;
+
+	unsigned char* pixelData;
+	std::vector<MipGenerator::Level> mipLevels;
+
+	// Block compressed mip chain from a cooked file, starting at baseLevel.
+	std::vector<std::vector<unsigned char>> compressedLevels;
+	GLenum compressedFormat;
+	BlockFormat cookedFormat;
+	unsigned int cookedLevelCount;
+	unsigned int baseLevel;
+	bool streamed;
+
+	std::string fileLocation;
 
-	const char* fileLocation;
+	bool ReadCooked();
+	void Upload(unsigned char const* data, int dataWidth, int dataHeight, bool dataHasAlpha, std::vector<MipGenerator::Level> const& mips);
+	void UploadCompressed(std::vector<std::vector<unsigned char>> const& levels, GLenum format, int dataWidth, int dataHeight,
+		unsigned int firstLevel, unsigned int levelCount);
 
-};
\ No newline at end of file
+};
@@ -0,0 +1,125 @@
+#include "TextureCook.hpp"
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+
+#include <stb_image.h>
+
+#include <Ktx2File.hpp>
+#include <JobPool.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+	std::string ToLower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)tolower(c); });
+		return text;
+	}
+}
+
+bool TextureCook::IsImage(std::string const& path)
+{
+	static const char* extensions[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp", ".gif", ".psd" };
+
+	std::string extension = ToLower(fs::path(path).extension().string());
+	for (auto candidate : extensions) {
+		if (extension == candidate) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+char const* TextureCook::GetFormatName(BlockFormat format)
+{
+	switch (format) {
+	case BlockFormat::BC1: return "BC1";
+	case BlockFormat::BC3: return "BC3";
+	case BlockFormat::BC5: return "BC5";
+	case BlockFormat::BC7: return "BC7";
+	}
+	return "?";
+}
+
+BlockFormat TextureCook::PickFormat(std::string const& name, uint8_t const* rgba, size_t pixelCount, CookSettings const& settings)
+{
+	if (settings.format == "bc1") return BlockFormat::BC1;
+	if (settings.format == "bc3") return BlockFormat::BC3;
+	if (settings.format == "bc5") return BlockFormat::BC5;
+	if (settings.format == "bc7") return BlockFormat::BC7;
+
+	if (settings.normalMap || ToLower(name).find("normal") != std::string::npos) {
+		return BlockFormat::BC5;
+	}
+
+	for (size_t i = 0; i < pixelCount; i++) {
+		if (rgba[i * 4 + 3] != 255) {
+			return BlockFormat::BC3;
+		}
+	}
+
+	return BlockFormat::BC1;
+}
+
+MipGenerator::Options TextureCook::GetMipOptions(std::string const& name, CookSettings const& settings)
+{
+	MipGenerator::Options options = MipGenerator::GetDefaultOptions(name);
+
+	if (settings.filter == "box") {
+		options.filter = MipFilter::Box;
+	}
+	options.alphaCutoff = settings.alphaCutoff;
+
+	if (settings.normalMap) {
+		options.normalMap = true;
+		options.srgb = false;
+	}
+	if (settings.linear) {
+		options.srgb = false;
+	}
+
+	return options;
+}
+
+bool TextureCook::Cook(std::string const& source, std::string const& destination, CookSettings const& settings, JobPool& jobPool,
+	CookResult& result)
+{
+	int width, height, channels;
+	uint8_t* rgba = stbi_load(source.c_str(), &width, &height, &channels, 4);
+
+	if (!rgba) {
+		printf("Failed to load %s: %s\n", source.c_str(), stbi_failure_reason());
+		return false;
+	}
+
+	result.name = fs::path(source).filename().string();
+	result.width = width;
+	result.height = height;
+	result.format = PickFormat(result.name, rgba, (size_t)width * height, settings);
+	result.uncompressedBytes = 0;
+	result.compressedBytes = 0;
+
+	std::vector<MipGenerator::Level> chain = MipGenerator::GenerateMips(rgba, width, height, 4, GetMipOptions(result.name, settings), &jobPool);
+	chain.insert(chain.begin(), { width, height, std::vector<uint8_t>(rgba, rgba + (size_t)width * height * 4) });
+	stbi_image_free(rgba);
+
+	std::vector<std::vector<uint8_t>> levels(chain.size());
+
+	for (size_t i = 0; i < chain.size(); i++) {
+		levels[i].resize(BlockCompression::GetImageSize(result.format, chain[i].width, chain[i].height));
+		BlockCompression::CompressImage(result.format, chain[i].pixels.data(), chain[i].width, chain[i].height, levels[i].data(), &jobPool);
+
+		// Drivers pad GL_RGB8 to four bytes per texel, so RGBA8 is what the loose path really costs.
+		result.uncompressedBytes += (size_t)chain[i].width * chain[i].height * 4;
+		result.compressedBytes += levels[i].size();
+	}
+
+	std::error_code ec;
+	fs::create_directories(fs::path(destination).parent_path(), ec);
+
+	return Ktx2File::Write(destination, result.format, width, height, levels);
+}
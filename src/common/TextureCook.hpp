@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#include <BlockCompression.hpp>
+#include <MipGenerator.hpp>
+
+class JobPool;
+
+struct CookSettings {
+	std::string format;		// auto, bc1, bc3, bc5 or bc7
+	std::string filter;		// box or kaiser
+	float alphaCutoff;
+	bool normalMap;			// auto picks BC5 and renormalizes the mips, whatever the name says
+	bool linear;			// data such as a height map, filtered without the sRGB curve
+};
+
+struct CookResult {
+	std::string name;
+	int width, height;
+	BlockFormat format;
+	size_t uncompressedBytes;
+	size_t compressedBytes;
+};
+
+// Turns one loose image into a block compressed KTX2 file with its full mip chain, for
+// texture_cooker and the asset builder. Bump version whenever the same image and settings
+// would cook to different bytes, so cooked files made by the old code count as stale.
+class TextureCook {
+public:
+	static constexpr uint32_t version = 1;
+
+	static CookSettings GetDefaultSettings() { return { "auto", "kaiser", 0.f, false, false }; }
+
+	static bool IsImage(std::string const& path);
+	static char const* GetFormatName(BlockFormat format);
+	static MipGenerator::Options GetMipOptions(std::string const& name, CookSettings const& settings);
+
+	static bool Cook(std::string const& source, std::string const& destination, CookSettings const& settings, JobPool& jobPool,
+		CookResult& result);
+
+private:
+	static BlockFormat PickFormat(std::string const& name, uint8_t const* rgba, size_t pixelCount, CookSettings const& settings);
+};
@@ -0,0 +1,349 @@
+#include "TextureStreamer.hpp"
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+#include <Ktx2File.hpp>
+
+namespace {
+
+	// Textures nobody asked for in this many frames fall back to their tail.
+	const unsigned int requestTimeoutFrames = 60;
+
+}
+
+TextureStreamer::TextureStreamer()
+{
+	jobPool = nullptr;
+	nextId = 1;
+	frame = 0;
+	eye = glm::vec3(0.f);
+	projectionScale = 1.f;
+	tailSize = 128;
+	budgetBytes = 64 << 20;
+	uploadBudgetBytes = 4 << 20;
+	levelBias = 0.f;
+	maxPendingLoads = 4;
+	stats = {};
+}
+
+void TextureStreamer::Init(JobPool* jobPool, size_t budgetBytes, int tailSize)
+{
+	this->jobPool = jobPool;
+	this->budgetBytes = budgetBytes;
+	this->tailSize = tailSize;
+
+	Texture::SetStreamer(this, tailSize);
+}
+
+void TextureStreamer::Shutdown()
+{
+	for (auto& job : jobs) {
+		job.wait();
+	}
+	jobs.clear();
+	loaded.clear();
+
+	for (auto& entry : entries) {
+		entry.first->SetStreamed(false);
+	}
+	entries.clear();
+
+	Texture::SetStreamer(nullptr, 0);
+}
+
+void TextureStreamer::SetView(glm::vec3 const& eye, float fovY, float viewportHeight)
+{
+	this->eye = eye;
+
+	// Pixels covered by one world unit at distance one.
+	projectionScale = viewportHeight / (2.f * tanf(fovY * 0.5f));
+}
+
+void TextureStreamer::RequestModel(Model& model, glm::mat4 const& transform)
+{
+	float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+	float radius = model.GetBoundsRadius() * scale;
+
+	if (!(radius > 0.f) || !std::isfinite(radius)) {
+		return;
+	}
+
+	glm::vec3 center = glm::vec3(transform * glm::vec4(model.GetBoundsCenter(), 1.f));
+	float distance = std::max(glm::length(center - eye) - radius, 0.01f);
+	float pixels = std::max(2.f * radius * projectionScale / distance, 1.f);
+
+	// Assumes each texture is spread once over the whole model, which holds for the atlased assets we ship.
+	for (auto texture : model.GetTextures()) {
+		if (texture) {
+			float size = (float)std::max(texture->GetWidth(), texture->GetHeight());
+			RequestTexture(texture, log2f(size / pixels));
+		}
+	}
+}
+
+void TextureStreamer::RequestTexture(Texture* texture, float level)
+{
+	if (!texture->IsStreamable()) {
+		return;
+	}
+
+	auto it = entries.find(texture);
+
+	if (it == entries.end()) {
+		it = entries.emplace(texture, Entry{ nextId++, level, frame, false, false }).first;
+		texture->SetStreamed(true);
+		return;
+	}
+
+	Entry& entry = it->second;
+
+	if (entry.lastRequestFrame != frame) {
+		entry.desiredLevel = level;
+		entry.lastRequestFrame = frame;
+	}
+	else {
+		entry.desiredLevel = std::min(entry.desiredLevel, level);
+	}
+}
+
+void TextureStreamer::Update()
+{
+	jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](std::future<void>& job) {
+		return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}), jobs.end());
+
+	UploadLoaded();
+	EvictOverBudget();
+	StartLoads();
+
+	stats.residentBytes = 0;
+	stats.pendingLoads = 0;
+
+	for (auto& entry : entries) {
+		stats.residentBytes += GetResidentBytes(entry.first);
+		stats.pendingLoads += entry.second.loading ? 1 : 0;
+	}
+
+	stats.budgetBytes = budgetBytes;
+	stats.streamingTextures = (unsigned int)entries.size();
+
+	frame++;
+}
+
+void TextureStreamer::Forget(Texture* texture)
+{
+	entries.erase(texture);
+}
+
+size_t TextureStreamer::GetResidentBytes(Texture* texture)
+{
+	size_t size = 0;
+	for (unsigned int level = texture->GetBaseLevel(); level < texture->GetCookedLevelCount(); level++) {
+		size += texture->GetCookedLevelSize(level);
+	}
+	return size;
+}
+
+unsigned int TextureStreamer::GetTailLevel(Texture* texture)
+{
+	unsigned int level = 0;
+	while (level + 1 < texture->GetCookedLevelCount() &&
+		std::max(Ktx2File::GetLevelWidth(texture->GetWidth(), level), Ktx2File::GetLevelHeight(texture->GetHeight(), level)) > tailSize) {
+		level++;
+	}
+	return level;
+}
+
+unsigned int TextureStreamer::GetTargetLevel(Texture* texture, Entry const& entry)
+{
+	unsigned int tail = GetTailLevel(texture);
+
+	if (frame - entry.lastRequestFrame > requestTimeoutFrames) {
+		return tail;
+	}
+
+	float level = floorf(entry.desiredLevel + levelBias);
+	return level <= 0.f ? 0 : std::min((unsigned int)level, tail);
+}
+
+Texture* TextureStreamer::PickEviction(bool onlyUnneeded, Texture* exclude)
+{
+	Texture* best = nullptr;
+	float bestScore = 0.f;
+
+	for (auto& item : entries) {
+		Texture* texture = item.first;
+		Entry const& entry = item.second;
+
+		if (texture == exclude || entry.loading || texture->GetBaseLevel() >= GetTailLevel(texture)) {
+			continue;
+		}
+
+		// Levels finer than needed go first, then whatever was requested longest ago.
+		float excess = (float)GetTargetLevel(texture, entry) - (float)texture->GetBaseLevel();
+		if (onlyUnneeded && excess <= 0.f) {
+			continue;
+		}
+
+		float score = excess * 1000.f + (float)std::min(frame - entry.lastRequestFrame, 999u);
+
+		if (!best || score > bestScore) {
+			best = texture;
+			bestScore = score;
+		}
+	}
+
+	return best;
+}
+
+void TextureStreamer::UploadLoaded()
+{
+	std::vector<LoadedLevel> ready;
+	{
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		ready.swap(loaded);
+	}
+
+	size_t uploaded = 0;
+	size_t i = 0;
+
+	for (; i < ready.size(); i++) {
+		LoadedLevel& level = ready[i];
+
+		if (uploaded > 0 && uploaded + level.data.size() > uploadBudgetBytes) {
+			break;
+		}
+
+		auto it = entries.find(level.texture);
+		if (it == entries.end() || it->second.id != level.id) {
+			continue;
+		}
+
+		Entry& entry = it->second;
+		entry.loading = false;
+
+		if (level.data.empty()) {
+			entry.failed = true;
+			continue;
+		}
+
+		// A reload may have replaced the texture's levels while this one was read.
+		if (level.texture->GetBaseLevel() != level.level + 1) {
+			continue;
+		}
+
+		level.texture->UploadLevel(level.level, level.data);
+		uploaded += level.data.size();
+		stats.levelsLoaded++;
+	}
+
+	// Whatever didn't fit in this frame's upload budget waits for the next one.
+	if (i < ready.size()) {
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		loaded.insert(loaded.begin(), std::make_move_iterator(ready.begin() + i), std::make_move_iterator(ready.end()));
+	}
+}
+
+void TextureStreamer::EvictOverBudget()
+{
+	size_t total = 0;
+	for (auto& entry : entries) {
+		total += GetResidentBytes(entry.first);
+	}
+
+	while (total > budgetBytes) {
+		Texture* texture = PickEviction(false, nullptr);
+		if (!texture) {
+			break;
+		}
+
+		total -= texture->GetCookedLevelSize(texture->GetBaseLevel());
+		texture->EvictLevel();
+		stats.levelsEvicted++;
+	}
+}
+
+void TextureStreamer::StartLoads()
+{
+	size_t total = 0;
+	unsigned int pending = 0;
+
+	std::vector<std::pair<Texture*, Entry*>> candidates;
+
+	for (auto& item : entries) {
+		Texture* texture = item.first;
+		Entry& entry = item.second;
+
+		total += GetResidentBytes(texture);
+
+		if (entry.loading) {
+			total += texture->GetCookedLevelSize(texture->GetBaseLevel() - 1);
+			pending++;
+		}
+		else if (!entry.failed && texture->GetBaseLevel() > GetTargetLevel(texture, entry)) {
+			candidates.push_back({ texture, &entry });
+		}
+	}
+
+	// Biggest shortfall first, ties go to whatever is closest to the camera.
+	std::sort(candidates.begin(), candidates.end(), [this](auto const& a, auto const& b) {
+		int deficitA = (int)a.first->GetBaseLevel() - (int)GetTargetLevel(a.first, *a.second);
+		int deficitB = (int)b.first->GetBaseLevel() - (int)GetTargetLevel(b.first, *b.second);
+		return deficitA != deficitB ? deficitA > deficitB : a.second->desiredLevel < b.second->desiredLevel;
+	});
+
+	for (auto& candidate : candidates) {
+		if (pending >= maxPendingLoads) {
+			break;
+		}
+
+		Texture* texture = candidate.first;
+		Entry& entry = *candidate.second;
+
+		unsigned int level = texture->GetBaseLevel() - 1;
+		size_t size = texture->GetCookedLevelSize(level);
+
+		// Make room from levels nobody needs any more, never from what is on screen.
+		while (total + size > budgetBytes) {
+			Texture* victim = PickEviction(true, texture);
+			if (!victim) {
+				break;
+			}
+
+			total -= victim->GetCookedLevelSize(victim->GetBaseLevel());
+			victim->EvictLevel();
+			stats.levelsEvicted++;
+		}
+
+		if (total + size > budgetBytes) {
+			continue;
+		}
+
+		total += size;
+		pending++;
+		entry.loading = true;
+
+		std::string location = texture->GetCookedLocation();
+		unsigned int id = entry.id;
+
+		jobs.push_back(jobPool->Submit([this, texture, id, level, location]() {
+			LoadedLevel result = { texture, id, level, {} };
+
+			Ktx2File file;
+			if (!file.Open(location) || !file.ReadLevel(level, result.data)) {
+				printf("Failed to stream level %u of %s\n", level, location.c_str());
+				result.data.clear();
+			}
+
+			std::lock_guard<std::mutex> lock(loadedMutex);
+			loaded.push_back(std::move(result));
+		}));
+	}
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	Shutdown();
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <future>
+
+#include <glm\glm.hpp>
+
+#include <JobPool.hpp>
+#include <Texture.hpp>
+#include <Model.hpp>
+
+// Keeps the finer mip levels of cooked textures resident only while something
+// on screen needs them. Every frame each texture gets a desired level from the
+// screen size of the models using it; missing levels are read from the cooked
+// file on the job pool and added one at a time, and levels are evicted whenever
+// the resident total goes over the VRAM budget. Sampling is clamped with
+// GL_TEXTURE_BASE_LEVEL so a texture is always complete at its coarsest levels.
+class TextureStreamer {
+public:
+	struct Stats {
+		size_t residentBytes;
+		size_t budgetBytes;
+		unsigned int streamingTextures;
+		unsigned int pendingLoads;
+		unsigned int levelsLoaded;
+		unsigned int levelsEvicted;
+	};
+
+	TextureStreamer();
+
+	// Textures read after Init only load levels up to tailSize texels, the rest streams.
+	void Init(JobPool* jobPool, size_t budgetBytes, int tailSize = 128);
+	void Shutdown();
+
+	void SetBudget(size_t bytes) { budgetBytes = bytes; }
+	void SetUploadBudget(size_t bytes) { uploadBudgetBytes = bytes; }
+	void SetLevelBias(float bias) { levelBias = bias; }
+
+	// Camera the screen sizes are measured from, set once per frame before the requests.
+	void SetView(glm::vec3 const& eye, float fovY, float viewportHeight);
+
+	// Requests the level each texture of the model needs at the model's current screen size.
+	void RequestModel(Model& model, glm::mat4 const& transform);
+	void RequestTexture(Texture* texture, float level);
+
+	// Uploads finished reads, evicts down to the budget and starts new reads. Main thread only.
+	void Update();
+
+	// Called by Texture when it is cleared so no stale pointer is kept.
+	void Forget(Texture* texture);
+
+	Stats const& GetStats() { return stats; }
+
+	~TextureStreamer();
+
+private:
+	struct Entry {
+		unsigned int id;
+		float desiredLevel;
+		unsigned int lastRequestFrame;
+		bool loading;
+		bool failed;
+	};
+
+	struct LoadedLevel {
+		Texture* texture;
+		unsigned int id;
+		unsigned int level;
+		std::vector<unsigned char> data;
+	};
+
+	JobPool* jobPool;
+	std::vector<std::future<void>> jobs;
+
+	std::unordered_map<Texture*, Entry> entries;
+	unsigned int nextId;
+	unsigned int frame;
+
+	std::mutex loadedMutex;
+	std::vector<LoadedLevel> loaded;
+
+	glm::vec3 eye;
+	float projectionScale;
+
+	int tailSize;
+	size_t budgetBytes;
+	size_t uploadBudgetBytes;
+	float levelBias;
+	unsigned int maxPendingLoads;
+
+	Stats stats;
+
+	size_t GetResidentBytes(Texture* texture);
+	unsigned int GetTailLevel(Texture* texture);
+	unsigned int GetTargetLevel(Texture* texture, Entry const& entry);
+
+	// Picks the texture whose base level is worth least, onlyUnneeded limits it to levels finer than requested.
+	Texture* PickEviction(bool onlyUnneeded, Texture* exclude);
+
+	void UploadLoaded();
+	void EvictOverBudget();
+	void StartLoads();
+};
@@ -0,0 +1,399 @@
+#include "VertexPacker.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <float.h>
+#include <algorithm>
+
+namespace {
+
+	const unsigned int sourceStride = 8;
+
+	inline int16_t ToSnorm16(float value)
+	{
+		return (int16_t)roundf(std::min(std::max(value, -1.f), 1.f) * 32767.f);
+	}
+
+	inline uint16_t ToUnorm16(float value)
+	{
+		return (uint16_t)roundf(std::min(std::max(value, 0.f), 1.f) * 65535.f);
+	}
+
+	inline float SignNotZero(float value)
+	{
+		return value >= 0.f ? 1.f : -1.f;
+	}
+
+}
+
+GLsizei VertexFormat::GetStride() const
+{
+	return GetNormalOffset() + (normal == NormalFormat::Float3 ? 12 : 4);
+}
+
+GLsizei VertexFormat::GetPositionStride() const
+{
+	return position == PositionFormat::Float3 ? 12 : 8;
+}
+
+GLsizei VertexFormat::GetTexCoordOffset() const
+{
+	return GetPositionStride();
+}
+
+GLsizei VertexFormat::GetNormalOffset() const
+{
+	return GetTexCoordOffset() + (texCoord == TexCoordFormat::Float2 ? 8 : 4);
+}
+
+VertexFormat VertexPacker::GetFullFormat()
+{
+	return { PositionFormat::Float3, TexCoordFormat::Float2, NormalFormat::Float3, false };
+}
+
+VertexFormat VertexPacker::ChooseFormat(GLfloat const* vertices, unsigned int vertexCount, float positionTolerance, float texCoordTolerance)
+{
+	VertexFormat format = { PositionFormat::Float3, TexCoordFormat::Float2, NormalFormat::Octahedral16, vertexCount <= 65536 };
+
+	glm::vec3 minimum, maximum;
+	GetBounds(vertices, vertexCount, minimum, maximum);
+
+	glm::vec3 extent = maximum - minimum;
+	glm::vec3 center = (minimum + maximum) * 0.5f;
+
+	float unormError = 0.f, halfError = 0.f, texCoordError = 0.f;
+
+	for (unsigned int i = 0; i < vertexCount; i++) {
+		GLfloat const* vertex = vertices + i * sourceStride;
+
+		for (int c = 0; c < 3; c++) {
+			float range = extent[c] > 0.f ? extent[c] : 1.f;
+			float unorm = ToUnorm16((vertex[c] - minimum[c]) / range) / 65535.f * range + minimum[c];
+			float half = HalfToFloat(FloatToHalf(vertex[c] - center[c])) + center[c];
+
+			unormError = std::max(unormError, fabsf(unorm - vertex[c]));
+			halfError = std::max(halfError, fabsf(half - vertex[c]));
+		}
+
+		for (int c = 3; c < 5; c++) {
+			texCoordError = std::max(texCoordError, fabsf(HalfToFloat(FloatToHalf(vertex[c])) - vertex[c]));
+		}
+	}
+
+	float tolerance = positionTolerance * glm::length(extent);
+
+	if (std::min(unormError, halfError) <= tolerance) {
+		format.position = unormError <= halfError ? PositionFormat::Unorm16x4 : PositionFormat::Half4;
+	}
+
+	if (texCoordError <= texCoordTolerance) {
+		format.texCoord = TexCoordFormat::Half2;
+	}
+
+	return format;
+}
+
+PackedMesh VertexPacker::Pack(GLfloat const* vertices, unsigned int vertexCount, unsigned int const* indices, unsigned int indexCount,
+	VertexFormat const& format)
+{
+	PackedMesh packed;
+	packed.format = format;
+	packed.vertexCount = vertexCount;
+	packed.indexCount = indexCount;
+	packed.lods = { { 0, indexCount, 0.f, 0, 0 } };
+
+	glm::vec3 minimum, maximum;
+	GetBounds(vertices, vertexCount, minimum, maximum);
+
+	packed.boundsMin = minimum;
+	packed.boundsMax = maximum;
+
+	switch (format.position) {
+	case PositionFormat::Float3:
+		packed.positionScale = glm::vec3(1.f);
+		packed.positionOffset = glm::vec3(0.f);
+		break;
+	case PositionFormat::Half4:
+		packed.positionScale = glm::vec3(1.f);
+		packed.positionOffset = (minimum + maximum) * 0.5f;
+		break;
+	case PositionFormat::Unorm16x4:
+		packed.positionScale = glm::max(maximum - minimum, glm::vec3(FLT_MIN));
+		packed.positionOffset = minimum;
+		break;
+	}
+
+	GLsizei stride = format.GetStride();
+	packed.vertices.resize((size_t)vertexCount * stride);
+
+	for (unsigned int i = 0; i < vertexCount; i++) {
+		GLfloat const* source = vertices + i * sourceStride;
+		uint8_t* vertex = packed.vertices.data() + (size_t)i * stride;
+
+		if (format.position == PositionFormat::Float3) {
+			memcpy(vertex, source, 12);
+		}
+		else {
+			uint16_t position[4] = {};
+			for (int c = 0; c < 3; c++) {
+				float value = (source[c] - packed.positionOffset[c]) / packed.positionScale[c];
+				position[c] = format.position == PositionFormat::Half4 ? FloatToHalf(value) : ToUnorm16(value);
+			}
+			memcpy(vertex, position, 8);
+		}
+
+		uint8_t* texCoord = vertex + format.GetTexCoordOffset();
+		if (format.texCoord == TexCoordFormat::Float2) {
+			memcpy(texCoord, source + 3, 8);
+		}
+		else {
+			uint16_t half[2] = { FloatToHalf(source[3]), FloatToHalf(source[4]) };
+			memcpy(texCoord, half, 4);
+		}
+
+		uint8_t* normal = vertex + format.GetNormalOffset();
+		if (format.normal == NormalFormat::Float3) {
+			memcpy(normal, source + 5, 12);
+		}
+		else {
+			int16_t encoded[2];
+			EncodeOctahedral(glm::vec3(source[5], source[6], source[7]), encoded);
+			memcpy(normal, encoded, 4);
+		}
+	}
+
+	WriteIndices(packed.indices, indices, indexCount, format.shortIndices);
+
+	// Depth stream: vertices split only by texture coordinates or normals share
+	// one position, copied from the packed vertices so both streams rasterize
+	// to the same depth.
+	std::vector<unsigned int> weld = MeshOptimizer::WeldPositions(vertices, vertexCount, sourceStride);
+	std::vector<unsigned int> remap(vertexCount, ~0u);
+	std::vector<unsigned int> depthIndices(indexCount);
+
+	GLsizei positionStride = format.GetPositionStride();
+	packed.depthVertexCount = 0;
+
+	for (unsigned int i = 0; i < indexCount; i++) {
+		unsigned int welded = weld[indices[i]];
+
+		if (remap[welded] == ~0u) {
+			remap[welded] = packed.depthVertexCount++;
+			uint8_t const* vertex = packed.vertices.data() + (size_t)welded * stride;
+			packed.depthVertices.insert(packed.depthVertices.end(), vertex, vertex + positionStride);
+		}
+
+		depthIndices[i] = remap[welded];
+	}
+
+	packed.shortDepthIndices = packed.depthVertexCount <= 65536;
+	WriteIndices(packed.depthIndices, depthIndices.data(), indexCount, packed.shortDepthIndices);
+
+	return packed;
+}
+
+QuantizationError VertexPacker::MeasureError(PackedMesh const& packed, GLfloat const* vertices)
+{
+	QuantizationError error = { 0.f, 0.f, 0.f };
+	GLsizei stride = packed.format.GetStride();
+
+	for (unsigned int i = 0; i < packed.vertexCount; i++) {
+		GLfloat const* source = vertices + i * sourceStride;
+		uint8_t const* vertex = packed.vertices.data() + (size_t)i * stride;
+
+		glm::vec3 position = UnpackPosition(packed, vertex);
+		error.position = std::max(error.position, glm::length(position - glm::vec3(source[0], source[1], source[2])));
+
+		uint8_t const* texCoord = vertex + packed.format.GetTexCoordOffset();
+		for (int c = 0; c < 2; c++) {
+			float value;
+			if (packed.format.texCoord == TexCoordFormat::Float2) {
+				memcpy(&value, texCoord + c * 4, 4);
+			}
+			else {
+				uint16_t half;
+				memcpy(&half, texCoord + c * 2, 2);
+				value = HalfToFloat(half);
+			}
+			error.texCoord = std::max(error.texCoord, fabsf(value - source[3 + c]));
+		}
+
+		glm::vec3 original(source[5], source[6], source[7]);
+		if (packed.format.normal == NormalFormat::Octahedral16 && glm::length(original) > 0.f) {
+			int16_t encoded[2];
+			memcpy(encoded, vertex + packed.format.GetNormalOffset(), 4);
+
+			float cosine = glm::dot(DecodeOctahedral(encoded), glm::normalize(original));
+			error.normalDegrees = std::max(error.normalDegrees, glm::degrees(acosf(std::min(std::max(cosine, -1.f), 1.f))));
+		}
+	}
+
+	return error;
+}
+
+uint16_t VertexPacker::FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (((bits >> 23) & 0xFF) == 0xFF) {
+		return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	}
+
+	if (exponent >= 31) {
+		return (uint16_t)(sign | 0x7C00);
+	}
+
+	if (exponent <= 0) {
+		// Denormal or zero, round to nearest even on the shifted mantissa.
+		if (exponent < -10) {
+			return (uint16_t)sign;
+		}
+
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t midpoint = 1u << (shift - 1);
+
+		if (remainder > midpoint || (remainder == midpoint && (half & 1))) {
+			half++;
+		}
+		return (uint16_t)(sign | half);
+	}
+
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1FFF;
+
+	// Carrying into the exponent is the correct rounding, up to infinity.
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+		half++;
+	}
+
+	return (uint16_t)(sign | half);
+}
+
+float VertexPacker::HalfToFloat(uint16_t value)
+{
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+	uint32_t bits;
+
+	if (exponent == 0) {
+		if (mantissa == 0) {
+			bits = sign;
+		}
+		else {
+			// Renormalize the denormal.
+			exponent = 127 - 15 + 1;
+			while (!(mantissa & 0x400)) {
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+		}
+	}
+	else if (exponent == 31) {
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else {
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, 4);
+	return result;
+}
+
+void VertexPacker::GetBounds(GLfloat const* vertices, unsigned int vertexCount, glm::vec3& minimum, glm::vec3& maximum)
+{
+	minimum = glm::vec3(FLT_MAX);
+	maximum = glm::vec3(-FLT_MAX);
+
+	for (unsigned int i = 0; i < vertexCount; i++) {
+		glm::vec3 position(vertices[i * sourceStride], vertices[i * sourceStride + 1], vertices[i * sourceStride + 2]);
+		minimum = glm::min(minimum, position);
+		maximum = glm::max(maximum, position);
+	}
+
+	if (vertexCount == 0) {
+		minimum = maximum = glm::vec3(0.f);
+	}
+}
+
+void VertexPacker::EncodeOctahedral(glm::vec3 normal, int16_t* encoded)
+{
+	float sum = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	if (sum <= 0.f) {
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+
+	float x = normal.x / sum;
+	float y = normal.y / sum;
+
+	// Fold the lower hemisphere over the diagonals.
+	if (normal.z < 0.f) {
+		float foldedX = (1.f - fabsf(y)) * SignNotZero(x);
+		float foldedY = (1.f - fabsf(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = ToSnorm16(x);
+	encoded[1] = ToSnorm16(y);
+}
+
+glm::vec3 VertexPacker::DecodeOctahedral(int16_t const* encoded)
+{
+	// Same as OctDecode in the vertex shaders.
+	glm::vec3 normal(std::max(encoded[0] / 32767.f, -1.f), std::max(encoded[1] / 32767.f, -1.f), 0.f);
+	normal.z = 1.f - fabsf(normal.x) - fabsf(normal.y);
+
+	float t = std::max(-normal.z, 0.f);
+	normal.x += normal.x >= 0.f ? -t : t;
+	normal.y += normal.y >= 0.f ? -t : t;
+
+	return glm::normalize(normal);
+}
+
+glm::vec3 VertexPacker::UnpackPosition(PackedMesh const& packed, uint8_t const* vertex)
+{
+	glm::vec3 position;
+
+	if (packed.format.position == PositionFormat::Float3) {
+		memcpy(&position, vertex, 12);
+		return position;
+	}
+
+	uint16_t stored[4];
+	memcpy(stored, vertex, 8);
+
+	for (int c = 0; c < 3; c++) {
+		position[c] = packed.format.position == PositionFormat::Half4 ? HalfToFloat(stored[c]) : stored[c] / 65535.f;
+	}
+
+	return position * packed.positionScale + packed.positionOffset;
+}
+
+void VertexPacker::WriteIndices(std::vector<uint8_t>& destination, unsigned int const* indices, unsigned int indexCount, bool shortIndices)
+{
+	if (shortIndices) {
+		destination.resize((size_t)indexCount * sizeof(uint16_t));
+		uint16_t* shortDestination = (uint16_t*)destination.data();
+
+		for (unsigned int i = 0; i < indexCount; i++) {
+			shortDestination[i] = (uint16_t)indices[i];
+		}
+	}
+	else {
+		destination.resize((size_t)indexCount * sizeof(uint32_t));
+		memcpy(destination.data(), indices, destination.size());
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+enum class PositionFormat {
+	Float3,		// 12 bytes
+	Half4,		// 8 bytes, relative to the mesh centre
+	Unorm16x4	// 8 bytes, normalized over the mesh bounds
+};
+
+enum class TexCoordFormat {
+	Float2,		// 8 bytes
+	Half2		// 4 bytes
+};
+
+enum class NormalFormat {
+	Float3,			// 12 bytes
+	Octahedral16	// 4 bytes, two snorm16 on the octahedron
+};
+
+// Layout of one interleaved vertex: position, texture coordinate, normal.
+struct VertexFormat {
+	PositionFormat position;
+	TexCoordFormat texCoord;
+	NormalFormat normal;
+	bool shortIndices;
+
+	GLsizei GetStride() const;
+	GLsizei GetPositionStride() const;
+	GLsizei GetTexCoordOffset() const;
+	GLsizei GetNormalOffset() const;
+};
+
+// A few dozen neighbouring triangles, drawn or culled together. The bounding
+// sphere and normal cone are in model space; coneCutoff is 1 when the
+// triangles face too many ways for the cluster to ever be back-facing.
+struct MeshCluster {
+	glm::vec3 center;
+	float radius;
+	glm::vec3 coneAxis;
+	float coneCutoff;
+	unsigned int indexOffset;
+	unsigned int indexCount;
+};
+
+// One level of detail: a range of the index buffer split into a range of
+// clusters, and how far its surface strays from the full detail mesh in model units.
+struct MeshLod {
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	float error;
+	unsigned int clusterOffset;
+	unsigned int clusterCount;
+};
+
+// Vertex and index data in a given format, ready for Mesh::CreateMesh. The
+// shaders rebuild positions as stored * positionScale + positionOffset.
+struct PackedMesh {
+	VertexFormat format;
+
+	std::vector<uint8_t> vertices;
+	std::vector<uint8_t> indices;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+
+	// Positions alone for depth passes, each distinct one stored once in the
+	// same encoding as vertices. Triangles keep their order, so lods and
+	// clusters index both buffers alike.
+	std::vector<uint8_t> depthVertices;
+	std::vector<uint8_t> depthIndices;
+	unsigned int depthVertexCount;
+	bool shortDepthIndices;
+
+	// Finest first, Pack fills in a single level covering all indices.
+	std::vector<MeshLod> lods;
+	std::vector<MeshCluster> clusters;
+
+	glm::vec3 positionScale;
+	glm::vec3 positionOffset;
+
+	// Source positions, before quantization.
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+};
+
+// Largest difference between packed and source data.
+struct QuantizationError {
+	float position;			// world units
+	float texCoord;
+	float normalDegrees;
+};
+
+// Quantizes the 8 float vertices (x, y, z, u, v, nx, ny, nz) used throughout
+// the renderer into the compact formats.
+class VertexPacker {
+public:
+	static VertexFormat GetFullFormat();
+
+	// Smallest format whose error stays under the tolerances. Positions are
+	// measured relative to the mesh extent, texture coordinates absolutely.
+	static VertexFormat ChooseFormat(GLfloat const* vertices, unsigned int vertexCount, float positionTolerance, float texCoordTolerance);
+
+	static PackedMesh Pack(GLfloat const* vertices, unsigned int vertexCount, unsigned int const* indices, unsigned int indexCount,
+		VertexFormat const& format);
+
+	static QuantizationError MeasureError(PackedMesh const& packed, GLfloat const* vertices);
+
+	static uint16_t FloatToHalf(float value);
+	static float HalfToFloat(uint16_t value);
+
+private:
+	static void GetBounds(GLfloat const* vertices, unsigned int vertexCount, glm::vec3& minimum, glm::vec3& maximum);
+	static void EncodeOctahedral(glm::vec3 normal, int16_t* encoded);
+	static glm::vec3 DecodeOctahedral(int16_t const* encoded);
+	static glm::vec3 UnpackPosition(PackedMesh const& packed, uint8_t const* vertex);
+	static void WriteIndices(std::vector<uint8_t>& destination, unsigned int const* indices, unsigned int indexCount, bool shortIndices);
+};
@@ -11,6 +11,7 @@ Window::Window()
 
 	xChange = 0.f;
 	yChange = 0.f;
+	hidden = false;
 }
 
 Window::Window(GLint windowWidth, GLint windowHeight)
@@ -24,6 +25,7 @@ Window::Window(GLint windowWidth, GLint windowHeight)
 
 	xChange = 0.f;
 	yChange = 0.f;
+	hidden = false;
 }
 
 int Window::Initialize()
@@ -37,16 +39,26 @@ int Window::Initialize()
 	}
 
 	// Setup GLFW window properties
-	// OpenGL version
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	// Core Profile
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	// Allow Forward Compatbility
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_VISIBLE, hidden ? GLFW_FALSE : GLFW_TRUE);
+
+	// OpenGL version, 4.3 for the GPU culling path where the driver has it, 3.3 otherwise
+	const int versions[][2] = { { 4, 3 }, { 3, 3 } };
 
 	// Create the window
-	mainWindow = glfwCreateWindow(width, height, "Test Window", NULL, NULL);
+	for (auto const& version : versions) {
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+
+		mainWindow = glfwCreateWindow(width, height, "Test Window", NULL, NULL);
+		if (mainWindow) {
+			break;
+		}
+	}
+
 	if (!mainWindow)
 	{
 		printf("GLFW window creation failed!");
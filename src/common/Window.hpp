@@ -10,12 +10,16 @@ public:
 	Window();
 	Window(GLint windowWidth, GLint windowHeight);
 
+	// A hidden window still gets a context, for benchmarks without a display. Set before Initialize.
+	void setHidden(bool hidden) { this->hidden = hidden; }
+
 	int Initialize();
 
 	GLint getBufferWidth() { return bufferWidth; }
 	GLint getBufferHeight() { return bufferHeight;  }
 
 	bool getShouldClose() { return glfwWindowShouldClose(mainWindow); };
+	void setShouldClose(bool shouldClose) { glfwSetWindowShouldClose(mainWindow, shouldClose ? GLFW_TRUE : GLFW_FALSE); }
 
 	bool* getKeys() { return keys; }
 	GLfloat getXChange();
@@ -23,6 +27,8 @@ public:
 
 
 	void swapBuffers() { glfwSwapBuffers(mainWindow); }
+
+	void setTitle(const char* title) { glfwSetWindowTitle(mainWindow, title); }
 	
 	~Window();
 
@@ -34,6 +40,7 @@ private:
 
 	GLfloat lastX, lastY, xChange, yChange;
 	bool mouseFirstMoved;
+	bool hidden;
 
 	void createCallbacks();
 	static void handleKeys(GLFWwindow* window, int key, int code, int action, int mode);
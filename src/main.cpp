@@ -1,11 +1,14 @@
 #define STB_IMAGE_IMPLEMENTATION
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <cmath>
 #include <GL\glew.h>
 #include <GLFW\glfw3.h>
 #include <vector>
+#include <algorithm>
+#include <chrono>
 #include <glm\glm.hpp>
 #include <glm\gtc\matrix_transform.hpp>
 #include <glm\gtc\type_ptr.hpp>
@@ -22,12 +25,42 @@
 #include <Constants.hpp>
 #include <Model.hpp>
 #include <Skybox.hpp>
+#include <AssetReloader.hpp>
+#include <AssetLoader.hpp>
+#include <JobPool.hpp>
+#include <TextureStreamer.hpp>
+#include <ShadowAtlas.hpp>
+#include <ShadowScheduler.hpp>
+#include <MomentShadowMap.hpp>
+#include <OcclusionCuller.hpp>
+#include <GpuScene.hpp>
+#include <FillLights.hpp>
+#include <DeferredRenderer.hpp>
+#include <FrameGraph.hpp>
+#include <ResolutionScaler.hpp>
+#include <Scene.hpp>
+#include <LevelFile.hpp>
+#include <AssetPack.hpp>
 
 std::vector<Mesh*> meshList;
 
 std::vector<Shader> shaderList;
 Shader directionalShadowShader;
 Shader omniShadowShader;
+Shader omniShadowInstancedShader;
+Shader omniShadowFaceShader;
+Shader shadowMomentShader;
+Shader depthPrepassShader;
+Shader overdrawShader;
+Shader gpuColorShader;
+Shader gpuOverdrawShader;
+Shader gpuDepthPrepassShader;
+Shader gpuDirectionalShadowShader;
+Shader gBufferShader;
+Shader gpuGBufferShader;
+Shader deferredLightShader;
+Shader deferredVolumeShader;
+Shader upscaleShader;
 
 Skybox skyBox;
 
@@ -36,7 +69,21 @@ Camera camera;
 
 Material glossyMaterial, matteMaterial;
 
-Model mech, bugatti, xwingPlayer, xwing;
+// The scene's models, materials, entities, lights and skybox come from a compiled level, --level picks
+// another. Models and materials are made once per record, entities point at them by index.
+const char* levelPath = "levels/default.lvl";
+LevelFile level;
+std::vector<Model> levelModels;
+std::vector<Material> levelMaterials;
+std::vector<Entity> levelEntities;
+
+// Shaders, textures and models are read from the pack the build writes next to the executable when
+// there is one, --pack picks another and --loose reads the loose files. Startup reports the files
+// opened until every asset has loaded.
+const char* packPath = "assets.pack";
+bool looseAssets = false;
+AssetPack assetPack;
+std::chrono::steady_clock::time_point startupStart;
 
 Texture brickTexture;
 Texture dirtTexture;
@@ -46,6 +93,12 @@ DirectionalLight mainLight;
 PointLight pointLights[N_POINT_LIGHTS];
 SpotLight spotLights[N_SPOT_LIGHTS];
 
+JobPool jobPool;
+AssetLoader assetLoader;
+AssetReloader assetReloader;
+AssetCooker assetCooker;
+TextureStreamer textureStreamer;
+
 GLfloat deltaTime = 0.f;
 GLfloat lastTime = 0.f;
 
@@ -67,6 +120,166 @@ static const char* fShader = "shaders/fragment.glsl";
 unsigned int pointLightCount = 0;
 unsigned int spotLightCount = 0;
 
+// LODs are picked from the main camera, the shadow passes draw lodBias levels coarser than that.
+static const float lodPixelError = 1.0f;
+static const unsigned int shadowLodBias = 1;
+
+bool lodEnabled = true;
+float lodProjectionScale = 1.f;
+unsigned int lodBias = 0;
+
+// Clusters are culled in the main view only, the omni shadow passes draw all six faces in one go.
+bool clusterCulling = true;
+bool cullClusters = false;
+glm::mat4 cullViewProjection(1.f);
+
+// Shadow passes only write depth and draw from the position only streams.
+bool depthOnly = false;
+
+// Omni shadows either amplify every triangle to all six cube faces in a geometry shader, or cull
+// casters per face on the CPU and draw each one instanced over the faces it touches, the face picked
+// in the vertex shader, or draw the culled casters one face at a time.
+enum class OmniShadowPath { Geometry, Instanced, PerFace };
+
+OmniShadowPath omniShadowPath = OmniShadowPath::Instanced;
+
+// All omni lights share one atlas, tiles go to the lights that matter most on screen.
+static const unsigned int shadowAtlasSize = 4096;
+static const unsigned int minShadowFaceSize = 64;
+
+ShadowAtlas shadowAtlas;
+
+// EVSM reads one prefiltered texel per light where PCF takes up to 20 depth samples, F cycles through
+// PCF and the EVSM tiers. The omni moments are kept at half the atlas resolution.
+ShadowFilter shadowFilter = ShadowFilter::EvsmMedium;
+static const unsigned int omniMomentDownsample = 2;
+
+MomentShadowMap directionalMoments, omniMoments;
+
+// Set when the moment maps were recreated and every omni face needs filtering again.
+bool omniMomentsStale = true;
+
+// Omni shadow faces are redrawn within a budget per frame, --shadow-faces and --shadow-ms change it.
+unsigned int shadowFaceBudget = 12;
+float shadowBudgetMs = 2.f;
+
+ShadowScheduler shadowScheduler;
+
+// The directional pass draws every caster once and records them for the scheduler.
+bool gatherCasters = false;
+
+// Light, faces due for an update and face being drawn by the culled paths, omniLight is null otherwise.
+PointLight* omniLight = nullptr;
+unsigned int omniUpdateMask = 0;
+unsigned int omniFace = 0;
+
+// --shadow-benchmark draws the mech grid and times the omni shadow passes, switching path after every step.
+bool shadowBenchmark = false;
+
+// Models hidden behind others in the main view are skipped, tested against occluders rasterized on the
+// CPU while the GPU draws the omni shadows. The directional pass, which draws every caster, collects
+// the occluders. U toggles it.
+OcclusionCuller occlusionCuller;
+bool occlusionCulling = true;
+bool occlusionTest = false;
+// The color pass repeats the depth prepass's tests, only the first pass to test counts them in the stats.
+bool occlusionCounted = false;
+
+// With GL 4.3 the mech grid is culled and drawn on the GPU: a compute pass tests every instance against
+// the view and the last frame's depth pyramid, picks its LOD and fills the draw commands, one multi-draw
+// per mesh. The omni shadow passes still draw the grid from the CPU, culled per face. G toggles it.
+static const unsigned int gpuMainView = 0;
+static const unsigned int gpuShadowView = 1;
+
+GpuScene gpuScene;
+bool gpuCullingSupported = false;
+bool gpuCulling = false;
+
+// Set by the passes that leave the grid to gpuScene.
+bool gpuInstances = false;
+
+// --gpu-culling-benchmark fills the grid with this many mechs and switches between the paths after every step.
+static const unsigned int gpuBenchmarkMechCount = 10000;
+
+bool gpuCullingBenchmark = false;
+
+// The depth prepass lays down the scene's depth from the position only streams, so the color pass
+// shades one fragment per pixel. P toggles it, V shows how many fragments each pixel shades.
+bool depthPrepass = true;
+bool showOverdraw = false;
+
+// --prepass-benchmark draws the mech grid and counts the fragments shaded per frame, toggling the prepass after every step.
+bool prepassBenchmark = false;
+GLuint shadedSamplesQuery = 0;
+
+// The deferred renderer writes albedo, normals and material to a G-buffer, then lights it: the directional
+// and shadowed omni lights over the whole screen, each fill light only where its volume covers the scene.
+// --renderer deferred picks it at startup, the overdraw view always shows the forward path.
+DeferredRenderer deferredRenderer;
+bool deferredSupported = false;
+bool deferredShading = false;
+
+// Passes are declared every frame with what they read and write. The frame graph orders them, culls
+// those no output needs and hands out the transient targets, the scene, the G-buffer and the moment
+// blur scratch, sharing a texture between targets whose passes don't overlap. It reports whenever that
+// changes.
+FrameGraph frameGraph;
+std::string frameGraphOrder;
+size_t frameGraphBytes = 0;
+
+// The main view renders to part of a target the window's size, shrinking when the GPU runs over the
+// target frame time and growing back when it's under, and the upscale pass sharpens it over the window.
+// Anything drawn after the upscale, like a HUD, gets the window's resolution. --target-ms sets the time,
+// R toggles the scaling. Benchmarks run at the window's resolution.
+ResolutionScaler resolutionScaler;
+bool dynamicResolution = true;
+float targetFrameMs = 16.7f;
+
+// Unshadowed lights for both renderers, --fill-lights sets how many. They hang over the floor and the
+// front of the mech grid.
+static const glm::vec3 fillLightMin(-15.f, -1.f, -25.f);
+static const glm::vec3 fillLightMax(15.f, -1.f, 10.f);
+static const float fillLightRadius = 4.f;
+static const float fillLightIntensity = 0.8f;
+
+FillLights fillLights;
+unsigned int fillLightCount = 0;
+
+// --lighting-benchmark draws the mech grid and times the main view with the forward then the deferred
+// renderer at each fill light count, one step each. --headless hides the window and exits after the
+// last count.
+static const unsigned int lightingBenchmarkLights[] = { 0, 16, 64, 256 };
+static const unsigned int lightingBenchmarkSteps = sizeof(lightingBenchmarkLights) / sizeof(lightingBenchmarkLights[0]);
+
+bool lightingBenchmark = false;
+bool headless = false;
+
+// How long every benchmark averages each step over, --benchmark-seconds sets it. A software rasterizer
+// needs far longer than two seconds to see more than a frame or two.
+float benchmarkSeconds = 2.f;
+unsigned int lightingBenchmarkStep = 0;
+GLuint lightingTimer = 0;
+
+// --lod-benchmark fills the scene with a grid of mechs and reports the triangles submitted and clusters culled per frame,
+// with LODs on and off in turn.
+static const unsigned int benchmarkMechCount = 200;
+
+bool lodBenchmark = false;
+unsigned int benchmarkMechs = 0;
+
+// Models are entities with a Renderable, drawn where their transforms put them. The world matrices are
+// updated once a frame on the job pool, after the level's camera_mech has moved to follow the camera.
+// The benchmark grid hangs off one root entity; gpuScene keeps copies of its transforms, so it stays put.
+struct Renderable {
+	Model* model;
+	Material* material;
+	unsigned int lod;		// kept between frames, see Model::SelectLod
+	bool gpuInstance;		// also in gpuScene, which draws it when gpuInstances is set
+};
+
+Scene scene;
+Entity mechEntity = nullEntity;
+
 GLuint uniformProjection = 0, uniformModel = 0, uniformView = 0, uniformEyePosition = 0,
 uniformSpecularIntensity = 0, uniformShininess = 0,
 uniformDirectionalLightTransform = 0,
@@ -127,6 +340,219 @@ void CreateShaders() {
 	omniShadowShader = Shader();
 	omniShadowShader.CreateFromFiles("shaders/omni_directional_shadow_map_vertex.glsl", "shaders/omni_directional_shadow_map_geometry.glsl",
 		"shaders/omni_directional_shadow_map_fragment.glsl");
+	omniShadowInstancedShader = Shader();
+	omniShadowInstancedShader.CreateFromFiles("shaders/omni_directional_shadow_map_instanced_vertex.glsl", "shaders/omni_directional_shadow_map_fragment.glsl");
+	omniShadowFaceShader = Shader();
+	omniShadowFaceShader.CreateFromFiles("shaders/omni_directional_shadow_map_face_vertex.glsl", "shaders/omni_directional_shadow_map_fragment.glsl");
+	shadowMomentShader = Shader();
+	shadowMomentShader.CreateFromFiles("shaders/fullscreen_vertex.glsl", "shaders/shadow_moments_fragment.glsl");
+	depthPrepassShader = Shader();
+	depthPrepassShader.CreateFromFiles("shaders/depth_prepass_vertex.glsl", "shaders/directional_shadow_map_fragment.glsl");
+	overdrawShader = Shader();
+	overdrawShader.CreateFromFiles(vShader, "shaders/overdraw_fragment.glsl");
+	gBufferShader = Shader();
+	gBufferShader.CreateFromFiles(vShader, "shaders/gbuffer_fragment.glsl");
+	deferredLightShader = Shader();
+	deferredLightShader.SetDefines("#define DEFERRED\n");
+	deferredLightShader.CreateFromFiles("shaders/fullscreen_vertex.glsl", fShader);
+	deferredVolumeShader = Shader();
+	deferredVolumeShader.SetDefines("#define DEFERRED\n#define LIGHT_VOLUME\n");
+	deferredVolumeShader.CreateFromFiles("shaders/deferred_light_volume_vertex.glsl", fShader);
+	upscaleShader = Shader();
+	upscaleShader.CreateFromFiles("shaders/fullscreen_vertex.glsl", "shaders/upscale_fragment.glsl");
+
+	if (gpuCullingSupported) {
+		gpuColorShader = Shader();
+		gpuColorShader.CreateFromFiles("shaders/vertex_indirect.glsl", fShader);
+		gpuOverdrawShader = Shader();
+		gpuOverdrawShader.CreateFromFiles("shaders/vertex_indirect.glsl", "shaders/overdraw_fragment.glsl");
+		gpuDepthPrepassShader = Shader();
+		gpuDepthPrepassShader.CreateFromFiles("shaders/depth_prepass_indirect_vertex.glsl", "shaders/directional_shadow_map_fragment.glsl");
+		gpuDirectionalShadowShader = Shader();
+		gpuDirectionalShadowShader.CreateFromFiles("shaders/directional_shadow_map_indirect_vertex.glsl", "shaders/directional_shadow_map_fragment.glsl");
+		gpuGBufferShader = Shader();
+		gpuGBufferShader.CreateFromFiles("shaders/vertex_indirect.glsl", "shaders/gbuffer_fragment.glsl");
+	}
+}
+
+const char* GetShadowFilterName(ShadowFilter filter) {
+	switch (filter) {
+	case ShadowFilter::EvsmLow:
+		return "EVSM low";
+	case ShadowFilter::EvsmMedium:
+		return "EVSM medium";
+	case ShadowFilter::EvsmHigh:
+		return "EVSM high";
+	default:
+		return "PCF";
+	}
+}
+
+ShadowFilter NextShadowFilter(ShadowFilter filter) {
+	switch (filter) {
+	case ShadowFilter::Pcf:
+		return ShadowFilter::EvsmLow;
+	case ShadowFilter::EvsmLow:
+		return ShadowFilter::EvsmMedium;
+	case ShadowFilter::EvsmMedium:
+		return ShadowFilter::EvsmHigh;
+	default:
+		return ShadowFilter::Pcf;
+	}
+}
+
+// Each tier has its own texture format, so the moment maps are recreated whenever the filter changes.
+void InitShadowMoments() {
+	directionalMoments.Init(mainLight.GetShadowMap()->GetShadowWidth(), mainLight.GetShadowMap()->GetShadowHeight(), 1, shadowFilter, true);
+	omniMoments.Init(shadowAtlasSize, shadowAtlasSize, omniMomentDownsample, shadowFilter, false);
+	omniMomentsStale = true;
+}
+
+const char* GetOmniShadowPathName(OmniShadowPath path) {
+	switch (path) {
+	case OmniShadowPath::Instanced:
+		return "instanced";
+	case OmniShadowPath::PerFace:
+		return "per face";
+	default:
+		return "geometry shader";
+	}
+}
+
+OmniShadowPath NextOmniShadowPath(OmniShadowPath path) {
+	switch (path) {
+	case OmniShadowPath::Geometry:
+		return OmniShadowPath::Instanced;
+	case OmniShadowPath::Instanced:
+		return OmniShadowPath::PerFace;
+	default:
+		return OmniShadowPath::Geometry;
+	}
+}
+
+// Instances to draw a caster with into the omni shadow map: one per updated face its bounding sphere
+// touches on the instanced path, with the faces handed to the shader, or one or none per face. The
+// sphere is given in model space and placed by transform.
+GLsizei SetOmniCasterFaces(glm::mat4 const& transform, glm::vec3 const& modelCenter, float modelRadius) {
+	float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+	glm::vec3 center = glm::vec3(transform * glm::vec4(modelCenter, 1.f));
+	float radius = modelRadius * scale;
+
+	if (gatherCasters) {
+		shadowScheduler.AddCaster(center, radius);
+	}
+
+	if (!omniLight) {
+		return 1;
+	}
+
+	unsigned int mask = omniLight->GetFaceMask(center, radius) & omniUpdateMask;
+
+	if (omniShadowPath == OmniShadowPath::PerFace) {
+		return (mask >> omniFace) & 1;
+	}
+
+	GLint faces[6];
+	GLsizei count = 0;
+
+	for (GLint face = 0; face < 6; face++) {
+		if (mask & (1u << face)) {
+			faces[count++] = face;
+		}
+	}
+
+	if (count > 0) {
+		omniShadowInstancedShader.SetOmniFaces(faces, count);
+	}
+
+	return count;
+}
+
+// The level's entities, with a Renderable for those with a model, then the benchmark grid of the camera's mech.
+void CreateEntities() {
+	level.Instantiate(scene, levelEntities);
+
+	ComponentPool<Renderable>& renderables = scene.Components<Renderable>();
+	LevelEntity const* records = level.GetEntities();
+
+	for (uint32_t i = 0; i < level.GetEntityCount(); i++) {
+		if (records[i].model != noLevelIndex) {
+			Material* material = records[i].material != noLevelIndex ? &levelMaterials[records[i].material] : &glossyMaterial;
+			renderables.Add(levelEntities[i], { &levelModels[records[i].model], material, 0, false });
+		}
+	}
+
+	uint32_t follower = level.FindEntity("camera_mech");
+	mechEntity = follower != noLevelIndex ? levelEntities[follower] : nullEntity;
+
+	Renderable* mech = renderables.Get(mechEntity);
+	if (benchmarkMechs == 0 || !mech) {
+		return;
+	}
+
+	// Benchmark mechs stand in rows of 20, or more for larger grids.
+	Model* mechModel = mech->model;
+	unsigned int columns = std::max(20u, (unsigned int)sqrtf((float)benchmarkMechs));
+	unsigned int gpuMech = gpuScene.AddModel(mechModel);
+	std::vector<Entity> grid;
+
+	Entity gridRoot = scene.Create();
+	scene.SetPosition(gridRoot, glm::vec3(-1.5f * columns, -2.0f, -5.0f));
+
+	for (unsigned int i = 0; i < benchmarkMechs; i++) {
+		Entity entity = scene.Create();
+		scene.SetParent(entity, gridRoot);
+		scene.SetPosition(entity, glm::vec3(3.0f * (i % columns), 0.0f, -4.0f * (i / columns)));
+		scene.SetScale(entity, glm::vec3(0.05f));
+		renderables.Add(entity, { mechModel, &glossyMaterial, 0, true });
+		grid.push_back(entity);
+	}
+
+	scene.UpdateTransforms(&jobPool);
+
+	for (Entity entity : grid) {
+		gpuScene.AddInstance(gpuMech, scene.GetWorldMatrix(entity));
+	}
+}
+
+// Keeps the mech a few units ahead of the camera, facing the way it looks.
+void FollowCamera(Entity entity) {
+	glm::vec3 cameraFront = camera.getCameraDirection();
+
+	scene.SetPosition(entity, camera.getCameraPosition() + cameraFront * 4.f + glm::vec3(0.f, -0.5f, 0.f));
+	scene.SetRotation(entity, glm::quatLookAt(glm::normalize(cameraFront), glm::vec3(0.f, 1.f, 0.f)));
+}
+
+// Picks the instance's LOD from the main camera and draws it, lod holds the instance's LOD between frames.
+void DrawModel(Model& model, glm::mat4 const& transform, unsigned int& lod) {
+	if (gatherCasters && occlusionCulling) {
+		occlusionCuller.AddOccluder(&model.GetOccluder(), transform);
+	}
+
+	if (occlusionTest && !occlusionCuller.IsVisible(cullViewProjection * transform, model.GetBoundsMin(), model.GetBoundsMax(), occlusionCounted)) {
+		return;
+	}
+
+	lod = lodEnabled ? model.SelectLod(transform, camera.getCameraPosition(), lodProjectionScale, lodPixelError, lod) : 0;
+
+	ClusterView view;
+	ClusterView const* cullView = nullptr;
+
+	if (cullClusters) {
+		view = ClusterView::Create(cullViewProjection, transform, camera.getCameraPosition(), true);
+		cullView = &view;
+	}
+
+	if (depthOnly) {
+		GLsizei instances = SetOmniCasterFaces(transform, model.GetBoundsCenter(), model.GetBoundsRadius());
+
+		if (instances > 0) {
+			model.RenderModelDepth(lod + lodBias, cullView, instances);
+		}
+	}
+	else {
+		model.RenderModel(lod + lodBias, cullView);
+	}
 }
 
 void RenderScene() {
@@ -150,68 +576,201 @@ void RenderScene() {
 	glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
 	plainTexture.UseTexture();
 	glossyMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-	meshList[2]->RenderMesh();
+	if (depthOnly) {
+		GLsizei instances = SetOmniCasterFaces(model, meshList[2]->GetBoundsCenter(), meshList[2]->GetBoundsRadius());
 
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(-7.0f, 0.0f, 10.0f));
-	model = glm::rotate(model, glm::radians(0.f), glm::vec3(1.f, 0.f, 0.f));
-	model = glm::scale(model, glm::vec3(0.006f, 0.006f, 0.006f));
-	glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-	glossyMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-	xwing.RenderModel();
+		if (instances > 0) {
+			meshList[2]->RenderDepth(0, nullptr, instances);
+		}
+	}
+	else {
+		meshList[2]->RenderMesh();
+	}
 
+	ComponentPool<Renderable>& renderables = scene.Components<Renderable>();
+	for (size_t i = 0; i < renderables.GetCount(); i++) {
+		Renderable& renderable = renderables.GetData()[i];
+		if (renderable.gpuInstance && gpuInstances) {
+			continue;
+		}
 
-	/*model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(-7.5f, 0.0f, 8.0f));
-	model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));*/
+		model = scene.GetWorldMatrix(renderables.GetEntities()[i]);
+		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
+		renderable.material->UseMaterial(uniformSpecularIntensity, uniformShininess);
 
-	glm::vec3 cameraPosition = camera.getCameraPosition();
-	float cameraYaw = camera.GetYaw(); // Assuming the Camera class has getYaw() function
-	glm::vec3 cameraFront = camera.getCameraDirection();
+		// The grid shares the mech's textures, requested by the one following the camera.
+		if (!renderable.gpuInstance) {
+			textureStreamer.RequestModel(*renderable.model, model);
+		}
 
-	// Adjust the position and orientation of the mech
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, cameraPosition - cameraFront * -4.f); // Adjust the offset
-	model = glm::translate(model, glm::vec3(0.f, -0.5f, 0.f));
-	//model = glm::rotate(model, glm::radians(cameraYaw), glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate the model to face the camera's direction
-	
-	// Calculate the rotation to make the model face the camera's direction
-	glm::vec3 modelForward = glm::vec3(0.0f, 0.0f, 1.0f); // Assuming the model's forward direction is +Z
-	glm::vec3 targetDirection = glm::normalize(cameraFront);
-	glm::quat rotation = glm::quatLookAt(targetDirection, glm::vec3(0.f, 1.f, 0.f));
+		DrawModel(*renderable.model, model, renderable.lod);
+	}
+}
 
-	model = model * glm::mat4(rotation);
+// Point lights then spot lights, the order the atlas and scheduler keep their state in.
+std::vector<PointLight*> GetOmniLights() {
+	std::vector<PointLight*> lights;
+	for (size_t i = 0; i < pointLightCount; i++) {
+		lights.push_back(&pointLights[i]);
+	}
+	for (size_t i = 0; i < spotLightCount; i++) {
+		lights.push_back(&spotLights[i]);
+	}
+	return lights;
+}
 
-	
-	model = glm::scale(model, glm::vec3(0.05f, 0.05f, 0.05f));
-	glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-	glossyMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-	mech.RenderModel();
+// Lights whose reach is outside the main view ask for no shadow, the rest by how large and bright they appear.
+void AllocateShadowTiles(glm::mat4 const& viewProjection) {
+	std::vector<PointLight*> lights = GetOmniLights();
+
+	ClusterView view = ClusterView::Create(viewProjection, glm::mat4(1.f), camera.getCameraPosition(), false);
+	std::vector<ShadowRequest> requests;
+
+	for (auto light : lights) {
+		MeshCluster reach = {};
+		reach.center = light->GetPosition();
+		reach.radius = light->GetReach();
+
+		float importance = view.IsInFrustum(reach) ? light->GetShadowImportance(camera.getCameraPosition(), lodProjectionScale) : 0.f;
+		requests.push_back({ importance, light->GetMaxShadowFaceSize() });
+	}
+
+	std::vector<OmniShadowTiles> tiles = shadowAtlas.Allocate(requests);
+
+	for (size_t i = 0; i < lights.size(); i++) {
+		lights[i]->SetShadowTiles(tiles[i]);
+	}
 }
 
-void OmniShadowMapPass(PointLight* light) {
-	glViewport(0, 0, light->GetShadowMap()->GetShadowWidth(), light->GetShadowMap()->GetShadowHeight());
+// Redraws the faces in updateMask, each cleared to its tile first.
+void OmniShadowMapPass(PointLight* light, unsigned int updateMask) {
+	OmniShadowTiles const& tiles = light->GetShadowTiles();
 
-	omniShadowShader.UseShader();
-	uniformModel = omniShadowShader.GetModelLocation();
-	uniformOmniLightPos = omniShadowShader.GetOmniLightPosLocation();
-	uniformFarPlane = omniShadowShader.GetFarPlaneLocation();
+	if (tiles.faceScale == 0.f || updateMask == 0) {
+		return;
+	}
 
-	light->GetShadowMap()->Write();
+	GLsizei tileSize = (GLsizei)(tiles.faceScale * shadowAtlasSize + 0.5f);
+	auto scissorFace = [&](unsigned int face) {
+		glScissor((GLint)(tiles.faceOffsets[face].x * shadowAtlasSize + 0.5f), (GLint)(tiles.faceOffsets[face].y * shadowAtlasSize + 0.5f), tileSize, tileSize);
+	};
 
-	glClear(GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_SCISSOR_TEST);
+	for (unsigned int face = 0; face < 6; face++) {
+		if (updateMask & (1u << face)) {
+			scissorFace(face);
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+	}
+
+	// Drawing several faces at once relies on the clip distances alone, a face at a time keeps to its tile's scissor too.
+	if (omniShadowPath != OmniShadowPath::PerFace) {
+		glDisable(GL_SCISSOR_TEST);
+	}
+
+	Shader& shader = omniShadowPath == OmniShadowPath::Geometry ? omniShadowShader :
+		omniShadowPath == OmniShadowPath::Instanced ? omniShadowInstancedShader : omniShadowFaceShader;
+
+	shader.UseShader();
+	uniformModel = shader.GetModelLocation();
+	uniformOmniLightPos = shader.GetOmniLightPosLocation();
+	uniformFarPlane = shader.GetFarPlaneLocation();
 
 	glUniform3f(uniformOmniLightPos, light->GetPosition().x, light->GetPosition().y, light->GetPosition().z);
 	glUniform1f(uniformFarPlane, light->GetFarPlane());
-	omniShadowShader.SetOmniLightMatrices(light->CalcLightTransform());
+	shader.SetOmniLightMatrices(light->CalcLightTransform());
+	shader.SetOmniShadowTiles(tiles);
 
-	omniShadowShader.Validate();
-	RenderScene();
+	shader.Validate();
+	lodBias = lodEnabled ? shadowLodBias : 0;
+	cullClusters = false;
+	depthOnly = true;
+
+	// The geometry shader draws all six faces, the scheduler hands it whole lights.
+	if (omniShadowPath == OmniShadowPath::Geometry) {
+		RenderScene();
+	}
+	else if (omniShadowPath == OmniShadowPath::Instanced) {
+		omniLight = light;
+		omniUpdateMask = updateMask;
+		RenderScene();
+	}
+	else {
+		omniLight = light;
+		omniUpdateMask = updateMask;
+
+		for (omniFace = 0; omniFace < 6; omniFace++) {
+			if (updateMask & (1u << omniFace)) {
+				GLint face = (GLint)omniFace;
+				shader.SetOmniFaces(&face, 1);
+				scissorFace(omniFace);
+				RenderScene();
+			}
+		}
+
+		glDisable(GL_SCISSOR_TEST);
+	}
+
+	omniLight = nullptr;
+	depthOnly = false;
+}
+
+void FilterOmniShadowMoments(PointLight* light, unsigned int faceMask, GLuint momentScratch) {
+	OmniShadowTiles const& tiles = light->GetShadowTiles();
+
+	if (tiles.faceScale == 0.f) {
+		return;
+	}
+
+	GLint tileSize = (GLint)(tiles.faceScale * shadowAtlasSize + 0.5f);
+	for (int face = 0; face < 6; face++) {
+		if (faceMask & (1u << face)) {
+			omniMoments.Filter(shadowMomentShader, &shadowAtlas, glm::ivec4((GLint)(tiles.faceOffsets[face].x * shadowAtlasSize + 0.5f),
+				(GLint)(tiles.faceOffsets[face].y * shadowAtlasSize + 0.5f), tileSize, tileSize), momentScratch);
+		}
+	}
+}
+
+// The shaders clip each face to its tile with four clip distances, the tiles are cleared one by one
+// under a scissor as faces not due for an update keep last frame's depth.
+void OmniShadowMapPasses(GLuint momentScratch) {
+	std::vector<PointLight*> lights = GetOmniLights();
+	shadowScheduler.Schedule(lights, camera.getCameraPosition(), omniShadowPath == OmniShadowPath::Geometry);
+
+	shadowAtlas.Write();
+	glViewport(0, 0, shadowAtlasSize, shadowAtlasSize);
+
+	for (int i = 0; i < 4; i++) {
+		glEnable(GL_CLIP_DISTANCE0 + i);
+	}
+
+	for (size_t i = 0; i < lights.size(); i++) {
+		OmniShadowMapPass(lights[i], shadowScheduler.GetUpdateMask(i));
+	}
+
+	for (int i = 0; i < 4; i++) {
+		glDisable(GL_CLIP_DISTANCE0 + i);
+	}
+
+	// Only the faces just drawn need their moments filtered again.
+	if (shadowFilter != ShadowFilter::Pcf) {
+		for (size_t i = 0; i < lights.size(); i++) {
+			FilterOmniShadowMoments(lights[i], omniMomentsStale ? 0x3F : shadowScheduler.GetUpdateMask(i), momentScratch);
+		}
+		omniMomentsStale = false;
+	}
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// Lights still missing faces shade unshadowed until the scheduler gets to them.
+	for (size_t i = 0; i < lights.size(); i++) {
+		if (!shadowScheduler.IsReady(i)) {
+			lights[i]->SetShadowTiles(OmniShadowTiles{});
+		}
+	}
 }
 
-void DirectionalShadowMapPass(DirectionalLight* light) {
+void DirectionalShadowMapPass(DirectionalLight* light, GLuint momentScratch) {
 	directionalShadowShader.UseShader();
 
 	glViewport(0, 0, light->GetShadowMap()->GetShadowWidth(), light->GetShadowMap()->GetShadowHeight());
@@ -224,142 +783,486 @@ void DirectionalShadowMapPass(DirectionalLight* light) {
 	directionalShadowShader.SetDirectionalLightTransform(&lightTransform);
 
 	directionalShadowShader.Validate();
+	lodBias = lodEnabled ? shadowLodBias : 0;
+	cullClusters = false;
+	depthOnly = true;
+	gatherCasters = true;
+	gpuInstances = gpuCulling;
 	RenderScene();
+	gatherCasters = false;
+	depthOnly = false;
+
+	if (gpuInstances) {
+		gpuDirectionalShadowShader.UseShader();
+		gpuDirectionalShadowShader.SetDirectionalLightTransform(&lightTransform);
+		gpuScene.Draw(gpuShadowView, true);
+		gpuInstances = false;
+	}
+
+	if (shadowFilter != ShadowFilter::Pcf) {
+		directionalMoments.Filter(shadowMomentShader, light->GetShadowMap(),
+			glm::ivec4(0, 0, light->GetShadowMap()->GetShadowWidth(), light->GetShadowMap()->GetShadowHeight()), momentScratch);
+	}
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void RenderPass(glm::mat4 viewMatrix, glm::mat4 projectionMatrix) {
-	glViewport(0, 0, 1366, 768);
+// Camera, lights and shadow maps, for the color pass shaders of both paths.
+void SetColorPassUniforms(Shader& shader, glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix) {
+	shader.UseShader();
 
+	glUniformMatrix4fv(shader.GetProjectionLocation(), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+	glUniformMatrix4fv(shader.GetViewLocation(), 1, GL_FALSE, glm::value_ptr(viewMatrix));
+	glUniform3f(shader.GetEyePositionLocation(), camera.getCameraPosition().x, camera.getCameraPosition().y, camera.getCameraPosition().z);
+
+	shader.SetDirectionalLight(&mainLight);
+	shader.SetPointLights(pointLights, pointLightCount, 0);
+	shader.SetSpotLights(spotLights, spotLightCount, pointLightCount);
+	auto lightTansform = mainLight.CalcLightTransform();
+	shader.SetDirectionalLightTransform(&lightTansform);
+
+	mainLight.GetShadowMap()->Read(GL_TEXTURE2);
+	shadowAtlas.Read(GL_TEXTURE3);
+	shader.SetTexture(1);
+	shader.SetDirectionalShadowMap(2);
+	shader.SetOmniShadowAtlas(3);
+
+	directionalMoments.Read(GL_TEXTURE4);
+	omniMoments.Read(GL_TEXTURE5);
+	shader.SetMomentMaps(4, 5);
+	shader.SetShadowFilter(shadowFilter);
+
+	fillLights.Bind();
+	shader.SetFillLightCount(fillLights.GetCount());
+}
+
+// Both of gpuScene's views are culled before the shadow pass, the camera's against last frame's depth.
+void CullGpuInstances(glm::mat4 const& viewProjection) {
+	float maxPixels = lodEnabled ? lodPixelError : -1.f;
+
+	gpuScene.Cull(gpuShadowView, mainLight.CalcLightTransform(), camera.getCameraPosition(), lodProjectionScale, maxPixels,
+		lodEnabled ? shadowLodBias : 0, false);
+	gpuScene.Cull(gpuMainView, viewProjection, camera.getCameraPosition(), lodProjectionScale, maxPixels, 0, true);
+}
+
+// Same LODs and clusters as the color pass, which tests for equal depth and would leave holes otherwise.
+void DepthPrepass(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix) {
+	depthPrepassShader.UseShader();
+
+	uniformModel = depthPrepassShader.GetModelLocation();
+	glUniformMatrix4fv(depthPrepassShader.GetProjectionLocation(), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+	glUniformMatrix4fv(depthPrepassShader.GetViewLocation(), 1, GL_FALSE, glm::value_ptr(viewMatrix));
+
+	depthPrepassShader.Validate();
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	lodBias = 0;
+	cullClusters = clusterCulling;
+	cullViewProjection = projectionMatrix * viewMatrix;
+	occlusionTest = occlusionCulling;
+	occlusionCounted = true;
+	gpuInstances = gpuCulling;
+	depthOnly = true;
+	RenderScene();
+	depthOnly = false;
+	occlusionTest = false;
+
+	if (gpuInstances) {
+		gpuDepthPrepassShader.UseShader();
+		glUniformMatrix4fv(gpuDepthPrepassShader.GetProjectionLocation(), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+		glUniformMatrix4fv(gpuDepthPrepassShader.GetViewLocation(), 1, GL_FALSE, glm::value_ptr(viewMatrix));
+		gpuScene.Draw(gpuMainView, true);
+		gpuInstances = false;
+	}
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// Clears the bound target and draws the scene into it, after the depth prepass if on. The samples
+// query of --prepass-benchmark is left running for the caller to end after the skybox.
+void ScenePass(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix, Shader& shader, Shader& gpuShader) {
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	skyBox.DrawSkybox(viewMatrix, projectionMatrix);
+	if (depthPrepass) {
+		DepthPrepass(viewMatrix, projectionMatrix);
 
-	shaderList[0].UseShader();
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
 
-	uniformModel = shaderList[0].GetModelLocation();
-	uniformProjection = shaderList[0].GetProjectionLocation();
-	uniformView = shaderList[0].GetViewLocation();
-	uniformModel = shaderList[0].GetModelLocation();
-	uniformEyePosition = shaderList[0].GetEyePositionLocation();
-	uniformSpecularIntensity = shaderList[0].GetSpecularIntensityLocation();
-	uniformShininess = shaderList[0].GetShininessLocation();
+	if (prepassBenchmark) {
+		glBeginQuery(GL_SAMPLES_PASSED, shadedSamplesQuery);
+	}
 
-	glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-	glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-	glUniform3f(uniformEyePosition, camera.getCameraPosition().x, camera.getCameraPosition().y, camera.getCameraPosition().z);
+	SetColorPassUniforms(shader, viewMatrix, projectionMatrix);
 
-	shaderList[0].SetDirectionalLight(&mainLight);
-	shaderList[0].SetPointLights(pointLights, pointLightCount, 3, 0);
-	shaderList[0].SetSpotLights(spotLights, spotLightCount, 3 + pointLightCount, pointLightCount);
-	auto lightTansform = mainLight.CalcLightTransform();
-	shaderList[0].SetDirectionalLightTransform(&lightTansform);
-
-	mainLight.GetShadowMap()->Read(GL_TEXTURE2);
-	shaderList[0].SetTexture(1);
-	shaderList[0].SetDirectionalShadowMap(2);
+	uniformModel = shader.GetModelLocation();
+	uniformProjection = shader.GetProjectionLocation();
+	uniformView = shader.GetViewLocation();
+	uniformEyePosition = shader.GetEyePositionLocation();
+	uniformSpecularIntensity = shader.GetSpecularIntensityLocation();
+	uniformShininess = shader.GetShininessLocation();
 
 	glm::vec3 lowerLight = camera.getCameraPosition();
 	lowerLight.y -= 0.3f;
 	//spotLights[0].SetFlash(lowerLight, camera.getCameraDirection());
 
-	shaderList[0].Validate();
+	shader.Validate();
 
+	if (showOverdraw) {
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+	}
+
+	lodBias = 0;
+	cullClusters = clusterCulling;
+	cullViewProjection = projectionMatrix * viewMatrix;
+	occlusionTest = occlusionCulling;
+	occlusionCounted = !depthPrepass;
+	gpuInstances = gpuCulling;
 	RenderScene();
+	occlusionTest = false;
+
+	if (gpuInstances) {
+		SetColorPassUniforms(gpuShader, viewMatrix, projectionMatrix);
+		glossyMaterial.UseMaterial(gpuShader.GetSpecularIntensityLocation(), gpuShader.GetShininessLocation());
+		gpuScene.Draw(gpuMainView, false);
+
+		// The next frame tests against this frame's depth.
+		gpuScene.BuildHiZ(projectionMatrix * viewMatrix);
+		gpuInstances = false;
+	}
+
+	glDisable(GL_BLEND);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+}
+
+void RenderPass(glm::mat4 viewMatrix, glm::mat4 projectionMatrix, GLuint color, GLuint depth) {
+	resolutionScaler.Write(color, depth);
+
+	ScenePass(viewMatrix, projectionMatrix, showOverdraw ? overdrawShader : shaderList[0], showOverdraw ? gpuOverdrawShader : gpuColorShader);
+
+	// The overdraw view leaves the sky black, so only the scene's fragments are counted in it.
+	if (!showOverdraw) {
+		skyBox.DrawSkybox(viewMatrix, projectionMatrix);
+	}
+
+	if (prepassBenchmark) {
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+}
+
+void GBufferPass(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix, GLuint albedo, GLuint normal, GLuint depth) {
+	deferredRenderer.Write(albedo, normal, depth, resolutionScaler.GetWidth(), resolutionScaler.GetHeight());
+	ScenePass(viewMatrix, projectionMatrix, gBufferShader, gpuGBufferShader);
 }
 
+// Lights the G-buffer into the scene target. The full screen pass writes the scene's depth back for the
+// light volumes and the skybox after it.
+void DeferredLightingPass(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix, GLuint albedo, GLuint normal, GLuint depth,
+	GLuint sceneColor, GLuint sceneDepth) {
+	resolutionScaler.Write(sceneColor, sceneDepth);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glm::mat4 inverseViewProjection = glm::inverse(projectionMatrix * viewMatrix);
+	glm::vec2 viewportSize((float)resolutionScaler.GetWidth(), (float)resolutionScaler.GetHeight());
+	deferredRenderer.Read(GL_TEXTURE6, albedo, normal, depth);
+
+	SetColorPassUniforms(deferredLightShader, viewMatrix, projectionMatrix);
+	deferredLightShader.SetGBuffer(6, inverseViewProjection, viewportSize);
+	deferredLightShader.Validate();
+
+	glDepthFunc(GL_ALWAYS);
+	deferredRenderer.DrawFullscreen();
+	glDepthFunc(GL_LESS);
+
+	// Only the volumes' far sides are drawn, where they lie behind the scene: pixels in front of that can
+	// be in reach, the shader drops the rest. Depth clamping keeps the far sides past the far plane.
+	if (fillLights.GetCount() > 0) {
+		SetColorPassUniforms(deferredVolumeShader, viewMatrix, projectionMatrix);
+		deferredVolumeShader.SetGBuffer(6, inverseViewProjection, viewportSize);
+		deferredVolumeShader.Validate();
+
+		glDepthMask(GL_FALSE);
+		glDepthFunc(GL_GEQUAL);
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_FRONT);
+		glEnable(GL_DEPTH_CLAMP);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+
+		deferredRenderer.DrawLightVolumes(fillLights.GetCount());
+
+		glDisable(GL_BLEND);
+		glDisable(GL_DEPTH_CLAMP);
+		glCullFace(GL_BACK);
+		glDisable(GL_CULL_FACE);
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+	}
+
+	skyBox.DrawSkybox(viewMatrix, projectionMatrix);
+
+	if (prepassBenchmark) {
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+}
+
+int main(int argc, char** argv) {
+	startupStart = std::chrono::steady_clock::now();
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--lod-benchmark") == 0) {
+			lodBenchmark = true;
+			benchmarkMechs = benchmarkMechCount;
+		}
+		else if (strcmp(argv[i], "--shadow-benchmark") == 0) {
+			shadowBenchmark = true;
+			benchmarkMechs = benchmarkMechCount;
+		}
+		else if (strcmp(argv[i], "--prepass-benchmark") == 0) {
+			prepassBenchmark = true;
+			benchmarkMechs = benchmarkMechCount;
+		}
+		else if (strcmp(argv[i], "--gpu-culling-benchmark") == 0) {
+			gpuCullingBenchmark = true;
+			benchmarkMechs = gpuBenchmarkMechCount;
+		}
+		else if (strcmp(argv[i], "--lighting-benchmark") == 0) {
+			lightingBenchmark = true;
+			benchmarkMechs = benchmarkMechCount;
+		}
+		else if (strcmp(argv[i], "--headless") == 0) {
+			headless = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-seconds") == 0 && i + 1 < argc) {
+			benchmarkSeconds = std::max((float)atof(argv[++i]), 0.1f);
+		}
+		else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc) {
+			packPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--loose") == 0) {
+			looseAssets = true;
+		}
+		else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+			levelPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc) {
+			// forward or deferred.
+			deferredShading = strcmp(argv[++i], "deferred") == 0;
+		}
+		else if (strcmp(argv[i], "--target-ms") == 0 && i + 1 < argc) {
+			targetFrameMs = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--fixed-resolution") == 0) {
+			dynamicResolution = false;
+		}
+		else if (strcmp(argv[i], "--fill-lights") == 0 && i + 1 < argc) {
+			fillLightCount = (unsigned int)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--shadow-faces") == 0 && i + 1 < argc) {
+			shadowFaceBudget = (unsigned int)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--shadow-ms") == 0 && i + 1 < argc) {
+			shadowBudgetMs = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--shadow-filter") == 0 && i + 1 < argc) {
+			// pcf, low, medium or high.
+			i++;
+			shadowFilter = strcmp(argv[i], "pcf") == 0 ? ShadowFilter::Pcf : strcmp(argv[i], "low") == 0 ? ShadowFilter::EvsmLow :
+				strcmp(argv[i], "high") == 0 ? ShadowFilter::EvsmHigh : ShadowFilter::EvsmMedium;
+		}
+	}
 
-int main() {
 	mainWindow = Window(1366, 768); // 1280, 1024 or 1024, 768
+	mainWindow.setHidden(headless);
 	mainWindow.Initialize();
 
+	if (!looseAssets && assetPack.Open(packPath)) {
+		AssetPack::Mount(&assetPack);
+		printf("Assets: %s, %u files, %.1f MB\n", packPath, assetPack.GetEntryCount(), assetPack.GetSize() / (1024.f * 1024.f));
+	}
+	else {
+		printf("Assets: loose files\n");
+	}
+
+	jobPool.Init();
+	assetLoader.Init(&jobPool);
+
+	// Cooked textures load their small tail levels only and stream the rest within this budget.
+	textureStreamer.Init(&jobPool, 64 << 20);
+
+	// One view for the camera, one for the directional light.
+	gpuCullingSupported = gpuScene.Init(2);
+	gpuCulling = gpuCullingSupported;
+	printf("GPU culling: %s\n", gpuCullingSupported ? "on" : "unavailable, the CPU path draws everything");
+
 	CreateObjects();
 	CreateShaders();
 
+	if (lightingBenchmark) {
+		fillLightCount = lightingBenchmarkLights[0];
+		deferredShading = false;
+	}
+
+	fillLights.Init();
+	fillLights.Scatter(fillLightCount, fillLightMin, fillLightMax, fillLightRadius, fillLightIntensity);
+
+	deferredSupported = deferredRenderer.Init(mainWindow.getBufferWidth(), mainWindow.getBufferHeight());
+	deferredShading = deferredShading && deferredSupported;
+
+	if (!resolutionScaler.Init(mainWindow.getBufferWidth(), mainWindow.getBufferHeight(), targetFrameMs)) {
+		return 1;
+	}
+
+	dynamicResolution = dynamicResolution && !lodBenchmark && !shadowBenchmark && !prepassBenchmark && !gpuCullingBenchmark && !lightingBenchmark;
+	resolutionScaler.SetEnabled(dynamicResolution);
+	printf("Dynamic resolution: %s, %.1f ms target\n", dynamicResolution ? "on" : "off", targetFrameMs);
+	printf("Renderer: %s, %u fill lights\n", deferredShading ? "deferred" : "forward", fillLights.GetCount());
+
+	shadowAtlas.Init(shadowAtlasSize, minShadowFaceSize);
+	shadowScheduler.SetBudget(shadowFaceBudget, shadowBudgetMs);
+
+	printf("Omni shadows: %s path\n", GetOmniShadowPathName(omniShadowPath));
+
 	camera = Camera(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), -60.0f, 0.0f, 5.0f, 0.5f);
 
 	brickTexture = Texture("textures/brick.png");
-	brickTexture.LoadTextureA();
+	assetLoader.LoadTexture(&brickTexture, true);
 	dirtTexture = Texture("textures/dirt.png");
-	dirtTexture.LoadTextureA();
+	assetLoader.LoadTexture(&dirtTexture, true);
 	plainTexture = Texture("textures/plain.png");
-	plainTexture.LoadTextureA();
+	assetLoader.LoadTexture(&plainTexture, true);
 
 	glossyMaterial = Material(4.0f, 256);
 	matteMaterial = Material(0.3f, 4);
 
-	xwing = Model();
-	xwing.LoadModel("models/x-wing.obj");
+	if (!level.Load(levelPath)) {
+		return 1;
+	}
+
+	if (level.GetDirectionalLightCount() == 0) {
+		printf("Level %s has no directional light\n", levelPath);
+		return 1;
+	}
 
-	mech = Model();
-	mech.LoadModel("models/Kaiser.obj");
+	LevelMaterial const* materials = level.GetMaterials();
+	for (uint32_t i = 0; i < level.GetMaterialCount(); i++) {
+		levelMaterials.push_back(Material(materials[i].specularIntensity, materials[i].shininess));
+	}
+
+	// Models stream in over the first frames, the window is interactive right away.
+	levelModels = std::vector<Model>(level.GetModelCount());
+	for (uint32_t i = 0; i < level.GetModelCount(); i++) {
+		assetLoader.LoadModel(&levelModels[i], level.GetString(level.GetModels()[i].path));
+	}
 
+	CreateEntities();
+
+	LevelDirectionalLight const& directional = level.GetDirectionalLights()[0];
 	mainLight = DirectionalLight(
-		0.678f, 0.847f, 0.902f,
-		0.1f, 0.9f,
-		-10.0f, -12.0f, -18.5f,
-		2048, 2048);
-
-	pointLights[1] = PointLight(
-		0.678, 0.847, 0.902, 
-		0.0f, 0.4f,
-		2.0f, 2.0f, 0.0f,
-		0.3f, 0.01f, 0.01f,
-		1024, 1024,
-		0.1f, 100.0f);
-
-	pointLightCount++;
-
-	pointLights[0] = PointLight(
-		0.400, 0.600, 1.000,
-		0.0f, 0.4f,
-		-2.0f, 2.0f, 0.0f,
-		0.3f, 0.01f, 0.01f,
-		1024, 1024,
-		0.1f, 100.0f);
-
-	pointLightCount++;
-
-	spotLights[0] = SpotLight(
-		0.635, 0.482, 0.933,
-		0.0f, 2.0f,
-		0.0f, 0.0f, 0.0f,
-		0.0f, -1.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		20.0f,
-		1024, 1024,
-		0.1f, 100.0f);
-
-	spotLightCount++;
-
-	spotLights[1] = SpotLight(
-		0.400, 0.600, 1.000,
-		0.0f, 1.0f,
-		0.0f, -1.5f, 0.0f,
-		-100.0f, -1.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		20.0f,
-		1024, 1024,
-		0.1f, 100.0f);
-
-	spotLightCount++;
-
-	std::vector<std::string> skyBoxFaces;
-
-	skyBoxFaces.push_back("textures/lightblue/right.tga");
-	skyBoxFaces.push_back("textures/lightblue/left.tga");
-	skyBoxFaces.push_back("textures/lightblue/top.tga");
-	skyBoxFaces.push_back("textures/lightblue/bot.tga");
-	skyBoxFaces.push_back("textures/lightblue/back.tga");
-	skyBoxFaces.push_back("textures/lightblue/front.tga");
-
-
-	skyBox = Skybox(skyBoxFaces);
+		directional.color[0], directional.color[1], directional.color[2],
+		directional.ambientIntensity, directional.diffuseIntensity,
+		directional.direction[0], directional.direction[1], directional.direction[2],
+		directional.shadowWidth, directional.shadowHeight);
+
+	// Lights past what the shaders hold are dropped.
+	for (uint32_t i = 0; i < level.GetPointLightCount() && pointLightCount < N_POINT_LIGHTS; i++) {
+		LevelPointLight const& light = level.GetPointLights()[i];
+		pointLights[pointLightCount++] = PointLight(
+			light.color[0], light.color[1], light.color[2],
+			light.ambientIntensity, light.diffuseIntensity,
+			light.position[0], light.position[1], light.position[2],
+			light.constant, light.linear, light.exponent,
+			light.shadowWidth, light.shadowHeight,
+			light.nearPlane, light.farPlane);
+	}
+
+	for (uint32_t i = 0; i < level.GetSpotLightCount() && spotLightCount < N_SPOT_LIGHTS; i++) {
+		LevelSpotLight const& spot = level.GetSpotLights()[i];
+		LevelPointLight const& light = spot.light;
+		spotLights[spotLightCount++] = SpotLight(
+			light.color[0], light.color[1], light.color[2],
+			light.ambientIntensity, light.diffuseIntensity,
+			light.position[0], light.position[1], light.position[2],
+			spot.direction[0], spot.direction[1], spot.direction[2],
+			light.constant, light.linear, light.exponent,
+			spot.edgeAngle,
+			light.shadowWidth, light.shadowHeight,
+			light.nearPlane, light.farPlane);
+	}
+
+	InitShadowMoments();
+	printf("Shadow filter: %s\n", GetShadowFilterName(shadowFilter));
+
+	skyBox = Skybox(level.GetSkyboxFaces());
+
+#ifdef ASSET_SOURCE_DIR
+	// Picks up the manifest asset_builder left next to the executable.
+	assetCooker.Init(ASSET_SOURCE_DIR, ".", &jobPool);
+	assetReloader.SetCooker(&assetCooker);
+	assetReloader.Start(ASSET_SOURCE_DIR);
+#else
+	assetReloader.Start(".");
+#endif
+	assetReloader.WatchShader(&shaderList[0]);
+	assetReloader.WatchShader(&directionalShadowShader);
+	assetReloader.WatchShader(&omniShadowShader);
+	assetReloader.WatchShader(&omniShadowInstancedShader);
+	assetReloader.WatchShader(&omniShadowFaceShader);
+	assetReloader.WatchShader(&shadowMomentShader);
+	assetReloader.WatchShader(&depthPrepassShader);
+	assetReloader.WatchShader(&overdrawShader);
+	assetReloader.WatchShader(&gBufferShader);
+	assetReloader.WatchShader(&deferredLightShader);
+	assetReloader.WatchShader(&deferredVolumeShader);
+	assetReloader.WatchShader(&upscaleShader);
+	if (gpuCullingSupported) {
+		assetReloader.WatchShader(&gpuColorShader);
+		assetReloader.WatchShader(&gpuOverdrawShader);
+		assetReloader.WatchShader(&gpuDepthPrepassShader);
+		assetReloader.WatchShader(&gpuDirectionalShadowShader);
+		assetReloader.WatchShader(&gpuGBufferShader);
+	}
+	assetReloader.WatchShader(skyBox.GetShader());
+	assetReloader.WatchTexture(&brickTexture);
+	assetReloader.WatchTexture(&dirtTexture);
+	assetReloader.WatchTexture(&plainTexture);
 
 	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (GLfloat)mainWindow.getBufferWidth() / mainWindow.getBufferHeight(), 0.1f, 100.0f);
 
+	bool loadingDone = false;
+	float resolutionScale = resolutionScaler.GetScale();
+
+	size_t benchmarkFrames = 0, benchmarkTriangles = 0, benchmarkShadowTriangles = 0, benchmarkDraws = 0;
+	GLfloat benchmarkStart = glfwGetTime();
+
+	// Two timers so the previous frame's result is read without waiting on the GPU.
+	GLuint omniTimers[2] = {};
+	unsigned int omniTimerFaces[2] = {};
+	bool omniTimerPending[2] = {};
+	unsigned int omniTimerIndex = 0;
+	float omniGpuTime = 0.f;
+
+	glGenQueries(2, omniTimers);
+
+	size_t benchmarkShadedSamples = 0;
+
+	if (prepassBenchmark) {
+		glGenQueries(1, &shadedSamplesQuery);
+	}
+
+	if (lightingBenchmark) {
+		glGenQueries(1, &lightingTimer);
+	}
+
+	double benchmarkOmniGpuTime = 0.0, benchmarkOmniCpuTime = 0.0;
+	double benchmarkFrameTime = 0.0, benchmarkCpuTime = 0.0, benchmarkMainGpuTime = 0.0;
+	size_t benchmarkShadowFaces = 0;
+
 	// Loop until window closed
 	while (!mainWindow.getShouldClose()) {
 		GLfloat now = glfwGetTime(); 
@@ -369,25 +1272,391 @@ int main() {
 		// Get + Handle User Input
 		glfwPollEvents();
 
+		// Sets this frame's scale from the GPU time of an earlier one.
+		resolutionScaler.BeginFrame();
+
+		if (resolutionScaler.GetScale() != resolutionScale) {
+			resolutionScale = resolutionScaler.GetScale();
+			printf("Resolution scale: %.0f%%, %dx%d, %.2f ms GPU per frame\n", resolutionScale * 100.f, resolutionScaler.GetWidth(),
+				resolutionScaler.GetHeight(), resolutionScaler.GetGpuTime());
+		}
+
+		// Pixels covered by one world unit at distance one, at the scene's resolution.
+		lodProjectionScale = resolutionScaler.GetHeight() / (2.f * tanf(glm::radians(45.0f) * 0.5f));
+
+		// Swap in any assets that finished reloading before this frame renders.
+		assetReloader.Update();
+		assetLoader.Update();
+
+		textureStreamer.SetView(camera.getCameraPosition(), glm::radians(45.0f), (float)resolutionScaler.GetHeight());
+		textureStreamer.Update();
+
+		if (!loadingDone) {
+			auto const& loadStats = assetLoader.GetStats();
+			char title[128];
+
+			loadingDone = assetLoader.IsIdle();
+			if (loadingDone) {
+				printf("Startup: every asset loaded after %.0f ms, %zu files opened\n",
+					std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startupStart).count(), AssetPack::GetFileOpenCount());
+
+				// Watched only now, the reloader reads their texture lists while the loader's jobs still fill them.
+				for (Model& model : levelModels) {
+					assetReloader.WatchModel(&model);
+				}
+			}
+			snprintf(title, sizeof(title), loadingDone ? "Test Window" : "Test Window - loading %u/%u assets, %.1f MB, %.0f%% of upload budget",
+				loadStats.assetsLoaded, loadStats.assetsQueued, loadStats.bytesUploaded / (1024.f * 1024.f), loadStats.frameBudgetUsage * 100.f);
+			mainWindow.setTitle(title);
+		}
+
 		camera.keyControl(mainWindow.getKeys(), deltaTime);
 		camera.mouseControl(mainWindow.getXChange(), mainWindow.getYChange());
 
+		FollowCamera(mechEntity);
+		scene.UpdateTransforms(&jobPool);
+
 		if (mainWindow.getKeys()[GLFW_KEY_L]) {
 			spotLights[0].Toggle();
 			mainWindow.getKeys()[GLFW_KEY_L] = false;
 		}
 
-		DirectionalShadowMapPass(&mainLight);
+		if (mainWindow.getKeys()[GLFW_KEY_K]) {
+			lodEnabled = !lodEnabled;
+			mainWindow.getKeys()[GLFW_KEY_K] = false;
+		}
+
+		if (mainWindow.getKeys()[GLFW_KEY_C]) {
+			clusterCulling = !clusterCulling;
+			mainWindow.getKeys()[GLFW_KEY_C] = false;
+		}
+
+		if (mainWindow.getKeys()[GLFW_KEY_F]) {
+			shadowFilter = NextShadowFilter(shadowFilter);
+			InitShadowMoments();
+			printf("Shadow filter: %s\n", GetShadowFilterName(shadowFilter));
+			mainWindow.getKeys()[GLFW_KEY_F] = false;
+		}
+
+		if (mainWindow.getKeys()[GLFW_KEY_P]) {
+			depthPrepass = !depthPrepass;
+			printf("Depth prepass %s\n", depthPrepass ? "on" : "off");
+			mainWindow.getKeys()[GLFW_KEY_P] = false;
+		}
+
+		if (mainWindow.getKeys()[GLFW_KEY_U]) {
+			occlusionCulling = !occlusionCulling;
+			printf("Occlusion culling %s\n", occlusionCulling ? "on" : "off");
+			mainWindow.getKeys()[GLFW_KEY_U] = false;
+		}
+
+		if (mainWindow.getKeys()[GLFW_KEY_G]) {
+			gpuCulling = gpuCullingSupported && !gpuCulling;
+			printf("GPU culling %s\n", gpuCulling ? "on" : "off");
+			mainWindow.getKeys()[GLFW_KEY_G] = false;
+		}
+
+		if (mainWindow.getKeys()[GLFW_KEY_R]) {
+			dynamicResolution = !dynamicResolution;
+			resolutionScaler.SetEnabled(dynamicResolution);
+			printf("Dynamic resolution %s\n", dynamicResolution ? "on" : "off");
+			mainWindow.getKeys()[GLFW_KEY_R] = false;
+		}
 
-		for (size_t i = 0; i < pointLightCount; i++) {
-			OmniShadowMapPass(&pointLights[i]);
+		if (mainWindow.getKeys()[GLFW_KEY_V]) {
+			showOverdraw = !showOverdraw;
+			mainWindow.getKeys()[GLFW_KEY_V] = false;
 		}
 
-		for (size_t i = 0; i < spotLightCount; i++) {
-			OmniShadowMapPass(&spotLights[i]);
+		if (mainWindow.getKeys()[GLFW_KEY_O]) {
+			omniShadowPath = NextOmniShadowPath(omniShadowPath);
+			printf("Omni shadows: %s path\n", GetOmniShadowPathName(omniShadowPath));
+			mainWindow.getKeys()[GLFW_KEY_O] = false;
+		}
+
+		Mesh::ResetSubmittedTriangles();
+
+		AllocateShadowTiles(projection * camera.calculateViewMatrix());
+
+		if (gpuCulling) {
+			CullGpuInstances(projection * camera.calculateViewMatrix());
 		}
 
-		RenderPass(camera.calculateViewMatrix(), projection);
+		// Shadow maps and moments are kept by their lights between frames, the casters are what the
+		// directional pass gathers for the omni shadow scheduler and the occlusion culler.
+		FrameResource casters = frameGraph.Import("shadow casters");
+		FrameResource directionalShadow = frameGraph.Import("directional shadow map");
+		FrameResource omniShadow = frameGraph.Import("omni shadow atlas");
+		FrameResource window = frameGraph.Import("window");
+		frameGraph.MarkOutput(window);
+
+		std::vector<FrameResource> directionalWrites = { directionalShadow, casters };
+		std::vector<FrameResource> omniWrites = { omniShadow };
+		FrameResource directionalScratch = 0, omniScratch = 0;
+
+		if (shadowFilter != ShadowFilter::Pcf) {
+			directionalScratch = frameGraph.CreateTexture("directional moment scratch", directionalMoments.GetScratchDesc());
+			omniScratch = frameGraph.CreateTexture("omni moment scratch", omniMoments.GetScratchDesc());
+			directionalWrites.push_back(directionalScratch);
+			omniWrites.push_back(omniScratch);
+		}
+
+		std::future<void> occlusion;
+		size_t directionalTriangles = 0, shadowTriangles = 0;
+		GLfloat omniCpuTime = 0.f;
+		unsigned int updatedFaces = 0;
+
+		frameGraph.AddPass("directional shadow", {}, directionalWrites, [&]() {
+			shadowScheduler.BeginFrame();
+			occlusionCuller.Begin(projection * camera.calculateViewMatrix());
+			DirectionalShadowMapPass(&mainLight, shadowFilter != ShadowFilter::Pcf ? frameGraph.GetTexture(directionalScratch) : 0);
+
+			if (occlusionCulling) {
+				occlusion = jobPool.Submit([]() { occlusionCuller.Rasterize(&jobPool); });
+			}
+
+			directionalTriangles = Mesh::GetSubmittedTriangles();
+		});
+
+		frameGraph.AddPass("omni shadows", { casters }, omniWrites, [&]() {
+			GLfloat omniStart = glfwGetTime();
+
+			// The result from two frames ago is long done, it sets how many faces the millisecond budget buys.
+			GLuint omniTimer = omniTimers[omniTimerIndex];
+			if (omniTimerPending[omniTimerIndex]) {
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(omniTimer, GL_QUERY_RESULT, &elapsed);
+				omniGpuTime = elapsed / 1e6f;
+				shadowScheduler.ReportCost(omniGpuTime, omniTimerFaces[omniTimerIndex]);
+			}
+
+			glBeginQuery(GL_TIME_ELAPSED, omniTimer);
+			OmniShadowMapPasses(shadowFilter != ShadowFilter::Pcf ? frameGraph.GetTexture(omniScratch) : 0);
+			glEndQuery(GL_TIME_ELAPSED);
+
+			for (ShadowLightStats const& lightStats : shadowScheduler.GetStats()) {
+				updatedFaces += lightStats.updatedFaces;
+			}
+
+			omniTimerFaces[omniTimerIndex] = updatedFaces;
+			omniTimerPending[omniTimerIndex] = true;
+			omniTimerIndex ^= 1;
+
+			omniCpuTime = glfwGetTime() - omniStart;
+			shadowTriangles = Mesh::GetSubmittedTriangles();
+		});
+
+		// Either renderer draws the scene into these, at the scaler's resolution.
+		FrameResource sceneColor = frameGraph.CreateTexture("scene color", resolutionScaler.GetColorDesc());
+		FrameResource sceneDepth = frameGraph.CreateTexture("scene depth", resolutionScaler.GetDepthDesc());
+
+		// Always declared, the graph culls it when the forward path draws the scene.
+		FrameResource gBufferAlbedo = frameGraph.CreateTexture("g-buffer albedo", deferredRenderer.GetTargetDesc(GBufferTarget::Albedo));
+		FrameResource gBufferNormal = frameGraph.CreateTexture("g-buffer normal", deferredRenderer.GetTargetDesc(GBufferTarget::Normal));
+		FrameResource gBufferDepth = frameGraph.CreateTexture("g-buffer depth", deferredRenderer.GetTargetDesc(GBufferTarget::Depth));
+
+		frameGraph.AddPass("g-buffer", { casters }, { gBufferAlbedo, gBufferNormal, gBufferDepth }, [&]() {
+			if (occlusion.valid()) {
+				jobPool.Wait(occlusion);
+			}
+
+			if (lightingBenchmark) {
+				glBeginQuery(GL_TIME_ELAPSED, lightingTimer);
+			}
+
+			GBufferPass(camera.calculateViewMatrix(), projection, frameGraph.GetTexture(gBufferAlbedo), frameGraph.GetTexture(gBufferNormal),
+				frameGraph.GetTexture(gBufferDepth));
+		});
+
+		// The overdraw view always counts the forward path's fragments.
+		if (deferredShading && !showOverdraw) {
+			frameGraph.AddPass("deferred lighting", { gBufferAlbedo, gBufferNormal, gBufferDepth, directionalShadow, omniShadow }, { sceneColor, sceneDepth }, [&]() {
+				DeferredLightingPass(camera.calculateViewMatrix(), projection, frameGraph.GetTexture(gBufferAlbedo), frameGraph.GetTexture(gBufferNormal),
+					frameGraph.GetTexture(gBufferDepth), frameGraph.GetTexture(sceneColor), frameGraph.GetTexture(sceneDepth));
+
+				if (lightingBenchmark) {
+					glEndQuery(GL_TIME_ELAPSED);
+				}
+			});
+		}
+		else {
+			frameGraph.AddPass("forward", { casters, directionalShadow, omniShadow }, { sceneColor, sceneDepth }, [&]() {
+				if (occlusion.valid()) {
+					jobPool.Wait(occlusion);
+				}
+
+				if (lightingBenchmark) {
+					glBeginQuery(GL_TIME_ELAPSED, lightingTimer);
+				}
+
+				RenderPass(camera.calculateViewMatrix(), projection, frameGraph.GetTexture(sceneColor), frameGraph.GetTexture(sceneDepth));
+
+				if (lightingBenchmark) {
+					glEndQuery(GL_TIME_ELAPSED);
+				}
+			});
+		}
+
+		frameGraph.AddPass("upscale", { sceneColor }, { window }, [&]() {
+			resolutionScaler.Upscale(upscaleShader, frameGraph.GetTexture(sceneColor), 0);
+		});
+
+		frameGraph.Execute();
+		resolutionScaler.EndFrame();
+
+		GLfloat frameCpuTime = glfwGetTime() - now;
+
+		// Whenever the passes or targets change, with what every declared target would take without the graph.
+		FrameGraphStats const& graphStats = frameGraph.GetStats();
+		if (graphStats.order != frameGraphOrder || graphStats.allocatedBytes != frameGraphBytes) {
+			printf("Frame graph: %s, %zu of %zu passes culled\n", graphStats.order.c_str(), graphStats.culledPasses, graphStats.passes);
+			printf("  %zu transient targets in %.1f MB, %.1f MB with a texture for every declared one\n", graphStats.transientTextures,
+				graphStats.allocatedBytes / (1024.0 * 1024.0), graphStats.unaliasedBytes / (1024.0 * 1024.0));
+
+			frameGraphOrder = graphStats.order;
+			frameGraphBytes = graphStats.allocatedBytes;
+		}
+
+		if (shadowBenchmark) {
+			// The geometry shader rasterizes every triangle into all six faces.
+			size_t omniTriangles = shadowTriangles - directionalTriangles;
+			if (omniShadowPath == OmniShadowPath::Geometry) {
+				omniTriangles *= 6;
+			}
+
+			benchmarkFrames++;
+			benchmarkOmniGpuTime += omniGpuTime;
+			benchmarkOmniCpuTime += omniCpuTime;
+			benchmarkShadowTriangles += omniTriangles;
+			benchmarkShadowFaces += updatedFaces;
+
+			if (now - benchmarkStart >= benchmarkSeconds) {
+				printf("Omni shadows, %s path, %s filter: %.3f ms GPU, %.3f ms CPU, %zu face triangles, %.1f faces of %u budgeted per frame\n",
+					GetOmniShadowPathName(omniShadowPath), GetShadowFilterName(shadowFilter), benchmarkOmniGpuTime / benchmarkFrames, benchmarkOmniCpuTime * 1e3 / benchmarkFrames,
+					benchmarkShadowTriangles / benchmarkFrames, (float)benchmarkShadowFaces / benchmarkFrames, shadowScheduler.GetFaceBudget());
+				printf("Shadow atlas: %u of %u omni lights shadowed, %.0f%% used\n", shadowAtlas.GetShadowedLights(), pointLightCount + spotLightCount,
+					shadowAtlas.GetUsage() * 100.f);
+
+				std::vector<ShadowLightStats> const& lightStats = shadowScheduler.GetStats();
+				for (size_t i = 0; i < lightStats.size(); i++) {
+					printf("  light %zu: oldest face %u frames, average %.1f%s\n", i, lightStats[i].oldestFace, lightStats[i].averageAge,
+						lightStats[i].ready ? "" : ", not ready");
+				}
+
+				omniShadowPath = NextOmniShadowPath(omniShadowPath);
+				benchmarkFrames = benchmarkShadowTriangles = benchmarkShadowFaces = 0;
+				benchmarkOmniGpuTime = 0.0;
+				benchmarkOmniCpuTime = 0.0;
+				benchmarkStart = now;
+			}
+		}
+		else if (prepassBenchmark) {
+			GLuint shadedSamples = 0;
+			glGetQueryObjectuiv(shadedSamplesQuery, GL_QUERY_RESULT, &shadedSamples);
+
+			benchmarkFrames++;
+			benchmarkShadedSamples += shadedSamples;
+
+			if (now - benchmarkStart >= benchmarkSeconds) {
+				size_t perFrame = benchmarkShadedSamples / benchmarkFrames;
+				printf("Depth prepass %s: %zu fragments shaded per frame, %.2f per pixel\n", depthPrepass ? "on" : "off", perFrame,
+					(float)perFrame / (mainWindow.getBufferWidth() * mainWindow.getBufferHeight()));
+
+				depthPrepass = !depthPrepass;
+				benchmarkFrames = benchmarkShadedSamples = 0;
+				benchmarkStart = now;
+			}
+		}
+		else if (gpuCullingBenchmark) {
+			benchmarkFrames++;
+			benchmarkFrameTime += deltaTime;
+			benchmarkCpuTime += frameCpuTime;
+			benchmarkTriangles += Mesh::GetSubmittedTriangles();
+			benchmarkDraws += Mesh::GetSubmittedDraws();
+
+			if (now - benchmarkStart >= benchmarkSeconds) {
+				printf("GPU culling %s: %.2f ms per frame, %.2f ms of it on the CPU, %zu triangles in %zu draw calls submitted from the CPU\n",
+					gpuCulling ? "on" : "off", benchmarkFrameTime * 1e3 / benchmarkFrames, benchmarkCpuTime * 1e3 / benchmarkFrames,
+					benchmarkTriangles / benchmarkFrames, benchmarkDraws / benchmarkFrames);
+
+				if (gpuCulling) {
+					GpuCullStats gpuStats = gpuScene.ReadStats(gpuMainView);
+					printf("  main view: %zu of %zu instances drawn, %zu triangles\n", gpuStats.drawn, gpuStats.instances, gpuStats.triangles);
+				}
+
+				gpuCulling = gpuCullingSupported && !gpuCulling;
+				benchmarkFrames = benchmarkTriangles = benchmarkDraws = 0;
+				benchmarkFrameTime = benchmarkCpuTime = 0.0;
+				benchmarkStart = now;
+			}
+		}
+		else if (lightingBenchmark && !loadingDone) {
+			// Streaming would weigh on the first step only.
+			benchmarkStart = now;
+		}
+		else if (lightingBenchmark) {
+			// Waits on the GPU, which the frame times include.
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(lightingTimer, GL_QUERY_RESULT, &elapsed);
+
+			benchmarkFrames++;
+			benchmarkMainGpuTime += elapsed / 1e6;
+			benchmarkFrameTime += deltaTime;
+
+			if (now - benchmarkStart >= benchmarkSeconds) {
+				printf("%s, %u fill lights: %.3f ms GPU in the main view, %.2f ms per frame\n", deferredShading ? "Deferred" : "Forward",
+					fillLights.GetCount(), benchmarkMainGpuTime / benchmarkFrames, benchmarkFrameTime * 1e3 / benchmarkFrames);
+
+				if (!deferredShading && deferredSupported) {
+					deferredShading = true;
+				}
+				else {
+					deferredShading = false;
+					lightingBenchmarkStep = (lightingBenchmarkStep + 1) % lightingBenchmarkSteps;
+
+					if (lightingBenchmarkStep == 0 && headless) {
+						mainWindow.setShouldClose(true);
+					}
+
+					fillLights.Scatter(lightingBenchmarkLights[lightingBenchmarkStep], fillLightMin, fillLightMax, fillLightRadius, fillLightIntensity);
+				}
+
+				benchmarkFrames = 0;
+				benchmarkFrameTime = benchmarkMainGpuTime = 0.0;
+				benchmarkStart = now;
+			}
+		}
+		else if (lodBenchmark) {
+			benchmarkFrames++;
+			benchmarkTriangles += Mesh::GetSubmittedTriangles();
+			benchmarkShadowTriangles += shadowTriangles;
+
+			if (now - benchmarkStart >= benchmarkSeconds) {
+				printf("LOD %s: %zu triangles submitted per frame, %zu of them in shadow passes\n", lodEnabled ? "on" : "off",
+					benchmarkTriangles / benchmarkFrames, benchmarkShadowTriangles / benchmarkFrames);
+
+				// Only the main view culls clusters, so these are per main view.
+				ClusterStats const& clusterStats = Mesh::GetClusterStats();
+				if (clusterStats.clusters > 0) {
+					printf("Clusters: %.1f%% of %zu per view culled, %.1f%% outside the frustum, %.1f%% back-facing\n",
+						100.0 * (clusterStats.frustumCulled + clusterStats.backfaceCulled) / clusterStats.clusters, clusterStats.clusters / benchmarkFrames,
+						100.0 * clusterStats.frustumCulled / clusterStats.clusters, 100.0 * clusterStats.backfaceCulled / clusterStats.clusters);
+				}
+
+				// The culler's counters cover the last frame only.
+				OcclusionStats const& occlusionStats = occlusionCuller.GetStats();
+				if (occlusionCulling && occlusionStats.tested > 0) {
+					printf("Occlusion: %.1f%% of %zu models culled, %zu occluders, %zu triangles in %.3f ms, %.2f us testing\n",
+						100.0 * occlusionStats.culled / occlusionStats.tested, occlusionStats.tested, occlusionStats.occluders,
+						occlusionStats.triangles, occlusionStats.rasterMilliseconds, occlusionStats.testMicroseconds);
+				}
+
+				lodEnabled = !lodEnabled;
+				benchmarkFrames = benchmarkTriangles = benchmarkShadowTriangles = 0;
+				benchmarkStart = now;
+				Mesh::ResetClusterStats();
+			}
+		}
 		
 		glUseProgram(0);
 
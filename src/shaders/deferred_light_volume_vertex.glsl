@@ -0,0 +1,33 @@
+#version 330
+
+layout (location = 0) in vec3 pos;
+
+const int MAX_FILL_LIGHTS = 256;
+
+// As in fragment.glsl.
+struct FillLight
+{
+	vec4 positionRadius;
+	vec4 colorIntensity;
+};
+
+layout (std140) uniform FillLightBlock
+{
+	FillLight fillLights[MAX_FILL_LIGHTS];
+};
+
+flat out int fillLight;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+// The unit icosahedron's faces are this far from its center, scaled by its inverse it encloses the unit sphere.
+const float icosahedronInradius = 0.7946545;
+
+void main()
+{
+	fillLight = gl_InstanceID;
+
+	vec4 positionRadius = fillLights[gl_InstanceID].positionRadius;
+	gl_Position = projection * view * vec4(positionRadius.xyz + pos * (positionRadius.w / icosahedronInradius), 1.0);
+}
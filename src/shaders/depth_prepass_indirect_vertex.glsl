@@ -0,0 +1,21 @@
+#version 330
+
+layout (location = 0) in vec3 pos;
+
+layout (location = 4) in vec4 positionScale;
+layout (location = 5) in vec4 positionOffset;
+
+layout (location = 6) in mat4 model;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+// Must match vertex_indirect.glsl term for term, the color pass only shades fragments at exactly this depth.
+invariant gl_Position;
+
+void main()
+{
+	vec3 position = pos * positionScale.xyz + positionOffset.xyz;
+
+	gl_Position = projection * view * model * vec4(position, 1.0);
+}
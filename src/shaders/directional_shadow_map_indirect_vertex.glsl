@@ -0,0 +1,15 @@
+#version 330
+
+layout (location = 0) in vec3 pos;
+
+layout (location = 4) in vec4 positionScale;
+layout (location = 5) in vec4 positionOffset;
+
+layout (location = 6) in mat4 model;
+
+uniform mat4 directionalLightTransform;
+
+void main()
+{
+	gl_Position = directionalLightTransform * model * vec4(pos * positionScale.xyz + positionOffset.xyz, 1.0);
+}
\ No newline at end of file
@@ -1,15 +1,28 @@
 #version 330
 
+// DEFERRED lights the G-buffer over the whole screen instead, see DeferredRenderer. LIGHT_VOLUME
+// then shades one fill light per instance of deferred_light_volume_vertex.glsl.
+#ifdef DEFERRED
+vec3 Normal;
+vec3 FragPos;
+vec4 DirectionalLightSpacePos;
+
+#ifdef LIGHT_VOLUME
+flat in int fillLight;
+#endif
+#else
 in vec4 vCol;
 in vec2 TexCoord;
 in vec3 Normal;
 in vec3 FragPos;
 in vec4 DirectionalLightSpacePos;
+#endif
 
 out vec4 color;
 
 const int MAX_POINT_LIGHTS = 3;
 const int MAX_SPOT_LIGHTS = 3;
+const int MAX_FILL_LIGHTS = 256;
 
 struct Light
 {
@@ -41,12 +54,21 @@ struct SpotLight
 	float edgeAngle;
 };
 
+// Tiles of the light's cube faces in the shadow atlas, faceScale is 0 without a shadow.
 struct OmniShadowMap
 {
-	samplerCube shadowMap;
+	vec2 faceOffsets[6];
+	float faceScale;
 	float farPlane;
 };
 
+// Unshadowed, fading out to nothing at positionRadius.w, see FillLights.
+struct FillLight
+{
+	vec4 positionRadius;
+	vec4 colorIntensity;
+};
+
 struct Material
 {
 	float specularIntensity;
@@ -62,10 +84,43 @@ uniform SpotLight spotLights[MAX_SPOT_LIGHTS];
 
 uniform OmniShadowMap omniShadowMaps[MAX_POINT_LIGHTS + MAX_SPOT_LIGHTS];
 
+layout (std140) uniform FillLightBlock
+{
+	FillLight fillLights[MAX_FILL_LIGHTS];
+};
+
+uniform int fillLightCount;
+uniform sampler2D omniShadowAtlas;
+
 uniform sampler2D theTexture;
 uniform sampler2D directionalShadowMap;
 
+// 0 filters the depth maps with PCF, 1 reads prefiltered exponential variance moments instead.
+uniform int shadowFilter;
+uniform int momentCount;
+uniform vec2 evsmExponents;
+uniform sampler2D directionalMomentMap;
+uniform sampler2D omniMomentAtlas;
+
+// Cuts off the lowest lit fractions, where overlapping casters leak light.
+const float lightBleedingReduction = 0.2;
+const float evsmVarianceBias = 0.0001;
+
+#ifdef DEFERRED
+Material material;
+
+uniform sampler2D gBufferAlbedo;
+uniform sampler2D gBufferNormal;
+uniform sampler2D gBufferDepth;
+uniform mat4 inverseViewProjection;
+uniform vec2 gBufferViewport;
+uniform mat4 directionalLightTransform;
+
+// As encoded by gbuffer_fragment.glsl.
+const float maxSpecularIntensity = 8.0;
+#else
 uniform Material material;
+#endif
 
 uniform vec3 eyePosition;
 
@@ -103,10 +158,87 @@ vec4 CalcLightByDirection(Light light, vec3 direction, float shadowFactor)
 	return (ambientColor + (1.0 - shadowFactor) * (diffuseColor + specularColor));
 }
 
+// Same face selection and orientation as a cube map lookup, atlasSize in texels of the texture sampled.
+vec2 GetOmniShadowAtlasCoord(int shadowIndex, vec3 direction, float atlasSize)
+{
+	vec3 absolute = abs(direction);
+	int face;
+	vec3 coord;
+
+	if(absolute.x >= absolute.y && absolute.x >= absolute.z)
+	{
+		face = direction.x > 0.0 ? 0 : 1;
+		coord = vec3(direction.x > 0.0 ? -direction.z : direction.z, -direction.y, absolute.x);
+	}
+	else if(absolute.y >= absolute.z)
+	{
+		face = direction.y > 0.0 ? 2 : 3;
+		coord = vec3(direction.x, direction.y > 0.0 ? direction.z : -direction.z, absolute.y);
+	}
+	else
+	{
+		face = direction.z > 0.0 ? 4 : 5;
+		coord = vec3(direction.z > 0.0 ? direction.x : -direction.x, -direction.y, absolute.z);
+	}
+
+	// Stay half a texel inside the tile so filtering never reads a neighbour.
+	float faceScale = omniShadowMaps[shadowIndex].faceScale;
+	float halfTexel = 0.5 / (faceScale * atlasSize);
+	vec2 uv = clamp(coord.xy / coord.z * 0.5 + 0.5, halfTexel, 1.0 - halfTexel);
+
+	return omniShadowMaps[shadowIndex].faceOffsets[face] + uv * faceScale;
+}
+
+float SampleOmniShadowAtlas(int shadowIndex, vec3 direction)
+{
+	return texture(omniShadowAtlas, GetOmniShadowAtlasCoord(shadowIndex, direction, float(textureSize(omniShadowAtlas, 0).x))).r;
+}
+
+// Chebyshev's upper bound on the lit fraction.
+float CalcMomentVisibility(vec2 moments, float mean, float minVariance)
+{
+	if(mean <= moments.x)
+		return 1.0;
+
+	float variance = max(moments.y - moments.x * moments.x, minVariance);
+	float difference = mean - moments.x;
+	float visibility = variance / (variance + difference * difference);
+
+	return clamp((visibility - lightBleedingReduction) / (1.0 - lightBleedingReduction), 0.0, 1.0);
+}
+
+// depth in [0;1] as stored in the shadow map, returns how much is in shadow.
+float CalcEvsmShadowFactor(vec4 moments, float depth)
+{
+	depth = depth * 2.0 - 1.0;
+
+	float positive = exp(evsmExponents.x * depth);
+	float positiveScale = evsmVarianceBias * evsmExponents.x * positive;
+	float visibility = CalcMomentVisibility(moments.xy, positive, positiveScale * positiveScale);
+
+	if(momentCount > 2)
+	{
+		float negative = -exp(-evsmExponents.y * depth);
+		float negativeScale = evsmVarianceBias * evsmExponents.y * negative;
+		visibility = min(visibility, CalcMomentVisibility(moments.zw, negative, negativeScale * negativeScale));
+	}
+
+	return 1.0 - visibility;
+}
+
 float CalcPointShadowFactor(PointLight light, int shadowIndex)
 {
+	if(omniShadowMaps[shadowIndex].faceScale == 0.0)
+		return 0.0;
+
 	vec3 fragToLight = FragPos - light.position;
 	float currentDepth = length(fragToLight);
+
+	if(shadowFilter != 0)
+	{
+		vec4 moments = texture(omniMomentAtlas, GetOmniShadowAtlasCoord(shadowIndex, fragToLight, float(textureSize(omniMomentAtlas, 0).x)));
+		return CalcEvsmShadowFactor(moments, currentDepth / omniShadowMaps[shadowIndex].farPlane);
+	}
 	
 	float shadow = 0.0;
 	float bias   = 0.15;
@@ -115,7 +247,7 @@ float CalcPointShadowFactor(PointLight light, int shadowIndex)
 	float diskRadius = (1.0 + (viewDistance / omniShadowMaps[shadowIndex].farPlane)) / 25.0;
 	for(int i = 0; i < samples; ++i)
 	{
-		float closestDepth = texture(omniShadowMaps[shadowIndex].shadowMap, fragToLight + gridSamplingDisk[i] * diskRadius).r;
+		float closestDepth = SampleOmniShadowAtlas(shadowIndex, fragToLight + gridSamplingDisk[i] * diskRadius);
 		closestDepth *= omniShadowMaps[shadowIndex].farPlane;   // Undo mapping [0;1]
 		if(currentDepth - bias > closestDepth)
 			shadow += 1.0;
@@ -129,6 +261,14 @@ float CalcShadowFactor(vec4 DirectionalLightSpacePos)
 {
 	vec3 projCoords = DirectionalLightSpacePos.xyz / DirectionalLightSpacePos.w;
 	projCoords = projCoords * 0.5 + 0.5;
+
+	if(shadowFilter != 0)
+	{
+		if(projCoords.z > 1.0 || any(lessThan(projCoords.xy, vec2(0.0))) || any(greaterThan(projCoords.xy, vec2(1.0))))
+			return 0.0;
+
+		return CalcEvsmShadowFactor(texture(directionalMomentMap, projCoords.xy), projCoords.z);
+	}
 	
 	float closestDepth = texture(directionalShadowMap, projCoords.xy).r;
 	float currentDepth = projCoords.z;
@@ -157,9 +297,15 @@ float CalcShadowFactor(vec4 DirectionalLightSpacePos)
 	return shadow;
 }
 
+// Faces turned away get no diffuse or specular light, so their shadow maps aren't sampled.
+bool IsFacing(vec3 direction)
+{
+	return dot(Normal, direction) > 0.0;
+}
+
 vec4 CalcDirectionalLight(vec4 DirectionalLightSpacePos)
 {
-	float ShadowFactor = CalcShadowFactor(DirectionalLightSpacePos);
+	float ShadowFactor = IsFacing(directionalLight.direction) ? CalcShadowFactor(DirectionalLightSpacePos) : 0.0;
 	return CalcLightByDirection(directionalLight.base, directionalLight.direction, ShadowFactor);
 }
 
@@ -169,7 +315,7 @@ vec4 CalcPointLight(PointLight pLight, int shadowIndex)
 	float distance = length(direction);
 	direction = normalize(direction);
 	
-	float shadowFactor = CalcPointShadowFactor(pLight, shadowIndex);
+	float shadowFactor = IsFacing(direction) ? CalcPointShadowFactor(pLight, shadowIndex) : 0.0;
 	
 	vec4 color = CalcLightByDirection(pLight.base, direction, shadowFactor);
 	float attenuation = pLight.exponent * distance * distance +
@@ -217,11 +363,95 @@ vec4 CalcSpotLights()
 	return totalColor;
 }
 
+vec4 CalcFillLight(FillLight light)
+{
+	vec3 direction = FragPos - light.positionRadius.xyz;
+	float distanceSquared = dot(direction, direction);
+	float falloff = clamp(1.0 - distanceSquared / (light.positionRadius.w * light.positionRadius.w), 0.0, 1.0);
+
+	if(falloff == 0.0)
+		return vec4(0, 0, 0, 0);
+
+	Light base = Light(light.colorIntensity.rgb, 0.0, light.colorIntensity.a);
+	return CalcLightByDirection(base, direction, 0.0) * falloff * falloff;
+}
+
+vec4 CalcFillLights()
+{
+	vec4 totalColor = vec4(0, 0, 0, 0);
+	for(int i = 0; i < fillLightCount; i++)
+	{
+		totalColor += CalcFillLight(fillLights[i]);
+	}
+
+	return totalColor;
+}
+
+#ifdef DEFERRED
+vec3 OctDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+// Fills in what the forward path interpolates, false for the sky.
+bool ReadGBuffer(out vec3 albedo, out float depth)
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+
+	depth = texelFetch(gBufferDepth, texel, 0).r;
+	if(depth == 1.0)
+		return false;
+
+	vec4 albedoSpecular = texelFetch(gBufferAlbedo, texel, 0);
+	vec4 normalShininess = texelFetch(gBufferNormal, texel, 0);
+
+	albedo = albedoSpecular.rgb;
+	material.specularIntensity = albedoSpecular.a * maxSpecularIntensity;
+	material.shininess = exp2(normalShininess.b * 16.0);
+	Normal = OctDecode(normalShininess.rg * 2.0 - 1.0);
+
+	// The viewport may cover only part of the G-buffer.
+	vec2 screen = gl_FragCoord.xy / gBufferViewport;
+	vec4 position = inverseViewProjection * vec4(vec3(screen, depth) * 2.0 - 1.0, 1.0);
+	FragPos = position.xyz / position.w;
+	DirectionalLightSpacePos = directionalLightTransform * vec4(FragPos, 1.0);
+
+	return true;
+}
+
+void main()
+{
+	vec3 albedo;
+	float depth;
+
+	if(!ReadGBuffer(albedo, depth))
+		discard;
+
+#ifdef LIGHT_VOLUME
+	color = vec4(albedo, 1.0) * CalcFillLight(fillLights[fillLight]);
+#else
+	vec4 finalColor = CalcDirectionalLight(DirectionalLightSpacePos);
+	finalColor += CalcPointLights();
+	finalColor += CalcSpotLights();
+
+	color = vec4(albedo, 1.0) * finalColor;
+
+	// For the light volumes' depth test and the skybox after them.
+	gl_FragDepth = depth;
+#endif
+}
+#else
 void main()
 {
 	vec4 finalColor = CalcDirectionalLight(DirectionalLightSpacePos);
 	finalColor += CalcPointLights();
 	finalColor += CalcSpotLights();
+	finalColor += CalcFillLights();
 	
 	color = texture(theTexture, TexCoord) * finalColor;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#version 330
+
+in vec2 TexCoord;
+in vec3 Normal;
+
+// Read back by fragment.glsl's deferred variant, which undoes the same encoding.
+layout (location = 0) out vec4 albedoSpecular;
+layout (location = 1) out vec4 normalShininess;
+
+struct Material
+{
+	float specularIntensity;
+	float shininess;
+};
+
+uniform Material material;
+
+uniform sampler2D theTexture;
+
+const float maxSpecularIntensity = 8.0;
+
+vec2 OctEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if(n.z < 0.0)
+		e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return e;
+}
+
+void main()
+{
+	albedoSpecular = vec4(texture(theTexture, TexCoord).rgb, material.specularIntensity / maxSpecularIntensity);
+	normalShininess = vec4(OctEncode(normalize(Normal)) * 0.5 + 0.5, log2(max(material.shininess, 1.0)) / 16.0, 0.0);
+}
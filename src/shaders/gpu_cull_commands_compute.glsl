@@ -0,0 +1,28 @@
+#version 430
+
+layout (local_size_x = 64) in;
+
+// DrawElementsIndirectCommand.
+struct DrawCommand {
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 2) readonly buffer Counters { uint counters[]; };
+layout (std430, binding = 4) buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 5) readonly buffer CommandCounters { uint commandCounters[]; };
+
+// Every mesh of a model draws the same instances at a given LOD, their commands share its counter.
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+
+	if (index >= uint(commands.length())) {
+		return;
+	}
+
+	commands[index].instanceCount = counters[commandCounters[index]];
+}
@@ -0,0 +1,155 @@
+#version 430
+
+layout (local_size_x = 64) in;
+
+struct Instance {
+	mat4 transform;
+	uint model;
+};
+
+// Bounds in model space, errors of each LOD in model units, and where the model's
+// LOD counters and transform lists start. capacity is 0 until the model has loaded.
+struct ModelInfo {
+	vec4 boundsMin;
+	vec4 boundsMax;
+	vec4 lodErrors[2];
+	uint lodCount;
+	uint counterBase;
+	uint slotBase;
+	uint capacity;
+};
+
+layout (std430, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout (std430, binding = 1) readonly buffer Models { ModelInfo models[]; };
+layout (std430, binding = 2) buffer Counters { uint counters[]; };
+layout (std430, binding = 3) writeonly buffer Transforms { mat4 transforms[]; };
+
+uniform mat4 cullViewProjection;
+uniform vec3 cullEye;
+
+uniform float lodProjectionScale;
+uniform float lodMaxPixels;
+uniform int lodBias;
+
+// Farthest depth pyramid of the last frame in window depth, and the view it was seen from.
+uniform bool occlusionEnabled;
+uniform mat4 occlusionViewProjection;
+uniform sampler2D hiZ;
+
+vec3 BoxCorner(ModelInfo model, int corner)
+{
+	return mix(model.boundsMin.xyz, model.boundsMax.xyz, vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1));
+}
+
+// Outside only when every corner is beyond the same clip plane.
+bool IsInFrustum(ModelInfo model, mat4 modelViewProjection)
+{
+	uint outside = 63u;
+
+	for (int i = 0; i < 8; i++) {
+		vec4 clip = modelViewProjection * vec4(BoxCorner(model, i), 1.0);
+
+		uint planes = 0u;
+		planes |= clip.x < -clip.w ? 1u : 0u;
+		planes |= clip.x > clip.w ? 2u : 0u;
+		planes |= clip.y < -clip.w ? 4u : 0u;
+		planes |= clip.y > clip.w ? 8u : 0u;
+		planes |= clip.z < -clip.w ? 16u : 0u;
+		planes |= clip.z > clip.w ? 32u : 0u;
+		outside &= planes;
+	}
+
+	return outside == 0u;
+}
+
+// Hidden when the box's nearest depth lies behind the farthest depth under its screen rectangle,
+// read from the level where the rectangle spans a texel or less. Boxes that crossed the near plane
+// or the edge of the screen count as visible.
+bool IsOccluded(ModelInfo model, mat4 modelViewProjection)
+{
+	vec2 rectMin = vec2(1.0);
+	vec2 rectMax = vec2(-1.0);
+	float nearest = 1.0;
+
+	for (int i = 0; i < 8; i++) {
+		vec4 clip = modelViewProjection * vec4(BoxCorner(model, i), 1.0);
+
+		if (clip.w <= 0.0) {
+			return false;
+		}
+
+		vec3 ndc = clip.xyz / clip.w;
+		rectMin = min(rectMin, ndc.xy);
+		rectMax = max(rectMax, ndc.xy);
+		nearest = min(nearest, ndc.z);
+	}
+
+	if (any(lessThan(rectMin, vec2(-1.0))) || any(greaterThan(rectMax, vec2(1.0)))) {
+		return false;
+	}
+
+	rectMin = rectMin * 0.5 + 0.5;
+	rectMax = rectMax * 0.5 + 0.5;
+	nearest = nearest * 0.5 + 0.5;
+
+	vec2 extent = (rectMax - rectMin) * vec2(textureSize(hiZ, 0));
+	int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, textureQueryLevels(hiZ) - 1);
+
+	ivec2 size = textureSize(hiZ, level);
+	ivec2 first = clamp(ivec2(rectMin * vec2(size)), ivec2(0), size - 1);
+	ivec2 last = clamp(ivec2(rectMax * vec2(size)), ivec2(0), size - 1);
+
+	float farthest = 0.0;
+
+	for (int y = first.y; y <= last.y; y++) {
+		for (int x = first.x; x <= last.x; x++) {
+			farthest = max(farthest, texelFetch(hiZ, ivec2(x, y), level).r);
+		}
+	}
+
+	return nearest > farthest;
+}
+
+// Coarsest LOD whose error projects to at most lodMaxPixels, as Model::SelectLod without the hysteresis.
+uint SelectLod(ModelInfo model, mat4 transform)
+{
+	float scale = max(length(transform[0].xyz), max(length(transform[1].xyz), length(transform[2].xyz)));
+	vec3 center = (transform * vec4((model.boundsMin.xyz + model.boundsMax.xyz) * 0.5, 1.0)).xyz;
+	float radius = length(model.boundsMax.xyz - model.boundsMin.xyz) * 0.5;
+	float distance = max(length(center - cullEye) - radius * scale, 0.01);
+
+	uint lod = 0u;
+
+	for (uint i = 1u; i < model.lodCount; i++) {
+		if (model.lodErrors[i / 4u][i % 4u] * scale * lodProjectionScale / distance <= lodMaxPixels) {
+			lod = i;
+		}
+	}
+
+	return min(lod + uint(lodBias), model.lodCount - 1u);
+}
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+
+	if (index >= uint(instances.length())) {
+		return;
+	}
+
+	mat4 transform = instances[index].transform;
+	ModelInfo model = models[instances[index].model];
+
+	if (model.capacity == 0u || !IsInFrustum(model, cullViewProjection * transform)) {
+		return;
+	}
+
+	if (occlusionEnabled && IsOccluded(model, occlusionViewProjection * transform)) {
+		return;
+	}
+
+	uint lod = SelectLod(model, transform);
+	uint slot = atomicAdd(counters[model.counterBase + lod], 1u);
+
+	transforms[model.slotBase + lod * model.capacity + slot] = transform;
+}
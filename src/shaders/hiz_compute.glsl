@@ -0,0 +1,35 @@
+#version 430
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// Level 0 reads the copied depth buffer, every other level the one before it.
+uniform sampler2D hiZSource;
+uniform int hiZSourceLevel;
+
+layout (r32f, binding = 0) uniform writeonly image2D hiZDestination;
+
+void main()
+{
+	ivec2 size = imageSize(hiZDestination);
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+
+	if (any(greaterThanEqual(texel, size))) {
+		return;
+	}
+
+	// Farthest of each 2x2 block, the last row and column also take the odd source row and column.
+	ivec2 sourceSize = textureSize(hiZSource, hiZSourceLevel);
+	ivec2 first = texel * 2;
+	ivec2 last = first + 1 + ivec2(equal(texel, size - 1)) * (sourceSize - size * 2);
+	last = min(last, sourceSize - 1);
+
+	float depth = 0.0;
+
+	for (int y = first.y; y <= last.y; y++) {
+		for (int x = first.x; x <= last.x; x++) {
+			depth = max(depth, texelFetch(hiZSource, ivec2(x, y), hiZSourceLevel).r);
+		}
+	}
+
+	imageStore(hiZDestination, texel, vec4(depth));
+}
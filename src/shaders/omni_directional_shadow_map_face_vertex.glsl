@@ -0,0 +1,32 @@
+#version 330
+layout (location = 0) in vec3 pos;
+
+layout (location = 4) in vec4 positionScale;
+layout (location = 5) in vec4 positionOffset;
+
+uniform mat4 model;
+uniform mat4 lightMatrices[6];
+
+// The face being drawn in faces[0].
+uniform int faces[6];
+
+// The light's tiles in the shadow atlas.
+uniform vec2 faceOffsets[6];
+uniform float faceScale;
+
+out vec4 FragPos;
+
+void main()
+{
+	int face = faces[0];
+
+	FragPos = model * vec4(pos * positionScale.xyz + positionOffset.xyz, 1.0);
+	vec4 position = lightMatrices[face] * FragPos;
+
+	// Clip to the face frustum, then squeeze it into its tile.
+	gl_ClipDistance[0] = position.w + position.x;
+	gl_ClipDistance[1] = position.w - position.x;
+	gl_ClipDistance[2] = position.w + position.y;
+	gl_ClipDistance[3] = position.w - position.y;
+	gl_Position = vec4(position.xy * faceScale + (faceOffsets[face] * 2.0 + faceScale - 1.0) * position.w, position.zw);
+}
@@ -4,17 +4,27 @@ layout (triangle_strip, max_vertices=18) out;
 
 uniform mat4 lightMatrices[6];
 
+// The light's tiles in the shadow atlas.
+uniform vec2 faceOffsets[6];
+uniform float faceScale;
+
 out vec4 FragPos;
 
 void main()
 {
 	for(int face = 0; face < 6; ++face)
 	{ 
-		gl_Layer = face;
 		for(int i = 0; i < 3; i++)
 		{
 			FragPos = gl_in[i].gl_Position;
-			gl_Position = lightMatrices[face] * FragPos;
+			vec4 position = lightMatrices[face] * FragPos;
+
+			// Clip to the face frustum, then squeeze it into its tile.
+			gl_ClipDistance[0] = position.w + position.x;
+			gl_ClipDistance[1] = position.w - position.x;
+			gl_ClipDistance[2] = position.w + position.y;
+			gl_ClipDistance[3] = position.w - position.y;
+			gl_Position = vec4(position.xy * faceScale + (faceOffsets[face] * 2.0 + faceScale - 1.0) * position.w, position.zw);
 			EmitVertex();
 		}
 		EndPrimitive();
@@ -1,9 +1,12 @@
 #version 330
 layout (location = 0) in vec3 pos;
 
+layout (location = 4) in vec4 positionScale;
+layout (location = 5) in vec4 positionOffset;
+
 uniform mat4 model;
  
 void main()
 {
-	gl_Position = model * vec4(pos, 1.0);
+	gl_Position = model * vec4(pos * positionScale.xyz + positionOffset.xyz, 1.0);
 } 
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 330
+
+out vec4 color;
+
+// Blended additively, each shaded fragment warms the pixel: red after 8, yellow after 16, white after 32.
+void main()
+{
+	color = vec4(0.125, 0.0625, 0.03125, 1.0);
+}
@@ -0,0 +1,59 @@
+#version 330
+
+out vec4 moments;
+
+// Depth on the first pass, with downsample depth texels per moment texel, moments on the second.
+uniform sampler2D filterSource;
+uniform int downsample;
+
+uniform ivec2 blurDirection;
+uniform int blurRadius;
+
+// First and last texels of the tile, taps past them are clamped.
+uniform ivec4 filterBounds;
+
+uniform int momentCount;
+uniform vec2 evsmExponents;
+
+// Moments average correctly where depths don't, so depth is warped before it's blurred.
+vec4 WarpDepth(float depth)
+{
+	depth = depth * 2.0 - 1.0;
+	float positive = exp(evsmExponents.x * depth);
+	float negative = momentCount > 2 ? -exp(-evsmExponents.y * depth) : 0.0;
+	return vec4(positive, positive * positive, negative, negative * negative);
+}
+
+vec4 FetchMoments(ivec2 texel)
+{
+	texel = clamp(texel, filterBounds.xy, filterBounds.zw);
+
+	if(downsample == 0)
+		return texelFetch(filterSource, texel, 0);
+
+	vec4 sum = vec4(0.0);
+	for(int y = 0; y < downsample; y++)
+	{
+		for(int x = 0; x < downsample; x++)
+			sum += WarpDepth(texelFetch(filterSource, texel * downsample + ivec2(x, y), 0).r);
+	}
+
+	return sum / float(downsample * downsample);
+}
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	float sigma = max(float(blurRadius) * 0.5, 0.5);
+
+	vec4 sum = vec4(0.0);
+	float weights = 0.0;
+	for(int i = -blurRadius; i <= blurRadius; i++)
+	{
+		float weight = exp(-float(i * i) / (2.0 * sigma * sigma));
+		sum += FetchMoments(texel + blurDirection * i) * weight;
+		weights += weight;
+	}
+
+	moments = sum / weights;
+}
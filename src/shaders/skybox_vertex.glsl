@@ -10,5 +10,7 @@ uniform mat4 view;
 void main()
 {
 	TexCoords = pos;
-	gl_Position = projection * view * vec4(pos, 1.0);
+
+	// Pinned to the far plane, so only pixels nothing else covered pass the depth test.
+	gl_Position = (projection * view * vec4(pos, 1.0)).xyww;
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+#version 330
+
+out vec4 color;
+
+// The window and the source are the same size, the scene was rendered to the part of the source
+// from the corner to upscaleExtent, in texture coordinates. Sampled bilinear.
+uniform sampler2D upscaleSource;
+uniform vec2 upscaleExtent;
+
+// 0 leaves the stretch as it is, 1 sharpens the most.
+uniform float sharpening;
+
+vec3 Fetch(vec2 uv, vec2 lowest, vec2 highest)
+{
+	return texture(upscaleSource, clamp(uv, lowest, highest)).rgb;
+}
+
+void main()
+{
+	vec2 texelSize = 1.0 / vec2(textureSize(upscaleSource, 0));
+
+	// Half a texel in from the rendered part's edges, so nothing past them is blended in.
+	vec2 lowest = texelSize * 0.5;
+	vec2 highest = upscaleExtent - texelSize * 0.5;
+	vec2 uv = gl_FragCoord.xy * texelSize * upscaleExtent;
+
+	vec3 center = Fetch(uv, lowest, highest);
+
+	if(sharpening <= 0.0)
+	{
+		color = vec4(center, 1.0);
+		return;
+	}
+
+	vec3 left = Fetch(uv - vec2(texelSize.x, 0.0), lowest, highest);
+	vec3 right = Fetch(uv + vec2(texelSize.x, 0.0), lowest, highest);
+	vec3 down = Fetch(uv - vec2(0.0, texelSize.y), lowest, highest);
+	vec3 up = Fetch(uv + vec2(0.0, texelSize.y), lowest, highest);
+
+	// Contrast adaptive sharpening: the neighbours are subtracted from the center, less where they
+	// already span most of the range, so strong edges don't ring.
+	vec3 darkest = min(center, min(min(left, right), min(down, up)));
+	vec3 brightest = max(center, max(max(left, right), max(down, up)));
+	vec3 headroom = clamp(min(darkest, 1.0 - brightest) / max(brightest, vec3(1e-4)), 0.0, 1.0);
+	vec3 weight = -sqrt(headroom) * sharpening * 0.2;
+
+	vec3 sharpened = (center + (left + right + down + up) * weight) / (1.0 + 4.0 * weight);
+	color = vec4(clamp(sharpened, 0.0, 1.0), 1.0);
+}
@@ -4,6 +4,10 @@ layout (location = 0) in vec3 pos;
 layout (location = 1) in vec2 tex;
 layout (location = 2) in vec3 norm;
 
+// Per-mesh dequantization, see Mesh::RenderMesh. positionOffset.w flags octahedral normals.
+layout (location = 4) in vec4 positionScale;
+layout (location = 5) in vec4 positionOffset;
+
 out vec4 vCol;
 out vec2 TexCoord;
 out vec3 Normal;
@@ -15,17 +19,32 @@ uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 directionalLightTransform;
 
+// Computed exactly as in the depth prepass, so the depths match for the GL_EQUAL test.
+invariant gl_Position;
+
+vec3 OctDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 void main()
 {
-	gl_Position = projection * view * model * vec4(pos, 1.0);
+	vec3 position = pos * positionScale.xyz + positionOffset.xyz;
+	vec3 normal = positionOffset.w > 0.5 ? OctDecode(norm.xy) : norm;
+
+	gl_Position = projection * view * model * vec4(position, 1.0);
 	
-	DirectionalLightSpacePos = directionalLightTransform * model * vec4(pos, 1.0);
+	DirectionalLightSpacePos = directionalLightTransform * model * vec4(position, 1.0);
 	
-	vCol = vec4(clamp(pos, 0.0f, 1.0f), 1.0f);
+	vCol = vec4(clamp(position, 0.0f, 1.0f), 1.0f);
 	
 	TexCoord = tex;
 	
-	Normal = mat3(transpose(inverse(model))) * norm;
+	Normal = mat3(transpose(inverse(model))) * normal;
 	
-	FragPos = (model * vec4(pos, 1.0)).xyz; 
+	FragPos = (model * vec4(position, 1.0)).xyz; 
 }
\ No newline at end of file
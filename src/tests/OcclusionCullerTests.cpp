@@ -0,0 +1,99 @@
+#include <stdio.h>
+
+#include <glm\glm.hpp>
+#include <glm\gtc\matrix_transform.hpp>
+
+#include <OcclusionCuller.hpp>
+#include <JobPool.hpp>
+
+// Rasterizes a wall in front of the camera and checks IsVisible against boxes around it. Run by ctest,
+// returns nonzero when a check fails.
+
+namespace {
+
+	int failures = 0;
+
+	void Check(bool condition, char const* name)
+	{
+		printf("%s %s\n", condition ? "pass" : "FAIL", name);
+		failures += condition ? 0 : 1;
+	}
+
+	OccluderMesh CreateBox()
+	{
+		OccluderMesh box;
+
+		for (int i = 0; i < 8; i++) {
+			box.positions.push_back(glm::vec3(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f));
+		}
+
+		box.indices = {
+			0, 2, 1, 1, 2, 3,	4, 5, 6, 5, 7, 6,
+			0, 1, 4, 1, 5, 4,	2, 6, 3, 3, 6, 7,
+			0, 4, 2, 2, 4, 6,	1, 3, 5, 3, 7, 5
+		};
+
+		box.center = glm::vec3(0.f);
+		box.radius = glm::length(glm::vec3(0.5f));
+
+		return box;
+	}
+
+}
+
+int main()
+{
+	JobPool jobPool;
+	jobPool.Init();
+
+	// The camera sits at the origin looking down -z. The wall spans -3 to 3 in x and y, its front face at z = -4.5.
+	glm::mat4 viewProjection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 100.f);
+	glm::mat4 wallTransform = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -5.f)), glm::vec3(6.f, 6.f, 1.f));
+
+	OccluderMesh box = CreateBox();
+	OcclusionCuller culler;
+
+	auto visible = [&](glm::vec3 const& boundsMin, glm::vec3 const& boundsMax) {
+		return culler.IsVisible(viewProjection, boundsMin, boundsMax);
+	};
+
+	culler.Begin(viewProjection);
+	culler.Rasterize(&jobPool);
+
+	Check(visible(glm::vec3(-0.5f, -0.5f, -10.5f), glm::vec3(0.5f, 0.5f, -9.5f)), "nothing is hidden without occluders");
+
+	culler.Begin(viewProjection);
+	culler.AddOccluder(&box, wallTransform);
+	culler.Rasterize(&jobPool);
+
+	Check(culler.GetStats().occluders == 1, "the wall is rasterized");
+
+	Check(!visible(glm::vec3(-0.5f, -0.5f, -10.5f), glm::vec3(0.5f, 0.5f, -9.5f)), "a box behind the wall is hidden");
+	Check(!visible(glm::vec3(-2.f, -2.f, -30.f), glm::vec3(2.f, 2.f, -20.f)), "a large box far behind the wall is hidden");
+
+	// The wall's edge is at x / -z = 0.67, the box runs from 0.4 to 1.
+	Check(visible(glm::vec3(4.f, -0.5f, -10.5f), glm::vec3(10.f, 0.5f, -9.5f)), "a box partly behind the wall is visible");
+	Check(visible(glm::vec3(8.f, -0.5f, -10.5f), glm::vec3(9.f, 0.5f, -9.5f)), "a box beside the wall is visible");
+
+	Check(visible(glm::vec3(-0.5f, -0.5f, -20.f), glm::vec3(0.5f, 0.5f, 0.5f)), "a box straddling the near plane is visible");
+	Check(visible(glm::vec3(-0.5f, -0.5f, -20.f), glm::vec3(0.5f, 0.5f, -0.05f)), "a box crossing the near plane is visible");
+
+	Check(visible(glm::vec3(-0.5f, -0.5f, -6.f), glm::vec3(0.5f, 0.5f, -4.f)), "a box poking out of the wall is visible");
+	Check(visible(glm::vec3(-0.5f, -0.5f, -5.f), glm::vec3(0.5f, 0.5f, -4.5f)), "a box touching the wall's front face is visible");
+	Check(!visible(glm::vec3(-0.5f, -0.5f, -5.4f), glm::vec3(0.5f, 0.5f, -4.6f)), "a box inside the wall is hidden");
+	Check(visible(glm::vec3(-0.5f, -0.5f, -3.f), glm::vec3(0.5f, 0.5f, -2.f)), "a box in front of the wall is visible");
+
+	Check(visible(glm::vec3(-0.5f, -0.5f, 9.5f), glm::vec3(0.5f, 0.5f, 10.5f)), "a box behind the camera is left to frustum culling");
+
+	size_t tested = culler.GetStats().tested;
+	size_t culled = culler.GetStats().culled;
+
+	Check(!culler.IsVisible(viewProjection, glm::vec3(-0.5f, -0.5f, -10.5f), glm::vec3(0.5f, 0.5f, -9.5f), false), "an uncounted test still culls");
+	Check(culler.GetStats().tested == tested && culler.GetStats().culled == culled, "an uncounted test leaves the stats alone");
+	Check(tested == 11 && culled == 3, "every counted test is in the stats");
+
+	jobPool.Shutdown();
+
+	printf("%d failed\n", failures);
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <stb_image.h>
+
+#include <AssetCooker.hpp>
+#include <JobPool.hpp>
+
+// Cooks what changed since the last run, see AssetCooker.
+//
+//   asset_builder <source dir> <output dir> [--pack name] [--threads N] [--changed file]... [--dependents file]
+//
+// Cooked textures go to <output dir>/cooked, where Texture looks for them, and the
+// manifest that makes the next run incremental next to them. --pack also writes the
+// asset pack to <output dir>/name. --changed limits the build to what the given
+// sources feed, as the hot reload does; --dependents also lists what uses a source.
+
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		printf("usage: %s <source dir> <output dir> [--pack name] [--threads N] [--changed file]... [--dependents file]\n", argv[0]);
+		return 1;
+	}
+
+	std::string packPath;
+	std::string dependentsOf;
+	std::vector<std::string> changed;
+	unsigned int threads = 0;
+
+	for (int i = 3; i < argc; i++) {
+		if (!strcmp(argv[i], "--pack") && i + 1 < argc) {
+			packPath = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			threads = (unsigned int)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--changed") && i + 1 < argc) {
+			changed.push_back(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--dependents") && i + 1 < argc) {
+			dependentsOf = argv[++i];
+		}
+		else {
+			printf("Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	JobPool jobPool;
+	jobPool.Init(threads);
+
+	AssetCooker cooker;
+	cooker.Init(argv[1], argv[2], &jobPool);
+	cooker.SetPackPath(packPath);
+
+	AssetCookStats stats;
+	bool built = cooker.Build(stats, changed);
+
+	for (auto const& output : stats.cookedOutputs) {
+		printf("Cooked %s\n", output.c_str());
+	}
+
+	for (auto const& output : stats.removedOutputs) {
+		printf("Removed %s, its source is gone\n", output.c_str());
+	}
+
+	printf("Assets: %zu sources, %zu read again, %zu of %zu outputs cooked, %zu removed, %zu failed, %.0f ms on %u threads\n", stats.sources,
+		stats.hashed, stats.cooked, stats.outputs, stats.removed, stats.failed, stats.milliseconds, jobPool.GetWorkerCount() + 1);
+
+	if (!dependentsOf.empty()) {
+		for (auto const& dependent : cooker.GetDependents(dependentsOf)) {
+			printf("%s is used by %s\n", dependentsOf.c_str(), dependent.c_str());
+		}
+	}
+
+	jobPool.Shutdown();
+
+	return built ? 0 : 1;
+}
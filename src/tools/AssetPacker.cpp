@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <AssetPack.hpp>
+
+// Packs the loose assets into the single file the engine mounts at startup.
+//
+//   asset_packer <output.pack> <root> <dir>... [--store .ext]...
+//   asset_packer --verify <pack>
+//   asset_packer --benchmark <pack> <root>
+//
+// Every file under each root/dir is packed under its path relative to root, which is
+// the name the loaders ask for. Files that shrink by an eighth are stored compressed,
+// except extensions given with --store; cooked .ktx2 files are always stored as they
+// are so streamed levels stay zero-copy. Missing directories are skipped.
+// --verify decompresses and hashes every entry. --benchmark reads every packed asset
+// once from the loose files and once from the pack, each after dropping it from the
+// OS's file cache, and reports the files opened and the time taken.
+
+namespace fs = std::filesystem;
+
+namespace {
+
+	double GetMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string ToLower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)tolower(c); });
+		return text;
+	}
+
+	// Cold cache without root: clean pages of a file go when asked to. Elsewhere the reads are warm.
+	bool Evict(std::string const& path)
+	{
+#ifdef __linux__
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+
+		bool evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+		close(fd);
+		return evicted;
+#else
+		return false;
+#endif
+	}
+
+	int Pack(int argc, char** argv)
+	{
+		std::string output = argv[1];
+		fs::path root = argv[2];
+		std::vector<std::string> directories;
+		std::vector<std::string> stored = { ".ktx2" };
+
+		for (int i = 3; i < argc; i++) {
+			if (!strcmp(argv[i], "--store") && i + 1 < argc) {
+				stored.push_back(ToLower(argv[++i]));
+			}
+			else {
+				directories.push_back(argv[i]);
+			}
+		}
+
+		std::vector<PackInput> inputs;
+		size_t totalBytes = 0;
+
+		for (auto const& directory : directories) {
+			std::error_code ec;
+			if (!fs::is_directory(root / directory, ec)) {
+				printf("Skipping %s, not a directory\n", (root / directory).string().c_str());
+				continue;
+			}
+
+			for (auto const& file : fs::recursive_directory_iterator(root / directory)) {
+				if (!file.is_regular_file()) {
+					continue;
+				}
+
+				std::string extension = ToLower(file.path().extension().string());
+
+				PackInput input;
+				input.name = file.path().lexically_relative(root).generic_string();
+				input.path = file.path().string();
+				input.compress = std::find(stored.begin(), stored.end(), extension) == stored.end();
+
+				totalBytes += (size_t)file.file_size();
+				inputs.push_back(input);
+			}
+		}
+
+		// Deterministic output whatever order the directories list in.
+		std::sort(inputs.begin(), inputs.end(), [](PackInput const& a, PackInput const& b) { return a.name < b.name; });
+
+		auto start = std::chrono::steady_clock::now();
+
+		unsigned int compressedCount = 0;
+		if (!AssetPack::Write(output, inputs, compressedCount)) {
+			return 1;
+		}
+
+		std::error_code ec;
+		size_t packBytes = (size_t)fs::file_size(output, ec);
+
+		printf("Packed %zu files, %.1f MB -> %.1f MB, %u compressed, in %.0f ms\n", inputs.size(), totalBytes / (1024.0 * 1024.0),
+			packBytes / (1024.0 * 1024.0), compressedCount, GetMilliseconds(start));
+
+		return 0;
+	}
+
+	int Verify(std::string const& path)
+	{
+		AssetPack pack;
+		if (!pack.Open(path)) {
+			printf("Failed to open %s\n", path.c_str());
+			return 1;
+		}
+
+		unsigned int failures = 0;
+		for (uint32_t i = 0; i < pack.GetEntryCount(); i++) {
+			PackEntry const& entry = pack.GetEntries()[i];
+
+			if (!pack.Verify(entry)) {
+				printf("%s doesn't match its hash\n", pack.GetName(entry));
+				failures++;
+			}
+		}
+
+		printf("%s: %u entries, %u damaged\n", path.c_str(), pack.GetEntryCount(), failures);
+		return failures > 0 ? 1 : 0;
+	}
+
+	int Benchmark(std::string const& path, fs::path const& root)
+	{
+		std::vector<std::string> names;
+		{
+			AssetPack pack;
+			if (!pack.Open(path)) {
+				printf("Failed to open %s\n", path.c_str());
+				return 1;
+			}
+
+			for (uint32_t i = 0; i < pack.GetEntryCount(); i++) {
+				names.push_back(pack.GetName(pack.GetEntries()[i]));
+			}
+		}
+
+		bool cold = Evict(path);
+		for (auto const& name : names) {
+			cold = Evict((root / name).string()) && cold;
+		}
+
+		// One byte of every page is read, which brings a mapped page in; the decoders would read the rest.
+		auto touch = [](PackView const& view) {
+			uint32_t sum = 0;
+			for (size_t i = 0; i < view.GetSize(); i += 4096) {
+				sum += view.GetData()[i];
+			}
+			return sum;
+		};
+
+		uint32_t looseSum = 0;
+		size_t looseBytes = 0;
+		size_t opensBefore = AssetPack::GetFileOpenCount();
+		auto start = std::chrono::steady_clock::now();
+
+		for (auto const& name : names) {
+			PackView view;
+			if (!AssetPack::Load((root / name).string(), view)) {
+				printf("Failed to read %s\n", (root / name).string().c_str());
+				return 1;
+			}
+
+			looseSum += touch(view);
+			looseBytes += view.GetSize();
+		}
+
+		double looseMilliseconds = GetMilliseconds(start);
+		size_t looseOpens = AssetPack::GetFileOpenCount() - opensBefore;
+
+		uint32_t packSum = 0;
+		opensBefore = AssetPack::GetFileOpenCount();
+		start = std::chrono::steady_clock::now();
+
+		AssetPack pack;
+		pack.Open(path);
+		AssetPack::Mount(&pack);
+
+		for (auto const& name : names) {
+			PackView view;
+			if (!AssetPack::LoadPacked(name, view)) {
+				printf("Failed to read %s from the pack\n", name.c_str());
+				return 1;
+			}
+
+			packSum += touch(view);
+		}
+
+		double packMilliseconds = GetMilliseconds(start);
+		size_t packOpens = AssetPack::GetFileOpenCount() - opensBefore;
+		AssetPack::Mount(nullptr);
+
+		if (packSum != looseSum) {
+			printf("The pack doesn't match the loose files under %s\n", root.string().c_str());
+			return 1;
+		}
+
+		printf("%zu assets, %.1f MB, %s cache\n", names.size(), looseBytes / (1024.0 * 1024.0), cold ? "cold" : "warm");
+		printf("Loose files: %zu opened, %.1f ms, %.0f MB/s\n", looseOpens, looseMilliseconds, looseBytes / (1024.0 * 1024.0) / (looseMilliseconds / 1000.0));
+		printf("Pack: %zu opened, %.1f ms, %.0f MB/s\n", packOpens, packMilliseconds, looseBytes / (1024.0 * 1024.0) / (packMilliseconds / 1000.0));
+
+		return 0;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 3 && !strcmp(argv[1], "--verify")) {
+		return Verify(argv[2]);
+	}
+
+	if (argc == 4 && !strcmp(argv[1], "--benchmark")) {
+		return Benchmark(argv[2], argv[3]);
+	}
+
+	if (argc < 4 || argv[1][0] == '-') {
+		printf("Usage: asset_packer <output.pack> <root> <dir>... [--store .ext]...\n");
+		printf("       asset_packer --verify <pack>\n");
+		printf("       asset_packer --benchmark <pack> <root>\n");
+		return 1;
+	}
+
+	return Pack(argc, argv);
+}
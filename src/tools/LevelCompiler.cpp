@@ -0,0 +1,474 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <glm\glm.hpp>
+#include <glm\gtc\quaternion.hpp>
+
+#include <LevelFile.hpp>
+#include <Scene.hpp>
+
+// Compiles a text level into the binary one the engine maps.
+//
+//   level_compiler <input.level> <output.lvl> [--time]
+//   level_compiler --generate <entities> <output.level>
+//
+// One statement per line, # starts a comment. A statement is a keyword, a name
+// where it takes one, then keys each followed by their values:
+//
+//   skybox <right> <left> <top> <bottom> <back> <front>
+//   material <name> specular <intensity> shininess <power>
+//   model <name> <path>
+//   entity <name> [model <name>] [material <name>] [parent <name>]
+//       [position <x y z>] [rotation <pitch yaw roll, degrees>] [scale <s> or <x y z>]
+//   directional_light color <r g b> ambient <a> diffuse <d> direction <x y z> [shadow <w h>]
+//   point_light color <r g b> ambient <a> diffuse <d> position <x y z>
+//       attenuation <constant linear exponent> [shadow <w h>] [planes <near far>]
+//   spot_light, as point_light with direction <x y z> edge <degrees>
+//
+// Parents have to come before their children. --time loads the result back
+// and times mapping it and creating its entities. --generate writes a level of
+// spinning groups to try that on.
+
+namespace {
+
+	struct Compiler {
+		std::vector<LevelModel> models;
+		std::vector<LevelMaterial> materials;
+		std::vector<LevelEntity> entities;
+		std::vector<LevelDirectionalLight> directionalLights;
+		std::vector<LevelPointLight> pointLights;
+		std::vector<LevelSpotLight> spotLights;
+		uint32_t skyboxFaces[6] = {};
+		bool skybox = false;
+
+		std::vector<char> strings;
+		std::map<std::string, uint32_t> stringOffsets;
+		std::map<std::string, uint32_t> modelIndices, materialIndices, entityIndices;
+
+		std::string fileName;
+		int lineNumber = 0;
+
+		uint32_t AddString(std::string const& value)
+		{
+			auto found = stringOffsets.find(value);
+			if (found != stringOffsets.end()) {
+				return found->second;
+			}
+
+			uint32_t offset = (uint32_t)strings.size();
+			strings.insert(strings.end(), value.begin(), value.end());
+			strings.push_back(0);
+			stringOffsets[value] = offset;
+			return offset;
+		}
+
+		bool Error(const char* message, std::string const& detail = "")
+		{
+			printf("%s:%d: %s%s\n", fileName.c_str(), lineNumber, message, detail.c_str());
+			return false;
+		}
+
+		// Reads count numbers after a key, or up to count when some are optional.
+		static bool ReadFloats(std::vector<std::string> const& tokens, size_t& i, float* values, size_t count)
+		{
+			for (size_t j = 0; j < count; j++) {
+				if (i + 1 >= tokens.size()) {
+					return false;
+				}
+
+				char* end = nullptr;
+				values[j] = strtof(tokens[i + 1].c_str(), &end);
+				if (*end != 0) {
+					return false;
+				}
+				i++;
+			}
+
+			return true;
+		}
+
+		static bool IsNumber(std::vector<std::string> const& tokens, size_t i)
+		{
+			char* end = nullptr;
+			return i < tokens.size() && (strtof(tokens[i].c_str(), &end), *end == 0);
+		}
+
+		bool Lookup(std::map<std::string, uint32_t> const& indices, std::string const& name, uint32_t& index, const char* what)
+		{
+			auto found = indices.find(name);
+			if (found == indices.end()) {
+				return Error(what, name);
+			}
+
+			index = found->second;
+			return true;
+		}
+
+		bool ParseLight(std::vector<std::string> const& tokens, LevelPointLight& light, float* direction, float* edgeAngle)
+		{
+			for (size_t i = 1; i < tokens.size(); i++) {
+				std::string const& key = tokens[i];
+				float shadow[2];
+				bool read = true;
+
+				if (key == "color") {
+					read = ReadFloats(tokens, i, light.color, 3);
+				}
+				else if (key == "ambient") {
+					read = ReadFloats(tokens, i, &light.ambientIntensity, 1);
+				}
+				else if (key == "diffuse") {
+					read = ReadFloats(tokens, i, &light.diffuseIntensity, 1);
+				}
+				else if (key == "position") {
+					read = ReadFloats(tokens, i, light.position, 3);
+				}
+				else if (key == "attenuation") {
+					float attenuation[3];
+					read = ReadFloats(tokens, i, attenuation, 3);
+					light.constant = attenuation[0];
+					light.linear = attenuation[1];
+					light.exponent = attenuation[2];
+				}
+				else if (key == "shadow") {
+					read = ReadFloats(tokens, i, shadow, 2);
+					light.shadowWidth = (uint32_t)shadow[0];
+					light.shadowHeight = (uint32_t)shadow[1];
+				}
+				else if (key == "planes") {
+					float planes[2];
+					read = ReadFloats(tokens, i, planes, 2);
+					light.nearPlane = planes[0];
+					light.farPlane = planes[1];
+				}
+				else if (key == "direction" && direction) {
+					read = ReadFloats(tokens, i, direction, 3);
+				}
+				else if (key == "edge" && edgeAngle) {
+					read = ReadFloats(tokens, i, edgeAngle, 1);
+				}
+				else {
+					return Error("unknown key ", key);
+				}
+
+				if (!read) {
+					return Error("missing values after ", key);
+				}
+			}
+
+			return true;
+		}
+
+		bool ParseStatement(std::vector<std::string> const& tokens)
+		{
+			std::string const& keyword = tokens[0];
+
+			if (keyword == "skybox") {
+				if (tokens.size() != 7) {
+					return Error("skybox takes six faces");
+				}
+
+				for (int i = 0; i < 6; i++) {
+					skyboxFaces[i] = AddString(tokens[i + 1]);
+				}
+				skybox = true;
+				return true;
+			}
+
+			if (keyword == "directional_light") {
+				LevelPointLight light = {};
+				float direction[3] = { 0.f, -1.f, 0.f };
+				light.shadowWidth = light.shadowHeight = 2048;
+
+				if (!ParseLight(tokens, light, direction, nullptr)) {
+					return false;
+				}
+
+				LevelDirectionalLight directional = {};
+				memcpy(directional.color, light.color, sizeof(light.color));
+				directional.ambientIntensity = light.ambientIntensity;
+				directional.diffuseIntensity = light.diffuseIntensity;
+				memcpy(directional.direction, direction, sizeof(direction));
+				directional.shadowWidth = light.shadowWidth;
+				directional.shadowHeight = light.shadowHeight;
+				directionalLights.push_back(directional);
+				return true;
+			}
+
+			if (keyword == "point_light" || keyword == "spot_light") {
+				LevelSpotLight spot = {};
+				spot.light.constant = 1.f;
+				spot.light.shadowWidth = spot.light.shadowHeight = 1024;
+				spot.light.nearPlane = 0.1f;
+				spot.light.farPlane = 100.f;
+				spot.direction[1] = -1.f;
+				spot.edgeAngle = 20.f;
+
+				bool isSpot = keyword == "spot_light";
+				if (!ParseLight(tokens, spot.light, isSpot ? spot.direction : nullptr, isSpot ? &spot.edgeAngle : nullptr)) {
+					return false;
+				}
+
+				if (isSpot) {
+					spotLights.push_back(spot);
+				}
+				else {
+					pointLights.push_back(spot.light);
+				}
+				return true;
+			}
+
+			if (tokens.size() < 2) {
+				return Error("missing name after ", keyword);
+			}
+
+			std::string const& name = tokens[1];
+
+			if (keyword == "model") {
+				if (tokens.size() != 3) {
+					return Error("model takes a name and a path");
+				}
+
+				modelIndices[name] = (uint32_t)models.size();
+				models.push_back({ AddString(name), AddString(tokens[2]) });
+				return true;
+			}
+
+			if (keyword == "material") {
+				LevelMaterial material = { AddString(name), 0.f, 1.f };
+
+				for (size_t i = 2; i < tokens.size(); i++) {
+					bool read = true;
+
+					if (tokens[i] == "specular") {
+						read = ReadFloats(tokens, i, &material.specularIntensity, 1);
+					}
+					else if (tokens[i] == "shininess") {
+						read = ReadFloats(tokens, i, &material.shininess, 1);
+					}
+					else {
+						return Error("unknown key ", tokens[i]);
+					}
+
+					if (!read) {
+						return Error("missing values after ", tokens[i]);
+					}
+				}
+
+				materialIndices[name] = (uint32_t)materials.size();
+				materials.push_back(material);
+				return true;
+			}
+
+			if (keyword == "entity") {
+				LevelEntity entity = {};
+				entity.name = AddString(name);
+				entity.model = entity.material = entity.parent = noLevelIndex;
+				entity.rotation[3] = 1.f;
+				entity.scale[0] = entity.scale[1] = entity.scale[2] = 1.f;
+
+				for (size_t i = 2; i < tokens.size(); i++) {
+					std::string const& key = tokens[i];
+					bool read = true;
+
+					if ((key == "model" || key == "material" || key == "parent") && i + 1 >= tokens.size()) {
+						read = false;
+					}
+					else if (key == "model") {
+						if (!Lookup(modelIndices, tokens[++i], entity.model, "unknown model ")) {
+							return false;
+						}
+					}
+					else if (key == "material") {
+						if (!Lookup(materialIndices, tokens[++i], entity.material, "unknown material ")) {
+							return false;
+						}
+					}
+					else if (key == "parent") {
+						if (!Lookup(entityIndices, tokens[++i], entity.parent, "parent not defined before: ")) {
+							return false;
+						}
+					}
+					else if (key == "position") {
+						read = ReadFloats(tokens, i, entity.position, 3);
+					}
+					else if (key == "rotation") {
+						float degrees[3];
+						read = ReadFloats(tokens, i, degrees, 3);
+
+						glm::quat rotation(glm::radians(glm::vec3(degrees[0], degrees[1], degrees[2])));
+						entity.rotation[0] = rotation.x;
+						entity.rotation[1] = rotation.y;
+						entity.rotation[2] = rotation.z;
+						entity.rotation[3] = rotation.w;
+					}
+					else if (key == "scale") {
+						// One value scales evenly.
+						read = ReadFloats(tokens, i, entity.scale, 1);
+						if (read && IsNumber(tokens, i + 1)) {
+							read = ReadFloats(tokens, i, entity.scale + 1, 2);
+						}
+						else {
+							entity.scale[1] = entity.scale[2] = entity.scale[0];
+						}
+					}
+					else {
+						return Error("unknown key ", key);
+					}
+
+					if (!read) {
+						return Error("missing values after ", key);
+					}
+				}
+
+				entityIndices[name] = (uint32_t)entities.size();
+				entities.push_back(entity);
+				return true;
+			}
+
+			return Error("unknown statement ", keyword);
+		}
+
+		bool Parse(std::string const& path)
+		{
+			fileName = path;
+
+			std::ifstream in(path);
+			if (!in) {
+				printf("Failed to open %s\n", path.c_str());
+				return false;
+			}
+
+			std::string line;
+			while (std::getline(in, line)) {
+				lineNumber++;
+
+				size_t comment = line.find('#');
+				if (comment != std::string::npos) {
+					line.resize(comment);
+				}
+
+				std::istringstream stream(line);
+				std::vector<std::string> tokens;
+				std::string token;
+				while (stream >> token) {
+					tokens.push_back(token);
+				}
+
+				if (!tokens.empty() && !ParseStatement(tokens)) {
+					return false;
+				}
+			}
+
+			if (!skybox) {
+				return Error("no skybox");
+			}
+
+			return true;
+		}
+	};
+
+	double GetMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Groups of a mech with nine x-wings circling it, on a square grid.
+	bool Generate(int entityCount, std::string const& path)
+	{
+		std::ofstream out(path);
+		if (!out) {
+			printf("Failed to write %s\n", path.c_str());
+			return false;
+		}
+
+		out << "# Generated by level_compiler --generate " << entityCount << "\n";
+		out << "skybox textures/lightblue/right.tga textures/lightblue/left.tga textures/lightblue/top.tga "
+			"textures/lightblue/bot.tga textures/lightblue/back.tga textures/lightblue/front.tga\n";
+		out << "material glossy specular 4 shininess 256\n";
+		out << "model xwing models/x-wing.obj\n";
+		out << "model mech models/Kaiser.obj\n";
+		out << "directional_light color 0.678 0.847 0.902 ambient 0.1 diffuse 0.9 direction -10 -12 -18.5\n";
+
+		int groups = std::max(entityCount / 10, 1);
+		int columns = (int)sqrtf((float)groups);
+
+		for (int group = 0; group < groups; group++) {
+			out << "entity group" << group << " model mech material glossy position " << (group % columns) * 6 << " -2 "
+				<< -(group / columns) * 6 << " rotation 0 " << (group * 37) % 360 << " 0 scale 0.05\n";
+
+			for (int i = 0; i < 9; i++) {
+				float angle = i * 6.2831853f / 9.f;
+				out << "entity group" << group << "_" << i << " model xwing material glossy parent group" << group
+					<< " position " << cosf(angle) * 60.f << " 40 " << sinf(angle) * 60.f << " rotation 0 " << i * 40 << " 0 scale 0.12\n";
+			}
+		}
+
+		printf("Wrote %d entities to %s\n", groups * 10, path.c_str());
+		return true;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 4 && !strcmp(argv[1], "--generate")) {
+		return Generate(std::max(atoi(argv[2]), 1), argv[3]) ? 0 : 1;
+	}
+
+	if (argc < 3 || (argc == 4 && strcmp(argv[3], "--time")) || argc > 4) {
+		printf("Usage: level_compiler <input.level> <output.lvl> [--time]\n");
+		printf("       level_compiler --generate <entities> <output.level>\n");
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	Compiler compiler;
+	if (!compiler.Parse(argv[1])) {
+		return 1;
+	}
+
+	double parseMilliseconds = GetMilliseconds(start);
+
+	if (!LevelFile::Write(argv[2], compiler.models, compiler.materials, compiler.entities, compiler.directionalLights,
+		compiler.pointLights, compiler.spotLights, compiler.skyboxFaces, compiler.strings)) {
+		return 1;
+	}
+
+	printf("%s: %zu entities, %zu models, %zu materials, %zu lights\n", argv[2], compiler.entities.size(), compiler.models.size(),
+		compiler.materials.size(), compiler.directionalLights.size() + compiler.pointLights.size() + compiler.spotLights.size());
+
+	if (argc == 4) {
+		// The file was just written, so this is a warm cache load.
+		start = std::chrono::steady_clock::now();
+		LevelFile level;
+		if (!level.Load(argv[2])) {
+			return 1;
+		}
+		double loadMilliseconds = GetMilliseconds(start);
+
+		start = std::chrono::steady_clock::now();
+		Scene scene;
+		std::vector<Entity> entities;
+		level.Instantiate(scene, entities);
+		double instantiateMilliseconds = GetMilliseconds(start);
+
+		start = std::chrono::steady_clock::now();
+		scene.UpdateTransforms(nullptr);
+		double updateMilliseconds = GetMilliseconds(start);
+
+		printf("Text: %.3f ms to parse\n", parseMilliseconds);
+		printf("Binary, %.1f KB: %.3f ms to map and check, %.3f ms to create the entities, %.3f ms for their first transforms\n",
+			level.GetSize() / 1024.0, loadMilliseconds, instantiateMilliseconds, updateMilliseconds);
+	}
+
+	return 0;
+}
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+
+#include <assimp\Importer.hpp>
+#include <assimp\scene.h>
+#include <assimp\postprocess.h>
+
+#include <ObjFile.hpp>
+#include <JobPool.hpp>
+
+// Parse throughput of ObjFile against Assimp on the same OBJ files, no GPU or window needed.
+//
+//   obj_benchmark [--threads N] [--runs N] [model.obj]...
+//
+// Both read the file through to welded, triangulated meshes with normals, Assimp with the flags
+// Model used to pass it. Every reader runs --runs times after a warm up, the file stays in the OS
+// cache, and the best run counts. ObjFile runs on the main thread alone, then on job pools of twice
+// as many threads each up to --threads, every hardware thread by default. Speeds are given against
+// ObjFile on one thread. Without files it reads models/x-wing.obj.
+
+namespace {
+
+	struct Result {
+		double milliseconds;
+		size_t vertices;
+		size_t triangles;
+	};
+
+	double GetMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	bool RunObjFile(std::string const& path, JobPool* jobPool, Result& result)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		ObjFile obj;
+		if (!obj.Load(path, jobPool)) {
+			return false;
+		}
+
+		result = { GetMilliseconds(start), obj.GetStats().vertices, obj.GetStats().triangles };
+		return true;
+	}
+
+	bool RunAssimp(std::string const& path, Result& result)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices);
+
+		if (!scene) {
+			printf("Assimp failed to read %s: %s\n", path.c_str(), importer.GetErrorString());
+			return false;
+		}
+
+		result = { GetMilliseconds(start), 0, 0 };
+
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+			result.vertices += scene->mMeshes[i]->mNumVertices;
+			result.triangles += scene->mMeshes[i]->mNumFaces;
+		}
+
+		return true;
+	}
+
+	template<typename F>
+	bool Best(int runs, F run, Result& best)
+	{
+		Result result;
+		if (!run(result)) {
+			return false;
+		}
+
+		best = result;
+		for (int i = 0; i < runs; i++) {
+			if (!run(result)) {
+				return false;
+			}
+			best = result.milliseconds < best.milliseconds ? result : best;
+		}
+
+		return true;
+	}
+
+	void Report(char const* name, size_t bytes, Result const& result, Result const& baseline)
+	{
+		printf("  %-22s %8.2f ms %8.1f MB/s %6.2fx, %zu vertices, %zu triangles\n", name, result.milliseconds,
+			bytes / (1024.0 * 1024.0) / (result.milliseconds / 1000.0), baseline.milliseconds / result.milliseconds,
+			result.vertices, result.triangles);
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int threads = 0;
+	int runs = 10;
+	std::vector<std::string> paths;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			threads = (unsigned int)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--runs") && i + 1 < argc) {
+			runs = std::max(atoi(argv[++i]), 1);
+		}
+		else if (argv[i][0] == '-') {
+			printf("Unknown option %s\n", argv[i]);
+			return 1;
+		}
+		else {
+			paths.push_back(argv[i]);
+		}
+	}
+
+	if (paths.empty()) {
+		paths.push_back("models/x-wing.obj");
+	}
+
+	unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	threads = threads > 0 ? threads : hardwareThreads;
+	printf("%u hardware threads, ObjFile runs on up to %u\n", hardwareThreads, threads);
+
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int count = 2; count < threads; count *= 2) {
+		threadCounts.push_back(count);
+	}
+	if (threads > 1) {
+		threadCounts.push_back(threads);
+	}
+
+	bool failed = false;
+
+	for (auto const& path : paths) {
+		Result serial, assimp;
+
+		if (!Best(runs, [&](Result& result) { return RunObjFile(path, nullptr, result); }, serial)) {
+			failed = true;
+			continue;
+		}
+
+		ObjFile obj;
+		obj.Load(path, nullptr);
+		size_t bytes = obj.GetStats().bytes;
+
+		printf("%s, %.2f MB in %zu chunks\n", path.c_str(), bytes / (1024.0 * 1024.0), obj.GetStats().chunks);
+
+		Report("ObjFile, 1 thread", bytes, serial, serial);
+		Result fastest = serial;
+
+		for (unsigned int count : threadCounts) {
+			// The calling thread works on the pool too.
+			JobPool jobPool;
+			jobPool.Init(count - 1);
+
+			Result pooled;
+			bool read = Best(runs, [&](Result& result) { return RunObjFile(path, &jobPool, result); }, pooled);
+			jobPool.Shutdown();
+
+			if (!read) {
+				failed = true;
+				break;
+			}
+
+			char pooledName[64];
+			snprintf(pooledName, sizeof(pooledName), "ObjFile, %u threads", count);
+			Report(pooledName, bytes, pooled, serial);
+			fastest = pooled.milliseconds < fastest.milliseconds ? pooled : fastest;
+		}
+
+		if (!Best(runs, [&](Result& result) { return RunAssimp(path, result); }, assimp)) {
+			failed = true;
+			continue;
+		}
+
+		Report("Assimp", bytes, assimp, serial);
+		printf("  ObjFile is %.1fx faster than Assimp on one thread, %.1fx at its fastest\n", assimp.milliseconds / serial.milliseconds,
+			assimp.milliseconds / fastest.milliseconds);
+	}
+
+	return failed ? 1 : 0;
+}
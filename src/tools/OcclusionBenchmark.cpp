@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <glm\glm.hpp>
+#include <glm\gtc\matrix_transform.hpp>
+
+#include <OcclusionCuller.hpp>
+#include <JobPool.hpp>
+
+// Times the software occlusion culler on a synthetic street of buildings, no GPU or window needed.
+//
+//   occlusion_benchmark [--threads N] [--frames N] [--buildings N] [--objects N]
+//
+// Rows of buildings line both sides of a street, with a grid of objects behind
+// them. The camera looks down the street, so the objects behind the first rows
+// should be culled and the ones along the street should not.
+
+namespace {
+
+	// A closed box with 12 triangles, the simplest occluder there is.
+	OccluderMesh CreateBox()
+	{
+		OccluderMesh box;
+
+		for (int i = 0; i < 8; i++) {
+			box.positions.push_back(glm::vec3(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f));
+		}
+
+		box.indices = {
+			0, 2, 1, 1, 2, 3,	4, 5, 6, 5, 7, 6,
+			0, 1, 4, 1, 5, 4,	2, 6, 3, 3, 6, 7,
+			0, 4, 2, 2, 4, 6,	1, 3, 5, 3, 7, 5
+		};
+
+		box.center = glm::vec3(0.f);
+		box.radius = glm::length(glm::vec3(0.5f));
+
+		return box;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int threads = 0;
+	int frames = 200;
+	int buildings = 64;
+	int objects = 4096;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			threads = (unsigned int)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+			frames = std::max(atoi(argv[++i]), 1);
+		}
+		else if (!strcmp(argv[i], "--buildings") && i + 1 < argc) {
+			buildings = std::max(atoi(argv[++i]), 1);
+		}
+		else if (!strcmp(argv[i], "--objects") && i + 1 < argc) {
+			objects = std::max(atoi(argv[++i]), 1);
+		}
+		else {
+			printf("Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	JobPool jobPool;
+	jobPool.Init(threads);
+
+	OccluderMesh box = CreateBox();
+
+	// Buildings 8 wide and 12 tall every 10 units on both sides of a 6 unit street along -z.
+	std::vector<glm::mat4> buildingTransforms;
+	for (int i = 0; i < buildings; i++) {
+		float side = i % 2 ? 1.f : -1.f;
+		glm::mat4 transform = glm::translate(glm::mat4(1.f), glm::vec3(side * 7.f, 6.f, -10.f * (i / 2) - 5.f));
+		buildingTransforms.push_back(glm::scale(transform, glm::vec3(8.f, 12.f, 9.f)));
+	}
+
+	// Unit boxes on a square grid centred on the street, most of them behind the buildings.
+	std::vector<glm::mat4> objectTransforms;
+	int columns = (int)sqrtf((float)objects);
+	for (int i = 0; i < objects; i++) {
+		float x = ((i % columns) - columns * 0.5f) * 3.f;
+		float z = -(float)(i / columns) * 3.f - 2.f;
+		objectTransforms.push_back(glm::translate(glm::mat4(1.f), glm::vec3(x, 1.f, z)));
+	}
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.f), (float)OcclusionCuller::width / OcclusionCuller::height, 0.1f, 1000.f);
+	OcclusionCuller culler;
+
+	double rasterMilliseconds = 0.0, testMicroseconds = 0.0;
+	size_t triangles = 0, tested = 0, culled = 0;
+
+	for (int frame = 0; frame < frames; frame++) {
+		// Walks down the street and sways a little, so every frame sees a different buffer.
+		glm::vec3 eye(sinf(frame * 0.05f) * 1.5f, 1.7f, -frame * 0.1f);
+		glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+		glm::mat4 viewProjection = projection * view;
+
+		culler.Begin(viewProjection);
+		for (auto const& transform : buildingTransforms) {
+			culler.AddOccluder(&box, transform);
+		}
+		culler.Rasterize(&jobPool);
+
+		for (auto const& transform : objectTransforms) {
+			culler.IsVisible(viewProjection * transform, glm::vec3(-0.5f), glm::vec3(0.5f));
+		}
+
+		OcclusionStats const& stats = culler.GetStats();
+		rasterMilliseconds += stats.rasterMilliseconds;
+		testMicroseconds += stats.testMicroseconds;
+		triangles += stats.triangles;
+		tested += stats.tested;
+		culled += stats.culled;
+	}
+
+	printf("Occlusion buffer %dx%d in %dx%d tiles, %u threads\n", OcclusionCuller::width, OcclusionCuller::height,
+		OcclusionCuller::tileWidth, OcclusionCuller::tileHeight, jobPool.GetWorkerCount() + 1);
+	printf("Rasterize: %.3f ms per frame, %zu triangles, %.0f triangles per ms\n", rasterMilliseconds / frames, triangles / frames,
+		rasterMilliseconds > 0.0 ? triangles / rasterMilliseconds : 0.0);
+	printf("Test: %zu boxes per frame, %.1f%% culled, %.0f ns per box\n", tested / frames, 100.0 * culled / tested,
+		testMicroseconds * 1000.0 / tested);
+
+	jobPool.Shutdown();
+
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#include <glm\glm.hpp>
+#include <glm\gtc\quaternion.hpp>
+
+#include <Scene.hpp>
+#include <JobPool.hpp>
+
+// Times the scene's per-frame transform update, no GPU or window needed.
+//
+//   scene_benchmark [--threads N] [--frames N] [--entities N] [--children N]
+//
+// Entities come in trees of a spinning root with --children children each, so
+// every frame every root turns and every transform has to be redone. The
+// update runs on the job pool, then on the main thread alone, then once more
+// on the pool with nothing moving.
+
+namespace {
+
+	struct Spin {
+		glm::vec3 axis;
+		float speed;
+	};
+
+	double GetMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int threads = 0;
+	int frames = 200;
+	int entities = 100000;
+	int children = 9;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			threads = (unsigned int)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+			frames = std::max(atoi(argv[++i]), 1);
+		}
+		else if (!strcmp(argv[i], "--entities") && i + 1 < argc) {
+			entities = std::max(atoi(argv[++i]), 1);
+		}
+		else if (!strcmp(argv[i], "--children") && i + 1 < argc) {
+			children = std::max(atoi(argv[++i]), 0);
+		}
+		else {
+			printf("Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	JobPool jobPool;
+	jobPool.Init(threads);
+
+	Scene scene;
+	ComponentPool<Spin>& spins = scene.Components<Spin>();
+
+	// Roots on a square grid, their children in a ring around them.
+	int trees = std::max(entities / (children + 1), 1);
+	int columns = (int)sqrtf((float)trees);
+
+	for (int tree = 0; tree < trees; tree++) {
+		Entity root = scene.Create();
+		scene.SetPosition(root, glm::vec3((tree % columns) * 4.f, 0.f, (tree / columns) * 4.f));
+		spins.Add(root, { glm::normalize(glm::vec3(0.2f, 1.f, (tree % 7) * 0.1f)), 0.5f + (tree % 5) * 0.25f });
+
+		for (int child = 0; child < children; child++) {
+			float angle = child * 6.2831853f / children;
+
+			Entity entity = scene.Create();
+			scene.SetParent(entity, root);
+			scene.SetPosition(entity, glm::vec3(cosf(angle), 0.5f, sinf(angle)) * 1.5f);
+			scene.SetScale(entity, glm::vec3(0.25f));
+		}
+	}
+
+	// Sorts the transforms by depth, which only happens again when entities come, go or change parents.
+	auto start = std::chrono::steady_clock::now();
+	scene.UpdateTransforms(&jobPool);
+	double firstUpdate = GetMilliseconds(start);
+
+	SceneStats const& stats = scene.GetStats();
+	printf("Scene: %zu entities in %zu depths, %d spinning roots, %u threads\n", stats.entities, stats.depths, trees,
+		jobPool.GetWorkerCount() + 1);
+	printf("First update, sorting included: %.3f ms\n", firstUpdate);
+
+	const float deltaTime = 1.f / 60.f;
+
+	auto spin = [&](JobPool* pool) {
+		spins.ForEach(pool, 1024, [&](Entity entity, Spin const& spin) {
+			scene.SetRotation(entity, glm::angleAxis(spin.speed * deltaTime, spin.axis) * scene.GetRotation(entity));
+		});
+	};
+
+	// The same frames with the pool, on this thread only, then standing still.
+	JobPool* pools[] = { &jobPool, nullptr, &jobPool };
+	const char* names[] = { "Moving, job pool", "Moving, one thread", "At rest, job pool" };
+
+	for (int run = 0; run < 3; run++) {
+		double systemMilliseconds = 0.0, updateMilliseconds = 0.0;
+		size_t updated = 0;
+
+		for (int frame = 0; frame < frames; frame++) {
+			start = std::chrono::steady_clock::now();
+			if (run < 2) {
+				spin(pools[run]);
+			}
+			systemMilliseconds += GetMilliseconds(start);
+
+			start = std::chrono::steady_clock::now();
+			scene.UpdateTransforms(pools[run]);
+			updateMilliseconds += GetMilliseconds(start);
+
+			updated += stats.updatedTransforms;
+		}
+
+		double frameMilliseconds = (systemMilliseconds + updateMilliseconds) / frames;
+		printf("%s: %.3f ms per frame, %.3f of it spinning, %zu transforms updated, %.1f M entities per second\n", names[run],
+			frameMilliseconds, systemMilliseconds / frames, updated / frames, stats.entities / (frameMilliseconds * 1e3));
+	}
+
+	jobPool.Shutdown();
+
+	return 0;
+}
@@ -0,0 +1,220 @@
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+#include <stb_image.h>
+
+#include <BlockCompression.hpp>
+#include <MipGenerator.hpp>
+#include <TextureCook.hpp>
+#include <JobPool.hpp>
+
+// Cooks the loose textures into block compressed KTX2 files with full mip chains.
+//
+//   texture_cooker <source dir> <output dir> [--format auto|bc1|bc3|bc5|bc7] [--filter box|kaiser]
+//                  [--alpha-cutoff X] [--threads N] [--report file.mtl]... [--benchmark]
+//
+// The output mirrors the source tree with the extension replaced by .ktx2, which is
+// where Texture looks for a cooked version before falling back to the loose file.
+// --benchmark only times the mip generator and reports megapixels per second per core.
+
+namespace fs = std::filesystem;
+
+static std::string ToLower(std::string text)
+{
+	std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)tolower(c); });
+	return text;
+}
+
+// Times the mip generator alone, once on the calling thread and once across the pool.
+static void BenchmarkMips(std::vector<fs::path> const& sources, CookSettings const& settings, JobPool& jobPool)
+{
+	unsigned int cores = jobPool.GetWorkerCount() + 1;
+
+	for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser }) {
+		double megapixels = 0.0, serialSeconds = 0.0, parallelSeconds = 0.0;
+
+		for (auto const& source : sources) {
+			int width, height, channels;
+			uint8_t* rgba = stbi_load(source.string().c_str(), &width, &height, &channels, 4);
+			if (!rgba) {
+				continue;
+			}
+
+			MipGenerator::Options options = TextureCook::GetMipOptions(source.filename().string(), settings);
+			options.filter = filter;
+
+			auto start = std::chrono::steady_clock::now();
+			MipGenerator::GenerateMips(rgba, width, height, 4, options, nullptr);
+			auto middle = std::chrono::steady_clock::now();
+			MipGenerator::GenerateMips(rgba, width, height, 4, options, &jobPool);
+			auto end = std::chrono::steady_clock::now();
+
+			stbi_image_free(rgba);
+
+			megapixels += (double)width * height / 1e6;
+			serialSeconds += std::chrono::duration<double>(middle - start).count();
+			parallelSeconds += std::chrono::duration<double>(end - middle).count();
+		}
+
+		printf("%-6s %8.1f MP  1 core %7.1f MP/s   %u cores %7.1f MP/s (%.1f MP/s per core)\n",
+			filter == MipFilter::Box ? "box" : "kaiser", megapixels, megapixels / serialSeconds,
+			cores, megapixels / parallelSeconds, megapixels / parallelSeconds / cores);
+	}
+}
+
+// Sums the diffuse maps referenced by a material library, those are the ones the model loader keeps resident.
+static void ReportMaterialLibrary(std::string const& mtlPath, std::map<std::string, CookResult> const& results)
+{
+	std::ifstream file(mtlPath);
+	if (!file.is_open()) {
+		printf("Failed to read %s\n", mtlPath.c_str());
+		return;
+	}
+
+	std::vector<std::string> textures;
+	std::string line;
+
+	while (std::getline(file, line)) {
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line.compare(start, 7, "map_Kd ") != 0) {
+			continue;
+		}
+
+		std::string path = line.substr(start + 7);
+		while (!path.empty() && (path.back() == '\r' || path.back() == ' ')) {
+			path.pop_back();
+		}
+
+		size_t slash = path.find_last_of("\\/");
+		std::string name = ToLower(slash == std::string::npos ? path : path.substr(slash + 1));
+
+		if (!name.empty() && std::find(textures.begin(), textures.end(), name) == textures.end()) {
+			textures.push_back(name);
+		}
+	}
+
+	size_t uncompressed = 0, compressed = 0;
+	unsigned int found = 0;
+
+	for (auto const& name : textures) {
+		auto it = results.find(name);
+		if (it == results.end()) {
+			continue;
+		}
+
+		uncompressed += it->second.uncompressedBytes;
+		compressed += it->second.compressedBytes;
+		found++;
+	}
+
+	printf("%s: %u/%u diffuse textures, VRAM %.2f MB -> %.2f MB (%.1fx)\n", mtlPath.c_str(), found, (unsigned int)textures.size(),
+		uncompressed / (1024.0 * 1024.0), compressed / (1024.0 * 1024.0), compressed ? (double)uncompressed / compressed : 0.0);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		printf("usage: %s <source dir> <output dir> [--format auto|bc1|bc3|bc5|bc7] [--filter box|kaiser] [--alpha-cutoff X]\n"
+			"       [--threads N] [--report file.mtl]... [--benchmark]\n", argv[0]);
+		return 1;
+	}
+
+	fs::path sourceDirectory = argv[1];
+	fs::path outputDirectory = argv[2];
+
+	CookSettings settings = TextureCook::GetDefaultSettings();
+	unsigned int threads = 0;
+	std::vector<std::string> reports;
+	bool benchmark = false;
+
+	for (int i = 3; i < argc; i++) {
+		if (!strcmp(argv[i], "--format") && i + 1 < argc) {
+			settings.format = ToLower(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+			settings.filter = ToLower(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--alpha-cutoff") && i + 1 < argc) {
+			settings.alphaCutoff = (float)atof(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--benchmark")) {
+			benchmark = true;
+		}
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			threads = (unsigned int)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--report") && i + 1 < argc) {
+			reports.push_back(argv[++i]);
+		}
+		else {
+			printf("Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	JobPool jobPool;
+	jobPool.Init(threads);
+
+	std::vector<fs::path> sources;
+	std::error_code ec;
+
+	for (auto const& entry : fs::recursive_directory_iterator(sourceDirectory, ec)) {
+		if (entry.is_regular_file() && TextureCook::IsImage(entry.path().string())) {
+			sources.push_back(entry.path());
+		}
+	}
+
+	std::sort(sources.begin(), sources.end());
+
+	if (benchmark) {
+		BenchmarkMips(sources, settings, jobPool);
+		return 0;
+	}
+
+	std::map<std::string, CookResult> results;
+	size_t totalUncompressed = 0, totalCompressed = 0;
+	int failures = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (auto const& source : sources) {
+		fs::path destination = outputDirectory / source.lexically_relative(sourceDirectory);
+		destination.replace_extension(".ktx2");
+
+		auto fileStart = std::chrono::steady_clock::now();
+
+		CookResult result;
+		if (!TextureCook::Cook(source.string(), destination.string(), settings, jobPool, result)) {
+			failures++;
+			continue;
+		}
+
+		float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - fileStart).count();
+		printf("%-40s %5dx%-5d %s %8.2f MB -> %6.2f MB %8.1f ms\n", result.name.c_str(), result.width, result.height, TextureCook::GetFormatName(result.format),
+			result.uncompressedBytes / (1024.0 * 1024.0), result.compressedBytes / (1024.0 * 1024.0), elapsed);
+
+		totalUncompressed += result.uncompressedBytes;
+		totalCompressed += result.compressedBytes;
+		results[ToLower(result.name)] = result;
+	}
+
+	float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+	printf("Cooked %u textures on %u threads in %.2f s, VRAM %.2f MB -> %.2f MB\n", (unsigned int)results.size(), jobPool.GetWorkerCount() + 1,
+		elapsed, totalUncompressed / (1024.0 * 1024.0), totalCompressed / (1024.0 * 1024.0));
+
+	for (auto const& report : reports) {
+		ReportMaterialLibrary(report, results);
+	}
+
+	return failures ? 1 : 0;
+}